@@ -0,0 +1,290 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/Registry>
+#include <osgEarth/TileKey>
+#include <osg/ArgumentParser>
+#include <osg/Image>
+#include <osg/Timer>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Thread>
+#include <cstdlib>
+#include <vector>
+
+#define LC "[cachebench] "
+
+using namespace osgEarth;
+
+/**
+ * Compares the tile cache drivers on the same workload: write N image
+ * tiles keyed by TileKey, read them all back from several threads, check
+ * record status, then remove half and compact. Every read is checked
+ * against what was written. Drivers whose plugin isn't available are
+ * skipped.
+ *
+ * Each driver gets its own folder under --path; point it at an empty
+ * location, since existing records would skew the numbers.
+ *
+ * --batch sets the leveldb driver's write_batch_size, to compare
+ * write-behind batching with writing each tile as it arrives.
+ *
+ * Usage:
+ *   osgearth_cachebench [--path cachebench] [--tiles 20000] [--size 256]
+ *       [--readers 4] [--batch 1] [--driver pack] [--driver leveldb] ...
+ */
+
+namespace
+{
+    // Cheap per-thread random numbers (rand() is not thread-safe everywhere).
+    struct Random
+    {
+        Random(unsigned seed) : _state(seed*2654435761u + 1u) { }
+        unsigned next() { _state = _state*1664525u + 1013904223u; return _state >> 8; }
+        unsigned _state;
+    };
+
+    // A tile's pixels are derived from its index, so reads can be verified.
+    osg::Image* makeTile(unsigned index, unsigned size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        Random random(index);
+        unsigned* pixels = (unsigned*)image->data();
+        for(unsigned i=0; i<size*size; ++i)
+            pixels[i] = (i & 7u) == 0u ? random.next() : pixels[i > 0u ? i-1u : 0u];
+        pixels[0] = index;
+        return image;
+    }
+
+    bool checkTile(const osg::Image* image, unsigned index, unsigned size)
+    {
+        return
+            image &&
+            (unsigned)image->s() == size &&
+            (unsigned)image->t() == size &&
+            *(const unsigned*)image->data() == index;
+    }
+
+    struct Reader : public OpenThreads::Thread
+    {
+        Reader(CacheBin* bin, const std::vector<std::string>& keys, unsigned ops, unsigned size, unsigned seed) :
+            _bin(bin), _keys(keys), _ops(ops), _size(size), _random(seed), _errors(0u) { }
+
+        void run()
+        {
+            for(unsigned i=0; i<_ops; ++i)
+            {
+                unsigned index = _random.next() % _keys.size();
+                ReadResult r = _bin->readImage( _keys[index] );
+                if ( !r.succeeded() || !checkTile(r.getImage(), index, _size) )
+                    ++_errors;
+            }
+        }
+
+        CacheBin*                       _bin;
+        const std::vector<std::string>& _keys;
+        unsigned                        _ops;
+        unsigned                        _size;
+        Random                          _random;
+        unsigned                        _errors;
+    };
+
+    double elapsed(osg::Timer_t start)
+    {
+        return osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    }
+
+    double rate(unsigned ops, double seconds)
+    {
+        return seconds > 0.0 ? (double)ops/seconds : 0.0;
+    }
+
+    bool runTest(const std::string& driver, const std::string& rootPath,
+                 const std::vector<std::string>& keys, unsigned tileSize, unsigned numReaders,
+                 unsigned batchSize)
+    {
+        Config conf;
+        conf.set( "driver", driver );
+        conf.set( "path", osgDB::concatPaths(rootPath, driver) );
+        conf.set( "write_batch_size", batchSize );
+        CacheOptions options( (ConfigOptions(conf)) );
+
+        osg::ref_ptr<Cache> cache = CacheFactory::create( options );
+        CacheBin* bin = cache.valid() && cache->isOK() ? cache->addBin("cachebench") : 0L;
+        if ( !bin )
+        {
+            OE_NOTICE << LC << driver << ": not available, skipping" << std::endl;
+            return true;
+        }
+
+        unsigned errors = 0u;
+        unsigned numTiles = keys.size();
+
+        // the encoded tiles would dwarf the cache cost, so build them up front.
+        std::vector< osg::ref_ptr<osg::Image> > tiles;
+        for(unsigned i=0; i<numTiles; ++i)
+            tiles.push_back( makeTile(i, tileSize) );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<numTiles; ++i)
+        {
+            if ( !bin->write(keys[i], tiles[i].get(), Config()) )
+                ++errors;
+        }
+        double writeTime = elapsed(start);
+        tiles.clear();
+
+        std::vector<Reader*> readers;
+        for(unsigned i=0; i<numReaders; ++i)
+            readers.push_back( new Reader(bin, keys, numTiles, tileSize, i+1u) );
+
+        start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<readers.size(); ++i) readers[i]->start();
+        for(unsigned i=0; i<readers.size(); ++i) readers[i]->join();
+        double readTime = elapsed(start);
+
+        for(unsigned i=0; i<readers.size(); ++i)
+        {
+            errors += readers[i]->_errors;
+            delete readers[i];
+        }
+
+        start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<numTiles; ++i)
+        {
+            if ( bin->getRecordStatus(keys[i]) != CacheBin::STATUS_OK )
+                ++errors;
+        }
+        double statusTime = elapsed(start);
+
+        off_t fullSize = cache->getApproximateSize();
+
+        start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<numTiles; i+=2u)
+        {
+            if ( !bin->remove(keys[i]) )
+                ++errors;
+        }
+        double removeTime = elapsed(start);
+
+        start = osg::Timer::instance()->tick();
+        bin->compact();
+        double compactTime = elapsed(start);
+
+        off_t compactSize = cache->getApproximateSize();
+
+        // the survivors must still read back, and the removed must stay gone.
+        for(unsigned i=0; i<numTiles; ++i)
+        {
+            bool found = bin->getRecordStatus(keys[i]) == CacheBin::STATUS_OK;
+            if ( found != ((i & 1u) == 1u) )
+                ++errors;
+        }
+        for(unsigned i=1u; i<numTiles; i+=97u)
+        {
+            ReadResult r = bin->readImage(keys[i]);
+            if ( !r.succeeded() || !checkTile(r.getImage(), i, tileSize) )
+                ++errors;
+        }
+
+        OE_NOTICE << LC << driver
+            << ": writes/sec = " << rate(numTiles, writeTime)
+            << ", reads/sec = " << rate(numTiles*numReaders, readTime)
+            << ", status/sec = " << rate(numTiles, statusTime)
+            << ", removes/sec = " << rate(numTiles/2u, removeTime)
+            << ", compact = " << compactTime << "s"
+            << ", size = " << (fullSize/1048576) << " MB -> " << (compactSize/1048576) << " MB"
+            << ", errors = " << errors
+            << std::endl;
+
+        bin->clear();
+
+        return errors == 0u;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    std::string rootPath = "cachebench";
+    arguments.read("--path", rootPath);
+
+    unsigned numTiles = 20000u;
+    arguments.read("--tiles", numTiles);
+    if ( numTiles < 2u ) numTiles = 2u;
+
+    unsigned tileSize = 256u;
+    arguments.read("--size", tileSize);
+    if ( tileSize < 1u ) tileSize = 1u;
+
+    unsigned numReaders = 4u;
+    arguments.read("--readers", numReaders);
+    if ( numReaders == 0u ) numReaders = 1u;
+
+    unsigned batchSize = 1u;
+    arguments.read("--batch", batchSize);
+
+    std::vector<std::string> drivers;
+    std::string driver;
+    while( arguments.read("--driver", driver) )
+        drivers.push_back( driver );
+    if ( drivers.empty() )
+    {
+        drivers.push_back( "filesystem" );
+        drivers.push_back( "leveldb" );
+        drivers.push_back( "pack" );
+    }
+
+    // keys as the terrain engine makes them, deepest LODs last.
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    std::vector<std::string> keys;
+    for(unsigned lod=0; keys.size() < numTiles; ++lod)
+    {
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        for(unsigned y=0; y<ty && keys.size() < numTiles; ++y)
+            for(unsigned x=0; x<tx && keys.size() < numTiles; ++x)
+                keys.push_back( TileKey(lod, x, y, profile).str() );
+    }
+
+    OE_NOTICE << LC << "Tiles = " << keys.size() << ", size = " << tileSize << "x" << tileSize
+        << ", readers = " << numReaders << ", batch = " << batchSize
+        << ", path = " << rootPath << std::endl;
+
+    bool ok = true;
+    for(unsigned i=0; i<drivers.size(); ++i)
+        ok = runTest( drivers[i], rootPath, keys, tileSize, numReaders, batchSize ) && ok;
+
+    if ( !ok )
+    {
+        OE_WARN << LC << "Validation FAILED" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/Decluttering>
+#include <osgEarth/StringUtils>
+#include <osgEarthAnnotation/LabelNode>
+#include <osgEarthSymbology/Style>
+#include <osgEarthSymbology/TextSymbol>
+#include <osg/ArgumentParser>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+#include <osgViewer/Viewer>
+#include <cstdlib>
+#include <algorithm>
+
+#define LC "[declutterbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+using namespace osgEarth::Symbology;
+
+/**
+ * Renders N synthetic labels in an offscreen (pbuffer) window with
+ * decluttering enabled, and reports the average frame and cull times.
+ * The camera slides a little every frame so that the declutter sort
+ * does real work each pass. The same scene is then rendered with
+ * decluttering disabled to give a baseline.
+ *
+ * Usage:
+ *   osgearth_declutterbench [--labels 20000] [--frames 200]
+ *       [--width 1920] [--height 1080]
+ */
+
+struct Result
+{
+    double frameMS;
+    double cullMS;
+};
+
+Result
+run(osgViewer::Viewer& viewer, unsigned frames)
+{
+    osg::Camera* cam = viewer.getCamera();
+    osg::Stats* stats = cam->getStats();
+
+    // warm up: first frames compile GL objects and fill the declutter memory.
+    for(unsigned i=0; i<10; ++i)
+        viewer.frame();
+
+    unsigned firstFrame = viewer.getFrameStamp()->getFrameNumber();
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<frames; ++i)
+    {
+        double t = (double)i / (double)frames;
+        cam->setViewMatrixAsLookAt(
+            osg::Vec3d(t*50.0, t*25.0, 1000.0),
+            osg::Vec3d(t*50.0, t*25.0, 0.0),
+            osg::Vec3d(0.0, 1.0, 0.0));
+        viewer.advance();
+        viewer.eventTraversal();
+        viewer.updateTraversal();
+        viewer.renderingTraversals();
+    }
+    osg::Timer_t end = osg::Timer::instance()->tick();
+
+    unsigned lastFrame = viewer.getFrameStamp()->getFrameNumber();
+
+    Result r;
+    r.frameMS = 1000.0 * osg::Timer::instance()->delta_s(start, end) / (double)frames;
+    r.cullMS  = 0.0;
+
+    double cullSec = 0.0;
+    if ( stats && stats->getAveragedAttribute(
+        std::max(firstFrame, stats->getEarliestFrameNumber()),
+        std::min(lastFrame, stats->getLatestFrameNumber()),
+        "Cull traversal time taken",
+        cullSec) )
+    {
+        r.cullMS = 1000.0 * cullSec;
+    }
+
+    return r;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numLabels = 20000u;
+    arguments.read("--labels", numLabels);
+
+    unsigned numFrames = 200u;
+    arguments.read("--frames", numFrames);
+
+    int width = 1920, height = 1080;
+    arguments.read("--width", width);
+    arguments.read("--height", height);
+
+    // offscreen window so the benchmark can run without a display.
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits();
+    traits->x = 0;
+    traits->y = 0;
+    traits->width = width;
+    traits->height = height;
+    traits->pbuffer = true;
+    traits->doubleBuffer = false;
+    traits->sharedContext = 0L;
+
+    osg::ref_ptr<osg::GraphicsContext> gc = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if ( !gc.valid() )
+    {
+        OE_WARN << LC << "Failed to create an offscreen graphics context" << std::endl;
+        return -1;
+    }
+
+    // synthetic labels scattered over a plane, each under its own transform.
+    Style style;
+    TextSymbol* text = style.getOrCreate<TextSymbol>();
+    text->size() = 16.0f;
+    text->declutter() = true;
+
+    osg::Group* root = new osg::Group();
+    srand(1);
+    for(unsigned i=0; i<numLabels; ++i)
+    {
+        osg::MatrixTransform* xform = new osg::MatrixTransform();
+        xform->setMatrix( osg::Matrix::translate(
+            -1000.0 + 2000.0*(double)rand()/(double)RAND_MAX,
+            -600.0  + 1200.0*(double)rand()/(double)RAND_MAX,
+            0.0) );
+        xform->addChild( new LabelNode(Stringify() << "Label " << i, style) );
+        root->addChild( xform );
+    }
+
+    osgViewer::Viewer viewer(arguments);
+    viewer.setThreadingModel( osgViewer::Viewer::SingleThreaded );
+    viewer.getCamera()->setGraphicsContext( gc.get() );
+    viewer.getCamera()->setViewport( new osg::Viewport(0, 0, width, height) );
+    viewer.getCamera()->setProjectionMatrixAsPerspective( 60.0, (double)width/(double)height, 1.0, 10000.0 );
+    viewer.getCamera()->setViewMatrixAsLookAt( osg::Vec3d(0,0,1000), osg::Vec3d(0,0,0), osg::Vec3d(0,1,0) );
+    viewer.getCamera()->getStats()->collectStats( "rendering", true );
+    viewer.setSceneData( root );
+    viewer.realize();
+
+    OE_NOTICE << LC << "Labels = " << numLabels << ", frames = " << numFrames
+        << ", window = " << width << "x" << height << std::endl;
+
+    Decluttering::setEnabled( true );
+    Result on = run( viewer, numFrames );
+    OE_NOTICE << LC << "Declutter on:  frame = " << on.frameMS << "ms, cull = " << on.cullMS << "ms" << std::endl;
+
+    Decluttering::setEnabled( false );
+    Result off = run( viewer, numFrames );
+    OE_NOTICE << LC << "Declutter off: frame = " << off.frameMS << "ms, cull = " << off.cullMS << "ms" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/ElevationQuery>
+#include <osgEarth/Random>
+#include <osgEarth/StringUtils>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#define LC "[elevationbench] "
+
+using namespace osgEarth;
+
+/**
+ * Measures ElevationQuery throughput (points per second) of the batched
+ * query for 1..N tile fetch threads, against the point-at-a-time query.
+ * Each run starts with an empty tile cache.
+ *
+ * Usage:
+ *   osgearth_elevationbench file.earth [--points 100000] [--threads 8]
+ *       [--bounds xmin ymin xmax ymax] [--resolution r] [--seed n]
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE << msg << std::endl
+        << "USAGE: osgearth_elevationbench file.earth" << std::endl
+        << "    --points <n>                 : number of query points (default 100000)" << std::endl
+        << "    --threads <n>                : maximum number of fetch threads (default 8)" << std::endl
+        << "    --bounds <xmin ymin xmax ymax> : lat/long area to sample (default: whole map)" << std::endl
+        << "    --resolution <r>             : desired resolution, map units (default best available)" << std::endl
+        << "    --seed <n>                   : random seed (default 0)" << std::endl;
+    return -1;
+}
+
+void
+report(const std::string& label, unsigned numPoints, unsigned numOK, double seconds)
+{
+    OE_NOTICE << LC
+        << label
+        << ", points = " << numPoints
+        << ", ok = " << numOK
+        << ", time = " << seconds << "s"
+        << ", points/sec = " << (seconds > 0.0 ? (double)numPoints/seconds : 0.0)
+        << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numPoints = 100000u;
+    arguments.read("--points", numPoints);
+
+    unsigned maxThreads = 8u;
+    arguments.read("--threads", maxThreads);
+
+    double resolution = 0.0;
+    arguments.read("--resolution", resolution);
+
+    unsigned seed = 0u;
+    arguments.read("--seed", seed);
+
+    double xmin = -180.0, ymin = -90.0, xmax = 180.0, ymax = 90.0;
+    bool hasBounds = arguments.read("--bounds", xmin, ymin, xmax, ymax);
+
+    osg::ref_ptr<MapNode> mapNode = MapNode::load( arguments );
+    if ( !mapNode.valid() )
+        return usage("Unable to load earth model.");
+
+    const Map* map = mapNode->getMap();
+    const SpatialReference* geoSRS = map->getProfile()->getSRS()->getGeographicSRS();
+
+    if ( !hasBounds )
+    {
+        GeoExtent extent = map->getProfile()->getExtent().transform( geoSRS );
+        xmin = extent.xMin(), ymin = extent.yMin(), xmax = extent.xMax(), ymax = extent.yMax();
+    }
+
+    Random prng( seed );
+    std::vector<osg::Vec3d> points;
+    points.reserve( numPoints );
+    for(unsigned i = 0; i < numPoints; ++i)
+    {
+        points.push_back( osg::Vec3d(
+            xmin + prng.next()*(xmax-xmin),
+            ymin + prng.next()*(ymax-ymin),
+            0.0) );
+    }
+
+    OE_NOTICE << LC << numPoints << " points in ("
+        << xmin << ", " << ymin << ") - (" << xmax << ", " << ymax << ")" << std::endl;
+
+    // baseline: one point at a time.
+    {
+        ElevationQuery query( map );
+
+        unsigned numOK = 0;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < numPoints; ++i)
+        {
+            double elevation;
+            if ( query.getElevation(GeoPoint(geoSRS, points[i], ALTMODE_ABSOLUTE), elevation, resolution) )
+                ++numOK;
+        }
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        report( "single", numPoints, numOK, seconds );
+    }
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; ++numThreads)
+    {
+        ElevationQuery query( map );
+        query.setNumBatchThreads( numThreads );
+
+        std::vector<double> elevations;
+        std::vector<ElevationQuery::Status> status;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        query.getElevationsBatch( points, geoSRS, elevations, 0L, &status, resolution );
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        unsigned numOK = 0;
+        for(unsigned i = 0; i < status.size(); ++i)
+        {
+            if ( status[i] == ElevationQuery::STATUS_OK )
+                ++numOK;
+        }
+
+        report( Stringify() << "batch, threads = " << numThreads, numPoints, numOK, seconds );
+    }
+
+    return 0;
+}
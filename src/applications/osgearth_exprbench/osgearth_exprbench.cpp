@@ -0,0 +1,147 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/StringUtils>
+#include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/CompiledExpression>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#define LC "[exprbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+/**
+ * Compares per-feature expression evaluation (Feature::eval) against
+ * expressions compiled once against the feature schema, for a numeric
+ * and a string expression, reporting features per second for each.
+ *
+ * Usage:
+ *   osgearth_exprbench [--features 1000000]
+ *       [--numeric "[height] * 1.5 + max([levels], 1) * 3"]
+ *       [--string "[name] + \" (\" + [kind] + \")\""]
+ */
+
+void
+report(const std::string& label, unsigned numFeatures, double seconds)
+{
+    OE_NOTICE << LC
+        << label
+        << ", features = " << numFeatures
+        << ", time = " << seconds << "s"
+        << ", features/sec = " << (seconds > 0.0 ? (double)numFeatures/seconds : 0.0)
+        << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numFeatures = 1000000u;
+    arguments.read("--features", numFeatures);
+
+    std::string numericSrc = "[height] * 1.5 + max([levels], 1) * 3 + 2 * 4";
+    arguments.read("--numeric", numericSrc);
+
+    std::string stringSrc = "[name] + \" (\" + [kind] + \")\"";
+    arguments.read("--string", stringSrc);
+
+    FeatureSchema schema;
+    schema["name"]   = ATTRTYPE_STRING;
+    schema["kind"]   = ATTRTYPE_STRING;
+    schema["height"] = ATTRTYPE_DOUBLE;
+    schema["levels"] = ATTRTYPE_INT;
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+
+    FeatureList features;
+    for(unsigned i = 0; i < numFeatures; ++i)
+    {
+        PointSet* geom = new PointSet();
+        geom->push_back( osg::Vec3d(0, 0, 0) );
+
+        Feature* feature = new Feature( geom, srs, Style(), i );
+        feature->set( "name",   Stringify() << "building " << i );
+        feature->set( "kind",   i % 3 == 0 ? std::string("residential") : std::string("commercial") );
+        feature->set( "height", 3.0 + (double)(i % 97) );
+        feature->set( "levels", (int)(i % 11) );
+        features.push_back( feature );
+    }
+
+    OE_NOTICE << LC << numFeatures << " features" << std::endl;
+
+    // numeric:
+    {
+        NumericExpression expr( numericSrc );
+        std::vector<double> baseline;
+        baseline.reserve( numFeatures );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+            baseline.push_back( i->get()->eval(expr) );
+        report( "numeric, Feature::eval", numFeatures, osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) );
+
+        std::vector<double> compiled;
+        start = osg::Timer::instance()->tick();
+        CompiledNumericExpression program( expr, schema );
+        program.eval( features, compiled );
+        report( "numeric, compiled", numFeatures, osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) );
+
+        unsigned mismatches = 0;
+        for(unsigned i = 0; i < numFeatures; ++i)
+            if ( baseline[i] != compiled[i] )
+                ++mismatches;
+        if ( mismatches > 0 )
+            OE_WARN << LC << "numeric results differ for " << mismatches << " features" << std::endl;
+    }
+
+    // string:
+    {
+        StringExpression expr( stringSrc );
+        std::vector<std::string> baseline;
+        baseline.reserve( numFeatures );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+            baseline.push_back( i->get()->eval(expr) );
+        report( "string, Feature::eval", numFeatures, osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) );
+
+        std::vector<std::string> compiled;
+        start = osg::Timer::instance()->tick();
+        CompiledStringExpression program( expr, schema );
+        program.eval( features, compiled );
+        report( "string, compiled", numFeatures, osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) );
+
+        unsigned mismatches = 0;
+        for(unsigned i = 0; i < numFeatures; ++i)
+            if ( baseline[i] != compiled[i] )
+                ++mismatches;
+        if ( mismatches > 0 )
+            OE_WARN << LC << "string results differ for " << mismatches << " features" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/Registry>
+#include <osgEarth/TileSource>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarthDrivers/gdal/GDALOptions>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+
+#define LC "[gdalbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+/**
+ * Measures GDAL tile source throughput (tiles per second) for 1..N reader
+ * threads, in either concurrent (per-thread dataset) or serialized mode.
+ *
+ * Usage:
+ *   osgearth_gdalbench --url data.tif [--lod 8] [--threads 8] [--elevation] [--serialized]
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE << msg << std::endl
+        << "USAGE: osgearth_gdalbench" << std::endl
+        << "    --url <file>      : GDAL dataset to read" << std::endl
+        << "    --lod <n>         : level of detail to read (default 8)" << std::endl
+        << "    --threads <n>     : maximum number of reader threads (default 8)" << std::endl
+        << "    --elevation       : read heightfields instead of images" << std::endl
+        << "    --serialized      : disable concurrent access (global GDAL lock)" << std::endl;
+    return -1;
+}
+
+struct KeyQueue
+{
+    KeyQueue(const std::vector<TileKey>& keys) : _keys(keys), _next(0) { }
+
+    bool next(TileKey& key)
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if ( _next >= _keys.size() )
+            return false;
+        key = _keys[_next++];
+        return true;
+    }
+
+    const std::vector<TileKey>& _keys;
+    unsigned                    _next;
+    Threading::Mutex            _mutex;
+};
+
+struct ReaderThread : public OpenThreads::Thread
+{
+    ReaderThread(TileSource* source, KeyQueue& queue, bool elevation)
+        : _source(source), _queue(queue), _elevation(elevation), _count(0) { }
+
+    void run()
+    {
+        TileKey key;
+        while( _queue.next(key) )
+        {
+            if ( _elevation )
+            {
+                osg::ref_ptr<osg::HeightField> hf = _source->createHeightField(key);
+            }
+            else
+            {
+                osg::ref_ptr<osg::Image> image = _source->createImage(key);
+            }
+            ++_count;
+        }
+    }
+
+    TileSource* _source;
+    KeyQueue&   _queue;
+    bool        _elevation;
+    unsigned    _count;
+};
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    std::string url;
+    if ( !arguments.read("--url", url) )
+        return usage("Missing required --url");
+
+    unsigned lod = 8u;
+    arguments.read("--lod", lod);
+
+    unsigned maxThreads = 8u;
+    arguments.read("--threads", maxThreads);
+
+    bool elevation  = arguments.read("--elevation");
+    bool serialized = arguments.read("--serialized");
+
+    GDALOptions options;
+    options.url() = url;
+    options.concurrent() = !serialized;
+    // bypass the L2 cache and any external cache so we measure GDAL itself
+    options.L2CacheSize() = 0;
+
+    osg::ref_ptr<TileSource> source = TileSourceFactory::create(options);
+    if ( !source.valid() )
+        return usage("Failed to create the GDAL tile source");
+
+    const TileSource::Status& status = source->open();
+    if ( status.isError() )
+        return usage(Stringify() << "Failed to open " << url << ": " << status.message());
+
+    std::vector<TileKey> keys;
+    source->getProfile()->getIntersectingTiles(source->getDataExtentsUnion(), lod, keys);
+    if ( keys.empty() )
+        return usage("No tiles at the requested LOD");
+
+    OE_NOTICE << LC << keys.size() << " tiles at LOD " << lod
+        << (serialized ? " (serialized)" : " (concurrent)") << std::endl;
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; ++numThreads)
+    {
+        KeyQueue queue(keys);
+
+        std::vector<ReaderThread*> threads;
+        for(unsigned i=0; i<numThreads; ++i)
+            threads.push_back( new ReaderThread(source.get(), queue, elevation) );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned i=0; i<numThreads; ++i)
+            threads[i]->start();
+
+        unsigned total = 0;
+        for(unsigned i=0; i<numThreads; ++i)
+        {
+            threads[i]->join();
+            total += threads[i]->_count;
+            delete threads[i];
+        }
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        OE_NOTICE << LC
+            << "threads = " << numThreads
+            << ", tiles = " << total
+            << ", time = " << seconds << "s"
+            << ", tiles/sec = " << (seconds > 0.0 ? (double)total/seconds : 0.0)
+            << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,314 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarthFeatures/FeatureSource>
+#include <osgEarthFeatures/FeatureCursor>
+#include <osgEarthDrivers/feature_ogr/OGRFeatureOptions>
+#include <osg/ArgumentParser>
+#include <osg/Math>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <ogr_api.h>
+#include <ogr_srs_api.h>
+#include <cmath>
+#include <vector>
+
+#define LC "[ogrbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Drivers;
+using namespace osgEarth::Symbology;
+
+/**
+ * Measures how feature tile loading from an OGR feature source scales with
+ * the number of threads. Writes a synthetic shapefile (a grid of polygons
+ * with a few attributes), splits its extent into tiles, and reads every tile
+ * through a feature cursor from 1..N threads, in either concurrent
+ * (per-thread datasource) or serialized (global GDAL lock) mode. Every run
+ * must read the same number of features.
+ *
+ * Usage:
+ *   osgearth_ogrbench [--out ogrbench.shp] [--features 100000] [--vertices 32]
+ *       [--tiles 16] [--threads 8] [--serialized]
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE << msg << std::endl
+        << "USAGE: osgearth_ogrbench" << std::endl
+        << "    --out <file>      : shapefile to write (default ogrbench.shp)" << std::endl
+        << "    --features <n>    : number of polygons (default 100000)" << std::endl
+        << "    --vertices <n>    : vertices per polygon (default 32)" << std::endl
+        << "    --tiles <n>       : tiles per side to read (default 16)" << std::endl
+        << "    --threads <n>     : maximum number of reader threads (default 8)" << std::endl
+        << "    --serialized      : only run with the global GDAL lock" << std::endl;
+    return -1;
+}
+
+namespace
+{
+    // extent of the synthetic data, in degrees.
+    const double XMIN = 0.0, YMIN = 0.0, XMAX = 10.0, YMAX = 10.0;
+
+    bool writeShapefile(const std::string& path, unsigned numFeatures, unsigned numVerts)
+    {
+        GDAL_SCOPED_LOCK;
+
+        OGRSFDriverH driver = OGRGetDriverByName( "ESRI Shapefile" );
+        if ( !driver )
+            return false;
+
+        OGR_Dr_DeleteDataSource( driver, path.c_str() );
+
+        OGRDataSourceH ds = OGR_Dr_CreateDataSource( driver, path.c_str(), 0L );
+        if ( !ds )
+            return false;
+
+        OGRSpatialReferenceH srs = OSRNewSpatialReference( 0L );
+        OSRSetWellKnownGeogCS( srs, "WGS84" );
+
+        OGRLayerH layer = OGR_DS_CreateLayer( ds, "ogrbench", srs, wkbPolygon, 0L );
+        OSRDestroySpatialReference( srs );
+        if ( !layer )
+        {
+            OGR_DS_Destroy( ds );
+            return false;
+        }
+
+        const char*  names[] = { "id", "name", "height" };
+        OGRFieldType types[] = { OFTInteger, OFTString, OFTReal };
+        for(unsigned i=0; i<3; ++i)
+        {
+            OGRFieldDefnH field = OGR_Fld_Create( names[i], types[i] );
+            OGR_L_CreateField( layer, field, 1 );
+            OGR_Fld_Destroy( field );
+        }
+
+        unsigned side = (unsigned)ceil( sqrt((double)numFeatures) );
+        double   dx   = (XMAX-XMIN)/(double)side;
+        double   dy   = (YMAX-YMIN)/(double)side;
+        double   r    = 0.4 * osg::minimum(dx, dy);
+
+        for(unsigned i=0; i<numFeatures; ++i)
+        {
+            double cx = XMIN + dx*((double)(i % side) + 0.5);
+            double cy = YMIN + dy*((double)(i / side) + 0.5);
+
+            OGRGeometryH ring = OGR_G_CreateGeometry( wkbLinearRing );
+            for(unsigned v=0; v<=numVerts; ++v)
+            {
+                double a = 2.0*osg::PI*(double)(v % numVerts)/(double)numVerts;
+                OGR_G_AddPoint_2D( ring, cx + r*cos(a), cy + r*sin(a) );
+            }
+            OGRGeometryH polygon = OGR_G_CreateGeometry( wkbPolygon );
+            OGR_G_AddGeometryDirectly( polygon, ring );
+
+            OGRFeatureH feature = OGR_F_Create( OGR_L_GetLayerDefn(layer) );
+            OGR_F_SetFieldInteger( feature, 0, (int)i );
+            OGR_F_SetFieldString ( feature, 1, (Stringify() << "feature_" << i).c_str() );
+            OGR_F_SetFieldDouble ( feature, 2, (double)(i % 100) );
+            OGR_F_SetGeometryDirectly( feature, polygon );
+            OGR_L_CreateFeature( layer, feature );
+            OGR_F_Destroy( feature );
+        }
+
+        OGR_DS_Destroy( ds );
+        return true;
+    }
+
+    struct TileQueue
+    {
+        TileQueue(const std::vector<Bounds>& tiles) : _tiles(tiles), _next(0) { }
+
+        bool next(Bounds& tile)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            if ( _next >= _tiles.size() )
+                return false;
+            tile = _tiles[_next++];
+            return true;
+        }
+
+        const std::vector<Bounds>& _tiles;
+        unsigned                   _next;
+        Threading::Mutex           _mutex;
+    };
+
+    struct ReaderThread : public OpenThreads::Thread
+    {
+        ReaderThread(FeatureSource* source, TileQueue& queue)
+            : _source(source), _queue(queue), _tiles(0), _features(0) { }
+
+        void run()
+        {
+            Bounds tile;
+            while( _queue.next(tile) )
+            {
+                Query query;
+                query.bounds() = tile;
+
+                osg::ref_ptr<FeatureCursor> cursor = _source->createFeatureCursor( query );
+                while( cursor.valid() && cursor->hasMore() )
+                {
+                    if ( cursor->nextFeature() )
+                        ++_features;
+                }
+                ++_tiles;
+            }
+        }
+
+        FeatureSource* _source;
+        TileQueue&     _queue;
+        unsigned       _tiles;
+        unsigned       _features;
+    };
+
+    // returns the number of features read on the first run, or -1 on failure.
+    int runTest(const std::string& path, const std::vector<Bounds>& tiles, unsigned maxThreads, bool concurrent)
+    {
+        OGRFeatureOptions options;
+        options.url() = path;
+        options.buildSpatialIndex() = true;
+        options.concurrent() = concurrent;
+
+        osg::ref_ptr<FeatureSource> source = FeatureSourceFactory::create( options );
+        if ( !source.valid() )
+            return -1;
+
+        source->initialize();
+        if ( !source->getFeatureProfile() )
+            return -1;
+
+        int expected = -1;
+
+        for(unsigned numThreads = 1; numThreads <= maxThreads; ++numThreads)
+        {
+            TileQueue queue(tiles);
+
+            std::vector<ReaderThread*> threads;
+            for(unsigned i=0; i<numThreads; ++i)
+                threads.push_back( new ReaderThread(source.get(), queue) );
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+
+            for(unsigned i=0; i<numThreads; ++i)
+                threads[i]->start();
+
+            unsigned numTiles = 0, numFeatures = 0;
+            for(unsigned i=0; i<numThreads; ++i)
+            {
+                threads[i]->join();
+                numTiles    += threads[i]->_tiles;
+                numFeatures += threads[i]->_features;
+                delete threads[i];
+            }
+
+            double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+            OE_NOTICE << LC
+                << (concurrent ? "concurrent" : "serialized")
+                << ": threads = " << numThreads
+                << ", tiles = " << numTiles
+                << ", features = " << numFeatures
+                << ", time = " << seconds << "s"
+                << ", tiles/sec = " << (seconds > 0.0 ? (double)numTiles/seconds : 0.0)
+                << ", features/sec = " << (seconds > 0.0 ? (double)numFeatures/seconds : 0.0)
+                << std::endl;
+
+            if ( expected < 0 )
+                expected = (int)numFeatures;
+            else if ( expected != (int)numFeatures )
+                return -1;
+        }
+
+        return expected;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    std::string path = "ogrbench.shp";
+    arguments.read("--out", path);
+
+    unsigned numFeatures = 100000u;
+    arguments.read("--features", numFeatures);
+    if ( numFeatures < 1u ) numFeatures = 1u;
+
+    unsigned numVerts = 32u;
+    arguments.read("--vertices", numVerts);
+    if ( numVerts < 3u ) numVerts = 3u;
+
+    unsigned tilesPerSide = 16u;
+    arguments.read("--tiles", tilesPerSide);
+    if ( tilesPerSide < 1u ) tilesPerSide = 1u;
+
+    unsigned maxThreads = 8u;
+    arguments.read("--threads", maxThreads);
+    if ( maxThreads < 1u ) maxThreads = 1u;
+
+    bool serializedOnly = arguments.read("--serialized");
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    if ( !writeShapefile(path, numFeatures, numVerts) )
+        return usage(Stringify() << "Failed to write " << path);
+
+    OE_NOTICE << LC << "Wrote " << numFeatures << " polygons to " << path << " in "
+        << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << "s" << std::endl;
+
+    std::vector<Bounds> tiles;
+    double tw = (XMAX-XMIN)/(double)tilesPerSide;
+    double th = (YMAX-YMIN)/(double)tilesPerSide;
+    for(unsigned y=0; y<tilesPerSide; ++y)
+        for(unsigned x=0; x<tilesPerSide; ++x)
+            tiles.push_back( Bounds(XMIN+tw*x, YMIN+th*y, XMIN+tw*(x+1), YMIN+th*(y+1)) );
+
+    int serialized = runTest(path, tiles, maxThreads, false);
+    if ( serialized < 0 )
+    {
+        OE_WARN << LC << "Validation FAILED (serialized)" << std::endl;
+        return -1;
+    }
+
+    if ( !serializedOnly )
+    {
+        int concurrent = runTest(path, tiles, maxThreads, true);
+        if ( concurrent != serialized )
+        {
+            OE_WARN << LC << "Validation FAILED (concurrent)" << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/Random>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarthUtil/TerrainProfile>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+
+#define LC "[profilebench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+/**
+ * Measures TerrainProfileEngine throughput (profiles per second) over a set
+ * of random routes: one request per route from 1..N threads sharing an
+ * engine, and then all routes in a single batched request, twice on the
+ * same engine so the second one runs warm. Every run must produce the same
+ * number of samples.
+ *
+ * Usage:
+ *   osgearth_profilebench file.earth [--profiles 10000] [--length 20000]
+ *       [--spacing 30] [--rhumb] [--threads 8]
+ *       [--bounds xmin ymin xmax ymax] [--seed n]
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE << msg << std::endl
+        << "USAGE: osgearth_profilebench file.earth" << std::endl
+        << "    --profiles <n>               : number of routes (default 10000)" << std::endl
+        << "    --length <m>                 : maximum route length, meters (default 20000)" << std::endl
+        << "    --spacing <m>                : sample spacing, meters (default 30)" << std::endl
+        << "    --rhumb                      : follow rhumb lines instead of great circles" << std::endl
+        << "    --threads <n>                : maximum number of threads (default 8)" << std::endl
+        << "    --bounds <xmin ymin xmax ymax> : lat/long area for the routes (default: whole map)" << std::endl
+        << "    --seed <n>                   : random seed (default 0)" << std::endl;
+    return -1;
+}
+
+namespace
+{
+    struct RouteQueue
+    {
+        RouteQueue(const std::vector< std::vector<GeoPoint> >& routes) : _routes(routes), _next(0) { }
+
+        bool next(unsigned& index)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            if ( _next >= _routes.size() )
+                return false;
+            index = _next++;
+            return true;
+        }
+
+        const std::vector< std::vector<GeoPoint> >& _routes;
+        unsigned                                    _next;
+        Threading::Mutex                            _mutex;
+    };
+
+    struct ProfileThread : public OpenThreads::Thread
+    {
+        ProfileThread(const TerrainProfileEngine* engine, const MapFrame& mapf, RouteQueue& queue)
+            : _engine(engine), _mapf(mapf), _queue(queue), _samples(0) { }
+
+        void run()
+        {
+            unsigned index;
+            TerrainProfile profile;
+            while( _queue.next(index) )
+            {
+                _engine->computeProfile( _mapf, _queue._routes[index], profile );
+                _samples += profile.getNumElevations();
+            }
+        }
+
+        const TerrainProfileEngine* _engine;
+        MapFrame                    _mapf;
+        RouteQueue&                 _queue;
+        unsigned                    _samples;
+    };
+
+    void report(const std::string& label, unsigned numProfiles, unsigned numSamples, double seconds)
+    {
+        OE_NOTICE << LC
+            << label
+            << ", profiles = " << numProfiles
+            << ", samples = " << numSamples
+            << ", time = " << seconds << "s"
+            << ", profiles/sec = " << (seconds > 0.0 ? (double)numProfiles/seconds : 0.0)
+            << std::endl;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numProfiles = 10000u;
+    arguments.read("--profiles", numProfiles);
+
+    double length = 20000.0;
+    arguments.read("--length", length);
+
+    double spacing = 30.0;
+    arguments.read("--spacing", spacing);
+
+    bool rhumb = arguments.read("--rhumb");
+
+    unsigned maxThreads = 8u;
+    arguments.read("--threads", maxThreads);
+    if ( maxThreads < 1u ) maxThreads = 1u;
+
+    unsigned seed = 0u;
+    arguments.read("--seed", seed);
+
+    double xmin = -180.0, ymin = -90.0, xmax = 180.0, ymax = 90.0;
+    bool hasBounds = arguments.read("--bounds", xmin, ymin, xmax, ymax);
+
+    osg::ref_ptr<MapNode> mapNode = MapNode::load( arguments );
+    if ( !mapNode.valid() )
+        return usage("Unable to load earth model.");
+
+    MapFrame mapf( mapNode->getMap(), Map::ELEVATION_LAYERS );
+    const SpatialReference* geoSRS = mapNode->getMapSRS()->getGeographicSRS();
+
+    if ( !hasBounds )
+    {
+        GeoExtent extent = mapNode->getMap()->getProfile()->getExtent().transform( geoSRS );
+        xmin = extent.xMin(), ymin = extent.yMin(), xmax = extent.xMax(), ymax = extent.yMax();
+    }
+
+    // random two-leg routes, each leg up to half the length.
+    double legDegrees = 0.5 * length / 111000.0;
+    Random prng( seed );
+    std::vector< std::vector<GeoPoint> > routes( numProfiles );
+    for(unsigned i = 0; i < numProfiles; ++i)
+    {
+        double x = xmin + prng.next()*(xmax-xmin);
+        double y = ymin + prng.next()*(ymax-ymin);
+        for(unsigned p = 0; p < 3; ++p)
+        {
+            routes[i].push_back( GeoPoint(geoSRS, x, y, 0.0, ALTMODE_ABSOLUTE) );
+            x = osg::clampBetween( x + (prng.next()*2.0-1.0)*legDegrees, xmin, xmax );
+            y = osg::clampBetween( y + (prng.next()*2.0-1.0)*legDegrees, ymin, ymax );
+        }
+    }
+
+    OE_NOTICE << LC << numProfiles << " routes in ("
+        << xmin << ", " << ymin << ") - (" << xmax << ", " << ymax << ")" << std::endl;
+
+    int expected = -1;
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; ++numThreads)
+    {
+        // many requests at once, so each one fetches its tiles itself.
+        osg::ref_ptr<TerrainProfileEngine> engine = new TerrainProfileEngine();
+        engine->setSpacing( spacing );
+        engine->setInterpolation( rhumb ? GEOINTERP_RHUMB_LINE : GEOINTERP_GREAT_CIRCLE );
+        engine->setNumThreads( 1u );
+
+        RouteQueue queue( routes );
+
+        std::vector<ProfileThread*> threads;
+        for(unsigned i = 0; i < numThreads; ++i)
+            threads.push_back( new ProfileThread(engine.get(), mapf, queue) );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned i = 0; i < numThreads; ++i)
+            threads[i]->start();
+
+        unsigned numSamples = 0;
+        for(unsigned i = 0; i < numThreads; ++i)
+        {
+            threads[i]->join();
+            numSamples += threads[i]->_samples;
+            delete threads[i];
+        }
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+        report( Stringify() << "single, threads = " << numThreads, numProfiles, numSamples, seconds );
+
+        if ( expected < 0 )
+            expected = (int)numSamples;
+        else if ( expected != (int)numSamples )
+        {
+            OE_WARN << LC << "Validation FAILED (threads = " << numThreads << ")" << std::endl;
+            return -1;
+        }
+    }
+
+    {
+        osg::ref_ptr<TerrainProfileEngine> engine = new TerrainProfileEngine();
+        engine->setSpacing( spacing );
+        engine->setInterpolation( rhumb ? GEOINTERP_RHUMB_LINE : GEOINTERP_GREAT_CIRCLE );
+        engine->setNumThreads( maxThreads );
+
+        // the second run reuses the engine's thread pool and tile cache.
+        for(unsigned run = 0; run < 2; ++run)
+        {
+            std::vector<TerrainProfile> profiles;
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            engine->computeProfiles( mapf, routes, profiles );
+            double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+            unsigned numSamples = 0;
+            for(unsigned i = 0; i < profiles.size(); ++i)
+                numSamples += profiles[i].getNumElevations();
+
+            report( Stringify() << "batch" << (run > 0 ? " (warm)" : "") << ", threads = " << maxThreads, numProfiles, numSamples, seconds );
+
+            if ( expected != (int)numSamples )
+            {
+                OE_WARN << LC << "Validation FAILED (batch)" << std::endl;
+                return -1;
+            }
+        }
+
+        CacheStats stats = engine->getStats();
+        OE_NOTICE << LC << "tile cache: entries = " << stats._entries << "/" << stats._maxEntries
+            << ", queries = " << stats._queries << ", hit ratio = " << stats._hitRatio << std::endl;
+    }
+
+    return 0;
+}
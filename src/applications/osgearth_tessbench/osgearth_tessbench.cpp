@@ -0,0 +1,276 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/Tessellator>
+#include <osg/ArgumentParser>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#define LC "[tessbench] "
+
+using namespace osgEarth;
+
+/**
+ * Times the osgEarth polygon tessellator on synthetic rings the size of
+ * real coastlines and lake-riddled land parcels: a noisy outer ring of
+ * N vertices, optionally with small holes scattered inside it. Each run
+ * checks the result: the triangle count must be (verts + 2*holes - 2),
+ * every triangle must be counter-clockwise, and the triangles' total area
+ * must match the polygon's. The classic ear clipper runs on the same
+ * hole-free rings up to --classic-max vertices to give a baseline.
+ *
+ * Usage:
+ *   osgearth_tessbench [--verts 50000] [--holes 100] [--hole-verts 64]
+ *       [--noise 0.2] [--classic-max 5000] [--iterations 5]
+ */
+
+namespace
+{
+    struct Ring
+    {
+        unsigned first, count;
+    };
+
+    struct Polygon
+    {
+        osg::ref_ptr<osg::Vec3Array> verts;
+        std::vector<Ring>            rings;
+    };
+
+    // appends a star-shaped ring with jittered radius; holes are wound clockwise.
+    void addRing(Polygon& poly, double cx, double cy, double radius, unsigned n, double noise, bool hole)
+    {
+        Ring ring;
+        ring.first = poly.verts->size();
+        ring.count = n;
+        for(unsigned i=0; i<n; ++i)
+        {
+            double t = 2.0*osg::PI*(double)i/(double)n;
+            if ( hole ) t = -t;
+            double r = radius * (1.0 + noise*((double)rand()/(double)RAND_MAX - 0.5));
+            poly.verts->push_back( osg::Vec3(cx + r*cos(t), cy + r*sin(t), 0.0f) );
+        }
+        poly.rings.push_back( ring );
+    }
+
+    Polygon makePolygon(unsigned numVerts, unsigned numHoles, unsigned holeVerts, double noise)
+    {
+        Polygon poly;
+        poly.verts = new osg::Vec3Array();
+        addRing( poly, 0.0, 0.0, 10000.0, numVerts, noise, false );
+
+        // holes on a grid well inside the outer ring's minimum radius
+        unsigned side = (unsigned)ceil(sqrt((double)numHoles));
+        double extent = 10000.0 * (1.0 - noise) * 0.6;
+        double spacing = side > 0 ? 2.0*extent/(double)side : 0.0;
+        for(unsigned h=0; h<numHoles; ++h)
+        {
+            double x = -extent + spacing*(0.5 + (double)(h % side));
+            double y = -extent + spacing*(0.5 + (double)(h / side));
+            addRing( poly, x, y, spacing*0.3, holeVerts, noise*0.5, true );
+        }
+        return poly;
+    }
+
+    double ringArea(const osg::Vec3Array& v, const Ring& ring)
+    {
+        double sum = 0.0;
+        for(unsigned i=0, j=ring.count-1; i<ring.count; j=i++)
+        {
+            const osg::Vec3& a = v[ring.first+j];
+            const osg::Vec3& b = v[ring.first+i];
+            sum += (double)a.x()*(double)b.y() - (double)b.x()*(double)a.y();
+        }
+        return fabs(0.5*sum);
+    }
+
+    osg::Geometry* makeGeometry(const Polygon& poly)
+    {
+        osg::Geometry* geom = new osg::Geometry();
+        geom->setVertexArray( poly.verts.get() );
+        if ( poly.rings.size() == 1 )
+        {
+            geom->addPrimitiveSet( new osg::DrawArrays(GL_POLYGON, 0, poly.rings[0].count) );
+        }
+        else
+        {
+            osg::DrawArrayLengths* lengths = new osg::DrawArrayLengths(GL_POLYGON, 0);
+            for(unsigned i=0; i<poly.rings.size(); ++i)
+                lengths->push_back( poly.rings[i].count );
+            geom->addPrimitiveSet( lengths );
+        }
+        return geom;
+    }
+
+    // checks triangle count, winding and total area; returns the number of problems.
+    unsigned validate(const Polygon& poly, osg::Geometry* geom)
+    {
+        const osg::Vec3Array& v = *poly.verts.get();
+
+        double expectedArea = ringArea(v, poly.rings[0]);
+        unsigned numVerts = poly.rings[0].count;
+        for(unsigned i=1; i<poly.rings.size(); ++i)
+        {
+            expectedArea -= ringArea(v, poly.rings[i]);
+            numVerts += poly.rings[i].count;
+        }
+        unsigned expectedTris = numVerts + 2*(poly.rings.size()-1) - 2;
+
+        unsigned errors = 0u, numTris = 0u;
+        double area = 0.0;
+        for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+        {
+            osg::DrawElementsUInt* de = dynamic_cast<osg::DrawElementsUInt*>(geom->getPrimitiveSet(p));
+            if ( !de || de->getMode() != GL_TRIANGLES )
+            {
+                ++errors;
+                continue;
+            }
+            for(unsigned i=0; i+2<de->size(); i+=3)
+            {
+                const osg::Vec3& a = v[(*de)[i]];
+                const osg::Vec3& b = v[(*de)[i+1]];
+                const osg::Vec3& c = v[(*de)[i+2]];
+                double cross =
+                    ((double)b.x()-a.x())*((double)c.y()-a.y()) -
+                    ((double)b.y()-a.y())*((double)c.x()-a.x());
+                if ( cross < 0.0 )
+                    ++errors;
+                area += 0.5*fabs(cross);
+                ++numTris;
+            }
+        }
+
+        if ( numTris != expectedTris )
+        {
+            OE_WARN << LC << "Expected " << expectedTris << " triangles, got " << numTris << std::endl;
+            ++errors;
+        }
+        if ( fabs(area - expectedArea) > 1e-4*expectedArea )
+        {
+            OE_WARN << LC << "Expected area " << expectedArea << ", got " << area << std::endl;
+            ++errors;
+        }
+        return errors;
+    }
+
+    bool run(const std::string& label, const Polygon& poly, Tessellator::Method method, unsigned iterations)
+    {
+        double total = 0.0;
+        unsigned errors = 0u;
+        bool ok = true;
+
+        for(unsigned i=0; i<iterations; ++i)
+        {
+            osg::ref_ptr<osg::Geometry> geom = makeGeometry(poly);
+
+            Tessellator tess;
+            tess.setMethod( method );
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            ok = tess.tessellateGeometry( *geom.get() ) && ok;
+            total += osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+            if ( i == 0 )
+                errors = ok ? validate(poly, geom.get()) : 1u;
+        }
+
+        OE_NOTICE << LC
+            << label
+            << ", verts = " << poly.verts->size()
+            << ", holes = " << poly.rings.size()-1
+            << ", time = " << total/(double)iterations << "ms"
+            << ", " << (ok ? "ok" : "FAILED")
+            << ", errors = " << errors
+            << std::endl;
+
+        return ok && errors == 0u;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numVerts = 50000u;
+    arguments.read("--verts", numVerts);
+    if ( numVerts < 3u ) numVerts = 3u;
+
+    unsigned numHoles = 100u;
+    arguments.read("--holes", numHoles);
+
+    unsigned holeVerts = 64u;
+    arguments.read("--hole-verts", holeVerts);
+    if ( holeVerts < 3u ) holeVerts = 3u;
+
+    double noise = 0.2;
+    arguments.read("--noise", noise);
+
+    unsigned classicMax = 5000u;
+    arguments.read("--classic-max", classicMax);
+
+    unsigned iterations = 5u;
+    arguments.read("--iterations", iterations);
+    if ( iterations == 0u ) iterations = 1u;
+
+    srand(1);
+
+    bool ok = true;
+
+    // hole-free rings of increasing size, both methods.
+    for(unsigned n = 1000u; ; n *= 4u)
+    {
+        if ( n > numVerts ) n = numVerts;
+
+        Polygon poly = makePolygon(n, 0u, 0u, noise);
+
+        ok = run( "Z-order ", poly, Tessellator::METHOD_ZORDER_EAR_CLIPPING, iterations ) && ok;
+
+        // the classic clipper may give up on noisy rings (callers fall back
+        // to the GLU tessellator), so its failures are reported but not fatal.
+        if ( n <= classicMax )
+            run( "Classic ", poly, Tessellator::METHOD_EAR_CLIPPING, iterations );
+
+        if ( n == numVerts )
+            break;
+    }
+
+    // outer ring with holes; only the z-order method handles these.
+    if ( numHoles > 0u )
+    {
+        Polygon poly = makePolygon(numVerts, numHoles, holeVerts, noise);
+        ok = run( "Z-order ", poly, Tessellator::METHOD_ZORDER_EAR_CLIPPING, iterations ) && ok;
+    }
+
+    if ( !ok )
+    {
+        OE_WARN << LC << "Validation FAILED" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
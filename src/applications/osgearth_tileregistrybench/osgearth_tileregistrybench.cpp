@@ -0,0 +1,307 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Containers>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/TileKey>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <cstdlib>
+#include <set>
+#include <map>
+
+#define LC "[tileregistrybench] "
+
+using namespace osgEarth;
+
+/**
+ * Stress test for the sharded map that backs the REX tile registry.
+ * Writer threads add and remove tiles while reader threads look them up,
+ * the same mix the pager and cull threads produce. Each writer owns its
+ * own set of keys, so after the run the map contents can be checked
+ * exactly. The same workload then runs against a single-mutex std::map
+ * to give a baseline.
+ *
+ * Usage:
+ *   osgearth_tileregistrybench [--readers 4] [--writers 2]
+ *       [--keys 100000] [--ops 1000000] [--shards 16]
+ */
+
+namespace
+{
+    // Same packing as the REX registry's TileKey hash.
+    struct KeyHash
+    {
+        unsigned operator()(const TileKey& key) const
+        {
+            unsigned long long k =
+                ((unsigned long long)(key.getLOD() & 0x3Fu) << 58) |
+                ((unsigned long long)(key.getTileX() & 0x1FFFFFFFu) << 29) |
+                ((unsigned long long)(key.getTileY() & 0x1FFFFFFFu));
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ULL;
+            k ^= k >> 33;
+            return (unsigned)(k ^ (k >> 32));
+        }
+    };
+
+    // Stand-in for a TileNode; remembers its key so readers can verify lookups.
+    struct Tile : public osg::Referenced
+    {
+        Tile(const TileKey& key) : _key(key) { }
+        TileKey _key;
+    };
+
+    typedef ShardedMap< TileKey, osg::ref_ptr<Tile>, KeyHash > Sharded;
+
+    // Baseline: one lock around a std::map, as the registry used to be.
+    class Locked
+    {
+    public:
+        Locked(unsigned) { }
+
+        bool insert(const TileKey& key, const osg::ref_ptr<Tile>& tile) {
+            Threading::ScopedWriteLock lock( _mutex );
+            bool isNew = _map.find(key) == _map.end();
+            _map[key] = tile;
+            return isNew;
+        }
+        bool get(const TileKey& key, osg::ref_ptr<Tile>& out) const {
+            Threading::ScopedReadLock lock( _mutex );
+            std::map<TileKey, osg::ref_ptr<Tile> >::const_iterator i = _map.find(key);
+            if ( i == _map.end() ) return false;
+            out = i->second;
+            return true;
+        }
+        bool erase(const TileKey& key) {
+            Threading::ScopedWriteLock lock( _mutex );
+            return _map.erase(key) > 0;
+        }
+        unsigned size() const { return _map.size(); }
+
+    private:
+        std::map<TileKey, osg::ref_ptr<Tile> > _map;
+        mutable Threading::ReadWriteMutex      _mutex;
+    };
+
+    // Cheap per-thread random numbers (rand() is not thread-safe everywhere).
+    struct Random
+    {
+        Random(unsigned seed) : _state(seed*2654435761u + 1u) { }
+        unsigned next() { _state = _state*1664525u + 1013904223u; return _state >> 8; }
+        unsigned _state;
+    };
+
+    template<typename MAP>
+    struct Writer : public OpenThreads::Thread
+    {
+        Writer(MAP& map, const std::vector<TileKey>& keys, unsigned ops, unsigned seed) :
+            _map(map), _keys(keys), _ops(ops), _random(seed), _errors(0u) { }
+
+        void run()
+        {
+            for(unsigned i=0; i<_ops; ++i)
+            {
+                const TileKey& key = _keys[_random.next() % _keys.size()];
+                if ( _present.find(key) == _present.end() )
+                {
+                    if ( !_map.insert(key, new Tile(key)) )
+                        ++_errors;
+                    _present.insert(key);
+                }
+                else
+                {
+                    if ( !_map.erase(key) )
+                        ++_errors;
+                    _present.erase(key);
+                }
+            }
+        }
+
+        MAP&                        _map;
+        const std::vector<TileKey>& _keys;
+        unsigned                    _ops;
+        Random                      _random;
+        std::set<TileKey>           _present;
+        unsigned                    _errors;
+    };
+
+    template<typename MAP>
+    struct Reader : public OpenThreads::Thread
+    {
+        Reader(MAP& map, const std::vector<TileKey>& keys, unsigned ops, unsigned seed) :
+            _map(map), _keys(keys), _ops(ops), _random(seed), _hits(0u), _errors(0u) { }
+
+        void run()
+        {
+            osg::ref_ptr<Tile> tile;
+            for(unsigned i=0; i<_ops; ++i)
+            {
+                const TileKey& key = _keys[_random.next() % _keys.size()];
+                if ( _map.get(key, tile) )
+                {
+                    ++_hits;
+                    if ( !tile.valid() || !(tile->_key == key) )
+                        ++_errors;
+                }
+            }
+        }
+
+        MAP&                        _map;
+        const std::vector<TileKey>& _keys;
+        unsigned                    _ops;
+        Random                      _random;
+        unsigned                    _hits;
+        unsigned                    _errors;
+    };
+
+    template<typename MAP>
+    bool
+    runTest(const std::string& label, unsigned numShards,
+            const std::vector< std::vector<TileKey> >& writerKeys,
+            const std::vector<TileKey>& allKeys,
+            unsigned numReaders, unsigned numOps)
+    {
+        MAP map( numShards );
+
+        std::vector< Writer<MAP>* > writers;
+        for(unsigned i=0; i<writerKeys.size(); ++i)
+            writers.push_back( new Writer<MAP>(map, writerKeys[i], numOps, i+1) );
+
+        std::vector< Reader<MAP>* > readers;
+        for(unsigned i=0; i<numReaders; ++i)
+            readers.push_back( new Reader<MAP>(map, allKeys, numOps, 1000+i) );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned i=0; i<writers.size(); ++i) writers[i]->start();
+        for(unsigned i=0; i<readers.size(); ++i) readers[i]->start();
+        for(unsigned i=0; i<writers.size(); ++i) writers[i]->join();
+        for(unsigned i=0; i<readers.size(); ++i) readers[i]->join();
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        // each writer owns its keys, so the final contents are known exactly.
+        unsigned errors = 0u, hits = 0u, expected = 0u;
+        for(unsigned i=0; i<writers.size(); ++i)
+        {
+            errors += writers[i]->_errors;
+            expected += writers[i]->_present.size();
+
+            const std::vector<TileKey>& keys = writerKeys[i];
+            for(unsigned k=0; k<keys.size(); ++k)
+            {
+                osg::ref_ptr<Tile> tile;
+                bool found = map.get(keys[k], tile);
+                bool shouldBe = writers[i]->_present.find(keys[k]) != writers[i]->_present.end();
+                if ( found != shouldBe )
+                    ++errors;
+            }
+            delete writers[i];
+        }
+        for(unsigned i=0; i<readers.size(); ++i)
+        {
+            errors += readers[i]->_errors;
+            hits += readers[i]->_hits;
+            delete readers[i];
+        }
+        if ( map.size() != expected )
+            ++errors;
+
+        double totalOps = (double)numOps * (double)(writerKeys.size() + numReaders);
+
+        OE_NOTICE << LC
+            << label
+            << ", time = " << seconds << "s"
+            << ", ops/sec = " << (seconds > 0.0 ? totalOps/seconds : 0.0)
+            << ", read hits = " << hits
+            << ", final size = " << map.size()
+            << ", errors = " << errors
+            << std::endl;
+
+        return errors == 0u;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numReaders = 4u;
+    arguments.read("--readers", numReaders);
+
+    unsigned numWriters = 2u;
+    arguments.read("--writers", numWriters);
+    if ( numWriters == 0u ) numWriters = 1u;
+
+    unsigned numKeys = 100000u;
+    arguments.read("--keys", numKeys);
+
+    unsigned numOps = 1000000u;
+    arguments.read("--ops", numOps);
+
+    unsigned numShards = 16u;
+    arguments.read("--shards", numShards);
+
+    // a quadtree's worth of keys spread over a few LODs, dealt out to the writers.
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    std::vector<TileKey> allKeys;
+    std::vector< std::vector<TileKey> > writerKeys( numWriters );
+    for(unsigned lod=0; allKeys.size() < numKeys; ++lod)
+    {
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        for(unsigned y=0; y<ty && allKeys.size() < numKeys; ++y)
+        {
+            for(unsigned x=0; x<tx && allKeys.size() < numKeys; ++x)
+            {
+                TileKey key(lod, x, y, profile);
+                writerKeys[allKeys.size() % numWriters].push_back( key );
+                allKeys.push_back( key );
+            }
+        }
+    }
+
+    OE_NOTICE << LC << "Readers = " << numReaders << ", writers = " << numWriters
+        << ", keys = " << allKeys.size() << ", ops/thread = " << numOps
+        << ", shards = " << numShards << std::endl;
+
+    bool ok = true;
+    ok = runTest<Sharded>( "Sharded map", numShards, writerKeys, allKeys, numReaders, numOps ) && ok;
+    ok = runTest<Locked> ( "Locked map ", numShards, writerKeys, allKeys, numReaders, numOps ) && ok;
+
+    if ( !ok )
+    {
+        OE_WARN << LC << "Consistency check FAILED" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
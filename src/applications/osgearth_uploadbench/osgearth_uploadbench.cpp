@@ -0,0 +1,208 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/StringUtils>
+#include <osgEarthUtil/EarthManipulator>
+#include <osgEarthDrivers/engine_rex/RexTerrainEngineNode>
+#include <osgEarthDrivers/engine_rex/Loader>
+#include <osgViewer/Viewer>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <vector>
+
+#define LC "[uploadbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace osgEarth::Drivers::RexTerrainEngine;
+
+/**
+ * Pages in a map with the REX engine and replaces the loader's upload sink
+ * with one that records the GL objects each request hands over, instead of
+ * compiling them. Checks that every request delivers valid textures and
+ * drawables before it merges, and that the merge follows right after.
+ *
+ * Usage:
+ *   osgearth_uploadbench file.earth [--frames 1000]
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE << msg << std::endl
+        << "USAGE: osgearth_uploadbench file.earth" << std::endl
+        << "    --frames <n>      : number of frames to run (default 1000)" << std::endl;
+    return -1;
+}
+
+namespace
+{
+    struct RecordingSink : public Loader::UploadSink
+    {
+        RecordingSink() : _numUploads(0), _numTextures(0), _numDrawables(0), _numBytes(0), _numErrors(0) { }
+
+        void upload(Loader::Request* request, const Loader::Request::UploadSet& objects)
+        {
+            // the objects must arrive before the request merges.
+            if ( request->isFinished() || request->isIdle() )
+                error( request, "uploaded after it merged" );
+
+            if ( objects.empty() )
+                error( request, "uploaded an empty set" );
+
+            for(unsigned i = 0; i < objects._textures.size(); ++i)
+            {
+                const osg::Texture* tex = objects._textures[i].get();
+                if ( !tex || tex->getNumImages() == 0 )
+                {
+                    error( request, "uploaded a texture with no images" );
+                    continue;
+                }
+
+                for(unsigned j = 0; j < tex->getNumImages(); ++j)
+                {
+                    const osg::Image* image = tex->getImage(j);
+                    if ( !image || !image->data() )
+                        error( request, "uploaded a texture with no image data" );
+                    else
+                        _numBytes += image->getTotalSizeInBytes();
+                }
+            }
+
+            for(unsigned i = 0; i < objects._drawables.size(); ++i)
+            {
+                if ( !objects._drawables[i].valid() )
+                    error( request, "uploaded a NULL drawable" );
+            }
+
+            ++_numUploads;
+            _numTextures  += objects._textures.size();
+            _numDrawables += objects._drawables.size();
+
+            _pending.push_back( request );
+        }
+
+        // Every request uploaded this frame must have merged by now.
+        void checkMerged()
+        {
+            for(unsigned i = 0; i < _pending.size(); ++i)
+            {
+                if ( _pending[i]->isMerging() )
+                    error( _pending[i].get(), "did not merge after its upload" );
+            }
+            _pending.clear();
+        }
+
+        void error(Loader::Request* request, const std::string& what)
+        {
+            // report the first few; count them all.
+            if ( _numErrors++ < 10 )
+                OE_WARN << LC << "Request " << request->getName() << " (" << request->getTileKey().str() << ") " << what << std::endl;
+        }
+
+        std::vector< osg::ref_ptr<Loader::Request> > _pending;
+        unsigned _numUploads;
+        unsigned _numTextures;
+        unsigned _numDrawables;
+        unsigned _numBytes;
+        unsigned _numErrors;
+    };
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    unsigned numFrames = 1000u;
+    arguments.read("--frames", numFrames);
+
+    osgViewer::Viewer viewer(arguments);
+
+    // single-threaded, so request states are stable between frames.
+    viewer.setThreadingModel( osgViewer::Viewer::SingleThreaded );
+    viewer.setCameraManipulator( new EarthManipulator(arguments) );
+
+    osg::ref_ptr<MapNode> mapNode = MapNode::load( arguments );
+    if ( !mapNode.valid() )
+        return usage("Unable to load earth model.");
+
+    TerrainEngineNode* engine = mapNode->getTerrainEngine();
+    if ( !engine || std::string(engine->className()) != "RexTerrainEngineNode" )
+        return usage("The earth model must use the rex terrain engine.");
+
+    // the REX engine always makes a PagerLoader.
+    Loader* base = static_cast<RexTerrainEngineNode*>(engine)->getLoader();
+    if ( !base )
+        return usage("The terrain engine has no loader.");
+
+    PagerLoader* loader = static_cast<PagerLoader*>(base);
+
+    osg::ref_ptr<RecordingSink> sink = new RecordingSink();
+    loader->setUploadSink( sink.get() );
+
+    viewer.setSceneData( mapNode.get() );
+    viewer.realize();
+
+    unsigned numMerges = 0u;
+    double mergeMS = 0.0;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    for(unsigned frame = 0; frame < numFrames && !viewer.done(); ++frame)
+    {
+        viewer.frame();
+        sink->checkMerged();
+
+        numMerges += loader->getLastMergeCount();
+        mergeMS   += loader->getLastMergeTime();
+    }
+
+    double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    OE_NOTICE << LC
+        << "frames = " << numFrames
+        << ", merges = " << numMerges
+        << ", uploads = " << sink->_numUploads
+        << ", textures = " << sink->_numTextures
+        << ", drawables = " << sink->_numDrawables
+        << ", texture data = " << (sink->_numBytes/1048576) << "MB"
+        << ", merge time = " << mergeMS << "ms"
+        << ", time = " << seconds << "s"
+        << std::endl;
+
+    if ( sink->_numErrors > 0 )
+    {
+        OE_WARN << LC << "Validation FAILED (" << sink->_numErrors << " errors)" << std::endl;
+        return -1;
+    }
+
+    if ( sink->_numUploads == 0 )
+    {
+        OE_WARN << LC << "Validation FAILED (no uploads; does the map have any layers?)" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/StringUtils>
+#include <osgEarthUtil/Viewshed>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <osgDB/WriteFile>
+
+#define LC "[viewshedbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+/**
+ * Measures ViewshedEngine throughput for 1..N threads: one viewshed around
+ * an observer, and a radial line of sight from the same spot. Every run
+ * starts with an empty tile cache, and every run must produce the same
+ * viewshed as the single-threaded one.
+ *
+ * Usage:
+ *   osgearth_viewshedbench file.earth --observer lon lat [--height 2]
+ *       [--radius 10000] [--resolution 30] [--spokes 360] [--threads 8]
+ *       [--out viewshed.tif]
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE << msg << std::endl
+        << "USAGE: osgearth_viewshedbench file.earth --observer <lon lat>" << std::endl
+        << "    --height <h>      : observer height above the terrain, meters (default 2)" << std::endl
+        << "    --radius <r>      : viewshed radius, meters (default 10000)" << std::endl
+        << "    --resolution <r>  : cell size, meters (default 30)" << std::endl
+        << "    --spokes <n>      : number of radial lines of sight (default 360)" << std::endl
+        << "    --threads <n>     : maximum number of threads (default 8)" << std::endl
+        << "    --out <file>      : write the visibility raster to this file" << std::endl;
+    return -1;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    double lon, lat;
+    if ( !arguments.read("--observer", lon, lat) )
+        return usage("Missing --observer");
+
+    double height = 2.0;
+    arguments.read("--height", height);
+
+    double radius = 10000.0;
+    arguments.read("--radius", radius);
+
+    double resolution = 30.0;
+    arguments.read("--resolution", resolution);
+
+    unsigned numSpokes = 360u;
+    arguments.read("--spokes", numSpokes);
+
+    unsigned maxThreads = 8u;
+    arguments.read("--threads", maxThreads);
+    if ( maxThreads < 1u ) maxThreads = 1u;
+
+    std::string out;
+    arguments.read("--out", out);
+
+    osg::ref_ptr<MapNode> mapNode = MapNode::load( arguments );
+    if ( !mapNode.valid() )
+        return usage("Unable to load earth model.");
+
+    MapFrame mapf( mapNode->getMap(), Map::ELEVATION_LAYERS );
+    const SpatialReference* geoSRS = mapNode->getMapSRS()->getGeographicSRS();
+    GeoPoint observer( geoSRS, lon, lat, height, ALTMODE_RELATIVE );
+
+    osg::ref_ptr<Viewshed> reference;
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; ++numThreads)
+    {
+        osg::ref_ptr<ViewshedEngine> engine = new ViewshedEngine();
+        engine->setResolution( resolution );
+        engine->setNumThreads( numThreads );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        osg::ref_ptr<Viewshed> viewshed = engine->computeViewshed( mapf, observer, radius );
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        if ( !viewshed.valid() )
+            return usage("Unable to compute the viewshed.");
+
+        // warm cache this time, so it's mostly the sweep.
+        start = osg::Timer::instance()->tick();
+        viewshed = engine->computeViewshed( mapf, observer, radius );
+        double warmSeconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        std::vector<double> blocked;
+        start = osg::Timer::instance()->tick();
+        engine->computeRadial( mapf, observer, radius, numSpokes, blocked );
+        double radialSeconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        unsigned numBlocked = 0;
+        for(unsigned i = 0; i < blocked.size(); ++i)
+        {
+            if ( blocked[i] >= 0.0 )
+                ++numBlocked;
+        }
+
+        unsigned numCells = viewshed->getSize() * viewshed->getSize();
+
+        OE_NOTICE << LC
+            << "threads = " << numThreads
+            << ", cells = " << numCells
+            << ", visible = " << viewshed->getNumVisible()
+            << ", time = " << seconds << "s"
+            << ", warm time = " << warmSeconds << "s"
+            << ", cells/sec = " << (warmSeconds > 0.0 ? (double)numCells/warmSeconds : 0.0)
+            << ", spokes blocked = " << numBlocked << "/" << numSpokes
+            << ", radial time = " << radialSeconds << "s"
+            << std::endl;
+
+        if ( !reference.valid() )
+        {
+            reference = viewshed.get();
+        }
+        else
+        {
+            for(unsigned row = 0; row < viewshed->getSize(); ++row)
+            {
+                for(unsigned col = 0; col < viewshed->getSize(); ++col)
+                {
+                    if ( viewshed->getValue(col, row) != reference->getValue(col, row) )
+                    {
+                        OE_WARN << LC << "Validation FAILED at cell " << col << ", " << row << std::endl;
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    if ( !out.empty() && reference.valid() )
+    {
+        GeoImage image = reference->createImage();
+        if ( osgDB::writeImageFile(*image.getImage(), out) )
+            OE_NOTICE << LC << "Wrote " << out << std::endl;
+        else
+            OE_WARN << LC << "Failed to write " << out << std::endl;
+    }
+
+    return 0;
+}
@@ -90,6 +90,168 @@ namespace
     
     typedef std::pair<const osg::Node*, osg::BoundingBox> RenderLeafBox;
 
+    /**
+     * Uniform screen-space grid of occupied declutter boxes. Each accepted
+     * box is registered in every cell it touches, so an occlusion test only
+     * has to look at the boxes sharing a cell with the candidate instead of
+     * every box accepted so far. Boxes outside the grid extent are clamped
+     * to the border cells, so the test is exact for any box position.
+     *
+     * The grid lives in the per-camera data and is reused from frame to
+     * frame; it only reallocates when the viewport size changes.
+     */
+    class DeclutterGrid
+    {
+    public:
+        DeclutterGrid() : _cols(0), _rows(0), _cellSize(64.0f), _xOrigin(0.0f), _yOrigin(0.0f), _query(0u) { }
+
+        /** Prepares the grid for a new pass over the given window extent. */
+        void reset(float x, float y, float width, float height)
+        {
+            int cols = std::max(1, (int)ceil(width / _cellSize));
+            int rows = std::max(1, (int)ceil(height / _cellSize));
+            if ( cols != _cols || rows != _rows )
+            {
+                _cols = cols;
+                _rows = rows;
+                _cells.clear();
+                _cells.resize( _cols * _rows );
+            }
+            else
+            {
+                for(unsigned i=0; i<_touched.size(); ++i)
+                    _cells[_touched[i]].clear();
+            }
+            _touched.clear();
+            _unbounded.clear();
+            _boxes.clear();
+            _stamps.clear();
+            _xOrigin = x;
+            _yOrigin = y;
+            _query = 0u;
+        }
+
+        /**
+         * True if the box overlaps (or touches) any box already in the grid
+         * that belongs to a different parent node.
+         */
+        bool intersects(const osg::Node* parent, const osg::BoundingBox& box)
+        {
+            ++_query;
+
+            for(unsigned i=0; i<_unbounded.size(); ++i)
+            {
+                if ( conflicts(_unbounded[i], parent, box) )
+                    return true;
+            }
+
+            int c0, c1, r0, r1;
+            if ( !getRange(box, c0, c1, r0, r1) )
+            {
+                // degenerate (NaN) boxes never test clear, so check everything.
+                for(unsigned i=0; i<_boxes.size(); ++i)
+                {
+                    if ( conflicts(i, parent, box) )
+                        return true;
+                }
+                return false;
+            }
+
+            for(int r=r0; r<=r1; ++r)
+            {
+                for(int c=c0; c<=c1; ++c)
+                {
+                    const std::vector<unsigned>& cell = _cells[r*_cols + c];
+                    for(unsigned i=0; i<cell.size(); ++i)
+                    {
+                        if ( conflicts(cell[i], parent, box) )
+                            return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        /** Reserves the screen space occupied by a box. */
+        void insert(const osg::Node* parent, const osg::BoundingBox& box)
+        {
+            unsigned index = _boxes.size();
+            _boxes.push_back( std::make_pair(parent, box) );
+            _stamps.push_back( 0u );
+
+            int c0, c1, r0, r1;
+            if ( !getRange(box, c0, c1, r0, r1) )
+            {
+                _unbounded.push_back( index );
+                return;
+            }
+
+            for(int r=r0; r<=r1; ++r)
+            {
+                for(int c=c0; c<=c1; ++c)
+                {
+                    unsigned cell = r*_cols + c;
+                    if ( _cells[cell].empty() )
+                        _touched.push_back( cell );
+                    _cells[cell].push_back( index );
+                }
+            }
+        }
+
+    private:
+        int   _cols, _rows;
+        float _cellSize;
+        float _xOrigin, _yOrigin;
+
+        std::vector<RenderLeafBox>          _boxes;     // accepted boxes
+        std::vector<unsigned>               _stamps;    // last query that tested each box
+        std::vector< std::vector<unsigned> > _cells;    // box indices per cell
+        std::vector<unsigned>               _touched;   // non-empty cells, for fast clearing
+        std::vector<unsigned>               _unbounded; // boxes that can't be binned
+        unsigned                            _query;
+
+        // same 2D test as the brute-force version; a box can live in several
+        // cells, so the stamp makes sure each one is only tested once per query.
+        bool conflicts(unsigned index, const osg::Node* parent, const osg::BoundingBox& box)
+        {
+            if ( _stamps[index] == _query )
+                return false;
+            _stamps[index] = _query;
+
+            const RenderLeafBox& used = _boxes[index];
+            bool isClear =
+                box.xMin() > used.second.xMax() ||
+                box.xMax() < used.second.xMin() ||
+                box.yMin() > used.second.yMax() ||
+                box.yMax() < used.second.yMin();
+
+            return !isClear && parent != used.first;
+        }
+
+        bool getRange(const osg::BoundingBox& box, int& c0, int& c1, int& r0, int& r1) const
+        {
+            if ( box.xMin() != box.xMin() || box.xMax() != box.xMax() ||
+                 box.yMin() != box.yMin() || box.yMax() != box.yMax() )
+            {
+                return false;
+            }
+            c0 = toCell(box.xMin(), _xOrigin, _cols);
+            c1 = toCell(box.xMax(), _xOrigin, _cols);
+            r0 = toCell(box.yMin(), _yOrigin, _rows);
+            r1 = toCell(box.yMax(), _yOrigin, _rows);
+            return true;
+        }
+
+        int toCell(float v, float origin, int count) const
+        {
+            // clamp in floating point first so huge/infinite values are safe.
+            double c = floor( (v - origin) / _cellSize );
+            if ( c < 0.0 ) return 0;
+            if ( c > (double)(count-1) ) return count-1;
+            return (int)c;
+        }
+    };
+
     // Data structure stored one-per-View.
     struct PerCamInfo
     {
@@ -101,7 +263,7 @@ namespace
         // re-usable structures (to avoid unnecessary re-allocation)
         osgUtil::RenderBin::RenderLeafList _passed;
         osgUtil::RenderBin::RenderLeafList _failed;
-        std::vector<RenderLeafBox>         _used;
+        DeclutterGrid                      _used;
 
         // time stamp of the previous pass, for calculating animation speed
         //double _lastTimeStamp;
@@ -228,13 +390,15 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         // Reset the local re-usable containers
         local._passed.clear();          // drawables that pass occlusion test
         local._failed.clear();          // drawables that fail occlusion test
-        local._used.clear();            // list of occupied bounding boxes in screen space
 
         // compute a window matrix so we can do window-space culling. If this is an RTT camera
         // with a reference camera attachment, we actually want to declutter in the window-space
         // of the reference camera.
         const osg::Viewport* vp = cam->getViewport();
 
+        // occupied bounding boxes in screen space
+        local._used.reset( vp->x(), vp->y(), vp->width(), vp->height() );
+
         osg::Matrix windowMatrix = vp->computeWindowMatrix();
 
         osg::Vec3f  refCamScale(1.0f, 1.0f, 1.0f);
@@ -330,24 +494,10 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                 else
                 {
                     // weed out any drawables that are obscured by closer drawables.
-                    // TODO: think about a more efficient algorithm - right now we are just using
-                    // brute force to compare all bbox's
-                    for( std::vector<RenderLeafBox>::const_iterator j = local._used.begin(); j != local._used.end(); ++j )
+                    // (overlaps with boxes from the same drawable parent are acceptable.)
+                    if ( local._used.intersects(drawableParent, box) )
                     {
-                        // only need a 2D test since we're in clip space
-                        bool isClear =
-                            box.xMin() > j->second.xMax() ||
-                            box.xMax() < j->second.xMin() ||
-                            box.yMin() > j->second.yMax() ||
-                            box.yMax() < j->second.yMin();
-
-                        // if there's an overlap (and the conflict isn't from the same drawable
-                        // parent, which is acceptable), then the leaf is culled.
-                        if ( !isClear && drawableParent != j->first )
-                        {
-                            visible = false;
-                            break;
-                        }
+                        visible = false;
                     }
                 }
             }
@@ -356,7 +506,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
             {
                 // passed the test, so add the leaf's bbox to the "used" list, and add the leaf
                 // to the final draw list.
-                local._used.push_back( std::make_pair(drawableParent, box) );
+                local._used.insert( drawableParent, box );
                 local._passed.push_back( leaf );
             }
 
@@ -129,6 +129,19 @@ namespace
         
         return true;
     }    
+
+    // Private copy of a heightfield shared by another thread's request.
+    osg::HeightField* copyHeightField(const osg::HeightField* hf)
+    {
+        return hf ? osg::clone(hf, osg::CopyOp::DEEP_COPY_ALL) : 0L;
+    }
+
+    // Whether a request was interrupted, in which case its (empty) result
+    // is not shared and the waiting threads try again themselves.
+    bool wasInterrupted(ProgressCallback* progress)
+    {
+        return progress && (progress->isCanceled() || progress->needsRetry());
+    }
 }
 
 //------------------------------------------------------------------------
@@ -218,6 +231,33 @@ ElevationLayer::getOrCreatePreCacheOp()
 osg::HeightField*
 ElevationLayer::createHeightFieldFromTileSource(const TileKey&    key,
                                                 ProgressCallback* progress)
+{
+    // If another thread is already fetching this tile, wait and share its result.
+    Threading::SingleFlight<std::string, osg::ref_ptr<osg::HeightField> >::Ticket ticket(
+        _tileSourceFlights, getFlightKey(key), progress );
+
+    if ( ticket.canceled() )
+        return 0L;
+
+    if ( ticket.hasResult() )
+        return copyHeightField( ticket.result().get() );
+
+    osg::ref_ptr<osg::HeightField> result = createHeightFieldFromTileSourceImpl( key, progress );
+
+    // waiting threads get their own copy since our caller owns this one.
+    bool interrupted = wasInterrupted( progress );
+    if ( ticket.close() > 0 && !interrupted )
+        ticket.finish( copyHeightField(result.get()) );
+    else
+        ticket.finish( result, !interrupted );
+
+    return result.release();
+}
+
+
+osg::HeightField*
+ElevationLayer::createHeightFieldFromTileSourceImpl(const TileKey&    key,
+                                                    ProgressCallback* progress)
 {
     osg::HeightField* result = 0L;
 
@@ -375,6 +415,38 @@ ElevationLayer::assembleHeightFieldFromTileSource(const TileKey&    key,
 GeoHeightField
 ElevationLayer::createHeightField(const TileKey&    key,
                                   ProgressCallback* progress )
+{
+    // If another thread is already creating this tile, wait and share its result.
+    Threading::SingleFlight<std::string, GeoHeightField>::Ticket ticket(
+        _keyProfileFlights, getFlightKey(key), progress );
+
+    if ( ticket.canceled() )
+        return GeoHeightField::INVALID;
+
+    if ( ticket.hasResult() )
+    {
+        const GeoHeightField& shared = ticket.result();
+        return shared.valid() ?
+            GeoHeightField( copyHeightField(shared.getHeightField()), shared.getExtent() ) :
+            GeoHeightField::INVALID;
+    }
+
+    GeoHeightField result = createHeightFieldImpl( key, progress );
+
+    // waiting threads get their own copy since our caller owns this one.
+    bool interrupted = wasInterrupted( progress );
+    if ( ticket.close() > 0 && !interrupted && result.valid() )
+        ticket.finish( GeoHeightField(copyHeightField(result.getHeightField()), result.getExtent()) );
+    else
+        ticket.finish( result, !interrupted );
+
+    return result;
+}
+
+
+GeoHeightField
+ElevationLayer::createHeightFieldImpl(const TileKey&    key,
+                                      ProgressCallback* progress )
 {
     GeoHeightField result;
     osg::ref_ptr<osg::HeightField> hf;
@@ -389,8 +461,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
     bool fromMemCache = false;
     if ( _memCache.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateBin( key.getProfile()->getFullSignature() );        
-        ReadResult cacheResult = bin->readObject(key.str() );
+        ReadResult cacheResult = _memCache->readTile( key );
         if ( cacheResult.succeeded() )
         {
             result = GeoHeightField(
@@ -399,7 +470,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
 
             fromMemCache = true;
         }
-        //_memCache->dumpStats(key.getProfile()->getFullSignature());
+        //_memCache->dumpStats("__default");
     }
 
     if ( !result.valid() )
@@ -513,8 +584,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
     // write to mem cache if needed:
     if ( result.valid() && !fromMemCache && _memCache.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateBin( key.getProfile()->getFullSignature() ); 
-        bin->write(key.str(), result.getHeightField());
+        _memCache->writeTile( key, result.getHeightField() );
     }
 
     // post-processing:
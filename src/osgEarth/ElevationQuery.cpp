@@ -38,6 +38,124 @@ namespace
         x |= x >> 16;
         return x+1;
     }
+
+    // Fetches every "stride"th elevation tile of a batched query, starting at "first".
+    struct FetchTiles
+    {
+        FetchTiles() : _mapf(0L), _keys(0L), _out(0L), _tileSize(0u), _first(0u), _stride(1u) { }
+
+        const MapFrame*              _mapf;
+        const std::vector<TileKey>*  _keys;
+        std::vector<GeoHeightField>* _out;
+        unsigned                     _tileSize;
+        unsigned                     _first, _stride;
+
+        void execute()
+        {
+            for(unsigned i = _first; i < _keys->size(); i += _stride)
+            {
+                osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+                hf->allocate( _tileSize, _tileSize );
+
+                // Initialize the heightfield to nodata
+                hf->getFloatArray()->assign( hf->getFloatArray()->size(), NO_DATA_VALUE );
+
+                if ( _mapf->populateHeightField(hf, (*_keys)[i], false /*heightsAsHAE*/, 0L) )
+                {
+                    (*_out)[i] = GeoHeightField( hf.get(), (*_keys)[i].getExtent() );
+                }
+            }
+        }
+    };
+
+    static Threading::Mutex s_batchServiceMutex;
+
+    // Task service shared by every query that doesn't bring its own.
+    TaskService* getSharedBatchService()
+    {
+        static osg::ref_ptr<TaskService> s_service;
+        if ( !s_service.valid() )
+        {
+            Threading::ScopedMutexLock lock( s_batchServiceMutex );
+            if ( !s_service.valid() )
+            {
+                int numThreads = osg::clampBetween( OpenThreads::GetNumberOfProcessors(), 1, 8 );
+                s_service = new TaskService( "ElevationQuery batch", numThreads );
+            }
+        }
+        return s_service.get();
+    }
+
+    // Samples a heightfield at the map-SRS points listed in "members", writing
+    // NO_DATA_VALUE for any point outside the tile. Bilinear samples whose four
+    // neighbors all hold data are computed inline straight from the height
+    // array; everything else goes through HeightFieldUtils so the results
+    // match GeoHeightField::getElevation exactly.
+    //
+    // This is a scalar loop, not a SIMD kernel: each point gathers its four
+    // neighbors from arbitrary offsets, which SSE2 can't load as a vector, and
+    // the batch gets its speed from fetching each tile once instead.
+    void sampleHeightField(const GeoHeightField&          geoHF,
+                           const std::vector<osg::Vec3d>& mapPoints,
+                           const std::vector<unsigned>&   members,
+                           ElevationInterpolation         interp,
+                           std::vector<float>&            out_samples)
+    {
+        const osg::HeightField* hf = geoHF.getHeightField();
+        const GeoExtent& extent = geoHF.getExtent();
+
+        const unsigned cols = hf->getNumColumns();
+        const unsigned rows = hf->getNumRows();
+        const double   xMin = extent.xMin();
+        const double   yMin = extent.yMin();
+        const double   xInterval = extent.width()  / (double)(cols-1);
+        const double   yInterval = extent.height() / (double)(rows-1);
+        const double   maxCol = (double)(cols-1);
+        const double   maxRow = (double)(rows-1);
+        const float*   heights = &(*hf->getFloatArray())[0];
+
+        out_samples.resize( members.size() );
+
+        for(unsigned k = 0; k < members.size(); ++k)
+        {
+            const osg::Vec3d& p = mapPoints[members[k]];
+
+            if ( !extent.contains(p.x(), p.y()) )
+            {
+                out_samples[k] = NO_DATA_VALUE;
+                continue;
+            }
+
+            if ( interp == INTERP_BILINEAR )
+            {
+                double c = osg::clampBetween( (p.x() - xMin) / xInterval, 0.0, maxCol );
+                double r = osg::clampBetween( (p.y() - yMin) / yInterval, 0.0, maxRow );
+
+                unsigned c0 = (unsigned)c;
+                unsigned r0 = (unsigned)r;
+                unsigned c1 = c > (double)c0 ? c0+1 : c0;
+                unsigned r1 = r > (double)r0 ? r0+1 : r0;
+
+                float ll = heights[r0*cols + c0];
+                float lr = heights[r0*cols + c1];
+                float ul = heights[r1*cols + c0];
+                float ur = heights[r1*cols + c1];
+
+                if ( ll != NO_DATA_VALUE && lr != NO_DATA_VALUE && ul != NO_DATA_VALUE && ur != NO_DATA_VALUE )
+                {
+                    double fx = c - (double)c0;
+                    double fy = r - (double)r0;
+                    float bottom = (1.0-fx)*ll + fx*lr;
+                    float top    = (1.0-fx)*ul + fx*ur;
+                    out_samples[k] = (1.0-fy)*bottom + fy*top;
+                    continue;
+                }
+            }
+
+            out_samples[k] = HeightFieldUtils::getHeightAtLocation(
+                hf, p.x(), p.y(), xMin, yMin, xInterval, yInterval, interp );
+        }
+    }
 }
 
 ElevationQueryCacheReadCallback::ElevationQueryCacheReadCallback()
@@ -116,19 +234,90 @@ osg::Node* ElevationQueryCacheReadCallback::readNodeFile(const std::string& file
 #endif
 }
 
-ElevationQuery::ElevationQuery()
+ElevationTileCache::ElevationTileCache(unsigned maxTiles) :
+_tiles      ( maxTiles ),
+_mapRevision( -1 )
+{
+    //nop
+}
+
+void
+ElevationTileCache::setMaxTiles(unsigned value)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _tiles.setMaxSize( value );
+}
+
+unsigned
+ElevationTileCache::getMaxTiles() const
+{
+    return _tiles.getMaxSize();
+}
+
+bool
+ElevationTileCache::syncLocked(int mapRevision)
+{
+    if ( mapRevision > _mapRevision )
+    {
+        _tiles.clear();
+        _mapRevision = mapRevision;
+    }
+    return mapRevision == _mapRevision;
+}
+
+bool
+ElevationTileCache::get(const TileKey& key, int mapRevision, GeoHeightField& out_tile)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    if ( !syncLocked(mapRevision) )
+        return false;
+
+    TileCache::Record record;
+    if ( !_tiles.get(key, record) )
+        return false;
+
+    out_tile = record.value();
+    return true;
+}
+
+void
+ElevationTileCache::insert(const TileKey& key, int mapRevision, const GeoHeightField& tile)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    if ( syncLocked(mapRevision) )
+        _tiles.insert( key, tile );
+}
+
+void
+ElevationTileCache::clear()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _tiles.clear();
+}
+
+CacheStats
+ElevationTileCache::getStats() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _tiles.getStats();
+}
+
+ElevationQuery::ElevationQuery() :
+_numBatchThreads( 0u )
 {
     //nop
 }
 
 ElevationQuery::ElevationQuery(const Map* map) :
-_mapf( map, (Map::ModelParts)(Map::TERRAIN_LAYERS | Map::MODEL_LAYERS) )
+_mapf( map, (Map::ModelParts)(Map::TERRAIN_LAYERS | Map::MODEL_LAYERS) ),
+_numBatchThreads( 0u )
 {
     postCTOR();
 }
 
 ElevationQuery::ElevationQuery(const MapFrame& mapFrame) :
-_mapf( mapFrame )
+_mapf( mapFrame ),
+_numBatchThreads( 0u )
 {
     postCTOR();
 }
@@ -305,6 +494,29 @@ ElevationQuery::getMaxLevelOverride() const
     return _maxLevelOverride;
 }
 
+bool
+ElevationQuery::getCachedTile(const TileKey& key, GeoHeightField& out_tile)
+{
+    if ( _tileCache.valid() )
+        return _tileCache->get( key, (int)_mapf.getRevision(), out_tile );
+
+    TileCache::Record record;
+    if ( !_cache.get(key, record) )
+        return false;
+
+    out_tile = record.value();
+    return true;
+}
+
+void
+ElevationQuery::cacheTile(const TileKey& key, const GeoHeightField& tile)
+{
+    if ( _tileCache.valid() )
+        _tileCache->insert( key, (int)_mapf.getRevision(), tile );
+    else
+        _cache.insert( key, tile );
+}
+
 bool
 ElevationQuery::getElevation(const GeoPoint&         point,
                              double&                 out_elevation,
@@ -368,6 +580,271 @@ ElevationQuery::getElevations(const std::vector<osg::Vec3d>& points,
     return true;
 }
 
+void
+ElevationQuery::fetchTiles(const std::vector<TileKey>&  keys,
+                           unsigned                     tileSize,
+                           std::vector<GeoHeightField>& out_tiles)
+{
+    out_tiles.resize( keys.size() );
+    if ( keys.empty() )
+        return;
+
+    // the tiles are dealt out to this many fetchers; the calling thread is one of them.
+    TaskService* service = 0L;
+    unsigned numFetchers = 1u;
+    if ( _numBatchThreads != 1u && keys.size() > 1u )
+    {
+        service = _batchService.valid() ? _batchService.get() : getSharedBatchService();
+
+        numFetchers = _numBatchThreads > 0u ?
+            _numBatchThreads :
+            (unsigned)service->getNumThreads() + 1u;
+
+        numFetchers = osg::clampBetween( numFetchers, 1u, (unsigned)keys.size() );
+    }
+
+    FetchTiles local;
+    local._mapf     = &_mapf;
+    local._keys     = &keys;
+    local._out      = &out_tiles;
+    local._tileSize = tileSize;
+    local._first    = numFetchers - 1u;
+    local._stride   = numFetchers;
+
+    Threading::MultiEvent done( numFetchers - 1u );
+    std::vector< osg::ref_ptr< ParallelTask<FetchTiles> > > tasks;
+
+    for(unsigned i = 0; i+1 < numFetchers; ++i)
+    {
+        ParallelTask<FetchTiles>* task = new ParallelTask<FetchTiles>( &done );
+        static_cast<FetchTiles&>(*task) = local;
+        task->_first = i;
+        tasks.push_back( task );
+        service->add( task );
+    }
+
+    local.execute();
+
+    // fetch any tiles the pool hasn't started, so a dropped task can't stall us.
+    for(unsigned i = 0; i < tasks.size(); ++i)
+        tasks[i]->runIfUnclaimed();
+
+    if ( !tasks.empty() )
+        done.wait();
+}
+
+bool
+ElevationQuery::getElevationsBatch(const std::vector<osg::Vec3d>& points,
+                                   const SpatialReference*        pointsSRS,
+                                   std::vector<double>&           out_elevations,
+                                   std::vector<double>*           out_resolutions,
+                                   std::vector<Status>*           out_status,
+                                   double                         desiredResolution)
+{
+    sync();
+
+    const unsigned numPoints = points.size();
+
+    std::vector<Status> localStatus;
+    std::vector<Status>& status = out_status ? *out_status : localStatus;
+
+    out_elevations.assign( numPoints, 0.0 );
+    status.assign( numPoints, STATUS_NO_DATA );
+    if ( out_resolutions )
+        out_resolutions->assign( numPoints, 0.0 );
+
+    if ( numPoints == 0 )
+        return true;
+
+    // terrain patches need a scene graph intersection per point, so they
+    // go through the single-point path.
+    if ( _patchLayers.size() > 0 )
+    {
+        bool allOK = true;
+        for(unsigned i = 0; i < numPoints; ++i)
+        {
+            double resolution = 0.0;
+            GeoPoint p(pointsSRS, points[i], ALTMODE_ABSOLUTE);
+            if ( getElevationImpl(p, out_elevations[i], desiredResolution, &resolution) )
+            {
+                status[i] = STATUS_OK;
+                if ( out_resolutions )
+                    (*out_resolutions)[i] = resolution;
+            }
+            else
+            {
+                out_elevations[i] = 0.0;
+                allOK = false;
+            }
+        }
+        return allOK;
+    }
+
+    if ( _mapf.elevationLayers().empty() )
+    {
+        // this means there are no heightfields.
+        status.assign( numPoints, STATUS_OK );
+        return true;
+    }
+
+    osg::Timer_t begin = osg::Timer::instance()->tick();
+
+    const Profile*          profile = _mapf.getProfile();
+    const SpatialReference* mapSRS  = profile->getSRS();
+
+    // transform the input coords to map coords, all at once:
+    std::vector<osg::Vec3d> mapPoints( points );
+    if ( pointsSRS && !pointsSRS->isHorizEquivalentTo(mapSRS) )
+    {
+        if ( !pointsSRS->transform(mapPoints, mapSRS) )
+        {
+            // at least one point failed; redo them one at a time to find out which.
+            for(unsigned i = 0; i < numPoints; ++i)
+            {
+                if ( !pointsSRS->transform(points[i], mapSRS, mapPoints[i]) )
+                    status[i] = STATUS_TRANSFORM_FAILED;
+            }
+        }
+    }
+
+    // tile size (resolution of elevation tiles)
+    unsigned tileSize = 33; // ???
+
+    int desiredLevel = -1;
+    if ( desiredResolution > 0.0 )
+    {
+        desiredLevel = (int)profile->getLevelOfDetailForHorizResolution( desiredResolution, tileSize );
+    }
+
+    // group the points by the tile that holds the best data for each one.
+    typedef std::map< TileKey, std::vector<unsigned> > TileGroups;
+    TileGroups groups;
+
+    for(unsigned i = 0; i < numPoints; ++i)
+    {
+        if ( status[i] == STATUS_TRANSFORM_FAILED )
+            continue;
+
+        const osg::Vec3d& p = mapPoints[i];
+
+        // A negative value means that no data is avaialble at that point at any resolution.
+        int bestAvailLevel = getMaxLevel( p.x(), p.y(), mapSRS, profile, tileSize );
+        if ( bestAvailLevel < 0 )
+            continue;
+
+        if ( desiredLevel >= 0 && desiredLevel < bestAvailLevel )
+            bestAvailLevel = desiredLevel;
+
+        TileKey key = profile->createTileKey( p.x(), p.y(), bestAvailLevel );
+        if ( !key.valid() )
+        {
+            status[i] = STATUS_OUT_OF_BOUNDS;
+            continue;
+        }
+
+        groups[key].push_back( i );
+    }
+
+    ElevationInterpolation interp = _mapf.getMapInfo().getElevationInterpolation();
+
+    std::vector<TileKey>        keys;
+    std::vector<GeoHeightField> tiles;
+    std::vector<TileKey>        missingKeys;
+    std::vector<unsigned>       missingIndices;
+    std::vector<GeoHeightField> fetched;
+    std::vector<float>          samples;
+
+    // each pass samples one tile per group; points that come up empty move on
+    // to the parent tile in the next pass, like the single-point query does.
+    while ( !groups.empty() )
+    {
+        keys.clear();
+        tiles.clear();
+        missingKeys.clear();
+        missingIndices.clear();
+
+        for(TileGroups::const_iterator g = groups.begin(); g != groups.end(); ++g)
+        {
+            keys.push_back( g->first );
+            tiles.push_back( GeoHeightField::INVALID );
+
+            if ( !getCachedTile(g->first, tiles.back()) )
+            {
+                missingKeys.push_back( g->first );
+                missingIndices.push_back( tiles.size()-1 );
+            }
+        }
+
+        if ( !missingKeys.empty() )
+        {
+            fetchTiles( missingKeys, tileSize, fetched );
+
+            for(unsigned m = 0; m < missingKeys.size(); ++m)
+            {
+                if ( fetched[m].valid() )
+                {
+                    tiles[missingIndices[m]] = fetched[m];
+                    cacheTile( missingKeys[m], fetched[m] );
+                }
+            }
+        }
+
+        TileGroups next;
+        unsigned t = 0;
+        for(TileGroups::const_iterator g = groups.begin(); g != groups.end(); ++g, ++t)
+        {
+            const TileKey&               key     = g->first;
+            const std::vector<unsigned>& members = g->second;
+            const GeoHeightField&        geoHF   = tiles[t];
+
+            if ( geoHF.valid() )
+            {
+                sampleHeightField( geoHF, mapPoints, members, interp, samples );
+
+                for(unsigned k = 0; k < members.size(); ++k)
+                {
+                    unsigned i = members[k];
+                    if ( samples[k] != NO_DATA_VALUE )
+                    {
+                        out_elevations[i] = (double)samples[k];
+                        status[i] = STATUS_OK;
+                        if ( out_resolutions )
+                            (*out_resolutions)[i] = geoHF.getXInterval();
+                    }
+                    else if ( _fallBackOnNoData )
+                    {
+                        TileKey parent = key.createParentKey();
+                        if ( parent.valid() )
+                            next[parent].push_back( i );
+                    }
+                }
+            }
+            else
+            {
+                TileKey parent = key.createParentKey();
+                if ( parent.valid() )
+                {
+                    std::vector<unsigned>& parentMembers = next[parent];
+                    parentMembers.insert( parentMembers.end(), members.begin(), members.end() );
+                }
+            }
+        }
+
+        groups.swap( next );
+    }
+
+    osg::Timer_t end = osg::Timer::instance()->tick();
+    _queries   += (double)numPoints;
+    _totalTime += osg::Timer::instance()->delta_s( begin, end );
+
+    for(unsigned i = 0; i < numPoints; ++i)
+    {
+        if ( status[i] != STATUS_OK )
+            return false;
+    }
+    return true;
+}
+
 bool
 ElevationQuery::getElevationImpl(const GeoPoint& point, /* abs */
                                  double&         out_elevation,
@@ -507,12 +984,7 @@ ElevationQuery::getElevationImpl(const GeoPoint& point, /* abs */
         GeoHeightField geoHF;
 
         // Try to get the hf from the cache
-        TileCache::Record record;
-        if ( _cache.get( key, record ) )
-        {
-            geoHF = record.value();
-        }
-        else
+        if ( !getCachedTile(key, geoHF) )
         {
             // Create it
             osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
@@ -524,7 +996,7 @@ ElevationQuery::getElevationImpl(const GeoPoint& point, /* abs */
             if (_mapf.populateHeightField(hf, key, false /*heightsAsHAE*/, 0L))
             {
                 geoHF = GeoHeightField( hf.get(), key.getExtent() );
-                _cache.insert( key, geoHF );
+                cacheTile( key, geoHF );
             }
         }
 
@@ -568,3 +1040,81 @@ void ElevationQuery::setElevationQueryCacheReadCallback(ElevationQueryCacheReadC
 {
     _eqcrc = eqcrc;
 }
+
+//------------------------------------------------------------------------
+
+BatchElevationSampler::BatchElevationSampler() :
+_numThreads( 0u )
+{
+    // 33x33 float tiles, so about 4MB.
+    _tiles = new ElevationTileCache( 1024u );
+}
+
+void
+BatchElevationSampler::setNumThreads(unsigned value)
+{
+    Threading::ScopedMutexLock lock( _serviceMutex );
+    if ( value != _numThreads )
+    {
+        _numThreads = value;
+        _service = 0L;
+    }
+}
+
+unsigned
+BatchElevationSampler::getEffectiveNumThreads() const
+{
+    return _numThreads > 0u ?
+        _numThreads :
+        (unsigned)osg::clampBetween( OpenThreads::GetNumberOfProcessors(), 1, 8 );
+}
+
+TaskService*
+BatchElevationSampler::getService() const
+{
+    Threading::ScopedMutexLock lock( _serviceMutex );
+    unsigned numThreads = getEffectiveNumThreads();
+    if ( !_service.valid() && numThreads > 1u )
+    {
+        _service = new TaskService( "BatchElevationSampler", numThreads-1u );
+    }
+    return _service.get();
+}
+
+void
+BatchElevationSampler::setMaxTilesToCache(unsigned value)
+{
+    _tiles->setMaxTiles( value );
+}
+
+unsigned
+BatchElevationSampler::getMaxTilesToCache() const
+{
+    return _tiles->getMaxTiles();
+}
+
+bool
+BatchElevationSampler::getElevations(const MapFrame&                      mapf,
+                                     const std::vector<osg::Vec3d>&       points,
+                                     const SpatialReference*              pointsSRS,
+                                     std::vector<double>&                 out_elevations,
+                                     std::vector<ElevationQuery::Status>* out_status,
+                                     double                               desiredResolution) const
+{
+    // The query itself is cheap; what's worth keeping is the heightfields,
+    // and those live in the shared cache.
+    ElevationQuery eq( mapf );
+    eq.setTileCache( _tiles.get() );
+
+    // want a result even if it's low res
+    eq.setFallBackOnNoData( true );
+
+    // hold a reference, since setNumThreads() can replace the pool mid-batch.
+    osg::ref_ptr<TaskService> service = getService();
+    if ( service.valid() )
+        eq.setBatchService( service.get() );
+    else
+        eq.setNumBatchThreads( 1u );
+
+    return eq.getElevationsBatch( points, pointsSRS, out_elevations, 0L, out_status, desiredResolution );
+}
@@ -25,6 +25,7 @@
 #include <osgEarth/Cube>
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Terrain>
+#include <osgEarth/TaskService>
 
 #include <osg/Notify>
 #include <osg/Timer>
@@ -1897,6 +1898,334 @@ namespace
 
         return result;
     }
+
+    // Native reprojection ---------------------------------------------------
+    //
+    // Instead of transforming every destination pixel through the SRS, we
+    // transform a coarse control grid and interpolate the source coordinates
+    // across each grid cell. The grid is refined until the interpolation
+    // error is below a fraction of a source pixel. Resampling then runs
+    // through typed kernels (no per-pixel PixelReader/Writer dispatch) and is
+    // split into row bands across a small thread pool.
+    //
+    // The kernels are scalar templates, not SIMD: every destination pixel
+    // reads its source neighbors at interpolated, non-contiguous offsets, so
+    // the inner loop is gather-bound, and the channel loop (fixed N) is left
+    // for the compiler to unroll.
+
+#define REPROJECT_GRID_STEP          16    // initial control grid spacing, in pixels
+#define REPROJECT_MAX_ERROR          0.125 // max interpolation error, in source pixels
+#define REPROJECT_MIN_ROWS_PER_TASK  32    // don't split images into smaller bands than this
+
+    struct ControlGrid
+    {
+        unsigned            _nx, _ny;  // number of grid points in x and y
+        std::vector<double> _x, _y;    // source coords, column-major (i*_ny + j)
+        double              _gx, _gy;  // destination pixel -> grid units
+    };
+
+    // Computes the interpolated source coordinate at fractional grid position (gx, gy).
+    inline void interpolateGrid(const ControlGrid& grid, double gx, double gy, double& out_x, double& out_y)
+    {
+        unsigned i = osg::minimum( (unsigned)gx, grid._nx-2 );
+        unsigned j = osg::minimum( (unsigned)gy, grid._ny-2 );
+        double fx = gx - (double)i, fy = gy - (double)j;
+        unsigned ll = i*grid._ny + j, lr = ll + grid._ny;
+        out_x =
+            (1.0-fx)*((1.0-fy)*grid._x[ll] + fy*grid._x[ll+1]) +
+            (    fx)*((1.0-fy)*grid._x[lr] + fy*grid._x[lr+1]);
+        out_y =
+            (1.0-fx)*((1.0-fy)*grid._y[ll] + fy*grid._y[ll+1]) +
+            (    fx)*((1.0-fy)*grid._y[lr] + fy*grid._y[lr+1]);
+    }
+
+    // Builds a control grid mapping destination pixel centers to source
+    // coordinates, refining it until it is accurate to REPROJECT_MAX_ERROR.
+    bool buildControlGrid(
+        const GeoExtent& src_extent, const GeoExtent& dest_extent,
+        unsigned width, unsigned height,
+        double xfac, double yfac,
+        ControlGrid& grid)
+    {
+        const double dx = dest_extent.width() / (double)width;
+        const double dy = dest_extent.height() / (double)height;
+        const double x0 = dest_extent.xMin() + .5 * dx, x1 = dest_extent.xMax() - .5 * dx;
+        const double y0 = dest_extent.yMin() + .5 * dy, y1 = dest_extent.yMax() - .5 * dy;
+
+        for(unsigned step = REPROJECT_GRID_STEP; ; step /= 2)
+        {
+            grid._nx = osg::maximum( (width  + step - 2) / step + 1, 2u );
+            grid._ny = osg::maximum( (height + step - 2) / step + 1, 2u );
+            grid._gx = width  > 1 ? (double)(grid._nx-1)/(double)(width-1)  : 0.0;
+            grid._gy = height > 1 ? (double)(grid._ny-1)/(double)(height-1) : 0.0;
+            grid._x.resize( grid._nx * grid._ny );
+            grid._y.resize( grid._nx * grid._ny );
+
+            if ( !dest_extent.getSRS()->transformExtentPoints(
+                src_extent.getSRS(), x0, y0, x1, y1, &grid._x[0], &grid._y[0], grid._nx, grid._ny) )
+            {
+                return false;
+            }
+
+            // an exact grid needs no error check.
+            if ( step == 1 || (grid._nx >= width && grid._ny >= height) )
+                return true;
+
+            // transform the center of each cell and compare it to the interpolated value.
+            std::vector<osg::Vec3d> centers;
+            centers.reserve( (grid._nx-1) * (grid._ny-1) );
+            const double cdx = (x1 - x0) / (double)(grid._nx-1);
+            const double cdy = (y1 - y0) / (double)(grid._ny-1);
+            for(unsigned i=0; i<grid._nx-1; ++i)
+                for(unsigned j=0; j<grid._ny-1; ++j)
+                    centers.push_back( osg::Vec3d(x0 + ((double)i+.5)*cdx, y0 + ((double)j+.5)*cdy, 0.0) );
+
+            if ( !dest_extent.getSRS()->transform(centers, src_extent.getSRS()) )
+                continue;
+
+            double maxError = 0.0;
+            unsigned k = 0;
+            for(unsigned i=0; i<grid._nx-1; ++i)
+            {
+                for(unsigned j=0; j<grid._ny-1; ++j, ++k)
+                {
+                    double ix, iy;
+                    interpolateGrid( grid, (double)i+.5, (double)j+.5, ix, iy );
+                    maxError = osg::maximum( maxError, osg::absolute(ix - centers[k].x()) * xfac );
+                    maxError = osg::maximum( maxError, osg::absolute(iy - centers[k].y()) * yfac );
+                }
+            }
+
+            if ( maxError <= REPROJECT_MAX_ERROR )
+                return true;
+        }
+    }
+
+    // Converts an interpolated sample back to the channel type.
+    template<typename T>
+    inline T roundSample(float value) { return (T)(value + 0.5f); }
+
+    template<>
+    inline float roundSample<float>(float value) { return value; }
+
+    // Resamples rows [rowStart, rowEnd) of the destination image.
+    // T = channel type, N = number of channels.
+    template<typename T, unsigned N>
+    void resampleRows(
+        const osg::Image* src, osg::Image* dst,
+        const ControlGrid& grid, const GeoExtent& src_extent,
+        bool bilinear, unsigned rowStart, unsigned rowEnd)
+    {
+        const int s = src->s(), t = src->t();
+        const double xfac = (double)(s - 1) / src_extent.width();
+        const double yfac = (double)(t - 1) / src_extent.height();
+        const double xmin = src_extent.xMin(), xmax = src_extent.xMax();
+        const double ymin = src_extent.yMin(), ymax = src_extent.yMax();
+        const unsigned width = dst->s();
+
+        for(unsigned r = rowStart; r < rowEnd; ++r)
+        {
+            T* out = (T*)dst->data(0, r);
+            const double gy = (double)r * grid._gy;
+
+            for(unsigned c = 0; c < width; ++c, out += N)
+            {
+                double src_x, src_y;
+                interpolateGrid( grid, (double)c * grid._gx, gy, src_x, src_y );
+
+                // outside the source extent: leave the pixel transparent.
+                if ( src_x < xmin || src_x > xmax || src_y < ymin || src_y > ymax )
+                    continue;
+
+                const float px = (float)((src_x - xmin) * xfac);
+                const float py = (float)((src_y - ymin) * yfac);
+
+                if ( !bilinear )
+                {
+                    int col = osg::clampBetween( (int)osg::round(px), 0, s-1 );
+                    int row = osg::clampBetween( (int)osg::round(py), 0, t-1 );
+                    const T* in = (const T*)src->data(col, row);
+                    for(unsigned n=0; n<N; ++n)
+                        out[n] = in[n];
+                }
+                else
+                {
+                    int col0 = osg::clampBetween( (int)floorf(px), 0, s-1 );
+                    int row0 = osg::clampBetween( (int)floorf(py), 0, t-1 );
+                    int col1 = osg::minimum( col0+1, s-1 );
+                    int row1 = osg::minimum( row0+1, t-1 );
+                    float fx = osg::clampBetween( px - (float)col0, 0.0f, 1.0f );
+                    float fy = osg::clampBetween( py - (float)row0, 0.0f, 1.0f );
+
+                    const T* ll = (const T*)src->data(col0, row0);
+                    const T* lr = (const T*)src->data(col1, row0);
+                    const T* ul = (const T*)src->data(col0, row1);
+                    const T* ur = (const T*)src->data(col1, row1);
+
+                    for(unsigned n=0; n<N; ++n)
+                    {
+                        float bottom = (float)ll[n] + fx*((float)lr[n] - (float)ll[n]);
+                        float top    = (float)ul[n] + fx*((float)ur[n] - (float)ul[n]);
+                        out[n] = roundSample<T>( bottom + fy*(top - bottom) );
+                    }
+                }
+            }
+        }
+    }
+
+    typedef void (*ResampleFunc)(
+        const osg::Image*, osg::Image*, const ControlGrid&, const GeoExtent&, bool, unsigned, unsigned);
+
+    template<typename T>
+    ResampleFunc getResampler(unsigned numComponents)
+    {
+        switch( numComponents )
+        {
+        case 1: return &resampleRows<T,1>;
+        case 2: return &resampleRows<T,2>;
+        case 3: return &resampleRows<T,3>;
+        case 4: return &resampleRows<T,4>;
+        default: return 0L;
+        }
+    }
+
+    // Picks the resampling kernel for an image, or NULL if the format is not supported.
+    ResampleFunc getResampler(const osg::Image* image)
+    {
+        if ( image->r() != 1 || image->isCompressed() )
+            return 0L;
+
+        unsigned numComponents = osg::Image::computeNumComponents( image->getPixelFormat() );
+
+        switch( image->getDataType() )
+        {
+        case GL_UNSIGNED_BYTE:  return getResampler<unsigned char>( numComponents );
+        case GL_UNSIGNED_SHORT: return getResampler<unsigned short>( numComponents );
+        case GL_FLOAT:          return getResampler<float>( numComponents );
+        default:                return 0L;
+        }
+    }
+
+    // One band of rows, run on the reprojection thread pool.
+    struct ResampleBand
+    {
+        ResampleFunc       _func;
+        const osg::Image*  _src;
+        osg::Image*        _dst;
+        const ControlGrid* _grid;
+        const GeoExtent*   _srcExtent;
+        bool               _bilinear;
+        unsigned           _rowStart, _rowEnd;
+
+        void execute()
+        {
+            _func( _src, _dst, *_grid, *_srcExtent, _bilinear, _rowStart, _rowEnd );
+        }
+    };
+
+    static Threading::Mutex s_reprojectServiceMutex;
+
+    TaskService* getReprojectService()
+    {
+        static osg::ref_ptr<TaskService> s_service;
+        if ( !s_service.valid() )
+        {
+            Threading::ScopedMutexLock lock( s_reprojectServiceMutex );
+            if ( !s_service.valid() )
+            {
+                int numThreads = osg::clampBetween( OpenThreads::GetNumberOfProcessors(), 1, 8 );
+                s_service = new TaskService( "GeoImage reproject", numThreads );
+            }
+        }
+        return s_service.get();
+    }
+
+    // Reprojects an image with the native engine. Returns NULL if the image
+    // format is not supported or the control grid cannot be transformed, in
+    // which case the caller should fall back on another method.
+    osg::Image* nativeReproject(
+        const osg::Image* image,
+        const GeoExtent&  src_extent,
+        const GeoExtent&  dest_extent,
+        bool              interpolate,
+        unsigned int      width = 0,
+        unsigned int      height = 0)
+    {
+        ResampleFunc func = getResampler( image );
+        if ( !func )
+            return 0L;
+
+        if (width == 0 || height == 0)
+        {
+            //If no width and height are specified, just use the minimum dimension for the image
+            width = osg::minimum(image->s(), image->t());
+            height = osg::minimum(image->s(), image->t());
+        }
+
+        const double xfac = (image->s() - 1) / src_extent.width();
+        const double yfac = (image->t() - 1) / src_extent.height();
+
+        ControlGrid grid;
+        if ( !buildControlGrid(src_extent, dest_extent, width, height, xfac, yfac, grid) )
+            return 0L;
+
+        osg::Image *result = new osg::Image();
+        result->allocateImage(width, height, 1, image->getPixelFormat(), image->getDataType());
+        result->setInternalTextureFormat(image->getInternalTextureFormat());
+        ImageUtils::markAsUnNormalized(result, ImageUtils::isUnNormalized(image));
+
+        //Initialize the image to be completely transparent/black
+        memset(result->data(), 0, result->getImageSizeInBytes());
+
+        // split the rows into bands; the calling thread runs the last one itself.
+        TaskService* service = getReprojectService();
+        unsigned numBands = osg::minimum(
+            (unsigned)service->getNumThreads() + 1u,
+            osg::maximum( height / REPROJECT_MIN_ROWS_PER_TASK, 1u ) );
+
+        unsigned rowsPerBand = (height + numBands - 1) / numBands;
+
+        Threading::MultiEvent done( numBands - 1 );
+        std::vector< osg::ref_ptr< ParallelTask<ResampleBand> > > tasks;
+
+        ResampleBand local;
+        for(unsigned b = 0; b < numBands; ++b)
+        {
+            ResampleBand band;
+            band._func      = func;
+            band._src       = image;
+            band._dst       = result;
+            band._grid      = &grid;
+            band._srcExtent = &src_extent;
+            band._bilinear  = interpolate;
+            band._rowStart  = b * rowsPerBand;
+            band._rowEnd    = osg::minimum( band._rowStart + rowsPerBand, height );
+
+            if ( b+1 == numBands )
+            {
+                local = band;
+            }
+            else
+            {
+                ParallelTask<ResampleBand>* task = new ParallelTask<ResampleBand>( &done );
+                static_cast<ResampleBand&>(*task) = band;
+                tasks.push_back( task );
+                service->add( task );
+            }
+        }
+
+        local.execute();
+
+        // pick up any bands the pool hasn't started, so we never wait on a
+        // band that was canceled or dropped from the queue.
+        for(unsigned i = 0; i < tasks.size(); ++i)
+            tasks[i]->runIfUnclaimed();
+
+        if ( numBands > 1 )
+            done.wait();
+
+        return result;
+    }
 }
 
 GeoImage
@@ -1915,16 +2244,37 @@ GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent,
     osg::Image* resultImage = 0L;
 
     bool isNormalized = ImageUtils::isNormalized(getImage());
-    
-    if ( getSRS()->isUserDefined()      || 
+
+    // if either of the SRS is a custom projection, we have to do a manual reprojection since
+    // GDAL will not recognize the SRS.
+    bool manual =
+        getSRS()->isUserDefined()       || 
         to_srs->isUserDefined()         ||
         getSRS()->isSphericalMercator() ||
         to_srs->isSphericalMercator()   ||
-        !isNormalized )
+        !isNormalized;
+
+    // The native engine handles the common pixel formats without the GDAL lock
+    // or a per-pixel transform. It replaces the manual path outright; otherwise
+    // it only takes normalized images with an explicit output size between SRS's
+    // on the same datum, and leaves datum shifts and size selection to GDAL.
+    bool native =
+        manual ||
+        (width > 0 && height > 0 && getSRS()->getDatumName() == to_srs->getDatumName());
+
+    if ( native )
+    {
+        resultImage = nativeReproject(getImage(), getExtent(), destExtent, useBilinearInterpolation && isNormalized, width, height);
+    }
+
+    if ( resultImage )
+    {
+        return GeoImage(resultImage, destExtent);
+    }
+
+    if ( manual )
     {
-        // if either of the SRS is a custom projection, we have to do a manual reprojection since
-        // GDAL will not recognize the SRS.
-        resultImage = manualReproject(getImage(), getExtent(), *to_extent, useBilinearInterpolation && isNormalized, width, height);
+        resultImage = manualReproject(getImage(), getExtent(), destExtent, useBilinearInterpolation && isNormalized, width, height);
     }
     else
     {
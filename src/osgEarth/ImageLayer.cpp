@@ -69,6 +69,7 @@ ImageLayerOptions::setDefaults()
     _minFilter.init( osg::Texture::LINEAR_MIPMAP_LINEAR );
     _magFilter.init( osg::Texture::LINEAR );
     _texcomp.init( osg::Texture::USE_IMAGE_DATA_FORMAT ); // none
+    _cacheCompressed.init( false );
     _shared.init( false );
     _coverage.init( false );    
 }
@@ -118,6 +119,8 @@ ImageLayerOptions::fromConfig( const Config& conf )
     conf.getIfSet("texture_compression", "fastdxt", _texcomp, (osg::Texture::InternalFormatMode)(~0 - 1));
     //TODO add all the enums
 
+    conf.getIfSet("cache_compressed", _cacheCompressed);
+
     // uniform names
     conf.getIfSet("shared_sampler", _shareTexUniformName);
     conf.getIfSet("shared_matrix",  _shareTexMatUniformName);
@@ -168,6 +171,8 @@ ImageLayerOptions::getConfig( bool isolate ) const
     conf.updateIfSet("texture_compression", "fastdxt", _texcomp, (osg::Texture::InternalFormatMode)(~0 - 1));
     //TODO add all the enums
 
+    conf.updateIfSet("cache_compressed", _cacheCompressed);
+
     // uniform names
     conf.updateIfSet("shared_sampler", _shareTexUniformName);
     conf.updateIfSet("shared_matrix",  _shareTexMatUniformName);
@@ -198,6 +203,31 @@ namespace
             return equiv;
         }
     };
+
+    // Private copy of an image shared by another thread's request.
+    GeoImage copyImage( const GeoImage& image )
+    {
+        if ( !image.valid() )
+            return image;
+
+        return GeoImage(
+            osg::clone(image.getImage(), osg::CopyOp::DEEP_COPY_ALL),
+            image.getExtent() );
+    }
+
+    // Publishes the result of a coalesced request. Waiting threads get their
+    // own copy since the caller may modify the image; an interrupted request
+    // is not shared, so the waiting threads try again themselves.
+    template<typename TICKET>
+    void shareImage( TICKET& ticket, const GeoImage& result, ProgressCallback* progress )
+    {
+        bool interrupted = progress && (progress->isCanceled() || progress->needsRetry());
+
+        if ( ticket.close() > 0 && !interrupted )
+            ticket.finish( copyImage(result) );
+        else
+            ticket.finish( result, !interrupted );
+    }
 }
 
 //------------------------------------------------------------------------
@@ -516,6 +546,23 @@ ImageLayer::createImageInNativeProfile(const TileKey&    key,
 GeoImage
 ImageLayer::createImageInKeyProfile(const TileKey&    key, 
                                     ProgressCallback* progress)
+{
+    // If another thread is already creating this tile, wait and share its result.
+    ImageFlights::Ticket ticket( _keyProfileFlights, getFlightKey(key), progress );
+    if ( ticket.canceled() )
+        return GeoImage::INVALID;
+    if ( ticket.hasResult() )
+        return copyImage( ticket.result() );
+
+    GeoImage result = createImageInKeyProfileImpl( key, progress );
+    shareImage( ticket, result, progress );
+    return result;
+}
+
+
+GeoImage
+ImageLayer::createImageInKeyProfileImpl(const TileKey&    key, 
+                                        ProgressCallback* progress)
 {
     GeoImage result;
 
@@ -537,11 +584,10 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     // Check the layer L2 cache first
     if ( _memCache.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateBin( key.getProfile()->getFullSignature() );        
-        ReadResult result = bin->readObject(key.str() );
+        ReadResult result = _memCache->readTile( key );
         if ( result.succeeded() )
             return GeoImage(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
-        //_memCache->dumpStats(key.getProfile()->getFullSignature());
+        //_memCache->dumpStats("__default");
     }
 
     // locate the cache bin for the target profile for this layer:
@@ -611,11 +657,16 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         ImageUtils::fixInternalFormat( result.getImage() );
     }
 
+    // Compress before caching, so the cache holds ready-to-use tiles.
+    if ( result.valid() && isFastDXTEnabled() && _runtimeOptions.cacheCompressed() == true )
+    {
+        compressImage( result.getImage(), true );
+    }
+
     // memory cache first:
     if ( result.valid() && _memCache.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateBin( key.getProfile()->getFullSignature() ); 
-        bin->write(key.str(), result.getImage());
+        _memCache->writeTile( key, result.getImage() );
     }
 
     // If we got a result, the cache is valid and we are caching in the map profile,
@@ -655,6 +706,24 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
 GeoImage
 ImageLayer::createImageFromTileSource(const TileKey&    key,
                                       ProgressCallback* progress)
+{
+    // If another thread is already fetching this tile, wait and share its result.
+    // (Parent-key fallbacks in particular tend to request the same tiles.)
+    ImageFlights::Ticket ticket( _tileSourceFlights, getFlightKey(key), progress );
+    if ( ticket.canceled() )
+        return GeoImage::INVALID;
+    if ( ticket.hasResult() )
+        return copyImage( ticket.result() );
+
+    GeoImage result = createImageFromTileSourceImpl( key, progress );
+    shareImage( ticket, result, progress );
+    return result;
+}
+
+
+GeoImage
+ImageLayer::createImageFromTileSourceImpl(const TileKey&    key,
+                                          ProgressCallback* progress)
 {
     TileSource* source = getTileSource();
     if ( !source )
@@ -879,6 +948,49 @@ ImageLayer::assembleImageFromTileSource(const TileKey&    key,
 }
 
 
+bool
+ImageLayer::isFastDXTEnabled() const
+{
+    return
+        !isCoverage() &&
+        _runtimeOptions.textureCompression() == (osg::Texture::InternalFormatMode)(~0 - 1);
+}
+
+bool
+ImageLayer::compressImage(osg::Image* image, bool generateMipmaps) const
+{
+    if ( !image || !isFastDXTEnabled() || ImageUtils::isCompressed(image) )
+        return false;
+
+    osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension("fastdxt");
+    if ( !imageProcessor )
+    {
+        OE_WARN << LC << "Failed to get ImageProcessor fastdxt" << std::endl;
+        return false;
+    }
+
+    osg::Texture::InternalFormatMode mode;
+    // RGB uses DXT1
+    if (image->getPixelFormat() == GL_RGB)
+    {
+        mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
+    }
+    // RGBA uses DXT5
+    else if (image->getPixelFormat() == GL_RGBA)
+    {
+        mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
+    }
+    else
+    {
+        OE_INFO << LC << "FastDXT only works on GL_RGBA or GL_RGB images" << std::endl;
+        return false;
+    }
+
+    imageProcessor->compress(*image, mode, generateMipmaps, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
+    image->dirty();
+    return ImageUtils::isCompressed(image);
+}
+
 void
 ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
 {
@@ -913,41 +1025,18 @@ ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
             }
         }
     }
-    else if ( _runtimeOptions.textureCompression() == (osg::Texture::InternalFormatMode)(~0 - 1))
+    else if ( isFastDXTEnabled() )
     {
-        osg::Timer_t start = osg::Timer::instance()->tick();
-        osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension("fastdxt");
-        if (imageProcessor)
+        osg::Image* image = tex->getImage(0);
+        if ( image && !ImageUtils::isCompressed(image) )
         {
-            osg::Texture::InternalFormatMode mode;
-            // RGB uses DXT1
-            if (tex->getImage(0)->getPixelFormat() == GL_RGB)
-            {
-                mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
-            }
-            // RGBA uses DXT5
-            else if (tex->getImage(0)->getPixelFormat() == GL_RGBA)
-            {         
-                mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
-            }
-            else
+            osg::Texture::FilterMode minFilter = tex->getFilter(osg::Texture::MIN_FILTER);
+            bool mipmaps = minFilter != osg::Texture::LINEAR && minFilter != osg::Texture::NEAREST;
+            if ( compressImage(image, mipmaps) )
             {
-                OE_INFO << "FastDXT only works on GL_RGBA or GL_RGB images" << std::endl;
-                return;
+                tex->setImage(0, image);
             }
-
-            osg::Image *image = tex->getImage(0);
-            imageProcessor->compress(*image, mode, false, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
-            osg::Timer_t end = osg::Timer::instance()->tick();
-            image->dirty();
-            tex->setImage(0, image);
-            OE_INFO << "Compress took " << osg::Timer::instance()->delta_m(start, end) << std::endl;        
         }
-        else
-        {
-            OE_WARN << "Failed to get ImageProcessor fastdxt" << std::endl;
-        }
-
     }
     else if ( _runtimeOptions.textureCompression().isSet() )
     {
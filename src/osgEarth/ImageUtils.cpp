@@ -434,6 +434,81 @@ ImageUtils::buildNearestNeighborMipmaps(const osg::Image* input)
     return result.release();
 }
 
+osg::Image*
+ImageUtils::buildMipmaps(const osg::Image* input)
+{
+    if ( !input || input->isCompressed() || input->r() != 1 )
+        return 0L;
+
+    int size = input->s();
+    if ( size < 2 || input->t() != size || (size & (size-1)) != 0 )
+        return 0L;
+
+    if ( !PixelReader::supports(input) || !PixelWriter::supports(input) )
+        return 0L;
+
+    // mipmap addressing assumes tightly packed rows.
+    int pixelSizeBytes = osg::Image::computePixelSizeInBits( input->getPixelFormat(), input->getDataType() ) / 8;
+    if ( pixelSizeBytes == 0 || (int)input->getRowSizeInBytes() != size * pixelSizeBytes )
+        return 0L;
+
+    // first, build the image that will hold all the mipmap levels.
+    int numMipmapLevels = osg::Image::computeNumberOfMipmapLevels( size, size );
+    int totalSizeBytes  = 0;
+    std::vector< unsigned int > mipmapDataOffsets;
+
+    mipmapDataOffsets.reserve( numMipmapLevels-1 );
+
+    for( int i=0; i<numMipmapLevels; ++i )
+    {
+        if ( i > 0 )
+            mipmapDataOffsets.push_back( totalSizeBytes );
+
+        int level_size = size >> i;
+        totalSizeBytes += level_size * level_size * pixelSizeBytes;
+    }
+
+    unsigned char* data = new unsigned char[totalSizeBytes];
+
+    osg::ref_ptr<osg::Image> result = new osg::Image();
+    result->setImage(
+        size, size, 1,
+        input->getInternalTextureFormat(), 
+        input->getPixelFormat(), 
+        input->getDataType(), 
+        data, osg::Image::USE_NEW_DELETE,
+        input->getPacking() );
+
+    result->setMipmapLevels( mipmapDataOffsets );
+    markAsNormalized( result.get(), isNormalized(input) );
+
+    // level 0 is a straight copy; each other level averages 2x2 blocks of the one above it.
+    memcpy( result->data(), input->data(), size * size * pixelSizeBytes );
+
+    PixelReader read( result.get() );
+    PixelWriter write( result.get() );
+
+    for( int level=1; level<numMipmapLevels; ++level )
+    {
+        int level_size = size >> level;
+        for( int t=0; t<level_size; ++t )
+        {
+            for( int s=0; s<level_size; ++s )
+            {
+                osg::Vec4 color =
+                    read(2*s,   2*t,   0, level-1) +
+                    read(2*s+1, 2*t,   0, level-1) +
+                    read(2*s,   2*t+1, 0, level-1) +
+                    read(2*s+1, 2*t+1, 0, level-1);
+
+                write( color * 0.25f, s, t, 0, level );
+            }
+        }
+    }
+
+    return result.release();
+}
+
 osg::Image*
 ImageUtils::createMipmapBlendedImage( const osg::Image* primary, const osg::Image* secondary )
 {
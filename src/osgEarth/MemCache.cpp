@@ -20,6 +20,8 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Containers>
+#include <osg/Image>
+#include <osg/Shape>
 
 using namespace osgEarth;
 
@@ -30,35 +32,63 @@ using namespace osgEarth;
 namespace
 {
     typedef std::pair<osg::ref_ptr<const osg::Object>, Config> MemCacheEntry;
-    typedef LRUCache<std::string, MemCacheEntry> MemCacheLRU;
+    typedef ShardedLRUCache<std::string, MemCacheEntry> MemCacheLRU;
+
+    // Approximate size of a metadata tree; counts its strings without serializing it.
+    size_t estimateSize(const Config& conf)
+    {
+        size_t size = sizeof(Config) + conf.key().size() + conf.value().size();
+        for(ConfigSet::const_iterator i = conf.children().begin(); i != conf.children().end(); ++i)
+            size += estimateSize( *i );
+        return size;
+    }
+
+    // Approximate memory footprint of a cached object, used for the byte budget.
+    size_t estimateSize(size_t keySize, const osg::Object* object, const Config& meta)
+    {
+        size_t size = sizeof(MemCacheEntry) + keySize + estimateSize(meta);
+
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        if ( image )
+            return size + image->getTotalSizeInBytesIncludingMipmaps();
+
+        const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+        if ( hf )
+            return size + hf->getNumColumns() * hf->getNumRows() * sizeof(float);
+
+        // unknown object type; count a nominal amount so it still ages out.
+        return size + 1024;
+    }
 
     struct MemCacheBin : public CacheBin
     {
-        MemCacheBin( const std::string& id, unsigned maxSize )
+        MemCacheBin( const std::string& id, unsigned maxSize, size_t maxBytes )
             : CacheBin( id ),
-              _lru    ( true /* MT-safe */, maxSize )
+              _lru    ( maxSize, maxBytes )
         {
             //nop
         }
 
         ReadResult readObject(const std::string& key )
+        {
+            return readHash( MemCacheLRU::hash(key) );
+        }
+
+        ReadResult readHash(MemCacheLRU::HashCode hash)
         {
             MemCacheLRU::Record rec;
-            _lru.get(key, rec);
+            _lru.getHash(hash, rec);
 
             // clone required since the cache is in memory
 
             if ( rec.valid() )
             {
-                //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
-
                 return ReadResult( 
                    osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL),
                    rec.value().second );
             }
             else
             {
-                //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
                 return ReadResult();
             }
         }
@@ -77,7 +107,18 @@ namespace
         {
             if ( object ) 
             {
-                _lru.insert( key, std::make_pair(object, meta) );
+                _lru.insert( key, std::make_pair(object, meta), estimateSize(key.size(), object, meta) );
+                return true;
+            }
+            else
+                return false;
+        }
+
+        bool writeHash( MemCacheLRU::HashCode hash, const osg::Object* object )
+        {
+            if ( object )
+            {
+                _lru.insertHash( hash, std::make_pair(object, Config()), estimateSize(0u, object, Config()) );
                 return true;
             }
             else
@@ -113,21 +154,35 @@ namespace
     };
     
 
+    // Hashes a tile key and its profile, without building the key's string.
+    MemCacheLRU::HashCode hashTileKey(const TileKey& key)
+    {
+        MemCacheLRU::HashCode h = MemCacheLRU::hash( key.getProfile()->getFullSignature() );
+        h ^= ShardHash64<unsigned long long>()(
+            ((unsigned long long)(key.getLOD() & 0x3Fu) << 58) |
+            ((unsigned long long)(key.getTileX() & 0x1FFFFFFFu) << 29) |
+            ((unsigned long long)(key.getTileY() & 0x1FFFFFFFu)) );
+        return h;
+    }
+
     static Threading::Mutex s_defaultBinMutex;
 }
 
 //------------------------------------------------------------------------
 
-MemCache::MemCache( unsigned maxBinSize ) :
-_maxBinSize( std::max(maxBinSize, 1u) )
+MemCache::MemCache( unsigned maxBinSize, size_t maxBinBytes ) :
+_maxBinSize ( maxBinSize ),
+_maxBinBytes( maxBinBytes )
 {
-    //nop
+    // at least one limit is required, or the cache would grow forever.
+    if ( _maxBinSize == 0u && _maxBinBytes == 0 )
+        _maxBinSize = 1u;
 }
 
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize, _maxBinBytes) );
 }
 
 CacheBin*
@@ -148,18 +203,52 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            _defaultBin = new MemCacheBin("__default", _maxBinSize, _maxBinBytes);
         }
     }
 
     return _defaultBin.get();
 }
 
+ReadResult
+MemCache::readTile(const TileKey& key)
+{
+    MemCacheBin* bin = static_cast<MemCacheBin*>(getOrCreateDefaultBin());
+    return bin->readHash( hashTileKey(key) );
+}
+
+bool
+MemCache::writeTile(const TileKey& key, const osg::Object* object)
+{
+    MemCacheBin* bin = static_cast<MemCacheBin*>(getOrCreateDefaultBin());
+    return bin->writeHash( hashTileKey(key), object );
+}
+
+bool
+MemCache::getStats(const std::string& binID, ShardedCacheStats& out)
+{
+    MemCacheBin* bin = binID == "__default" ?
+        static_cast<MemCacheBin*>(getOrCreateDefaultBin()) :
+        static_cast<MemCacheBin*>(getBin(binID));
+    if ( !bin )
+        return false;
+
+    out = bin->_lru.getStats();
+    return true;
+}
 
 void
 MemCache::dumpStats(const std::string& binID)
 {
-    MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
-    CacheStats stats = bin->_lru.getStats();
-    OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
+    ShardedCacheStats stats;
+    if ( getStats(binID, stats) )
+    {
+        OE_INFO << LC << "[" << binID << "] "
+            << "entries = " << stats._entries
+            << ", bytes = " << stats._bytes
+            << ", hits = " << stats._hits
+            << ", misses = " << stats._misses
+            << ", evictions = " << stats._evictions
+            << ", hit ratio = " << stats._hitRatio << std::endl;
+    }
 }
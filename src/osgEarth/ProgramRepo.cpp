@@ -0,0 +1,144 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/ProgramRepo>
+#include <osgEarth/Notify>
+
+#define LC "[ProgramRepo] "
+
+using namespace osgEarth;
+
+ProgramRepo::ProgramRepo() :
+_enabled       ( true ),
+_maxAge        ( 300u ),
+_lastPruneFrame( 0u )
+{
+    //nop
+}
+
+void
+ProgramRepo::setEnabled(bool value)
+{
+    _enabled = value;
+    if ( !_enabled )
+    {
+        clear();
+    }
+}
+
+bool
+ProgramRepo::get(const Signature& sig, unsigned frameNumber, osg::ref_ptr<osg::Program>& out)
+{
+    if ( !_enabled )
+        return false;
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    ProgramMap::iterator i = _programs.find( sig );
+    if ( i == _programs.end() )
+        return false;
+
+    i->second._frameLastUsed = frameNumber;
+    out = i->second._program.get();
+    ++_stats._hits;
+    return true;
+}
+
+osg::Program*
+ProgramRepo::add(const Signature& sig, osg::Program* program, double buildTime, unsigned frameNumber)
+{
+    if ( !_enabled )
+        return program;
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    ++_stats._built;
+    _stats._buildTime += buildTime;
+
+    Entry& entry = _programs[sig];
+    if ( !entry._program.valid() )
+    {
+        entry._program = program;
+    }
+    entry._frameLastUsed = frameNumber;
+
+    osg::Program* result = entry._program.get();
+
+    prune( frameNumber );
+
+    return result;
+}
+
+void
+ProgramRepo::prune(unsigned frameNumber)
+{
+    if ( frameNumber == 0u || frameNumber == _lastPruneFrame )
+        return;
+
+    _lastPruneFrame = frameNumber;
+
+    for(ProgramMap::iterator i = _programs.begin(); i != _programs.end(); )
+    {
+        // the repo holding the only reference means no VirtualProgram is using it.
+        if ( frameNumber - i->second._frameLastUsed > _maxAge &&
+             i->second._program->referenceCount() == 1 )
+        {
+            i->second._program->releaseGLObjects( 0L );
+            _programs.erase( i++ );
+            ++_stats._evicted;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void
+ProgramRepo::recordLink(double linkTime)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    ++_stats._linked;
+    _stats._linkTime += linkTime;
+}
+
+ProgramRepo::Stats
+ProgramRepo::getStats() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    Stats stats = _stats;
+    stats._programs = _programs.size();
+    return stats;
+}
+
+void
+ProgramRepo::resetStats()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _stats = Stats();
+}
+
+void
+ProgramRepo::clear()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _programs.clear();
+}
@@ -30,6 +30,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/ObjectIndex>
+#include <osgEarth/ProgramRepo>
 
 #include <osgEarth/Units>
 #include <osg/Notify>
@@ -58,6 +59,7 @@ using namespace OpenThreads;
 Registry::Registry() :
 osg::Referenced     ( true ),
 _gdal_registered    ( false ),
+_gdalConcurrency    ( false ),
 _numGdalMutexGets   ( 0 ),
 _uidGen             ( 0 ),
 _caps               ( 0L ),
@@ -95,6 +97,9 @@ _cacheDriver        ( "filesystem" )
     // Default object index for tracking scene object by UID.
     _objectIndex = new ObjectIndex();
 
+    // programs shared across all VirtualPrograms.
+    _programContentRepo = new ProgramRepo();
+
     // activate KMZ support
     osgDB::Registry::instance()->addArchiveExtension  ( "kmz" );
     //osgDB::Registry::instance()->addFileExtensionAlias( "kmz", "kml" );
@@ -171,6 +176,13 @@ _cacheDriver        ( "filesystem" )
         }
     }
 
+    // allow per-thread GDAL objects to run outside the global GDAL mutex
+    if ( ::getenv(OSGEARTH_ENV_GDAL_CONCURRENT) )
+    {
+        _gdalConcurrency = true;
+        OE_INFO << LC << "GDAL concurrency enabled from environment" << std::endl;
+    }
+
     const char* teStr = ::getenv(OSGEARTH_ENV_TERRAIN_ENGINE_DRIVER);
     if ( teStr )
     {
@@ -561,6 +573,12 @@ Registry::getProgramSharedRepo()
     return &_programRepo;
 }
 
+ProgramRepo*
+Registry::getProgramRepo() const
+{
+    return _programContentRepo.get();
+}
+
 ObjectIndex*
 Registry::getObjectIndex() const
 {
@@ -450,6 +450,15 @@ SpatialReference::~SpatialReference()
             OCTDestroyCoordinateTransformation(itr->second);
         }
 
+        for (ThreadTransformHandleCaches::iterator t = _threadTransformHandleCaches.begin(); t != _threadTransformHandleCaches.end(); ++t)
+        {
+            for (TransformHandleCache::iterator itr = t->second.begin(); itr != t->second.end(); ++itr)
+            {
+                if ( itr->second )
+                    OCTDestroyCoordinateTransformation(itr->second);
+            }
+        }
+
         if ( _owns_handle )
         {
             OSRDestroySpatialReference( _handle );
@@ -1146,6 +1155,45 @@ SpatialReference::transformXYPointArrays(double*  x,
                                          unsigned count,
                                          const SpatialReference* out_srs) const
 {  
+    // In concurrent mode, each thread owns its own OCT handles and can
+    // transform without the global GDAL/OGR lock.
+    if ( Registry::instance()->isGDALConcurrencyEnabled() )
+    {
+        TransformHandleCache* threadCache = 0L;
+        {
+            Threading::ScopedMutexLock lock( _threadTransformHandleCachesMutex );
+            threadCache = &_threadTransformHandleCaches[Threading::getCurrentThreadId()];
+        }
+
+        // only this thread ever touches its own cache, so no lock is needed here.
+        void* xform_handle = NULL;
+        const std::string& outWKT = out_srs->getWKT();
+        TransformHandleCache::const_iterator itr = threadCache->find(outWKT);
+        if (itr != threadCache->end())
+        {
+            xform_handle = itr->second;
+        }
+        else
+        {
+            // creating the OCT touches shared PROJ/OGR state, so lock for that part.
+            GDAL_SCOPED_LOCK;
+            OE_DEBUG << LC << "allocating new per-thread OCT Transform" << std::endl;
+            xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
+            (*threadCache)[outWKT] = xform_handle;
+        }
+
+        if ( !xform_handle )
+        {
+            OE_WARN << LC
+                << "SRS xform not possible" << std::endl
+                << "    From => " << getName() << std::endl
+                << "    To   => " << out_srs->getName() << std::endl;
+            return false;
+        }
+
+        return OCTTransform( xform_handle, count, x, y, 0L ) > 0;
+    }
+
     // Transform the X and Y values inside an exclusive GDAL/OGR lock
     GDAL_SCOPED_LOCK;
 
@@ -19,6 +19,8 @@
 #include <osgEarth/TaskService>
 #include <osg/Notify>
 #include <osg/Math>
+#include <OpenThreads/Thread>
+#include <climits>
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -30,7 +32,9 @@ using namespace OpenThreads;
 TaskRequest::TaskRequest( float priority ) :
 osg::Referenced( true ),
 _priority( priority ),
-_state( STATE_IDLE )
+_state( STATE_IDLE ),
+_stamp( -1 ),
+_enqueueTime( 0 )
 {
     _progress = new ProgressCallback();
 }
@@ -65,47 +69,142 @@ TaskRequest::wasCanceled() const
 
 //------------------------------------------------------------------------
 
-TaskRequestQueue::TaskRequestQueue(unsigned int maxSize) :
-osg::Referenced( true ),
-_done( false ),
-_maxSize( maxSize )
+TaskQueueStats::TaskQueueStats() :
+_pending      ( 0 ),
+_pendingByLane( TaskRequestQueue::NUM_LANES, 0u ),
+_dispatched   ( 0 ),
+_stolen       ( 0 ),
+_canceled     ( 0 ),
+_meanLatency  ( 0.0 ),
+_maxLatency   ( 0.0 )
+{
+    //nop
+}
+
+//------------------------------------------------------------------------
+
+TaskRequestQueue::WorkDeque::WorkDeque() :
+_dispatched  ( 0 ),
+_stolen      ( 0 ),
+_canceled    ( 0 ),
+_totalLatency( 0.0 ),
+_maxLatency  ( 0.0 )
 {
+    //nop
+}
+
+TaskRequestQueue::TaskRequestQueue(unsigned int maxSize, unsigned int numDeques) :
+osg::Referenced   ( true ),
+_done             ( false ),
+_maxSize          ( maxSize ),
+_stamp            ( 0 )
+{
+    if ( numDeques == 0 )
+        numDeques = (unsigned)osg::maximum( OpenThreads::GetNumberOfProcessors(), 1 );
+
+    for(unsigned lane=0; lane<NUM_LANES; ++lane)
+        _minLiveStamp[lane] = INT_MIN;
+
+    _deques.resize( numDeques );
+    for(unsigned i=0; i<numDeques; ++i)
+        _deques[i] = new WorkDeque();
+}
+
+TaskRequestQueue::~TaskRequestQueue()
+{
+    for(unsigned i=0; i<_deques.size(); ++i)
+        delete _deques[i];
+}
+
+unsigned
+TaskRequestQueue::getLane(float priority)
+{
+    // lowest value first, to match the old multimap ordering.
+    return priority < 0.0f ? 0u : priority > 0.0f ? 2u : 1u;
+}
+
+unsigned
+TaskRequestQueue::assignDeque()
+{
+    return (unsigned)(++_nextWorker) % _deques.size();
 }
 
 void
 TaskRequestQueue::clear()
 {
+    for(unsigned i=0; i<_deques.size(); ++i)
+    {
+        WorkDeque& wd = *_deques[i];
+        Threading::ScopedMutexLock lock( wd._mutex );
+        for(unsigned lane=0; lane<NUM_LANES; ++lane)
+        {
+            for(unsigned n=0; n<wd._lanes[lane].size(); ++n)
+            {
+                --_lanePending[lane];
+                --_numPending;
+            }
+            wd._lanes[lane].clear();
+        }
+    }
+
     ScopedLock<Mutex> lock(_mutex);
-    _requests.clear();
+    _poison = 0L;
+
+    // room was made; release any blocked adders.
+    for(int i=0; i<128; i++)
+        _notFull.signal();
 }
 
 void
 TaskRequestQueue::cancel()
 {
+    for(unsigned i=0; i<_deques.size(); ++i)
+    {
+        WorkDeque& wd = *_deques[i];
+        Threading::ScopedMutexLock lock( wd._mutex );
+        for(unsigned lane=0; lane<NUM_LANES; ++lane)
+        {
+            for(Lane::iterator r = wd._lanes[lane].begin(); r != wd._lanes[lane].end(); ++r)
+            {
+                r->second->cancel();
+                --_lanePending[lane];
+                --_numPending;
+            }
+            wd._lanes[lane].clear();
+        }
+    }
+
     ScopedLock<Mutex> lock(_mutex);
-    for (TaskRequestPriorityMap::iterator it = _requests.begin(); it != _requests.end(); ++it)
-        (*it).second->cancel();
+    _poison = 0L;
 
-    _requests.clear();
+    // room was made; release any blocked adders.
+    for(int i=0; i<128; i++)
+        _notFull.signal();
+}
+
+void
+TaskRequestQueue::cancelBefore(int stamp)
+{
+    for(unsigned lane=0; lane<NUM_LANES; ++lane)
+        _minLiveStamp[lane] = stamp;
 }
 
 bool
 TaskRequestQueue::isFull() const
 {
-    return _maxSize > 0 && (_maxSize == _requests.size());
+    return _maxSize > 0 && (unsigned)_numPending >= _maxSize;
 }
 
 bool
 TaskRequestQueue::isEmpty() const
 {
-    return !_done && _requests.empty();
+    return !_done && (unsigned)_numPending == 0;
 }
 
 unsigned int
 TaskRequestQueue::getNumRequests() const
 {
-    ScopedLock<Mutex> lock(const_cast<TaskRequestQueue*>(this)->_mutex);
-    return _requests.size();
+    return (unsigned)_numPending;
 }
 
 void 
@@ -113,63 +212,146 @@ TaskRequestQueue::add( TaskRequest* request )
 {
     request->setState( TaskRequest::STATE_PENDING );
 
+    // The poison pill is held aside and only handed out once the queue
+    // has drained, so threads finish the outstanding work before exiting.
+    if ( dynamic_cast<PoisonPill*>(request) )
+    {
+        ScopedLock<Mutex> lock( _mutex );
+        _poison = request;
+        for(int i=0; i<128; i++)
+            _notEmpty.signal();
+        return;
+    }
+
     // install a progress callback if one isn't already installed
     if ( !request->getProgressCallback() )
         request->setProgressCallback( new ProgressCallback() );
 
+    if ( request->getStamp() < 0 )
+        request->setStamp( _stamp );
+
+    request->setEnqueueTime( osg::Timer::instance()->tick() );
+
+    // Bounded queue: wait for room. The bound is approximate since several
+    // threads may pass this check at once.
+    if ( isFull() )
     {
-        // Lock on the add mutex so no one else can add.
         ScopedLock<Mutex> lock( _mutex );
-
-        while(isFull())
+        ++_numBlockedAdders;
+        while( !_done && isFull() )
         {
             _notFull.wait(&_mutex);
         }
+        --_numBlockedAdders;
+    }
 
-        // Check to make sure the bounded queue is working correctly.
-        if (_maxSize > 0 && _requests.size() > _maxSize)
-        {
-            OE_NOTICE << "ERROR:  TaskRequestQueue requests " << getNumRequests() << " > max size of " << _maxSize << std::endl;
-        }
+    // Spread new requests across the work deques; the counters are bumped
+    // under the deque lock so they never fall behind a dispatch.
+    float priority = request->getPriority();
+    unsigned lane = getLane( priority );
+    WorkDeque& wd = *_deques[(unsigned)(++_nextDeque) % _deques.size()];
+    {
+        // insert after any requests of equal priority, so they stay FIFO.
+        Threading::ScopedMutexLock lock( wd._mutex );
+        wd._lanes[lane].insert( wd._lanes[lane].upper_bound(priority), std::make_pair(priority, osg::ref_ptr<TaskRequest>(request)) );
+        ++_lanePending[lane];
+        ++_numPending;
+    }
+
+    // since there is data in the queue, wake up one waiting task thread.
+    if ( (unsigned)_numSleeping > 0 )
+    {
+        ScopedLock<Mutex> lock( _mutex );
+        _notEmpty.signal();
+    }
+}
+
+TaskRequest*
+TaskRequestQueue::dispatch(WorkDeque& wd, unsigned lane, bool stolen)
+{
+    // caller holds the deque's lock.
+    osg::ref_ptr<TaskRequest> request = wd._lanes[lane].begin()->second;
+    wd._lanes[lane].erase( wd._lanes[lane].begin() );
+
+    --_lanePending[lane];
+    --_numPending;
 
-        // insert by priority.
-        _requests.insert( std::pair<float,TaskRequest*>(request->getPriority(), request) );
+    double latency = osg::Timer::instance()->delta_s( request->enqueueTime(), osg::Timer::instance()->tick() );
+    wd._dispatched++;
+    wd._totalLatency += latency;
+    wd._maxLatency = osg::maximum( wd._maxLatency, latency );
+    if ( stolen )
+        wd._stolen++;
+
+    // cancel-by-stamp: the thread will discard it without running it.
+    if ( request->getStamp() < _minLiveStamp[lane] )
+    {
+        request->cancel();
+        wd._canceled++;
     }
 
-    //OE_NOTICE << "There are now " << _requests.size() << " tasks" << std::endl;
+    return request.release();
+}
 
-    // since there is data in the queue, wake up one waiting task thread.
-    _notEmpty.signal(); 
+TaskRequest*
+TaskRequestQueue::tryGet(unsigned deque)
+{
+    if ( (unsigned)_numPending == 0 )
+        return 0L;
+
+    unsigned numDeques = _deques.size();
+
+    // own deque first, then steal from the others. Each deque is locked once
+    // and gives up its best request, so the first non-empty one wins.
+    for(unsigned i=0; i<numDeques; ++i)
+    {
+        WorkDeque& wd = *_deques[(deque + i) % numDeques];
+        Threading::ScopedMutexLock lock( wd._mutex );
+        for(unsigned lane=0; lane<NUM_LANES; ++lane)
+        {
+            if ( !wd._lanes[lane].empty() )
+                return dispatch( wd, lane, i > 0 );
+        }
+    }
+
+    return 0L;
 }
 
 TaskRequest* 
-TaskRequestQueue::get()
+TaskRequestQueue::get(unsigned deque)
 {
-    
-    osg::ref_ptr<TaskRequest> next;
-    {
-        ScopedLock<Mutex> lock(_mutex);
+    deque = deque % _deques.size();
 
-        while ( isEmpty() )
-        {                
-            _notEmpty.wait( &_mutex );        
+    while( !_done )
+    {
+        TaskRequest* next = tryGet( deque );
+        if ( next )
+        {
+            // I'm done, someone else take a turn:
+            if ( (unsigned)_numBlockedAdders > 0 )
+            {
+                ScopedLock<Mutex> lock(_mutex);
+                _notFull.signal();
+            }
+            return next;
         }
 
-        if ( _done )
+        // nothing to steal; sleep until something arrives.
+        ScopedLock<Mutex> lock(_mutex);
+        ++_numSleeping;
+        while( !_done && (unsigned)_numPending == 0 && !_poison.valid() )
         {
-            return 0L;
+            _notEmpty.wait( &_mutex );
         }
+        --_numSleeping;
 
-        next = _requests.begin()->second.get(); //_requests.front();
-        _requests.erase( _requests.begin() ); //_requests.pop_front();
+        if ( !_done && (unsigned)_numPending == 0 && _poison.valid() )
+        {
+            return _poison.get();
+        }
     }
 
-    // I'm done, someone else take a turn:
-    // (technically this shouldn't be necessary since add() bumps the semaphore once
-    // for each request in the queue)    
-    _notFull.signal();    
-
-    return next.release();
+    return 0L;
 }
 
 void
@@ -190,10 +372,53 @@ TaskRequestQueue::setDone()
     }
 }
 
+TaskQueueStats
+TaskRequestQueue::getStats() const
+{
+    TaskQueueStats stats;
+    double totalLatency = 0.0;
+
+    for(unsigned i=0; i<_deques.size(); ++i)
+    {
+        const WorkDeque& wd = *_deques[i];
+        Threading::ScopedMutexLock lock( wd._mutex );
+        stats._dispatched += wd._dispatched;
+        stats._stolen     += wd._stolen;
+        stats._canceled   += wd._canceled;
+        stats._maxLatency  = osg::maximum( stats._maxLatency, wd._maxLatency );
+        totalLatency      += wd._totalLatency;
+    }
+
+    stats._pending = (unsigned)_numPending;
+    for(unsigned lane=0; lane<NUM_LANES; ++lane)
+        stats._pendingByLane[lane] = (unsigned)_lanePending[lane];
+
+    if ( stats._dispatched > 0 )
+        stats._meanLatency = totalLatency / (double)stats._dispatched;
+
+    return stats;
+}
+
+void
+TaskRequestQueue::resetStats()
+{
+    for(unsigned i=0; i<_deques.size(); ++i)
+    {
+        WorkDeque& wd = *_deques[i];
+        Threading::ScopedMutexLock lock( wd._mutex );
+        wd._dispatched   = 0;
+        wd._stolen       = 0;
+        wd._canceled     = 0;
+        wd._totalLatency = 0.0;
+        wd._maxLatency   = 0.0;
+    }
+}
+
 //------------------------------------------------------------------------
 
 TaskThread::TaskThread( TaskRequestQueue* queue ) :
 _queue( queue ),
+_deque( queue->assignDeque() ),
 _done( false )
 {
     //nop
@@ -204,7 +429,7 @@ TaskThread::run()
 {
     while( !_done )
     {
-        _request = _queue->get();
+        _request = _queue->get( _deque );
 
         if ( _done )
             break;
@@ -450,6 +675,24 @@ TaskService::cancelAll()
     }
 }
 
+void
+TaskService::cancelBefore( int stamp )
+{
+    _queue->cancelBefore( stamp );
+}
+
+TaskQueueStats
+TaskService::getStats() const
+{
+    return _queue->getStats();
+}
+
+void
+TaskService::resetStats()
+{
+    _queue->resetStats();
+}
+
 //------------------------------------------------------------------------
 
 TaskServiceManager::TaskServiceManager( int numThreads ) :
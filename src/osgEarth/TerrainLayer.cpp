@@ -195,8 +195,12 @@ TerrainLayer::init()
     storeProxySettings( _dbOptions.get() );
 
     // Create an L2 mem cache that sits atop the main cache, if necessary.
-    // For now: use the same L2 cache size at the driver.
-    int l2CacheSize = _initOptions.driver()->L2CacheSize().get();
+    // For now: use the same L2 cache size at the driver. A byte budget replaces
+    // the default entry count unless the entry count was set explicitly.
+    const TileSourceOptions& driverOptions = _initOptions.driver().value();
+    size_t l2CacheBytes = driverOptions.L2CacheMaxBytes().getOrUse( 0 );
+    int l2CacheSize = 
+        l2CacheBytes > 0 && !driverOptions.L2CacheSize().isSet() ? 0 : driverOptions.L2CacheSize().get();
     
     // See if it was overridden with an env var.
     char const* l2env = ::getenv( "OSGEARTH_L2_CACHE_SIZE" );
@@ -211,12 +215,13 @@ TerrainLayer::init()
     if ( noCacheEnv )
     {
         l2CacheSize = 0;
+        l2CacheBytes = 0;
     }
 
-    // Initialize the l2 cache if it's size is > 0
-    if ( l2CacheSize > 0 )
+    // Initialize the l2 cache if it has a size
+    if ( l2CacheSize > 0 || l2CacheBytes > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        _memCache = new MemCache( (unsigned)std::max(l2CacheSize, 0), l2CacheBytes );
     }
 }
 
@@ -254,6 +259,7 @@ TerrainLayer::setCache( Cache* cache )
                 hashConf.remove( "cache_policy" );
                 hashConf.remove( "cacheid" );
                 hashConf.remove( "l2_cache_size" );
+                hashConf.remove( "l2_cache_max_bytes" );
                 
                 // need this, b/c data is vdatum-transformed before caching.
                 if ( layerConf.hasValue("vdatum") )
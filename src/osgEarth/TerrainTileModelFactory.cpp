@@ -373,17 +373,28 @@ osg::Texture*
 TerrainTileModelFactory::createImageTexture(osg::Image*       image,
                                             const ImageLayer* layer) const
 {
+    osg::Texture::FilterMode magFilter = 
+        layer ? layer->getImageLayerOptions().magFilter().get() : osg::Texture::LINEAR;
+    osg::Texture::FilterMode minFilter =
+        layer ? layer->getImageLayerOptions().minFilter().get() : osg::Texture::LINEAR;
+
+    // CPU compression for fastdxt layers. Compress a copy, since the layer's
+    // memory cache may be holding on to this same image.
+    osg::ref_ptr<osg::Image> compressed;
+    if ( layer && layer->isFastDXTEnabled() && !ImageUtils::isCompressed(image) )
+    {
+        bool mipmaps = minFilter != osg::Texture::LINEAR && minFilter != osg::Texture::NEAREST;
+        compressed = new osg::Image( *image );
+        if ( layer->compressImage(compressed.get(), mipmaps) )
+            image = compressed.get();
+    }
+
     osg::Texture2D* tex = new osg::Texture2D( image );
 
     tex->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
     tex->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
     tex->setResizeNonPowerOfTwoHint(false);
 
-    osg::Texture::FilterMode magFilter = 
-        layer ? layer->getImageLayerOptions().magFilter().get() : osg::Texture::LINEAR;
-    osg::Texture::FilterMode minFilter =
-        layer ? layer->getImageLayerOptions().minFilter().get() : osg::Texture::LINEAR;
-
     tex->setFilter( osg::Texture::MAG_FILTER, magFilter );
     tex->setFilter( osg::Texture::MIN_FILTER, minFilter );
     tex->setMaxAnisotropy( 4.0f );
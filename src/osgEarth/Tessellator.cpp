@@ -20,8 +20,14 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include <limits.h>
+#include <float.h>
+#include <math.h>
 
 #include <osgEarth/Tessellator>
+#include <osgEarth/ThreadingUtils>
+#include <algorithm>
+#include <deque>
+#include <cstdlib>
 
 using namespace osgEarth;
 
@@ -122,6 +128,733 @@ struct TriIndices
 
 typedef std::vector<TriIndices> TriList;
 
+/**
+ * Ear clipper that keeps the ring in a doubly linked list and, for large
+ * rings, threads a second list through the vertices in z-order (Morton)
+ * order. An ear test then only has to visit the vertices whose z-values
+ * fall inside the candidate triangle's bounding box, instead of the
+ * whole ring. Holes are joined to the outer ring with bridge edges
+ * before clipping. When no ear can be found, it drops duplicate and
+ * collinear points, then fixes small self-intersections, and finally
+ * splits the ring along a valid diagonal and recurses.
+ *
+ * Structurally a port of Mapbox's "earcut" (https://github.com/mapbox/earcut),
+ * which is distributed under the following license:
+ *
+ *   ISC License
+ *
+ *   Copyright (c) 2016, Mapbox
+ *
+ *   Permission to use, copy, modify, and/or distribute this software for any purpose
+ *   with or without fee is hereby granted, provided that the above copyright notice
+ *   and this permission notice appear in all copies.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH REGARD TO
+ *   THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+ *   IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ *   CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+ *   OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ *   ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+class ZOrderEarClipper
+{
+public:
+    ZOrderEarClipper(const osg::Vec3Array& verts, TriList& tris)
+        : _verts(verts), _tris(tris), _minX(0.0), _minY(0.0), _invSize(0.0) { }
+
+    /**
+     * Triangulates one polygon. rings[0] is the outer ring; any others are
+     * holes. Each ring is a [first,last) vertex range. Ring orientation
+     * does not matter. Triangles come out counter-clockwise.
+     */
+    void run(const std::vector< std::pair<unsigned,unsigned> >& rings)
+    {
+        if ( rings.empty() )
+            return;
+
+        Node* outer = linkedList(rings[0].first, rings[0].second, true);
+        if ( !outer || outer->next == outer->prev )
+            return;
+
+        unsigned numVerts = rings[0].second - rings[0].first;
+
+        if ( rings.size() > 1 )
+        {
+            outer = eliminateHoles(rings, outer);
+            for(unsigned i=1; i<rings.size(); ++i)
+                numVerts += rings[i].second - rings[i].first;
+        }
+
+        // z-order hashing only pays off on rings that aren't tiny.
+        if ( numVerts > 80 )
+        {
+            double maxX, maxY;
+            _minX = maxX = _verts[rings[0].first].x();
+            _minY = maxY = _verts[rings[0].first].y();
+            for(unsigned i=rings[0].first; i<rings[0].second; ++i)
+            {
+                double x = _verts[i].x(), y = _verts[i].y();
+                if ( x < _minX ) _minX = x;
+                if ( y < _minY ) _minY = y;
+                if ( x > maxX ) maxX = x;
+                if ( y > maxY ) maxY = y;
+            }
+            double size = std::max(maxX - _minX, maxY - _minY);
+            _invSize = size != 0.0 ? 32767.0 / size : 0.0;
+        }
+
+        earcutLinked(outer, 0);
+    }
+
+private:
+    struct Node
+    {
+        Node(unsigned i_, double x_, double y_)
+            : i(i_), x(x_), y(y_), prev(0L), next(0L), z(0), prevZ(0L), nextZ(0L), steiner(false) { }
+        unsigned i;         // index into the vertex array
+        double   x, y;
+        Node*    prev;      // ring order
+        Node*    next;
+        int      z;         // z-order curve value
+        Node*    prevZ;     // z-order
+        Node*    nextZ;
+        bool     steiner;   // lone hole vertex; never filtered
+    };
+
+    const osg::Vec3Array& _verts;
+    TriList&              _tris;
+    std::deque<Node>      _nodes;   // deque, so node pointers stay valid as it grows
+    double                _minX, _minY, _invSize;
+
+    Node* insertNode(unsigned i, Node* last)
+    {
+        _nodes.push_back( Node(i, _verts[i].x(), _verts[i].y()) );
+        Node* p = &_nodes.back();
+        if ( !last )
+        {
+            p->prev = p;
+            p->next = p;
+        }
+        else
+        {
+            p->next = last->next;
+            p->prev = last;
+            last->next->prev = p;
+            last->next = p;
+        }
+        return p;
+    }
+
+    static void removeNode(Node* p)
+    {
+        p->next->prev = p->prev;
+        p->prev->next = p->next;
+        if ( p->prevZ ) p->prevZ->nextZ = p->nextZ;
+        if ( p->nextZ ) p->nextZ->prevZ = p->prevZ;
+    }
+
+    // builds a circular list from a ring, wound to the requested orientation
+    // (clockwise in earcut's sense: positive signed area below).
+    Node* linkedList(unsigned first, unsigned last, bool clockwise)
+    {
+        if ( last - first < 1 )
+            return 0L;
+
+        double sum = 0.0;
+        for(unsigned i=first, j=last-1; i<last; j=i++)
+            sum += (_verts[j].x() - _verts[i].x()) * (_verts[i].y() + _verts[j].y());
+
+        Node* node = 0L;
+        if ( clockwise == (sum > 0.0) )
+        {
+            for(unsigned i=first; i<last; ++i)
+                node = insertNode(i, node);
+        }
+        else
+        {
+            for(unsigned i=last; i>first; --i)
+                node = insertNode(i-1, node);
+        }
+
+        // drop the closing point if the ring repeats its first vertex
+        if ( node && equals(node, node->next) )
+        {
+            removeNode(node);
+            node = node->next;
+        }
+        return node;
+    }
+
+    static double area(const Node* p, const Node* q, const Node* r)
+    {
+        return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+    }
+
+    static bool equals(const Node* a, const Node* b)
+    {
+        return a->x == b->x && a->y == b->y;
+    }
+
+    static bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+    {
+        return
+            (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+            (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+            (bx - px) * (cy - py) >= (cx - px) * (by - py);
+    }
+
+    static int sign(double v)
+    {
+        return v > 0.0 ? 1 : v < 0.0 ? -1 : 0;
+    }
+
+    // q lies on segment pr, given the three are collinear
+    static bool onSegment(const Node* p, const Node* q, const Node* r)
+    {
+        return
+            q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) &&
+            q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+    }
+
+    static bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2)
+    {
+        int o1 = sign(area(p1, q1, p2));
+        int o2 = sign(area(p1, q1, q2));
+        int o3 = sign(area(p2, q2, p1));
+        int o4 = sign(area(p2, q2, q1));
+
+        if ( o1 != o2 && o3 != o4 ) return true;
+        if ( o1 == 0 && onSegment(p1, p2, q1) ) return true;
+        if ( o2 == 0 && onSegment(p1, q2, q1) ) return true;
+        if ( o3 == 0 && onSegment(p2, p1, q2) ) return true;
+        if ( o4 == 0 && onSegment(p2, q1, q2) ) return true;
+        return false;
+    }
+
+    static bool intersectsPolygon(const Node* a, const Node* b)
+    {
+        const Node* p = a;
+        do {
+            if ( p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
+                 intersects(p, p->next, a, b) )
+                return true;
+            p = p->next;
+        } while( p != a );
+        return false;
+    }
+
+    // diagonal ab lies inside the polygon near a
+    static bool locallyInside(const Node* a, const Node* b)
+    {
+        return area(a->prev, a, a->next) < 0.0 ?
+            area(a, b, a->next) >= 0.0 && area(a, a->prev, b) >= 0.0 :
+            area(a, b, a->prev) < 0.0 || area(a, a->next, b) < 0.0;
+    }
+
+    // midpoint of diagonal ab is inside the polygon
+    static bool middleInside(const Node* a, const Node* b)
+    {
+        const Node* p = a;
+        bool inside = false;
+        double px = 0.5*(a->x + b->x), py = 0.5*(a->y + b->y);
+        do {
+            if ( ((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+                 (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x) )
+                inside = !inside;
+            p = p->next;
+        } while( p != a );
+        return inside;
+    }
+
+    static bool isValidDiagonal(const Node* a, const Node* b)
+    {
+        return
+            a->next->i != b->i && a->prev->i != b->i && !intersectsPolygon(a, b) &&
+            ((locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b) &&
+              (area(a->prev, a, b->prev) != 0.0 || area(a, b->prev, b) != 0.0)) ||
+             (equals(a, b) && area(a->prev, a, a->next) > 0.0 && area(b->prev, b, b->next) > 0.0));
+    }
+
+    // removes duplicate and collinear points between start and end
+    static Node* filterPoints(Node* start, Node* end =0L)
+    {
+        if ( !start )
+            return start;
+        if ( !end )
+            end = start;
+
+        Node* p = start;
+        bool again;
+        do {
+            again = false;
+            if ( !p->steiner && (equals(p, p->next) || area(p->prev, p, p->next) == 0.0) )
+            {
+                removeNode(p);
+                p = end = p->prev;
+                if ( p == p->next )
+                    break;
+                again = true;
+            }
+            else
+            {
+                p = p->next;
+            }
+        } while( again || p != end );
+
+        return end;
+    }
+
+    // cuts the ring in two along diagonal ab; returns the node starting the new half
+    Node* splitPolygon(Node* a, Node* b)
+    {
+        _nodes.push_back( Node(a->i, a->x, a->y) );
+        Node* a2 = &_nodes.back();
+        _nodes.push_back( Node(b->i, b->x, b->y) );
+        Node* b2 = &_nodes.back();
+        Node* an = a->next;
+        Node* bp = b->prev;
+
+        a->next = b;
+        b->prev = a;
+
+        a2->next = an;
+        an->prev = a2;
+
+        b2->next = a2;
+        a2->prev = b2;
+
+        bp->next = b2;
+        b2->prev = bp;
+
+        return b2;
+    }
+
+    // z-order of a point, from its coordinates mapped into 15-bit integers
+    int zOrder(double px, double py) const
+    {
+        unsigned x = (unsigned)((px - _minX) * _invSize);
+        unsigned y = (unsigned)((py - _minY) * _invSize);
+
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+
+        y = (y | (y << 8)) & 0x00FF00FF;
+        y = (y | (y << 4)) & 0x0F0F0F0F;
+        y = (y | (y << 2)) & 0x33333333;
+        y = (y | (y << 1)) & 0x55555555;
+
+        return (int)(x | (y << 1));
+    }
+
+    void indexCurve(Node* start)
+    {
+        Node* p = start;
+        do {
+            if ( p->z == 0 )
+                p->z = zOrder(p->x, p->y);
+            p->prevZ = p->prev;
+            p->nextZ = p->next;
+            p = p->next;
+        } while( p != start );
+
+        p->prevZ->nextZ = 0L;
+        p->prevZ = 0L;
+
+        sortLinked(p);
+    }
+
+    // bottom-up merge sort of the z-order list (S. Tatham)
+    static Node* sortLinked(Node* list)
+    {
+        unsigned inSize = 1;
+        unsigned numMerges;
+        do {
+            Node* p = list;
+            Node* tail = 0L;
+            list = 0L;
+            numMerges = 0;
+
+            while( p )
+            {
+                ++numMerges;
+                Node* q = p;
+                unsigned pSize = 0;
+                for(unsigned i=0; i<inSize; ++i)
+                {
+                    ++pSize;
+                    q = q->nextZ;
+                    if ( !q ) break;
+                }
+                unsigned qSize = inSize;
+
+                while( pSize > 0 || (qSize > 0 && q) )
+                {
+                    Node* e;
+                    if ( pSize != 0 && (qSize == 0 || !q || p->z <= q->z) )
+                    {
+                        e = p;
+                        p = p->nextZ;
+                        --pSize;
+                    }
+                    else
+                    {
+                        e = q;
+                        q = q->nextZ;
+                        --qSize;
+                    }
+
+                    if ( tail ) tail->nextZ = e;
+                    else list = e;
+
+                    e->prevZ = tail;
+                    tail = e;
+                }
+                p = q;
+            }
+
+            tail->nextZ = 0L;
+            inSize *= 2;
+
+        } while( numMerges > 1 );
+
+        return list;
+    }
+
+    static bool isEar(const Node* ear)
+    {
+        const Node* a = ear->prev;
+        const Node* b = ear;
+        const Node* c = ear->next;
+
+        if ( area(a, b, c) >= 0.0 )
+            return false; // reflex
+
+        for(const Node* p = c->next; p != a; p = p->next)
+        {
+            if ( pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                 area(p->prev, p, p->next) >= 0.0 )
+                return false;
+        }
+        return true;
+    }
+
+    bool blocksEar(const Node* ear, const Node* p) const
+    {
+        const Node* a = ear->prev;
+        const Node* c = ear->next;
+        return
+            p != a && p != c &&
+            pointInTriangle(a->x, a->y, ear->x, ear->y, c->x, c->y, p->x, p->y) &&
+            area(p->prev, p, p->next) >= 0.0;
+    }
+
+    // isEar, visiting only the vertices inside the triangle's z-range
+    bool isEarHashed(const Node* ear) const
+    {
+        const Node* a = ear->prev;
+        const Node* b = ear;
+        const Node* c = ear->next;
+
+        if ( area(a, b, c) >= 0.0 )
+            return false; // reflex
+
+        double minTX = std::min(a->x, std::min(b->x, c->x));
+        double minTY = std::min(a->y, std::min(b->y, c->y));
+        double maxTX = std::max(a->x, std::max(b->x, c->x));
+        double maxTY = std::max(a->y, std::max(b->y, c->y));
+
+        int minZ = zOrder(minTX, minTY);
+        int maxZ = zOrder(maxTX, maxTY);
+
+        // walk both directions from the ear at once
+        const Node* p = ear->prevZ;
+        const Node* n = ear->nextZ;
+
+        while( p && p->z >= minZ && n && n->z <= maxZ )
+        {
+            if ( blocksEar(ear, p) ) return false;
+            p = p->prevZ;
+            if ( blocksEar(ear, n) ) return false;
+            n = n->nextZ;
+        }
+        while( p && p->z >= minZ )
+        {
+            if ( blocksEar(ear, p) ) return false;
+            p = p->prevZ;
+        }
+        while( n && n->z <= maxZ )
+        {
+            if ( blocksEar(ear, n) ) return false;
+            n = n->nextZ;
+        }
+        return true;
+    }
+
+    void addTriangle(const Node* a, const Node* b, const Node* c)
+    {
+        // "clockwise" rings in the convention above come out as
+        // counter-clockwise triangles in a y-up frame.
+        _tris.push_back( TriIndices(a->i, b->i, c->i) );
+    }
+
+    // pass 0: plain clipping. pass 1: after filtering points.
+    // pass 2: after curing local self-intersections. then split.
+    void earcutLinked(Node* ear, int pass)
+    {
+        if ( !ear )
+            return;
+
+        bool hashed = _invSize != 0.0;
+
+        if ( pass == 0 && hashed )
+            indexCurve(ear);
+
+        Node* stop = ear;
+
+        while( ear->prev != ear->next )
+        {
+            Node* prev = ear->prev;
+            Node* next = ear->next;
+
+            if ( hashed ? isEarHashed(ear) : isEar(ear) )
+            {
+                addTriangle(prev, ear, next);
+                removeNode(ear);
+
+                // skipping the next vertex leads to less sliver triangles
+                ear = next->next;
+                stop = next->next;
+                continue;
+            }
+
+            ear = next;
+
+            if ( ear == stop )
+            {
+                if ( pass == 0 )
+                {
+                    earcutLinked(filterPoints(ear), 1);
+                }
+                else if ( pass == 1 )
+                {
+                    ear = cureLocalIntersections(filterPoints(ear));
+                    earcutLinked(ear, 2);
+                }
+                else if ( pass == 2 )
+                {
+                    splitEarcut(ear);
+                }
+                break;
+            }
+        }
+    }
+
+    Node* cureLocalIntersections(Node* start)
+    {
+        Node* p = start;
+        do {
+            Node* a = p->prev;
+            Node* b = p->next->next;
+
+            if ( !equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a) )
+            {
+                addTriangle(a, p, b);
+                removeNode(p);
+                removeNode(p->next);
+                p = start = b;
+            }
+            p = p->next;
+        } while( p != start );
+
+        return filterPoints(p);
+    }
+
+    void splitEarcut(Node* start)
+    {
+        Node* a = start;
+        do {
+            Node* b = a->next->next;
+            while( b != a->prev )
+            {
+                if ( a->i != b->i && isValidDiagonal(a, b) )
+                {
+                    Node* c = splitPolygon(a, b);
+
+                    a = filterPoints(a, a->next);
+                    c = filterPoints(c, c->next);
+
+                    earcutLinked(a, 0);
+                    earcutLinked(c, 0);
+                    return;
+                }
+                b = b->next;
+            }
+            a = a->next;
+        } while( a != start );
+    }
+
+    static Node* getLeftmost(Node* start)
+    {
+        Node* p = start;
+        Node* leftmost = start;
+        do {
+            if ( p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y) )
+                leftmost = p;
+            p = p->next;
+        } while( p != start );
+        return leftmost;
+    }
+
+    struct LessX
+    {
+        bool operator()(const Node* a, const Node* b) const { return a->x < b->x; }
+    };
+
+    // links each hole into the outer ring, leftmost hole first
+    Node* eliminateHoles(const std::vector< std::pair<unsigned,unsigned> >& rings, Node* outer)
+    {
+        std::vector<Node*> queue;
+        for(unsigned i=1; i<rings.size(); ++i)
+        {
+            Node* list = linkedList(rings[i].first, rings[i].second, false);
+            if ( !list )
+                continue;
+            if ( list == list->next )
+                list->steiner = true;
+            queue.push_back( getLeftmost(list) );
+        }
+
+        std::sort( queue.begin(), queue.end(), LessX() );
+
+        for(unsigned i=0; i<queue.size(); ++i)
+            outer = eliminateHole(queue[i], outer);
+
+        return outer;
+    }
+
+    Node* eliminateHole(Node* hole, Node* outer)
+    {
+        Node* bridge = findHoleBridge(hole, outer);
+        if ( !bridge )
+            return outer;
+
+        Node* bridgeReverse = splitPolygon(bridge, hole);
+
+        // filter out collinear points around the cuts
+        filterPoints(bridgeReverse, bridgeReverse->next);
+        return filterPoints(bridge, bridge->next);
+    }
+
+    static bool sectorContainsSector(const Node* m, const Node* p)
+    {
+        return area(m->prev, m, p->prev) < 0.0 && area(p->next, m, m->next) < 0.0;
+    }
+
+    // David Eberly's algorithm for finding a bridge between a hole and the outer polygon
+    static Node* findHoleBridge(Node* hole, Node* outer)
+    {
+        Node* p = outer;
+        double hx = hole->x;
+        double hy = hole->y;
+        double qx = -DBL_MAX;
+        Node* m = 0L;
+
+        // find a segment intersected by a ray from the hole's leftmost point to the left;
+        // the segment's endpoint with the lesser x will be the potential connection point
+        do {
+            if ( hy <= p->y && hy >= p->next->y && p->next->y != p->y )
+            {
+                double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+                if ( x <= hx && x > qx )
+                {
+                    qx = x;
+                    m = p->x < p->next->x ? p : p->next;
+                    if ( x == hx )
+                        return m; // hole touches the outer segment
+                }
+            }
+            p = p->next;
+        } while( p != outer );
+
+        if ( !m )
+            return 0L;
+
+        // look for points inside the triangle of hole point, segment intersection
+        // and endpoint; if there are none, the endpoint is visible. otherwise pick
+        // the point with the smallest angle to the ray.
+        Node* stop = m;
+        double mx = m->x;
+        double my = m->y;
+        double tanMin = DBL_MAX;
+
+        p = m;
+        do {
+            if ( hx >= p->x && p->x >= mx && hx != p->x &&
+                 pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y) )
+            {
+                double tan = fabs(hy - p->y) / (hx - p->x);
+
+                if ( locallyInside(p, hole) &&
+                     (tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && sectorContainsSector(m, p))))) )
+                {
+                    m = p;
+                    tanMin = tan;
+                }
+            }
+            p = p->next;
+        } while( p != stop );
+
+        return m;
+    }
+};
+
+
+// -1 until first use, then a Tessellator::Method
+int s_defaultMethod = -1;
+Threading::Mutex s_defaultMethodMutex;
+
+osg::DrawElementsUInt* toElements(const TriList& tris)
+{
+    osg::DrawElementsUInt* triElements = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, 0);
+    triElements->reserve( tris.size() * 3 );
+    for (TriList::const_iterator it = tris.begin(); it != tris.end(); ++it)
+    {
+        triElements->push_back(it->a);
+        triElements->push_back(it->b);
+        triElements->push_back(it->c);
+    }
+    return triElements;
+}
+
+}
+
+void
+Tessellator::setDefaultMethod(Tessellator::Method method)
+{
+    Threading::ScopedMutexLock lock( s_defaultMethodMutex );
+    s_defaultMethod = (int)method;
+}
+
+Tessellator::Method
+Tessellator::getDefaultMethod()
+{
+    Threading::ScopedMutexLock lock( s_defaultMethodMutex );
+    if ( s_defaultMethod < 0 )
+    {
+        const char* env = ::getenv("OSGEARTH_TESSELLATOR");
+        s_defaultMethod = env && std::string(env) == "classic" ?
+            (int)METHOD_EAR_CLIPPING :
+            (int)METHOD_ZORDER_EAR_CLIPPING;
+    }
+    return (Method)s_defaultMethod;
+}
+
+Tessellator::Tessellator() :
+_method( getDefaultMethod() )
+{
+    //nop
 }
 
 bool
@@ -145,7 +878,23 @@ Tessellator::tessellateGeometry(osg::Geometry &geom)
 
         if (primitive->getMode()==osg::PrimitiveSet::POLYGON || primitive->getMode()==osg::PrimitiveSet::LINE_LOOP)
         {
-            if (primitive->getType()==osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
+            if (primitive->getType()==osg::PrimitiveSet::DrawArrayLengthsPrimitiveType &&
+                primitive->getMode()==osg::PrimitiveSet::POLYGON &&
+                _method == METHOD_ZORDER_EAR_CLIPPING)
+            {
+                // outer ring plus holes
+                osg::PrimitiveSet* newPrimitive = tessellatePolygon(static_cast<osg::DrawArrayLengths*>(primitive.get()), vertices);
+                if (newPrimitive)
+                {
+                    geom.addPrimitiveSet(newPrimitive);
+                }
+                else
+                {
+                    geom.addPrimitiveSet(primitive);
+                    success = false;
+                }
+            }
+            else if (primitive->getType()==osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
             {
                 osg::DrawArrayLengths* drawArrayLengths = static_cast<osg::DrawArrayLengths*>(primitive.get());
                 unsigned int first = drawArrayLengths->getFirst();
@@ -223,9 +972,63 @@ Tessellator::tessellatePrimitive(osg::PrimitiveSet* primitive, osg::Vec3Array* v
     return 0L;
 }
 
+osg::PrimitiveSet*
+Tessellator::tessellatePolygon(osg::DrawArrayLengths* lengths, osg::Vec3Array* vertices)
+{
+    std::vector< std::pair<unsigned,unsigned> > rings;
+    unsigned int first = lengths->getFirst();
+    for(osg::DrawArrayLengths::iterator itr=lengths->begin(); itr!=lengths->end(); ++itr)
+    {
+        unsigned int last = first + *itr;
+        if (last > vertices->size())
+            return 0L;
+        if (*itr >= 3)
+            rings.push_back( std::make_pair(first, last) );
+        else if (rings.empty())
+            return 0L;
+        first = last;
+    }
+
+    if (rings.empty())
+        return 0L;
+
+    TriList tris;
+    tris.reserve( first - lengths->getFirst() + 2*rings.size() );
+
+    ZOrderEarClipper(*vertices, tris).run(rings);
+
+    if (tris.empty())
+    {
+        OE_DEBUG << LC << "Tessellation failed!" << std::endl;
+        return 0L;
+    }
+
+    return toElements(tris);
+}
+
 osg::PrimitiveSet*
 Tessellator::tessellatePrimitive(unsigned int first, unsigned int last, osg::Vec3Array* vertices)
 {
+    if (_method == METHOD_ZORDER_EAR_CLIPPING)
+    {
+        if (last > vertices->size() || last - first < 3)
+            return 0L;
+
+        TriList tris;
+        tris.reserve( last-first );
+
+        std::vector< std::pair<unsigned,unsigned> > rings(1, std::make_pair(first, last));
+        ZOrderEarClipper(*vertices, tris).run(rings);
+
+        if (tris.empty())
+        {
+            OE_DEBUG << LC << "Tessellation failed!" << std::endl;
+            return 0L;
+        }
+
+        return toElements(tris);
+    }
+
     std::vector<unsigned int> activeVerts;
     activeVerts.reserve( last-first+1 );
     for (unsigned int i=first; i < last; i++)
@@ -310,16 +1113,7 @@ Tessellator::tessellatePrimitive(unsigned int first, unsigned int last, osg::Vec
             tris.push_back(TriIndices(activeVerts[0], activeVerts[1], activeVerts[2]));
         }
 
-        osg::DrawElementsUInt* triElements = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, 0);
-        triElements->reserve( tris.size() * 3 );
-        for (TriList::const_iterator it = tris.begin(); it != tris.end(); ++it)
-        {
-            triElements->push_back(it->a);
-            triElements->push_back(it->b);
-            triElements->push_back(it->c);
-        }
-
-        return triElements;
+        return toElements(tris);
     }
     else
     {
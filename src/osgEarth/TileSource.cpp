@@ -168,6 +168,7 @@ TileSourceOptions::getConfig() const
     conf.updateIfSet( "max_valid_value", _maxValidValue );
     conf.updateIfSet( "blacklist_filename", _blacklistFilename);
     conf.updateIfSet( "l2_cache_size", _L2CacheSize );
+    conf.updateIfSet( "l2_cache_max_bytes", _L2CacheMaxBytes );
     conf.updateIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.updateIfSet( "max_data_level", _maxDataLevel );
     conf.updateIfSet( "coverage", _coverage );
@@ -196,6 +197,7 @@ TileSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "nodata_max", _maxValidValue ); // backcompat
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "l2_cache_max_bytes", _L2CacheMaxBytes );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "max_data_level", _maxDataLevel );
     conf.getIfSet( "coverage", _coverage );
@@ -223,8 +225,11 @@ _mode   ( 0 )
 {
     this->setThreadSafeRefUnref( true );
 
-    // Initialize the l2 cache size to the options.
-    int l2CacheSize = *options.L2CacheSize();
+    // Initialize the l2 cache size to the options. A byte budget replaces
+    // the default entry count unless the entry count was set explicitly.
+    size_t l2CacheBytes = options.L2CacheMaxBytes().getOrUse( 0 );
+    int l2CacheSize = 
+        l2CacheBytes > 0 && !options.L2CacheSize().isSet() ? 0 : *options.L2CacheSize();
 
     // See if it was overridden with an env var.
     char const* l2env = ::getenv( "OSGEARTH_L2_CACHE_SIZE" );
@@ -238,12 +243,13 @@ _mode   ( 0 )
     if ( noCacheEnv )
     {
         l2CacheSize = 0;
+        l2CacheBytes = 0;
     }
 
-    // Initialize the l2 cache if it's size is > 0
-    if ( l2CacheSize > 0 )
+    // Initialize the l2 cache if it has a size
+    if ( l2CacheSize > 0 || l2CacheBytes > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        _memCache = new MemCache( (unsigned)std::max(l2CacheSize, 0), l2CacheBytes );
     }
 
     if (_options.blacklistFilename().isSet())
@@ -367,7 +373,7 @@ TileSource::createImage(const TileKey&        key,
     // Try to get it from the memcache fist
     if (_memCache.valid())
     {
-        ReadResult r = _memCache->getOrCreateDefaultBin()->readImage( key.str() );
+        ReadResult r = _memCache->readTile( key );
         if ( r.succeeded() )
             return r.releaseImage();
     }
@@ -380,7 +386,7 @@ TileSource::createImage(const TileKey&        key,
     if ( newImage.valid() && _memCache.valid() )
     {
         // cache it to the memory cache.
-        _memCache->getOrCreateDefaultBin()->write( key.str(), newImage.get() );
+        _memCache->writeTile( key, newImage.get() );
     }
 
     return newImage.release();
@@ -397,7 +403,7 @@ TileSource::createHeightField(const TileKey&        key,
     // Try to get it from the memcache first:
     if (_memCache.valid())
     {
-        ReadResult r = _memCache->getOrCreateDefaultBin()->readObject( key.str() );
+        ReadResult r = _memCache->readTile( key );
         if ( r.succeeded() )
             return r.release<osg::HeightField>();
     }
@@ -409,7 +415,7 @@ TileSource::createHeightField(const TileKey&        key,
 
     if ( newHF.valid() && _memCache.valid() )
     {
-        _memCache->getOrCreateDefaultBin()->write( key.str(), newHF.get() );
+        _memCache->writeTile( key, newHF.get() );
     }
 
     //TODO: why not just newHF.release()? -gw
@@ -23,6 +23,8 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
 #include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
@@ -289,11 +291,56 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------
+    // Coalescing of concurrent reads (used by the doRead method)
+
+    typedef Threading::SingleFlight<std::string, ReadResult> InFlightReads;
+
+    static InFlightReads s_inFlightReads;
+
+    // Reads of the same URI only coalesce if they want the same kind of
+    // result and use the same reader options...
+    std::string makeFlightKey( const char* type, const URI& uri, const osgDB::Options* opt )
+    {
+        return Stringify() << type << "|" << uri.full() << "|" << (opt ? opt->getOptionString() : std::string());
+    }
+
+    // ...and resolve to the same cache policy and bin and go through the same
+    // read callback. Otherwise a follower could get a result its own request
+    // would not have produced (e.g. the miss of a cache-only leader).
+    std::string makeFlightKey( const std::string& readKey, const CachePolicy& cp, const CacheBin* bin, const URIReadCallback* cb )
+    {
+        return Stringify()
+            << readKey
+            << "|" << (int)cp.usage().get() << "," << cp.maxAge().get() << "," << cp.minTime().get()
+            << "|" << (bin ? bin->getID() : std::string())
+            << "|" << (const void*)cb;
+    }
+
+    // Gives a waiting thread its own copy of a result read by another thread.
+    // Nodes are shared as the URIResultCache shares them; other objects
+    // (images in particular) are cloned since callers often modify them.
+    ReadResult copyForFollower( const ReadResult& shared )
+    {
+        osg::Object* object = shared.getObject();
+        if ( object && !dynamic_cast<osg::Node*>(object) )
+        {
+            object = osg::clone( object, osg::CopyOp::DEEP_COPY_ALL );
+        }
+
+        ReadResult result( shared.code(), object, shared.metadata() );
+        result.setIsFromCache( shared.isFromCache() );
+        result.setLastModifiedTime( shared.lastModifiedTime() );
+        result.setErrorDetail( shared.errorDetail() );
+        return result;
+    }
+
     //--------------------------------------------------------------------
     // Read functors (used by the doRead method)
 
     struct ReadObject
     {
+        std::string flightKey( const URI& uri, const osgDB::Options* opt ) const { return makeFlightKey("object", uri, opt); }
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_OBJECTS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readObject(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readObject(key); }
@@ -311,6 +358,7 @@ namespace
 
     struct ReadNode
     {
+        std::string flightKey( const URI& uri, const osgDB::Options* opt ) const { return makeFlightKey("node", uri, opt); }
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_NODES) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readNode(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key ) { return bin->readObject(key); }
@@ -328,6 +376,7 @@ namespace
 
     struct ReadImage
     {
+        std::string flightKey( const URI& uri, const osgDB::Options* opt ) const { return makeFlightKey("image", uri, opt); }
         bool callbackRequestsCaching( URIReadCallback* cb ) const { 
             return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_IMAGES) != 0); 
         }
@@ -360,6 +409,7 @@ namespace
 
     struct ReadString
     {
+        std::string flightKey( const URI& uri, const osgDB::Options* opt ) const { return makeFlightKey("string", uri, opt); }
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_STRINGS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readString(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readString(key); }
@@ -472,76 +522,105 @@ namespace
                         bin = s_getCacheBin( localOptions.get() );
                     }                    
 
+                    // coalesce concurrent reads of the same remote URI, so only
+                    // one thread hits the cache and the server.
+                    InFlightReads::Ticket ticket(
+                        s_inFlightReads,
+                        makeFlightKey(reader.flightKey(uri, localOptions.get()), cp.get(), bin, cb),
+                        progress );
 
-                    bool expired = false;
-                    // first try to go to the cache if there is one:
-                    if ( bin && cp->isCacheReadable() )
-                    {                                                
-                        result = reader.fromCache( bin, uri.cacheKey() );                        
-                        if ( result.succeeded() )
-                        {                                        
-                            expired = cp->isExpired(result.lastModifiedTime());
-                            result.setIsFromCache(true);
-                        }
+                    if ( ticket.canceled() )
+                    {
+                        result = ReadResult( ReadResult::RESULT_CANCELED );
+                    }
+                    else if ( ticket.hasResult() )
+                    {
+                        result = copyForFollower( ticket.result() );
                     }
+                    else
+                    {
 
-                    // If it's not cached, or it is cached but is expired then try to hit the server.                    
-                    if ( result.empty() || expired )
-                    {                        
-                        // Need to do this to support nested PLODs and Proxynodes.
-                        osg::ref_ptr<osgDB::Options> remoteOptions =
-                            Registry::instance()->cloneOrCreateOptions( localOptions );
-                        remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
-
-                        // Store the existing object from the cache if there is one.
-                        osg::ref_ptr< osg::Object > object = result.getObject();
-
-                        // try to use the callback if it's set. Callback ignores the caching policy.
-                        if ( cb )
-                        {                
-                            result = reader.fromCallback( cb, uri.full(), remoteOptions.get() );
-
-                            if ( result.code() != ReadResult::RESULT_NOT_IMPLEMENTED )
-                            {
-                                // "not implemented" is the only excuse for falling back
-                                gotResultFromCallback = true;
+                        bool expired = false;
+                        // first try to go to the cache if there is one:
+                        if ( bin && cp->isCacheReadable() )
+                        {                                                
+                            result = reader.fromCache( bin, uri.cacheKey() );                        
+                            if ( result.succeeded() )
+                            {                                        
+                                expired = cp->isExpired(result.lastModifiedTime());
+                                result.setIsFromCache(true);
                             }
                         }
 
-                        if ( !gotResultFromCallback )
-                        {                            
-                            // still no data, go to the source:
-                            if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
-                            {                                
-                                ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
-                                if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
-                                {                                    
-                                    OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
-                                    // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
-                                    bin->touch( uri.cacheKey() );
-                                }
-                                else
+                        // If it's not cached, or it is cached but is expired then try to hit the server.                    
+                        if ( result.empty() || expired )
+                        {                        
+                            // Need to do this to support nested PLODs and Proxynodes.
+                            osg::ref_ptr<osgDB::Options> remoteOptions =
+                                Registry::instance()->cloneOrCreateOptions( localOptions );
+                            remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
+
+                            // Store the existing object from the cache if there is one.
+                            osg::ref_ptr< osg::Object > object = result.getObject();
+
+                            // try to use the callback if it's set. Callback ignores the caching policy.
+                            if ( cb )
+                            {                
+                                result = reader.fromCallback( cb, uri.full(), remoteOptions.get() );
+
+                                if ( result.code() != ReadResult::RESULT_NOT_IMPLEMENTED )
                                 {
-                                    OE_DEBUG << LC << "Got remote result for " << uri.full() << std::endl;
-                                    result = remoteResult;                                    
+                                    // "not implemented" is the only excuse for falling back
+                                    gotResultFromCallback = true;
                                 }
                             }
 
-                            // write the result to the cache if possible:
-                            if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() )
-                            {
-                                OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
-                                bin->write( uri.cacheKey(), result.getObject(), result.metadata() );
+                            if ( !gotResultFromCallback )
+                            {                            
+                                // still no data, go to the source:
+                                if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
+                                {                                
+                                    ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
+                                    if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
+                                    {                                    
+                                        OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
+                                        // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
+                                        bin->touch( uri.cacheKey() );
+                                    }
+                                    else
+                                    {
+                                        OE_DEBUG << LC << "Got remote result for " << uri.full() << std::endl;
+                                        result = remoteResult;                                    
+                                    }
+                                }
+
+                                // write the result to the cache if possible:
+                                if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() )
+                                {
+                                    OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
+                                    bin->write( uri.cacheKey(), result.getObject(), result.metadata() );
+                                }
                             }
                         }
-                    }
 
-                    OE_TEST << LC 
-                        << uri.base() << ": " 
-                        << (result.succeeded() ? "OK" : "FAILED") 
-                        << "; policy=" << cp->usageString()
-                        << (result.isFromCache() && result.succeeded() ? "; (from cache)" : "")
-                        << std::endl;
+                        OE_TEST << LC 
+                            << uri.base() << ": " 
+                            << (result.succeeded() ? "OK" : "FAILED") 
+                            << "; policy=" << cp->usageString()
+                            << (result.isFromCache() && result.succeeded() ? "; (from cache)" : "")
+                            << std::endl;
+
+                        // share the result unless this read was interrupted. Waiting
+                        // threads get a private copy, since our caller owns this one.
+                        bool interrupted =
+                            result.code() == ReadResult::RESULT_CANCELED ||
+                            (progress && (progress->isCanceled() || progress->needsRetry()));
+
+                        if ( ticket.close() > 0 && !interrupted )
+                            ticket.finish( copyForFollower(result) );
+                        else
+                            ticket.finish( result, !interrupted );
+                    }
                 }
 
 
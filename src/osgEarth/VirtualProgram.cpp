@@ -29,10 +29,12 @@
 #include <osg/State>
 #include <osg/Notify>
 #include <osg/Version>
+#include <osg/Timer>
 #include <osg/GL2Extensions>
 #include <osg/GLExtensions>
 #include <fstream>
 #include <sstream>
+#include <string.h>
 #include <OpenThreads/Thread>
 
 #define LC "[VirtualProgram] "
@@ -408,6 +410,86 @@ namespace
     }
 
 
+    template<typename MAP>
+    void addBindingsToSignature(const MAP& bindings, ProgramRepo::Signature& sig)
+    {
+        sig.push_back( bindings.size() );
+        for( typename MAP::const_iterator i = bindings.begin(); i != bindings.end(); ++i )
+        {
+            sig.push_back( hashString(i->first) );
+            sig.push_back( (unsigned)i->second );
+        }
+    }
+
+    /**
+    * Builds the content signature that keys a program in the global ProgramRepo:
+    * everything buildProgram() consumes, reduced to hashes and values.
+    */
+    void makeProgramSignature(const ShaderComp::FunctionLocationMap&   accumFunctions,
+                              const VirtualProgram::ShaderMap&         accumShaderMap,
+                              const VirtualProgram::AttribBindingList& accumAttribBindings,
+                              const VirtualProgram::AttribAliasMap&    accumAttribAliases,
+                              const osg::Program*                      templateProgram,
+                              ProgramRepo::Signature&                  sig)
+    {
+        sig.clear();
+        sig.reserve( 4*accumShaderMap.size() + 32 );
+
+        // shaders, in accumulation order:
+        sig.push_back( accumShaderMap.size() );
+        for( VirtualProgram::ShaderMap::const_iterator i = accumShaderMap.begin(); i != accumShaderMap.end(); ++i )
+        {
+            const PolyShader* shader = i->data()._shader.get();
+            sig.push_back( shader->getHash().first );
+            sig.push_back( shader->getHash().second );
+            sig.push_back( (unsigned)shader->getLocation() );
+            sig.push_back( shader->getNominalShader() ? (unsigned)shader->getNominalShader()->getType() : ~0u );
+        }
+
+        // functions, which determine the generated mains:
+        for( ShaderComp::FunctionLocationMap::const_iterator loc = accumFunctions.begin(); loc != accumFunctions.end(); ++loc )
+        {
+            sig.push_back( (unsigned)loc->first );
+            sig.push_back( loc->second.size() );
+            for( ShaderComp::OrderedFunctionMap::const_iterator f = loc->second.begin(); f != loc->second.end(); ++f )
+            {
+                float order = f->first;
+                unsigned bits;
+                ::memcpy( &bits, &order, sizeof(bits) );
+                sig.push_back( bits );
+                sig.push_back( hashString(f->second._name) );
+
+                float minRange = f->second._minRange.isSet() ? f->second._minRange.get() : -1.0f;
+                float maxRange = f->second._maxRange.isSet() ? f->second._maxRange.get() : -1.0f;
+                ::memcpy( &bits, &minRange, sizeof(bits) );
+                sig.push_back( bits );
+                ::memcpy( &bits, &maxRange, sizeof(bits) );
+                sig.push_back( bits );
+            }
+        }
+        sig.push_back( ~0u );
+
+        addBindingsToSignature( accumAttribBindings, sig );
+
+        sig.push_back( accumAttribAliases.size() );
+        for( VirtualProgram::AttribAliasMap::const_iterator i = accumAttribAliases.begin(); i != accumAttribAliases.end(); ++i )
+        {
+            sig.push_back( hashString(i->first) );
+            sig.push_back( hashString(i->second) );
+        }
+
+        // template data (see addTemplateDataToProgram)
+        if ( templateProgram )
+        {
+            addBindingsToSignature( templateProgram->getFragDataBindingList(), sig );
+            addBindingsToSignature( templateProgram->getUniformBlockBindingList(), sig );
+            sig.push_back( (unsigned)templateProgram->getParameter(GL_GEOMETRY_VERTICES_OUT_EXT) );
+            sig.push_back( (unsigned)templateProgram->getParameter(GL_GEOMETRY_INPUT_TYPE_EXT) );
+            sig.push_back( (unsigned)templateProgram->getParameter(GL_GEOMETRY_OUTPUT_TYPE_EXT) );
+        }
+    }
+
+
     /**
     * Assemble a new OSG shader Program from the provided components.
     * Outputs the uniquely-identifying "key vector" and returns the new program.
@@ -1240,58 +1322,77 @@ VirtualProgram::apply( osg::State& state ) const
                 const_cast<VirtualProgram*>(this)->readProgramCache(local.programKey, frameNumber, program);
                 if ( !program.valid() )
                 {
-                    local.programKey.clear();
-
-                    //OE_NOTICE << LC << "Building new Program for VP " << getName() << std::endl;
-
-                    program = buildProgram(
-                        getName(),
-                        state,
+                    // another VP may already have built an identical program.
+                    makeProgramSignature(
                         accumFunctions,
-                        local.accumShaderMap, 
-                        local.accumAttribBindings, 
-                        local.accumAttribAliases, 
+                        local.accumShaderMap,
+                        local.accumAttribBindings,
+                        local.accumAttribAliases,
                         _template.get(),
-                        local.programKey);
+                        local.programSignature);
 
-                    if ( _logShaders && program.valid() )
+                    if ( !Registry::programRepo()->get(local.programSignature, frameNumber, program) )
                     {
-                        std::stringstream buf;
-                        for (unsigned i=0; i < program->getNumShaders(); i++)
-                        {
-                            buf << program->getShader(i)->getShaderSource() << std::endl << std::endl;
-                        }
+                        local.programKey.clear();
+
+                        //OE_NOTICE << LC << "Building new Program for VP " << getName() << std::endl;
+
+                        osg::Timer_t buildStart = osg::Timer::instance()->tick();
+
+                        program = buildProgram(
+                            getName(),
+                            state,
+                            accumFunctions,
+                            local.accumShaderMap, 
+                            local.accumAttribBindings, 
+                            local.accumAttribAliases, 
+                            _template.get(),
+                            local.programKey);
 
-                        if ( _logPath.length() > 0 )
+                        double buildTime = osg::Timer::instance()->delta_m(buildStart, osg::Timer::instance()->tick());
+
+                        // global sharing; if another thread beat us to it, use theirs.
+                        program = Registry::programRepo()->add(local.programSignature, program.get(), buildTime, frameNumber);
+
+                        if ( _logShaders && program.valid() )
                         {
-                            std::fstream outStream;
-                            outStream.open(_logPath.c_str(), std::ios::out);
-                            if (outStream.fail())
+                            std::stringstream buf;
+                            for (unsigned i=0; i < program->getNumShaders(); i++)
+                            {
+                                buf << program->getShader(i)->getShaderSource() << std::endl << std::endl;
+                            }
+
+                            if ( _logPath.length() > 0 )
                             {
-                                OE_WARN << LC << "Unable to open " << _logPath << " for logging shaders." << std::endl;
+                                std::fstream outStream;
+                                outStream.open(_logPath.c_str(), std::ios::out);
+                                if (outStream.fail())
+                                {
+                                    OE_WARN << LC << "Unable to open " << _logPath << " for logging shaders." << std::endl;
+                                }
+                                else
+                                {
+                                    outStream << buf.str();
+                                    outStream.close();
+                                }
                             }
                             else
                             {
-                                outStream << buf.str();
-                                outStream.close();
+                              OE_NOTICE << LC << "Shader source: " << getName() << std::endl << "===============" << std::endl << buf.str() << std::endl << "===============" << std::endl;
                             }
                         }
-                        else
-                        {
-                          OE_NOTICE << LC << "Shader source: " << getName() << std::endl << "===============" << std::endl << buf.str() << std::endl << "===============" << std::endl;
-                        }
                     }
 
-                    // global sharing.
-                    Registry::programSharedRepo()->share( program );
-
-                    // finally, put own new program in the cache.
-                    ProgramEntry& pe = _programCache[local.programKey];
-                    pe._program = program.get();
-                    pe._frameLastUsed = frameNumber;
+                    if ( program.valid() )
+                    {
+                        // finally, put own new program in the cache.
+                        ProgramEntry& pe = _programCache[local.programKey];
+                        pe._program = program.get();
+                        pe._frameLastUsed = frameNumber;
 
-                    // purge expired programs.
-                    const_cast<VirtualProgram*>(this)->removeExpiredProgramsFromCache(state, frameNumber);
+                        // purge expired programs.
+                        const_cast<VirtualProgram*>(this)->removeExpiredProgramsFromCache(state, frameNumber);
+                    }
                 }
             }
         }
@@ -1353,7 +1454,11 @@ VirtualProgram::apply( osg::State& state ) const
         if ( useProgram )
         {
             if( pcp->needsLink() )
+            {
+                osg::Timer_t linkStart = osg::Timer::instance()->tick();
                 program->compileGLObjects( state );
+                Registry::programRepo()->recordLink( osg::Timer::instance()->delta_m(linkStart, osg::Timer::instance()->tick()) );
+            }
 
             if( pcp->isLinked() )
             {
@@ -1686,7 +1791,7 @@ PolyShader::PolyShader() :
 _dirty( true ),
 _location( ShaderComp::LOCATION_UNDEFINED )
 {
-    //nop
+    updateHash();
 }
 
 PolyShader::PolyShader(osg::Shader* shader) :
@@ -1704,6 +1809,7 @@ _nominalShader( shader )
         // then preprocess the shader:
         //ShaderPreProcessor::run( shader );
     }
+    updateHash();
 }
 
 void
@@ -1711,6 +1817,21 @@ PolyShader::setShaderSource(const std::string& source)
 {
     _source = source;
     _dirty = true;
+    updateHash();
+}
+
+void
+PolyShader::updateHash()
+{
+    _hash.first = hashString( _source );
+
+    // FNV-1a, so that a collision in one hash alone can't alias two shaders.
+    _hash.second = 2166136261u;
+    for(std::string::const_iterator i = _source.begin(); i != _source.end(); ++i)
+    {
+        _hash.second ^= (unsigned char)(*i);
+        _hash.second *= 16777619u;
+    }
 }
 
 void
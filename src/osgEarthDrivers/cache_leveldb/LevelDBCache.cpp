@@ -44,7 +44,8 @@ using namespace osgEarth::Drivers::LevelDBCache;
 LevelDBCacheImpl::LevelDBCacheImpl( const CacheOptions& options ) :
 osgEarth::Cache( options ),
 _options       ( options ),
-_active        ( true )
+_active        ( true ),
+_db            ( 0L )
 {
     // Force OSG to initialize the image wrapper. Failure to do this can result
     // in a race condition within OSG when the cache is accessed from multiple threads.
@@ -103,6 +104,11 @@ _active        ( true )
 
 LevelDBCacheImpl::~LevelDBCacheImpl()
 {
+    if ( _writeBehind.valid() )
+    {
+        _writeBehind->flush();
+    }
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -133,6 +139,7 @@ LevelDBCacheImpl::init()
     if ( _db )
     {
         _tracker->calcSize();
+        _writeBehind = new WriteBehind(_db, _options);
     }
 
     if ( _active )
@@ -179,7 +186,7 @@ CacheBin*
 LevelDBCacheImpl::addBin( const std::string& name )
 {
     return _db ?
-        _bins.getOrCreate(name, new LevelDBCacheBin(name, _db, _tracker.get())) :
+        _bins.getOrCreate(name, new LevelDBCacheBin(name, _db, _tracker.get(), _writeBehind.get())) :
         0L;
 }
 
@@ -195,7 +202,7 @@ LevelDBCacheImpl::getOrCreateDefaultBin()
         Threading::ScopedMutexLock lock( s_defaultBinMutex );
         if ( !_defaultBin.valid() ) // double-check
         {
-            _defaultBin = new LevelDBCacheBin("_default", _db, _tracker.get());
+            _defaultBin = new LevelDBCacheBin("_default", _db, _tracker.get(), _writeBehind.get());
         }
     }
     return _defaultBin.get();
@@ -213,6 +220,7 @@ LevelDBCacheImpl::compact()
     if ( !_db )
         return false;
 
+    _writeBehind->flush();
     _db->CompactRange(0L, 0L);
 
     return true;
@@ -224,6 +232,8 @@ LevelDBCacheImpl::clear()
     if ( !_db )
         return false;
 
+    _writeBehind->flush();
+
     // No WriteBatch because it doesn't seem to allow compaction to occur
     // -- need to figure out why someday.
 
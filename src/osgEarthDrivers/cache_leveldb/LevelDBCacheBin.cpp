@@ -81,10 +81,12 @@ namespace
 
 LevelDBCacheBin::LevelDBCacheBin(const std::string& binID,
                                  leveldb::DB*       db,
-                                 Tracker*           tracker) :
+                                 Tracker*           tracker,
+                                 WriteBehind*       writeBehind) :
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
+_writeBehind      ( writeBehind ),
 _debug            ( false )
 {
     // reader to parse data:
@@ -248,29 +250,43 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     ++_tracker->reads;
 
     Config metadata;
-    leveldb::Status status;
-    leveldb::ReadOptions ro;
-
-    // first read the metadata record.
     std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
+    std::string datavalue;
+    bool hasMeta = false;
+
+    // a tile still waiting in the write-behind batch:
+    bool pending = _writeBehind->read( dataKey(key), &datavalue, &metavalue );
+    if ( pending )
+    {
+        hasMeta = true;
+    }
+    else
+    {
+        // read the metadata and data records from one snapshot, so a
+        // concurrent write can't pair one tile's metadata with another's data.
+        // No lock needed; leveldb handles concurrent readers.
+        leveldb::ReadOptions ro;
+        ro.snapshot = _db->GetSnapshot();
+
+        hasMeta = _db->Get( ro, metaKey(key), &metavalue ).ok();
+        leveldb::Status status = _db->Get( ro, dataKey(key), &datavalue );
+
+        _db->ReleaseSnapshot( ro.snapshot );
+
+        if ( !status.ok() )
+        {
+            // main record not found for some reason.
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        }
+    }
+
     TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
+    if ( hasMeta )
+    {
         decodeMeta(metavalue, metadata);
         DateTime t( metadata.value(TIME_FIELD));
         lastModified = t.asTimeStamp();
     }
-        
-    // next read the data record.
-    std::string datakey = dataKey(key);
-    std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
-    if ( !status.ok() )
-    {
-        // main record not found for some reason.
-        return ReadResult(ReadResult::RESULT_NOT_FOUND);
-    }
 
     // blend the data string
     if ( _tracker->seed().isSet() )
@@ -295,12 +311,12 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
         OE_NOTICE << LC << "Bin " << getID() << ": read (" << key << ")\n";
     }
 
-    // if there's a size limit, we need to 'touch' the record.
-    if ( _tracker->hasSizeLimit() )
+    // if there's a size limit, we need to 'touch' the record -- unless it
+    // was touched recently, or was just written and is still pending.
+    if ( _tracker->hasSizeLimit() && hasMeta && !pending && _tracker->isTimeToTouch(lastModified) )
     {
-        // Room for optimization here since we already have the 
-        // meta/time records around.
-        touch( key );
+        Config touched( metadata );
+        touchRecord( key, touched );
     }
 
     ++_tracker->hits;
@@ -372,24 +388,38 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     if (objWriteOK)
     {
         DateTime now;
-        leveldb::WriteBatch batch;
 
-        // write the data:
         data = datastream.str();
         if ( _tracker->seed().isSet() )
             blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
 
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
-
-        // write the metadata:
         Config metadata(meta);
         metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+        std::string metavalue;
+        encodeMeta( metadata, metavalue );
+
+        if ( _writeBehind->isEnabled() )
+        {
+            objWriteOK = _writeBehind->write(
+                dataKey(key), data,
+                metaKey(key), metavalue,
+                timeKey(now, key), binDataKeyTuple(key) );
+        }
+        else
+        {
+            leveldb::WriteBatch batch;
+
+            // write the data:
+            batch.Put( dataKey(key), data );
 
-        objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
+            // write the timestamp index:
+            batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+
+            // write the metadata:
+            batch.Put( metaKey(key), metavalue );
+
+            objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
+        }
 
         if ( objWriteOK )
         {
@@ -455,6 +485,9 @@ LevelDBCacheBin::getRecordStatus(const std::string& key)
     if ( !binValidForReading() ) 
         return STATUS_NOT_FOUND;
 
+    if ( _writeBehind->read(dataKey(key), 0L, 0L) )
+        return STATUS_OK;
+
     leveldb::Status status;
     leveldb::ReadOptions ro;
 
@@ -477,6 +510,8 @@ LevelDBCacheBin::remove(const std::string& key)
     if ( !binValidForReading() )
         return false;
 
+    _writeBehind->flush();
+
     // first read in the time from the metadata record.
     std::string metavalue;
     if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
@@ -511,6 +546,10 @@ LevelDBCacheBin::touch(const std::string& key)
     if ( !binValidForWriting() )
         return false;
 
+    // a pending tile was written a moment ago; nothing to refresh.
+    if ( _writeBehind->read(dataKey(key), 0L, 0L) )
+        return true;
+
     // first read in the time from the metadata record.
     std::string metavalue;
     if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
@@ -518,11 +557,18 @@ LevelDBCacheBin::touch(const std::string& key)
 
     Config metadata;
     decodeMeta(metavalue, metadata);
+    return touchRecord(key, metadata);
+}
+
+bool
+LevelDBCacheBin::touchRecord(const std::string& key, Config& metadata)
+{
     DateTime oldtime(metadata.value(TIME_FIELD));
-        
+
     leveldb::WriteBatch batch;
 
     // In a transaction, update the metadata record with the current time.
+    std::string metavalue;
     std::string newtime = DateTime().asCompactISO8601();
     metadata.set(TIME_FIELD, newtime);
     encodeMeta(metadata, metavalue);
@@ -551,6 +597,8 @@ LevelDBCacheBin::clear()
 {
     if ( !binValidForWriting() )
         return false;
+
+    _writeBehind->flush();
     
     leveldb::WriteOptions wo;
     std::string binphrase = binPhrase();
@@ -580,6 +628,8 @@ LevelDBCacheBin::compact()
     if ( !binValidForWriting() )
         return false;
 
+    _writeBehind->flush();
+
     // This could take a while.
     _db->CompactRange(0L, 0L);
 
@@ -611,8 +661,6 @@ LevelDBCacheBin::readMetadata()
     if ( !binValidForReading() )
         return Config();
 
-    ScopedMutexLock exclusiveLock( _rwMutex );
-
     std::string binvalue;
     leveldb::Status status = _db->Get(leveldb::ReadOptions(), binKey(), &binvalue);
     if ( !status.ok() )
@@ -653,6 +701,8 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
     if ( !binValidForWriting() )
         return false;
 
+    _writeBehind->flush();
+
     leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
 
     unsigned count = 0;
@@ -0,0 +1,523 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackCache"
+#include <osgEarth/URI>
+#include <osgEarth/Registry>
+#include <osgEarth/DateTime>
+#include <osgEarth/StringUtils>
+#include <osgEarth/FileUtils>
+#include <osgDB/Registry>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <osgDB/ObjectWrapper>
+#include <fstream>
+#include <sstream>
+#include <limits.h>
+
+#define LC "[PackCache] "
+
+#define PACK_CACHE_VERSION 1
+
+using namespace osgEarth;
+using namespace osgEarth::Threading;
+using namespace osgEarth::Drivers::PackCache;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Read-only stream buffer over a record in mapped memory, so the osgb
+    // reader decodes in place instead of from a copy.
+    struct RecordStreamBuf : public std::streambuf
+    {
+        RecordStreamBuf(const char* data, unsigned length) {
+            char* p = const_cast<char*>(data);
+            setg(p, p, p + length);
+        }
+
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+            if ( (which & std::ios_base::in) == 0 )
+                return pos_type(off_type(-1));
+            char* target =
+                dir == std::ios_base::beg ? eback() + off :
+                dir == std::ios_base::cur ? gptr() + off :
+                egptr() + off;
+            if ( target < eback() || target > egptr() )
+                return pos_type(off_type(-1));
+            setg( eback(), target, egptr() );
+            return pos_type(target - eback());
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+}
+
+//------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[PackCacheBin] "
+
+PackCacheBin::PackCacheBin(const std::string& binID,
+                           const std::string& rootPath,
+                           uint64_t           maxPackSize) :
+osgEarth::CacheBin( binID ),
+_ok               ( false ),
+_debug            ( false )
+{
+    _binPath  = osgDB::concatPaths( rootPath, binID );
+    _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
+    _store    = new PackStore( _binPath, maxPackSize );
+
+    // reader to parse data:
+    _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
+    _rwOptions = osgEarth::Registry::instance()->cloneOrCreateOptions();
+
+    if ( ::getenv("OSGEARTH_CACHE_DEBUG") )
+        _debug = true;
+}
+
+PackCacheBin::~PackCacheBin()
+{
+    _store->close();
+}
+
+bool
+PackCacheBin::binValidForReading(bool silent)
+{
+    if ( !_ok && _rw.valid() )
+    {
+        ScopedMutexLock lock( _openMutex );
+        if ( !_ok ) // double-check
+        {
+            _ok = osgDB::fileExists(_binPath) && _store->open(false);
+        }
+    }
+    return _ok;
+}
+
+bool
+PackCacheBin::binValidForWriting(bool silent)
+{
+    if ( !_ok && _rw.valid() )
+    {
+        ScopedMutexLock lock( _openMutex );
+        if ( !_ok ) // double-check
+        {
+            osgEarth::makeDirectoryForFile( _metaPath );
+            _ok = _store->open(true);
+
+            if ( !_ok && !silent )
+            {
+                OE_WARN << LC << "FAILED to find or create cache bin at [" << _binPath << "]" << std::endl;
+            }
+        }
+    }
+    return _ok;
+}
+
+ReadResult
+PackCacheBin::readImage(const std::string& key)
+{
+    return read(key, ImageReader(_rw.get(), _rwOptions.get()));
+}
+
+ReadResult
+PackCacheBin::readObject(const std::string& key)
+{
+    return read(key, ObjectReader(_rw.get(), _rwOptions.get()));
+}
+
+ReadResult
+PackCacheBin::readNode(const std::string& key)
+{
+    return read(key, NodeReader(_rw.get(), _rwOptions.get()));
+}
+
+ReadResult
+PackCacheBin::read(const std::string& key, const Reader& reader)
+{
+    if ( !binValidForReading() )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    // the record points into the mapped pack, which stays put as long as
+    // we hold the store's read lock.
+    ScopedReadLock sharedLock( _store->getMutex() );
+
+    PackStore::Record record;
+    if ( !_store->find(key, record) )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    Config metadata;
+    if ( record._metaSize > 0u )
+        metadata.fromJSON( std::string(record._meta, record._metaSize) );
+
+    RecordStreamBuf buf( record._data, record._dataSize );
+    std::istream datastream( &buf );
+    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+    if ( !r.success() )
+    {
+        OE_WARN << LC << "Cache read failure!"
+            << "\n reader = " << reader.name()
+            << "\n error detail = " << r.message()
+            << "\n";
+
+        return ReadResult(ReadResult::RESULT_READER_ERROR);
+    }
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": read (" << key << ")\n";
+    }
+
+    ReadResult rr(r.getObject(), metadata);
+    rr.setLastModifiedTime(record._time);
+    return rr;
+}
+
+ReadResult
+PackCacheBin::readString(const std::string& key)
+{
+    ReadResult r = readObject(key);
+    if ( r.succeeded() )
+    {
+        if ( r.get<StringObject>() )
+            return r;
+        else
+            return ReadResult();
+    }
+    else
+    {
+        return r;
+    }
+}
+
+bool
+PackCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta)
+{
+    if ( !binValidForWriting() || !object )
+        return false;
+
+    osgDB::ReaderWriter::WriteResult r;
+    bool objWriteOK = false;
+
+    std::stringstream datastream;
+
+    if ( dynamic_cast<const osg::Image*>(object) )
+    {
+        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
+        {
+            OE_WARN << LC << "Internal: tried to write image to " << _rw->className() << "\n";
+            return false;
+        }
+        r = _rw->writeImage( *static_cast<const osg::Image*>(object), datastream, _rwOptions.get() );
+        objWriteOK = r.success();
+    }
+    else if ( dynamic_cast<const osg::Node*>(object) )
+    {
+        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_NODE) == 0 )
+        {
+            OE_WARN << LC << "Internal: tried to write node to " << _rw->className() << "\n";
+            return false;
+        }
+        r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, _rwOptions.get() );
+        objWriteOK = r.success();
+    }
+    else
+    {
+        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_OBJECT) == 0 )
+        {
+            OE_WARN << LC << "Internal: tried to write an object to " << _rw->className() << "\n";
+            return false;
+        }
+        r = _rw->writeObject( *object, datastream );
+        objWriteOK = r.success();
+    }
+
+    if ( objWriteOK )
+    {
+        std::string metadata;
+        if ( !meta.empty() )
+            metadata = meta.toJSON(false);
+
+        objWriteOK = _store->put( key, metadata, datastream.str(), DateTime().asTimeStamp() );
+
+        if ( objWriteOK && _debug )
+        {
+            OE_NOTICE << LC << "Bin " << getID() << ": wrote (" << key << ")\n";
+        }
+    }
+
+    if ( !objWriteOK )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << key << "); msg = \""
+            << r.message() << "\"\n";
+    }
+
+    return objWriteOK;
+}
+
+CacheBin::RecordStatus
+PackCacheBin::getRecordStatus(const std::string& key)
+{
+    if ( !binValidForReading() )
+        return STATUS_NOT_FOUND;
+
+    TimeStamp t;
+    return _store->getTime(key, t) ? STATUS_OK : STATUS_NOT_FOUND;
+}
+
+bool
+PackCacheBin::remove(const std::string& key)
+{
+    if ( !binValidForReading() )
+        return false;
+
+    return _store->remove(key);
+}
+
+bool
+PackCacheBin::touch(const std::string& key)
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    return _store->touch(key, DateTime().asTimeStamp());
+}
+
+bool
+PackCacheBin::clear()
+{
+    if ( !binValidForReading() )
+        return false;
+
+    bool ok = _store->clear();
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Cleared bin " << getID() << std::endl;
+    }
+    return ok;
+}
+
+bool
+PackCacheBin::compact()
+{
+    if ( !binValidForReading() )
+        return false;
+
+    uint64_t before = _store->getStorageSize();
+
+    // This could take a while.
+    bool ok = _store->compact();
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Compacted bin " << getID() << " from "
+            << (before/1048576) << " MB to "
+            << (_store->getStorageSize()/1048576) << " MB" << std::endl;
+    }
+    return ok;
+}
+
+unsigned
+PackCacheBin::getStorageSize()
+{
+    uint64_t size = getStorageSize64();
+    return size > UINT_MAX ? UINT_MAX : (unsigned)size;
+}
+
+uint64_t
+PackCacheBin::getStorageSize64()
+{
+    return binValidForReading() ? _store->getStorageSize() : 0u;
+}
+
+Config
+PackCacheBin::readMetadata()
+{
+    if ( !binValidForReading() )
+        return Config();
+
+    ScopedMutexLock lock( _metaMutex );
+
+    std::ifstream input( _metaPath.c_str() );
+    if ( !input.is_open() )
+        return Config();
+
+    std::stringstream buf;
+    buf << input.rdbuf();
+
+    Config conf;
+    conf.fromJSON( buf.str() );
+    return conf;
+}
+
+bool
+PackCacheBin::writeMetadata(const Config& conf)
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    ScopedMutexLock lock( _metaMutex );
+
+    // inject the cache version
+    Config mutableConf(conf);
+    mutableConf.set("pack.cache_version", PACK_CACHE_VERSION);
+
+    std::ofstream output( _metaPath.c_str() );
+    if ( output.is_open() )
+    {
+        output << mutableConf.toJSON(true);
+        output.flush();
+        return output.good();
+    }
+
+    OE_WARN << LC << "Failed to write metadata record for bin (" << getID() << ")" << std::endl;
+    return false;
+}
+
+//------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[PackCache] "
+
+PackCacheImpl::PackCacheImpl( const CacheOptions& options ) :
+osgEarth::Cache( options ),
+_options       ( options )
+{
+    // Force OSG to initialize the image wrapper. Failure to do this can result
+    // in a race condition within OSG when the cache is accessed from multiple threads.
+    osgDB::ObjectWrapperManager* owm = osgDB::Registry::instance()->getObjectWrapperManager();
+    owm->findWrapper("osg::Image");
+    owm->findWrapper("osg::HeightField");
+
+    if ( _options.rootPath().isSet() )
+    {
+        _rootPath = URI( *_options.rootPath(), options.referrer() ).full();
+    }
+    else
+    {
+        // read the root path from ENV is necessary:
+        const char* cachePath = ::getenv(OSGEARTH_ENV_CACHE_PATH);
+        if ( cachePath )
+        {
+            _rootPath = cachePath;
+            OE_INFO << LC << "Cache location set from environment: \""
+                << cachePath << "\"" << std::endl;
+        }
+    }
+
+    _maxPackSize = (uint64_t)_options.maxPackSizeMB().value() * 1048576u;
+
+    if ( _rootPath.empty() )
+    {
+        _ok = false;
+        OE_WARN << LC << "Illegal: no root path set for cache!" << std::endl;
+    }
+    else if ( !osgDB::fileExists(_rootPath) && !osgDB::makeDirectory(_rootPath) )
+    {
+        _ok = false;
+        OE_WARN << LC << "Oh no, failed to create root cache folder \"" << _rootPath << "\"" << std::endl;
+    }
+    else
+    {
+        OE_INFO << LC << "Opened pack cache at " << _rootPath << std::endl;
+    }
+}
+
+PackCacheImpl::~PackCacheImpl()
+{
+    //nop
+}
+
+PackCacheBin*
+PackCacheImpl::track(CacheBin* bin)
+{
+    PackCacheBin* packBin = static_cast<PackCacheBin*>(bin);
+    if ( packBin )
+    {
+        ScopedMutexLock lock( _openBinsMutex );
+        for(unsigned i=0; i<_openBins.size(); ++i)
+        {
+            if ( _openBins[i].get() == packBin )
+                return packBin;
+        }
+        _openBins.push_back( packBin );
+    }
+    return packBin;
+}
+
+CacheBin*
+PackCacheImpl::addBin( const std::string& name )
+{
+    if ( !_ok )
+        return 0L;
+
+    return track( _bins.getOrCreate(name, new PackCacheBin(name, _rootPath, _maxPackSize)) );
+}
+
+CacheBin*
+PackCacheImpl::getOrCreateDefaultBin()
+{
+    if ( !_ok )
+        return 0L;
+
+    static Threading::Mutex s_defaultBinMutex;
+    if ( !_defaultBin.valid() )
+    {
+        Threading::ScopedMutexLock lock( s_defaultBinMutex );
+        if ( !_defaultBin.valid() ) // double-check
+        {
+            _defaultBin = track( new PackCacheBin("_default", _rootPath, _maxPackSize) );
+        }
+    }
+    return _defaultBin.get();
+}
+
+off_t
+PackCacheImpl::getApproximateSize() const
+{
+    ScopedMutexLock lock( _openBinsMutex );
+    uint64_t total = 0u;
+    for(unsigned i=0; i<_openBins.size(); ++i)
+        total += _openBins[i]->getStorageSize64();
+    return (off_t)total;
+}
+
+bool
+PackCacheImpl::compact()
+{
+    ScopedMutexLock lock( _openBinsMutex );
+    bool ok = true;
+    for(unsigned i=0; i<_openBins.size(); ++i)
+        ok = _openBins[i]->compact() && ok;
+    return ok;
+}
+
+bool
+PackCacheImpl::clear()
+{
+    ScopedMutexLock lock( _openBinsMutex );
+    bool ok = true;
+    for(unsigned i=0; i<_openBins.size(); ++i)
+        ok = _openBins[i]->clear() && ok;
+    return ok;
+}
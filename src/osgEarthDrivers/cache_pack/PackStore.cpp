@@ -0,0 +1,1171 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackStore"
+#include <osgEarth/Notify>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#   include <io.h>
+#else
+#   include <unistd.h>
+#   include <sys/mman.h>
+#endif
+
+#define LC "[PackStore] "
+
+using namespace osgEarth;
+using namespace osgEarth::Threading;
+using namespace osgEarth::Drivers::PackCache;
+
+// All multi-byte values are stored in native byte order; a cache is local
+// to the machine that wrote it.
+
+#define PACK_MAGIC          0x4B50454Fu  // "OEPK"
+#define RECORD_MAGIC        0x5243454Fu  // "OECR"
+#define INDEX_MAGIC         0x4950454Fu  // "OEPI"
+#define INDEX_VERSION       1u
+
+#define PACK_HEADER_SIZE    16u
+#define RECORD_HEADER_SIZE  32u
+#define RECORD_TOMBSTONE    1u
+
+#define INDEX_MIN_CAPACITY  4096u
+#define SLOT_EMPTY          0u
+#define SLOT_DELETED        1u
+
+// Bytes a pack may grow past its mapping before it is remapped. Records in
+// that tail are read with a copy instead.
+#define REMAP_THRESHOLD     (4u*1024u*1024u)
+
+namespace
+{
+    struct PackHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t reserved;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t flags;
+        uint32_t keySize;
+        uint32_t metaSize;
+        uint32_t dataSize;
+        uint32_t reserved;
+        int64_t  time;
+    };
+
+    struct IndexHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t clean;       // 1 if the index was closed properly
+        uint32_t nextPackID;
+        uint64_t capacity;    // number of slots (power of two)
+        uint64_t count;       // live slots
+        uint64_t used;        // live + deleted slots
+        uint64_t liveBytes;   // bytes of pack records the index refers to
+        uint64_t deadBytes;   // bytes of pack records it doesn't
+        uint64_t reserved;
+    };
+
+    struct Slot
+    {
+        uint64_t hash;
+        uint64_t offset;
+        int64_t  time;
+        uint32_t pack;
+        uint32_t size;
+    };
+
+    inline IndexHeader* indexHeader(const PackMapping& map)
+    {
+        return reinterpret_cast<IndexHeader*>(map.data());
+    }
+
+    inline Slot* indexSlots(const PackMapping& map)
+    {
+        return reinterpret_cast<Slot*>(map.data() + sizeof(IndexHeader));
+    }
+
+    // 64-bit FNV-1a; the two smallest values mark empty and deleted slots.
+    inline uint64_t hashKey(const std::string& key)
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for(std::string::const_iterator i = key.begin(); i != key.end(); ++i)
+        {
+            h ^= (unsigned char)(*i);
+            h *= 1099511628211ULL;
+        }
+        return h > SLOT_DELETED ? h : h + 2u;
+    }
+
+    inline uint64_t padded(uint64_t size)
+    {
+        return (size + 7u) & ~(uint64_t)7u;
+    }
+
+    inline uint64_t recordSize(const RecordHeader& h)
+    {
+        return padded(RECORD_HEADER_SIZE + (uint64_t)h.keySize + h.metaSize + h.dataSize);
+    }
+
+    // smallest power-of-two capacity that keeps the load under one half.
+    uint64_t capacityFor(uint64_t count)
+    {
+        uint64_t cap = INDEX_MIN_CAPACITY;
+        while( count*2u >= cap )
+            cap *= 2u;
+        return cap;
+    }
+
+    // places a slot in an index known not to contain its key.
+    void insertUnique(const PackMapping& map, const Slot& slot)
+    {
+        IndexHeader* h = indexHeader(map);
+        Slot* slots = indexSlots(map);
+        uint64_t mask = h->capacity - 1u;
+        uint64_t i = slot.hash & mask;
+        while( slots[i].hash != SLOT_EMPTY )
+            i = (i + 1u) & mask;
+        slots[i] = slot;
+        h->count++;
+        h->used++;
+        h->liveBytes += slot.size;
+    }
+
+    bool lessByLocation(const Slot& lhs, const Slot& rhs)
+    {
+        return lhs.pack < rhs.pack || (lhs.pack == rhs.pack && lhs.offset < rhs.offset);
+    }
+
+    bool replaceFile(const std::string& from, const std::string& to)
+    {
+#ifdef _WIN32
+        return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return ::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool
+PackFileHandle::open(const std::string& path, bool create)
+{
+    close();
+#ifdef _WIN32
+    int flags = _O_RDWR | _O_BINARY | (create ? _O_CREAT|_O_TRUNC : 0);
+    _fd = ::_open( path.c_str(), flags, _S_IREAD|_S_IWRITE );
+    if ( _fd >= 0 )
+        _size = (uint64_t)::_lseeki64( _fd, 0, SEEK_END );
+#else
+    int flags = O_RDWR | (create ? O_CREAT|O_TRUNC : 0);
+    _fd = ::open( path.c_str(), flags, 0644 );
+    if ( _fd >= 0 )
+    {
+        struct stat s;
+        _size = ::fstat(_fd, &s) == 0 ? (uint64_t)s.st_size : 0u;
+    }
+#endif
+    return _fd >= 0;
+}
+
+void
+PackFileHandle::close()
+{
+    if ( _fd >= 0 )
+    {
+#ifdef _WIN32
+        ::_close( _fd );
+#else
+        ::close( _fd );
+#endif
+        _fd = -1;
+        _size = 0u;
+    }
+}
+
+bool
+PackFileHandle::readAt(uint64_t offset, void* out, uint64_t size) const
+{
+    if ( _fd < 0 || offset + size > _size )
+        return false;
+
+    char* ptr = (char*)out;
+#ifdef _WIN32
+    ScopedMutexLock lock( _seekMutex );
+    if ( ::_lseeki64(_fd, (__int64)offset, SEEK_SET) < 0 )
+        return false;
+    while( size > 0u )
+    {
+        int n = ::_read( _fd, ptr, (unsigned)std::min(size, (uint64_t)(1u<<30)) );
+        if ( n <= 0 ) return false;
+        ptr += n; size -= n;
+    }
+#else
+    while( size > 0u )
+    {
+        ssize_t n = ::pread( _fd, ptr, (size_t)size, (off_t)offset );
+        if ( n <= 0 ) return false;
+        ptr += n; size -= n; offset += n;
+    }
+#endif
+    return true;
+}
+
+bool
+PackFileHandle::writeAt(uint64_t offset, const void* data, uint64_t size)
+{
+    if ( _fd < 0 )
+        return false;
+
+    const char* ptr = (const char*)data;
+    uint64_t end = offset + size;
+#ifdef _WIN32
+    ScopedMutexLock lock( _seekMutex );
+    if ( ::_lseeki64(_fd, (__int64)offset, SEEK_SET) < 0 )
+        return false;
+    while( size > 0u )
+    {
+        int n = ::_write( _fd, ptr, (unsigned)std::min(size, (uint64_t)(1u<<30)) );
+        if ( n <= 0 ) return false;
+        ptr += n; size -= n;
+    }
+#else
+    while( size > 0u )
+    {
+        ssize_t n = ::pwrite( _fd, ptr, (size_t)size, (off_t)offset );
+        if ( n <= 0 ) return false;
+        ptr += n; size -= n; offset += n;
+    }
+#endif
+    if ( end > _size )
+        _size = end;
+    return true;
+}
+
+bool
+PackFileHandle::append(const void* data, uint64_t size, uint64_t& out_offset)
+{
+    uint64_t offset = _size;
+    if ( !writeAt(offset, data, size) )
+    {
+        // drop whatever part of the record made it out.
+        resize( offset );
+        return false;
+    }
+    out_offset = offset;
+    return true;
+}
+
+bool
+PackFileHandle::resize(uint64_t size)
+{
+    if ( _fd < 0 )
+        return false;
+#ifdef _WIN32
+    bool ok = ::_chsize_s( _fd, (__int64)size ) == 0;
+#else
+    bool ok = ::ftruncate( _fd, (off_t)size ) == 0;
+#endif
+    if ( ok )
+        _size = size;
+    return ok;
+}
+
+//------------------------------------------------------------------------
+
+bool
+PackMapping::map(PackFileHandle& file, uint64_t size, bool writable)
+{
+    unmap();
+    if ( !file.isOpen() || size == 0u || size > file.size() )
+        return false;
+
+#ifdef _WIN32
+    HANDLE fh = (HANDLE)::_get_osfhandle( file.fd() );
+    HANDLE mh = ::CreateFileMappingA(
+        fh, 0L, writable ? PAGE_READWRITE : PAGE_READONLY,
+        (DWORD)(size >> 32), (DWORD)(size & 0xffffffffu), 0L );
+    if ( mh == 0L )
+        return false;
+    void* ptr = ::MapViewOfFile( mh, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)size );
+    if ( ptr == 0L )
+    {
+        ::CloseHandle( mh );
+        return false;
+    }
+    _handle = mh;
+#else
+    void* ptr = ::mmap( 0L, (size_t)size, writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, file.fd(), 0 );
+    if ( ptr == MAP_FAILED )
+        return false;
+#endif
+
+    _data = (char*)ptr;
+    _size = size;
+    return true;
+}
+
+void
+PackMapping::unmap()
+{
+    if ( _data )
+    {
+#ifdef _WIN32
+        ::UnmapViewOfFile( _data );
+        ::CloseHandle( (HANDLE)_handle );
+        _handle = 0L;
+#else
+        ::munmap( _data, (size_t)_size );
+#endif
+        _data = 0L;
+        _size = 0u;
+    }
+}
+
+void
+PackMapping::sync()
+{
+    if ( _data )
+    {
+#ifdef _WIN32
+        ::FlushViewOfFile( _data, (SIZE_T)_size );
+#else
+        ::msync( _data, (size_t)_size, MS_SYNC );
+#endif
+    }
+}
+
+//------------------------------------------------------------------------
+
+PackStore::PackStore(const std::string& path, uint64_t maxPackSize) :
+_path       ( path ),
+_maxPackSize( std::max(maxPackSize, (uint64_t)(1u*1024u*1024u)) )
+{
+    //nop
+}
+
+PackStore::~PackStore()
+{
+    close();
+}
+
+std::string
+PackStore::packPath(unsigned id) const
+{
+    char buf[32];
+    sprintf(buf, "pack_%06u.dat", id);
+    return osgDB::concatPaths(_path, buf);
+}
+
+std::string
+PackStore::indexPath() const
+{
+    return osgDB::concatPaths(_path, "index.dat");
+}
+
+bool
+PackStore::open(bool create)
+{
+    ScopedWriteLock lock( _mutex );
+
+    if ( isOpen() )
+        return true;
+
+    if ( !osgDB::fileExists(_path) )
+    {
+        if ( !create || !osgDB::makeDirectory(_path) )
+            return false;
+    }
+
+    // find the pack files, in order.
+    std::vector<unsigned> ids;
+    osgDB::DirectoryContents files = osgDB::getDirectoryContents(_path);
+    for(osgDB::DirectoryContents::const_iterator f = files.begin(); f != files.end(); ++f)
+    {
+        unsigned id;
+        char tail;
+        if ( sscanf(f->c_str(), "pack_%u.da%c", &id, &tail) == 2 && tail == 't' && packPath(id) == osgDB::concatPaths(_path, *f) )
+            ids.push_back( id );
+    }
+    std::sort( ids.begin(), ids.end() );
+
+    for(unsigned i=0; i<ids.size(); ++i)
+    {
+        if ( !addPack(ids[i], false) )
+        {
+            OE_WARN << LC << "Ignoring unreadable pack file " << packPath(ids[i]) << std::endl;
+        }
+    }
+
+    // use the index if it was closed properly; otherwise rebuild it from the packs.
+    bool indexOK = false;
+    if ( _indexFile.open(indexPath(), false) &&
+         _indexFile.size() >= sizeof(IndexHeader) &&
+         _index.map(_indexFile, _indexFile.size(), true) )
+    {
+        const IndexHeader* h = indexHeader(_index);
+        indexOK =
+            h->magic    == INDEX_MAGIC &&
+            h->version  == INDEX_VERSION &&
+            h->clean    == 1u &&
+            h->capacity >= INDEX_MIN_CAPACITY &&
+            (h->capacity & (h->capacity-1u)) == 0u &&
+            _indexFile.size() == sizeof(IndexHeader) + h->capacity*sizeof(Slot);
+    }
+
+    if ( !indexOK )
+    {
+        if ( _indexFile.isOpen() )
+        {
+            OE_WARN << LC << "Index at " << _path << " was not closed properly; rebuilding" << std::endl;
+        }
+
+        if ( !rebuildIndex() )
+        {
+            OE_WARN << LC << "Failed to create index at " << indexPath() << std::endl;
+            _index.unmap();
+            _indexFile.close();
+            closePacks();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+PackStore::close()
+{
+    ScopedWriteLock lock( _mutex );
+
+    if ( isOpen() )
+    {
+        IndexHeader* h = indexHeader(_index);
+        if ( h->clean == 0u )
+        {
+            _index.sync();
+            h->clean = 1u;
+            _index.sync();
+        }
+    }
+
+    _index.unmap();
+    _indexFile.close();
+    closePacks();
+}
+
+void
+PackStore::closePacks()
+{
+    for(unsigned i=0; i<_packs.size(); ++i)
+        delete _packs[i];
+    _packs.clear();
+}
+
+PackStore::Pack*
+PackStore::getPack(unsigned id) const
+{
+    // packs are sorted by id; usually there are only a few.
+    unsigned lo = 0u, hi = _packs.size();
+    while( lo < hi )
+    {
+        unsigned mid = (lo + hi) / 2u;
+        if ( _packs[mid]->_id < id ) lo = mid + 1u;
+        else hi = mid;
+    }
+    return lo < _packs.size() && _packs[lo]->_id == id ? _packs[lo] : 0L;
+}
+
+PackStore::Pack*
+PackStore::addPack(unsigned id, bool create)
+{
+    Pack* pack = new Pack();
+    pack->_id = id;
+
+    bool ok = pack->_file.open(packPath(id), create);
+    if ( ok && create )
+    {
+        PackHeader ph;
+        ph.magic = PACK_MAGIC;
+        ph.version = INDEX_VERSION;
+        ph.reserved = 0u;
+        uint64_t offset;
+        ok = pack->_file.append(&ph, sizeof(ph), offset);
+    }
+    else if ( ok )
+    {
+        PackHeader ph;
+        ok = pack->_file.readAt(0u, &ph, sizeof(ph)) && ph.magic == PACK_MAGIC;
+    }
+
+    if ( ok )
+        ok = pack->_map.map(pack->_file, pack->_file.size(), false);
+
+    if ( !ok )
+    {
+        delete pack;
+        return 0L;
+    }
+
+    _packs.push_back( pack );
+    return pack;
+}
+
+PackStore::Pack*
+PackStore::getActivePack(uint64_t bytesNeeded)
+{
+    Pack* active = _packs.empty() ? 0L : _packs.back();
+
+    if ( active && active->_file.size() + bytesNeeded > _maxPackSize && active->_file.size() > PACK_HEADER_SIZE )
+    {
+        // seal the full pack so all of it is readable without copying.
+        remapTail( active, true );
+        active = 0L;
+    }
+
+    if ( !active )
+    {
+        IndexHeader* h = indexHeader(_index);
+        active = addPack( h->nextPackID, true );
+        if ( active )
+            h->nextPackID++;
+        else
+            OE_WARN << LC << "Failed to create pack file " << packPath(h->nextPackID) << std::endl;
+    }
+
+    return active;
+}
+
+void
+PackStore::remapTail(Pack* pack, bool force)
+{
+    uint64_t size = pack->_file.size();
+    if ( size > pack->_map.size() && (force || size - pack->_map.size() >= REMAP_THRESHOLD) )
+    {
+        pack->_map.map( pack->_file, size, false );
+    }
+}
+
+bool
+PackStore::createIndex(const std::string& path, uint64_t capacity, PackFileHandle& file, PackMapping& map) const
+{
+    uint64_t size = sizeof(IndexHeader) + capacity*sizeof(Slot);
+    if ( !file.open(path, true) || !file.resize(size) || !map.map(file, size, true) )
+        return false;
+
+    IndexHeader* h = indexHeader(map);
+    memset( h, 0, sizeof(IndexHeader) );
+    h->magic    = INDEX_MAGIC;
+    h->version  = INDEX_VERSION;
+    h->capacity = capacity;
+    if ( isOpen() )
+        h->nextPackID = indexHeader(_index)->nextPackID;
+    return true;
+}
+
+bool
+PackStore::swapIndex(PackFileHandle& file, PackMapping& map, const std::string& path)
+{
+    map.sync();
+    map.unmap();
+    file.close();
+
+    _index.unmap();
+    _indexFile.close();
+
+    // on failure this reopens the old index, if there is one.
+    bool replaced = replaceFile(path, indexPath());
+
+    bool opened =
+        _indexFile.open(indexPath(), false) &&
+        _index.map(_indexFile, _indexFile.size(), true);
+
+    return replaced && opened;
+}
+
+bool
+PackStore::rebuildIndex()
+{
+    std::string tempPath = indexPath() + ".tmp";
+    PackFileHandle file;
+    PackMapping map;
+
+    _index.unmap();
+    _indexFile.close();
+
+    if ( !createIndex(tempPath, INDEX_MIN_CAPACITY, file, map) )
+        return false;
+
+    indexHeader(map)->nextPackID = _packs.empty() ? 0u : _packs.back()->_id + 1u;
+
+    if ( !swapIndex(file, map, tempPath) )
+        return false;
+
+    // replay every record in write order; later records win.
+    for(unsigned p=0; p<_packs.size(); ++p)
+    {
+        Pack* pack = _packs[p];
+        uint64_t offset = PACK_HEADER_SIZE;
+        while( offset + RECORD_HEADER_SIZE <= pack->_file.size() )
+        {
+            Record rec;
+            std::string key;
+            RecordHeader rh;
+            if ( !pack->_file.readAt(offset, &rh, sizeof(rh)) ||
+                 rh.magic != RECORD_MAGIC ||
+                 offset + recordSize(rh) > pack->_file.size() ||
+                 !readRecord(pack->_id, offset, rec, &key) )
+            {
+                break;
+            }
+
+            uint32_t size = (uint32_t)recordSize(rh);
+            if ( rh.flags & RECORD_TOMBSTONE )
+            {
+                IndexHeader* h = indexHeader(_index);
+                int64_t i = findSlot(key, hashKey(key));
+                if ( i >= 0 )
+                {
+                    Slot& slot = indexSlots(_index)[i];
+                    h->count--;
+                    h->liveBytes -= slot.size;
+                    h->deadBytes += slot.size;
+                    slot.hash = SLOT_DELETED;
+                }
+                h->deadBytes += size;
+            }
+            else
+            {
+                insertSlot(key, hashKey(key), pack->_id, offset, size, (TimeStamp)rh.time);
+            }
+            offset += size;
+        }
+
+        if ( offset < pack->_file.size() )
+        {
+            // a write was cut short; drop the partial record.
+            OE_WARN << LC << "Truncating damaged pack file " << packPath(pack->_id)
+                << " at " << offset << " bytes" << std::endl;
+            pack->_map.unmap();
+            pack->_file.resize( offset );
+            pack->_map.map( pack->_file, offset, false );
+        }
+    }
+
+    return isOpen();
+}
+
+bool
+PackStore::growIndex()
+{
+    const IndexHeader* oldHeader = indexHeader(_index);
+    uint64_t capacity = capacityFor(oldHeader->count + 1u);
+
+    std::string tempPath = indexPath() + ".tmp";
+    PackFileHandle file;
+    PackMapping map;
+    if ( !createIndex(tempPath, capacity, file, map) )
+    {
+        OE_WARN << LC << "Failed to grow index at " << indexPath() << std::endl;
+        return false;
+    }
+
+    IndexHeader* h = indexHeader(map);
+    h->deadBytes  = oldHeader->deadBytes;
+    h->nextPackID = oldHeader->nextPackID;
+
+    const Slot* slots = indexSlots(_index);
+    for(uint64_t i=0; i<oldHeader->capacity; ++i)
+    {
+        if ( slots[i].hash > SLOT_DELETED )
+            insertUnique( map, slots[i] );
+    }
+
+    return swapIndex(file, map, tempPath);
+}
+
+bool
+PackStore::keyMatches(const std::string& key, unsigned packID, uint64_t offset) const
+{
+    const Pack* pack = getPack(packID);
+    if ( !pack )
+        return false;
+
+    uint64_t end = offset + RECORD_HEADER_SIZE + key.size();
+    if ( end <= pack->_map.size() )
+    {
+        const RecordHeader* rh = reinterpret_cast<const RecordHeader*>(pack->_map.data() + offset);
+        return
+            rh->keySize == key.size() &&
+            memcmp(pack->_map.data() + offset + RECORD_HEADER_SIZE, key.data(), key.size()) == 0;
+    }
+    else
+    {
+        RecordHeader rh;
+        if ( !pack->_file.readAt(offset, &rh, sizeof(rh)) || rh.keySize != key.size() )
+            return false;
+        std::string buf(key.size(), '\0');
+        return
+            (key.empty() || pack->_file.readAt(offset + RECORD_HEADER_SIZE, &buf[0], key.size())) &&
+            buf == key;
+    }
+}
+
+bool
+PackStore::readRecord(unsigned packID, uint64_t offset, Record& out, std::string* out_key) const
+{
+    const Pack* pack = getPack(packID);
+    if ( !pack )
+        return false;
+
+    const char* base = 0L;
+    RecordHeader rh;
+
+    if ( offset + RECORD_HEADER_SIZE <= pack->_map.size() )
+    {
+        memcpy( &rh, pack->_map.data() + offset, sizeof(rh) );
+        if ( rh.magic == RECORD_MAGIC && offset + recordSize(rh) <= pack->_map.size() )
+        {
+            // zero-copy: the whole record is mapped.
+            base = pack->_map.data() + offset;
+        }
+    }
+
+    if ( !base )
+    {
+        // the record is in the unmapped tail of the active pack.
+        if ( !pack->_file.readAt(offset, &rh, sizeof(rh)) || rh.magic != RECORD_MAGIC )
+            return false;
+        out._copy.resize( (size_t)recordSize(rh) );
+        if ( !pack->_file.readAt(offset, &out._copy[0], out._copy.size()) )
+            return false;
+        base = out._copy.data();
+    }
+
+    if ( rh.magic != RECORD_MAGIC )
+        return false;
+
+    const char* ptr = base + RECORD_HEADER_SIZE;
+    if ( out_key )
+        out_key->assign( ptr, rh.keySize );
+    ptr += rh.keySize;
+
+    out._meta     = ptr;
+    out._metaSize = rh.metaSize;
+    out._data     = ptr + rh.metaSize;
+    out._dataSize = rh.dataSize;
+    out._time     = (TimeStamp)rh.time;
+    return true;
+}
+
+int64_t
+PackStore::findSlot(const std::string& key, uint64_t hash) const
+{
+    const IndexHeader* h = indexHeader(_index);
+    const Slot* slots = indexSlots(_index);
+    uint64_t mask = h->capacity - 1u;
+    uint64_t i = hash & mask;
+
+    for(uint64_t n=0; n<h->capacity; ++n, i = (i + 1u) & mask)
+    {
+        const Slot& slot = slots[i];
+        if ( slot.hash == SLOT_EMPTY )
+            return -1;
+        if ( slot.hash == hash && keyMatches(key, slot.pack, slot.offset) )
+            return (int64_t)i;
+    }
+    return -1;
+}
+
+bool
+PackStore::insertSlot(const std::string& key, uint64_t hash, unsigned pack, uint64_t offset, uint32_t size, TimeStamp time)
+{
+    if ( indexHeader(_index)->used + 1u > indexHeader(_index)->capacity/2u + indexHeader(_index)->capacity/5u )
+        growIndex();
+
+    IndexHeader* h = indexHeader(_index);
+    Slot* slots = indexSlots(_index);
+    uint64_t mask = h->capacity - 1u;
+    uint64_t i = hash & mask;
+    int64_t reuse = -1;
+    bool foundEmpty = false;
+
+    for(uint64_t n=0; n<h->capacity; ++n, i = (i + 1u) & mask)
+    {
+        Slot& slot = slots[i];
+        if ( slot.hash == SLOT_EMPTY )
+        {
+            foundEmpty = true;
+            break;
+        }
+        if ( slot.hash == SLOT_DELETED )
+        {
+            if ( reuse < 0 ) reuse = (int64_t)i;
+        }
+        else if ( slot.hash == hash && keyMatches(key, slot.pack, slot.offset) )
+        {
+            // replacing a record; the old one becomes garbage.
+            h->liveBytes -= slot.size;
+            h->deadBytes += slot.size;
+            h->count--;
+            reuse = (int64_t)i;
+            h->used--;
+            break;
+        }
+    }
+
+    if ( reuse < 0 )
+    {
+        // only possible if growing the index failed.
+        if ( !foundEmpty )
+            return false;
+        reuse = (int64_t)i;
+        h->used++;
+    }
+
+    Slot& slot = slots[reuse];
+    slot.hash   = hash;
+    slot.pack   = pack;
+    slot.offset = offset;
+    slot.size   = size;
+    slot.time   = (int64_t)time;
+    h->count++;
+    h->liveBytes += size;
+    return true;
+}
+
+void
+PackStore::markDirty()
+{
+    IndexHeader* h = indexHeader(_index);
+    if ( h->clean != 0u )
+    {
+        h->clean = 0u;
+        _index.sync();
+    }
+}
+
+bool
+PackStore::appendRecord(const std::string& key, const std::string& meta, const std::string& data, TimeStamp time, bool tombstone,
+                        unsigned& out_pack, uint64_t& out_offset, uint32_t& out_size)
+{
+    RecordHeader rh;
+    rh.magic    = RECORD_MAGIC;
+    rh.flags    = tombstone ? RECORD_TOMBSTONE : 0u;
+    rh.keySize  = key.size();
+    rh.metaSize = meta.size();
+    rh.dataSize = data.size();
+    rh.reserved = 0u;
+    rh.time     = (int64_t)time;
+
+    uint64_t size = recordSize(rh);
+    if ( size > 0xffffffffu )
+        return false;
+
+    std::string buf;
+    buf.reserve( (size_t)size );
+    buf.append( (const char*)&rh, sizeof(rh) );
+    buf.append( key );
+    buf.append( meta );
+    buf.append( data );
+    buf.resize( (size_t)size, '\0' );
+
+    Pack* pack = getActivePack( size );
+    if ( !pack || !pack->_file.append(buf.data(), size, out_offset) )
+        return false;
+
+    remapTail( pack, false );
+
+    out_pack = pack->_id;
+    out_size = (uint32_t)size;
+    return true;
+}
+
+bool
+PackStore::find(const std::string& key, Record& out) const
+{
+    if ( !isOpen() )
+        return false;
+
+    int64_t i = findSlot(key, hashKey(key));
+    if ( i < 0 )
+        return false;
+
+    const Slot& slot = indexSlots(_index)[i];
+    if ( !readRecord(slot.pack, slot.offset, out, 0L) )
+        return false;
+
+    out._time = (TimeStamp)slot.time;
+    return true;
+}
+
+bool
+PackStore::getTime(const std::string& key, TimeStamp& out)
+{
+    ScopedReadLock lock( _mutex );
+    if ( !isOpen() )
+        return false;
+
+    int64_t i = findSlot(key, hashKey(key));
+    if ( i < 0 )
+        return false;
+
+    out = (TimeStamp)indexSlots(_index)[i].time;
+    return true;
+}
+
+bool
+PackStore::put(const std::string& key, const std::string& meta, const std::string& data, TimeStamp time)
+{
+    ScopedWriteLock lock( _mutex );
+    if ( !isOpen() )
+        return false;
+
+    markDirty();
+
+    unsigned pack;
+    uint64_t offset;
+    uint32_t size;
+    if ( !appendRecord(key, meta, data, time, false, pack, offset, size) )
+        return false;
+
+    if ( !insertSlot(key, hashKey(key), pack, offset, size, time) )
+    {
+        indexHeader(_index)->deadBytes += size;
+        return false;
+    }
+    return true;
+}
+
+bool
+PackStore::remove(const std::string& key)
+{
+    ScopedWriteLock lock( _mutex );
+    if ( !isOpen() )
+        return false;
+
+    int64_t i = findSlot(key, hashKey(key));
+    if ( i < 0 )
+        return false;
+
+    markDirty();
+
+    // the tombstone keeps the record from coming back if the index is rebuilt.
+    unsigned pack;
+    uint64_t offset;
+    uint32_t size;
+    if ( !appendRecord(key, std::string(), std::string(), 0, true, pack, offset, size) )
+        return false;
+
+    IndexHeader* h = indexHeader(_index);
+    Slot& slot = indexSlots(_index)[i];
+    h->count--;
+    h->liveBytes -= slot.size;
+    h->deadBytes += slot.size + size;
+    slot.hash = SLOT_DELETED;
+    return true;
+}
+
+bool
+PackStore::touch(const std::string& key, TimeStamp time)
+{
+    ScopedWriteLock lock( _mutex );
+    if ( !isOpen() )
+        return false;
+
+    int64_t i = findSlot(key, hashKey(key));
+    if ( i < 0 )
+        return false;
+
+    markDirty();
+    indexSlots(_index)[i].time = (int64_t)time;
+    return true;
+}
+
+bool
+PackStore::clear()
+{
+    ScopedWriteLock lock( _mutex );
+    if ( !isOpen() )
+        return false;
+
+    markDirty();
+
+    std::vector<unsigned> ids;
+    for(unsigned i=0; i<_packs.size(); ++i)
+        ids.push_back( _packs[i]->_id );
+    closePacks();
+
+    bool ok = true;
+    for(unsigned i=0; i<ids.size(); ++i)
+        ok = ::remove( packPath(ids[i]).c_str() ) == 0 && ok;
+
+    return rebuildIndex() && ok;
+}
+
+bool
+PackStore::compact()
+{
+    ScopedWriteLock lock( _mutex );
+    if ( !isOpen() )
+        return false;
+
+    const IndexHeader* oldHeader = indexHeader(_index);
+    if ( oldHeader->deadBytes == 0u )
+        return true;
+
+    markDirty();
+
+    // copy live records in pack order, so the old packs are read sequentially.
+    std::vector<Slot> live;
+    live.reserve( (size_t)oldHeader->count );
+    const Slot* slots = indexSlots(_index);
+    for(uint64_t i=0; i<oldHeader->capacity; ++i)
+    {
+        if ( slots[i].hash > SLOT_DELETED )
+            live.push_back( slots[i] );
+    }
+    std::sort( live.begin(), live.end(), lessByLocation );
+
+    std::string tempPath = indexPath() + ".tmp";
+    PackFileHandle file;
+    PackMapping map;
+    if ( !createIndex(tempPath, capacityFor(live.size()), file, map) )
+        return false;
+
+    std::vector<Pack*> oldPacks;
+    oldPacks.swap( _packs );
+
+    // new packs are numbered after the old ones (getActivePack() takes ids
+    // from the live index), so if we die part way the rebuilt index still
+    // prefers the copies.
+    bool ok = true;
+    std::string buf;
+    for(unsigned i=0; i<live.size() && ok; ++i)
+    {
+        Slot slot = live[i];
+
+        Pack* source = 0L;
+        for(unsigned p=0; p<oldPacks.size() && !source; ++p)
+            if ( oldPacks[p]->_id == slot.pack ) source = oldPacks[p];
+
+        const char* bytes = 0L;
+        if ( source && slot.offset + slot.size <= source->_map.size() )
+        {
+            bytes = source->_map.data() + slot.offset;
+        }
+        else if ( source )
+        {
+            buf.resize( slot.size );
+            if ( source->_file.readAt(slot.offset, &buf[0], slot.size) )
+                bytes = buf.data();
+        }
+
+        if ( !bytes )
+        {
+            ok = false;
+            break;
+        }
+
+        Pack* target = getActivePack( slot.size );
+
+        ok = target && target->_file.append(bytes, slot.size, slot.offset);
+        if ( ok )
+        {
+            slot.pack = target->_id;
+            insertUnique( map, slot );
+        }
+    }
+
+    if ( ok )
+    {
+        for(unsigned i=0; i<_packs.size(); ++i)
+            remapTail( _packs[i], true );
+
+        indexHeader(map)->nextPackID = indexHeader(_index)->nextPackID;
+        ok = swapIndex(file, map, tempPath);
+    }
+
+    if ( ok )
+    {
+        for(unsigned i=0; i<oldPacks.size(); ++i)
+        {
+            std::string path = packPath(oldPacks[i]->_id);
+            delete oldPacks[i];
+            ::remove( path.c_str() );
+        }
+    }
+    else
+    {
+        // keep the old packs and index; drop the partial copies.
+        OE_WARN << LC << "Compaction failed at " << _path << std::endl;
+        map.unmap();
+        file.close();
+        ::remove( tempPath.c_str() );
+        for(unsigned i=0; i<_packs.size(); ++i)
+        {
+            std::string path = packPath(_packs[i]->_id);
+            delete _packs[i];
+            ::remove( path.c_str() );
+        }
+        _packs.swap( oldPacks );
+    }
+
+    return ok;
+}
+
+uint64_t
+PackStore::getStorageSize()
+{
+    ScopedReadLock lock( _mutex );
+    uint64_t size = _indexFile.size();
+    for(unsigned i=0; i<_packs.size(); ++i)
+        size += _packs[i]->_file.size();
+    return size;
+}
+
+uint64_t
+PackStore::getDeadBytes()
+{
+    ScopedReadLock lock( _mutex );
+    return isOpen() ? indexHeader(_index)->deadBytes : 0u;
+}
+
+unsigned
+PackStore::getNumRecords()
+{
+    ScopedReadLock lock( _mutex );
+    return isOpen() ? (unsigned)indexHeader(_index)->count : 0u;
+}
@@ -20,17 +20,13 @@
 #include <osgEarth/Locators>
 #include <osg/Point>
 #include <cstdlib> // for getenv
+#include <set>
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
 #define LC "[GeometryPool] "
 
-// TODO: experiment with sharing a single texture coordinate array 
-//// across all shared geometries.
-/// JB:  Disabled to fix issues with ATI.
-//#define SHARE_TEX_COORDS 1
-
 
 GeometryPool::GeometryPool(const RexTerrainEngineOptions& options) :
 _options ( options ),
@@ -75,7 +71,12 @@ GeometryPool::getPooledGeometry(const TileKey&               tileKey,
 
         if ( _debug )
         {
-            OE_NOTICE << LC << "Geometry pool size = " << _geometryMap.size() << "\n";
+            MemoryReport report;
+            getMemoryReportImpl( report );
+            OE_NOTICE << LC << "Geometry pool size = " << report.numGeometries
+                << ", arrays = " << report.numArrays << " (" << report.arrayBytes/1024 << " KB)"
+                << ", primitive sets = " << report.numPrimitiveSets << " (" << report.primitiveSetBytes/1024 << " KB)"
+                << "\n";
         }
     }
 }
@@ -97,6 +98,54 @@ GeometryPool::getNumSkirtElements() const
     return _options.heightFieldSkirtRatio().get() > 0.0 ? (_tileSize-1) * 4 * 6 : 0;
 }
 
+void
+GeometryPool::getMemoryReport(MemoryReport& out) const
+{
+    Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+    getMemoryReportImpl( out );
+}
+
+void
+GeometryPool::getMemoryReportImpl(MemoryReport& out) const
+{
+    out = MemoryReport();
+    out.numGeometries = _geometryMap.size();
+
+    std::set<const osg::Array*>        arrays;
+    std::set<const osg::PrimitiveSet*> primSets;
+
+    for(GeometryMap::const_iterator i = _geometryMap.begin(); i != _geometryMap.end(); ++i)
+    {
+        const osg::Geometry* geom = i->second.get();
+
+        std::vector<const osg::Array*> geomArrays;
+        geomArrays.push_back( geom->getVertexArray() );
+        geomArrays.push_back( geom->getNormalArray() );
+        for(unsigned t=0; t<geom->getNumTexCoordArrays(); ++t)
+            geomArrays.push_back( geom->getTexCoordArray(t) );
+
+        for(unsigned a=0; a<geomArrays.size(); ++a)
+        {
+            const osg::Array* array = geomArrays[a];
+            if ( array && arrays.insert(array).second )
+            {
+                out.arrayBytes += array->getTotalDataSize();
+                out.numArrays++;
+            }
+        }
+
+        for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+        {
+            const osg::PrimitiveSet* primSet = geom->getPrimitiveSet(p);
+            if ( primSet && primSets.insert(primSet).second )
+            {
+                out.primitiveSetBytes += primSet->getTotalDataSize();
+                out.numPrimitiveSets++;
+            }
+        }
+    }
+}
+
 namespace
 {
     int getMorphNeighborIndexOffset(unsigned col, unsigned row, int rowSize)
@@ -112,11 +161,11 @@ namespace
 { \
     verts->push_back( (*verts)[INDEX] ); \
     normals->push_back( (*normals)[INDEX] ); \
-    texCoords->push_back( (*texCoords)[INDEX] ); \
+    if ( populateTexCoords ) texCoords->push_back( (*texCoords)[INDEX] ); \
     if ( neighbors ) neighbors->push_back( (*neighbors)[INDEX] ); \
     verts->push_back( (*verts)[INDEX] - ((*normals)[INDEX])*(HEIGHT) ); \
     normals->push_back( (*normals)[INDEX] ); \
-    texCoords->push_back( (*texCoords)[INDEX] ); \
+    if ( populateTexCoords ) texCoords->push_back( (*texCoords)[INDEX] ); \
     if ( neighbors ) neighbors->push_back( (*neighbors)[INDEX] - ((*normals)[INDEX])*(HEIGHT) ); \
 }
 
@@ -133,6 +182,83 @@ namespace
     } \
 }
 
+osg::DrawElements*
+GeometryPool::createPrimitiveSet(bool            swapOrientation,
+                                 osg::Vec3Array* texCoords,
+                                 unsigned        skirtIndex,
+                                 unsigned        numVerts,
+                                 MaskGenerator*  maskSet) const
+{
+    unsigned numIndiciesInSurface = (_tileSize-1) * (_tileSize-1) * 6;
+    unsigned numIncidesInSkirt    = getNumSkirtElements();
+    
+    GLenum mode = (_options.gpuTessellation() == true) ? GL_PATCHES : GL_TRIANGLES;
+
+    // Pre-allocate enough space for all triangles.
+    osg::DrawElements* primSet = new osg::DrawElementsUShort(mode);
+
+    primSet->reserveElements(numIndiciesInSurface + numIncidesInSkirt);
+
+    for(unsigned j=0; j<_tileSize-1; ++j)
+    {
+        for(unsigned i=0; i<_tileSize-1; ++i)
+        {
+            int i00;
+            int i01;
+            if (swapOrientation)
+            {
+                i01 = j*_tileSize + i;
+                i00 = i01+_tileSize;
+            }
+            else
+            {
+                i00 = j*_tileSize + i;
+                i01 = i00+_tileSize;
+            }
+
+            int i10 = i00+1;
+            int i11 = i01+1;
+
+            // skip any triangles that have a discarded vertex:
+            bool discard = maskSet && (
+                maskSet->isMasked( (*texCoords)[i00] ) ||
+                maskSet->isMasked( (*texCoords)[i11] )
+            );
+
+            if ( !discard )
+            {
+                discard = maskSet && maskSet->isMasked( (*texCoords)[i01] );
+                if ( !discard )
+                {
+                    primSet->addElement(i01);
+                    primSet->addElement(i00);
+                    primSet->addElement(i11);
+                }
+            
+                discard = maskSet && maskSet->isMasked( (*texCoords)[i10] );
+                if ( !discard )
+                {
+                    primSet->addElement(i00);
+                    primSet->addElement(i10);
+                    primSet->addElement(i11);
+                }
+            }
+        }
+    }
+
+    if ( numIncidesInSkirt > 0 )
+    {
+        // skirt verts come in (top, extruded) pairs running around the tile.
+        int i;
+        for(i=skirtIndex; i<(int)numVerts-2; i+=2)
+            addSkirtTriangles( i, i+2 );
+
+        addSkirtTriangles( i, (int)skirtIndex );
+    }
+
+    return primSet;
+}
+
 osg::Geometry*
 GeometryPool::createGeometry(const TileKey& tileKey,
                              const MapInfo& mapInfo,
@@ -152,17 +278,11 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     bool createSkirt = _options.heightFieldSkirtRatio() > 0.0f;
 
     unsigned numVertsInSurface    = (_tileSize*_tileSize);
-    unsigned numVertsInSkirt      = createSkirt ? _tileSize*4u - 4u : 0;
+    unsigned numVertsInSkirt      = createSkirt ? (_tileSize*4u - 2u) * 2u : 0;
     unsigned numVerts             = numVertsInSurface + numVertsInSkirt;    
-    unsigned numIndiciesInSurface = (_tileSize-1) * (_tileSize-1) * 6;
-    unsigned numIncidesInSkirt    = getNumSkirtElements();
-    
-    GLenum mode = (_options.gpuTessellation() == true) ? GL_PATCHES : GL_TRIANGLES;
-
-    // Pre-allocate enough space for all triangles.
-    osg::DrawElements* primSet = new osg::DrawElementsUShort(mode);
 
-    primSet->reserveElements(numIndiciesInSurface + numIncidesInSkirt);
+    // Unmasked geometries all share the same topology (and tile coordinates).
+    bool masking = maskSet && maskSet->hasMasks();
 
     osg::BoundingSphere tileBound;
 
@@ -171,8 +291,6 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     geom->setUseVertexBufferObjects(true);
     geom->setUseDisplayList(false);
 
-    geom->addPrimitiveSet( primSet );
-
     // the vertex locations:
     osg::Vec3Array* verts = new osg::Vec3Array();
     verts->reserve( numVerts );
@@ -194,21 +312,29 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     }
 
     // tex coord is [0..1] across the tile. The 3rd dimension tracks whether the
-    // vert is masked: 0=yes, 1=no
-#ifdef SHARE_TEX_COORDS
-    bool populateTexCoords = false;
-    if ( !_sharedTexCoords.valid() )
-    {
-        _sharedTexCoords = new osg::Vec3Array();
-        _sharedTexCoords->reserve( numVerts );
-        populateTexCoords = true;
-    }    
-    osg::Vec3Array* texCoords = _sharedTexCoords.get();
-#else
+    // vert is masked: 0=yes, 1=no. With compact geometry, every unmasked
+    // geometry shares a single array.
     bool populateTexCoords = true;
-    osg::Vec3Array* texCoords = new osg::Vec3Array();
-    texCoords->reserve( numVerts );
-#endif
+    osg::Vec3Array* texCoords = 0L;
+
+    if ( !masking && _options.compactGeometry() == true )
+    {
+        if ( !_sharedTexCoords.valid() )
+        {
+            _sharedTexCoords = new osg::Vec3Array();
+            _sharedTexCoords->reserve( numVerts );
+        }
+        else
+        {
+            populateTexCoords = false;
+        }
+        texCoords = _sharedTexCoords.get();
+    }
+    else
+    {
+        texCoords = new osg::Vec3Array();
+        texCoords->reserve( numVerts );
+    }
 
     geom->setTexCoordArray( 0, texCoords );
     
@@ -254,67 +380,15 @@ GeometryPool::createGeometry(const TileKey& tileKey,
         }
     }
 
-    // Now tessellate the surface.
-    
-    // TODO: do we really need this??
-    bool swapOrientation = !locator->orientationOpenGL();
-
-    for(unsigned j=0; j<_tileSize-1; ++j)
-    {
-        for(unsigned i=0; i<_tileSize-1; ++i)
-        {
-            int i00;
-            int i01;
-            if (swapOrientation)
-            {
-                i01 = j*_tileSize + i;
-                i00 = i01+_tileSize;
-            }
-            else
-            {
-                i00 = j*_tileSize + i;
-                i01 = i00+_tileSize;
-            }
-
-            int i10 = i00+1;
-            int i11 = i01+1;
-
-            // skip any triangles that have a discarded vertex:
-            bool discard = maskSet && (
-                maskSet->isMasked( (*texCoords)[i00] ) ||
-                maskSet->isMasked( (*texCoords)[i11] )
-            );
-
-            if ( !discard )
-            {
-                discard = maskSet && maskSet->isMasked( (*texCoords)[i01] );
-                if ( !discard )
-                {
-                    primSet->addElement(i01);
-                    primSet->addElement(i00);
-                    primSet->addElement(i11);
-                }
-            
-                discard = maskSet && maskSet->isMasked( (*texCoords)[i10] );
-                if ( !discard )
-                {
-                    primSet->addElement(i00);
-                    primSet->addElement(i10);
-                    primSet->addElement(i11);
-                }
-            }
-        }
-    }
+    unsigned skirtIndex = verts->size();
 
     if ( createSkirt )
     {
         // SKIRTS:
         // calculate the skirt extrusion height
         double height = tileBound.radius() * _options.heightFieldSkirtRatio().get();
-        
-        unsigned skirtIndex = verts->size();
 
-        // first, create all the skirt verts, normals, and texcoords.
+        // create all the skirt verts, normals, and texcoords.
         for(int c=0; c<(int)_tileSize-1; ++c)
             addSkirtDataForIndex( c, height ); //top
 
@@ -326,14 +400,28 @@ GeometryPool::createGeometry(const TileKey& tileKey,
 
         for(int r=_tileSize-1; r>=0; --r)
             addSkirtDataForIndex( r*_tileSize, height ); //left
+    }
+
+    // Now tessellate the surface and skirt.
     
-        // then create the elements indices:
-        int i;
-        for(i=skirtIndex; i<(int)verts->size()-2; i+=2)
-            addSkirtTriangles( i, i+2 );
+    // TODO: do we really need this??
+    bool swapOrientation = !locator->orientationOpenGL();
 
-        addSkirtTriangles( i, skirtIndex );
+    osg::ref_ptr<osg::DrawElements> primSet;
+    if ( masking )
+    {
+        primSet = createPrimitiveSet( swapOrientation, texCoords, skirtIndex, verts->size(), maskSet );
     }
+    else
+    {
+        // the index buffer doesn't depend on the tile, so share it.
+        osg::ref_ptr<osg::DrawElements>& shared = _sharedPrimSets[swapOrientation];
+        if ( !shared.valid() )
+            shared = createPrimitiveSet( swapOrientation, texCoords, skirtIndex, verts->size(), 0L );
+        primSet = shared.get();
+    }
+
+    geom->addPrimitiveSet( primSet.get() );
 
     // create mask geometry
     if (maskSet)
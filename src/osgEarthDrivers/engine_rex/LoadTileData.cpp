@@ -21,6 +21,7 @@
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/Terrain>
 #include <osgEarth/Registry>
+#include <osgEarth/ImageUtils>
 #include <osg/NodeVisitor>
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
@@ -77,6 +78,50 @@ namespace
         const optional<bool>& unRefPolicy = Registry::instance()->unRefImageDataAfterApply();
         tex->setUnRefImageDataAfterApply( unRefPolicy.get() );
     }
+
+    bool usesMipmaps(const osg::Texture* tex)
+    {
+        osg::Texture::FilterMode mode = tex->getFilter(osg::Texture::MIN_FILTER);
+        return
+            mode == osg::Texture::LINEAR_MIPMAP_LINEAR  ||
+            mode == osg::Texture::LINEAR_MIPMAP_NEAREST ||
+            mode == osg::Texture::NEAREST_MIPMAP_LINEAR ||
+            mode == osg::Texture::NEAREST_MIPMAP_NEAREST;
+    }
+
+    // Replaces each image that would otherwise need mipmaps generated
+    // at upload time with one that carries a prebuilt mipmap chain.
+    void buildMipmaps(osg::Texture* tex)
+    {
+        if ( !usesMipmaps(tex) )
+            return;
+
+        for(unsigned i=0; i<tex->getNumImages(); ++i)
+        {
+            osg::Image* image = tex->getImage(i);
+            if ( image && !image->isMipmap() )
+            {
+                osg::Image* mipmapped = ImageUtils::buildMipmaps(image);
+                if ( mipmapped )
+                {
+                    tex->setImage(i, mipmapped);
+                }
+            }
+        }
+    }
+}
+
+void
+LoadTileData::prepareTexture(osg::Texture* texture)
+{
+    applyDefaultUnRefPolicy( texture );
+
+    if ( _context->getOptions().buildMipmapsOnLoad() == true )
+    {
+        buildMipmaps( texture );
+    }
+
+    addToUploadSet( texture );
 }
 
 
@@ -84,6 +129,9 @@ namespace
 void
 LoadTileData::invoke()
 {
+    // discard anything left over from an earlier, abandoned run.
+    getUploadSet().clear();
+
     osg::ref_ptr<TileNode> tilenode;
     if ( _tilenode.lock(tilenode) )
     {
@@ -116,7 +164,7 @@ LoadTileData::invoke()
                         TerrainTileImageLayerModel* layerModel = i->get();
                         if ( layerModel && layerModel->getTexture() )
                         {
-                            applyDefaultUnRefPolicy( layerModel->getTexture() );
+                            prepareTexture( layerModel->getTexture() );
                             mptex->setLayer( layerModel->getImageLayer(), layerModel->getTexture(), layerModel->getOrder() );
                         }
                     }
@@ -136,7 +184,7 @@ LoadTileData::invoke()
                 const SamplerBinding* binding = SamplerBinding::findUsage(bindings, SamplerBinding::ELEVATION);
                 if ( binding )
                 {                
-                    applyDefaultUnRefPolicy( _model->elevationModel()->getTexture() );
+                    prepareTexture( _model->elevationModel()->getTexture() );
 
                     stateSet->setTextureAttribute(
                         binding->unit(),
@@ -157,7 +205,7 @@ LoadTileData::invoke()
                 if ( binding )
                 {
                     //TODO: if we subload the normal texture later on, we will need to change unref to false.
-                    applyDefaultUnRefPolicy( _model->normalModel()->getTexture() );
+                    prepareTexture( _model->normalModel()->getTexture() );
 
                     stateSet->setTextureAttribute(
                         binding->unit(),
@@ -183,7 +231,7 @@ LoadTileData::invoke()
                     const SamplerBinding* binding = SamplerBinding::findUID(bindings, layerModel->getImageLayer()->getUID());
                     if ( binding )
                     {
-                        applyDefaultUnRefPolicy( layerModel->getTexture() );
+                        prepareTexture( layerModel->getTexture() );
 
                         stateSet->setTextureAttribute(
                             binding->unit(),
@@ -24,11 +24,16 @@
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
 #include <osgDB/ReaderWriter>
+#include <osgDB/DatabasePager>
 
 #include <string>
 
 #define REPORT_ACTIVITY true
 
+// update traversals to wait for a request's GL objects to compile before
+// merging it anyway (they then compile on first draw).
+#define MAX_COMPILE_FRAMES 30
+
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
 
@@ -59,6 +64,24 @@ Loader::Request::addToChangeSet(osg::Node* node)
     }
 }
 
+void
+Loader::Request::addToUploadSet(osg::Texture* texture)
+{
+    if ( texture )
+    {
+        _uploadSet._textures.push_back( texture );
+    }
+}
+
+void
+Loader::Request::addToUploadSet(osg::Drawable* drawable)
+{
+    if ( drawable )
+    {
+        _uploadSet._drawables.push_back( drawable );
+    }
+}
+
 //...............................................
 
 #undef  LC
@@ -81,6 +104,9 @@ SimpleLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& n
         
         //OE_INFO << LC << "Request apply : UID = " << request->getUID() << "\n";
         request->apply( nv.getFrameStamp() );
+
+        // GL objects compile on first draw.
+        request->getUploadSet().clear();
     }
     return request != 0L;
 }
@@ -173,7 +199,11 @@ namespace
 PagerLoader::PagerLoader(TerrainEngine* engine) :
 _engineUID     ( engine->getUID() ),
 _checkpoint    ( (osg::Timer_t)0 ),
-_mergesPerFrame( 0 )
+_mergesPerFrame( 0 ),
+_mergeBudgetMS ( 0.0 ),
+_lastMergeMS   ( 0.0 ),
+_lastMergeCount( 0u ),
+_icoChecked    ( false )
 {
     _myNodePath.push_back( this );
 
@@ -188,6 +218,13 @@ PagerLoader::setMergesPerFrame(int value)
     this->setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
+void
+PagerLoader::setMergeTimeBudget(double milliseconds)
+{
+    _mergeBudgetMS = std::max(milliseconds, 0.0);
+    this->setNumChildrenRequiringUpdateTraversal( 1 );
+}
+
 bool
 PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
 {
@@ -249,6 +286,15 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
         {
             Threading::ScopedMutexLock lock( _requestsMutex );
             _requests[request->getUID()] = request;
+
+            // find the pager's compile operation (if any) for the default upload sink.
+            if ( !_icoChecked )
+            {
+                _icoChecked = true;
+                osgDB::DatabasePager* pager = dynamic_cast<osgDB::DatabasePager*>( nv.getDatabaseRequestHandler() );
+                if ( pager )
+                    _ico = pager->getIncrementalCompileOperation();
+            }
         }
 
         return true;
@@ -266,7 +312,8 @@ PagerLoader::clear()
 void
 PagerLoader::traverse(osg::NodeVisitor& nv)
 {
-    // only called when _mergesPerFrame > 0
+    // only called when merging is limited (see isMergeLimited) or while
+    // requests wait on the compiler
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
     {
         if ( nv.getFrameStamp() )
@@ -274,23 +321,45 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             setFrameStamp(nv.getFrameStamp());
         }
 
-        int count;
-        for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
+        // Merge requests in priority order until we hit the request limit or
+        // use up the time budget. Always merge at least one so we make progress.
+        // Requests whose GL objects are done compiling go first.
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        unsigned merged = 0u;
+        int count = mergeCompiled( start, merged );
+
+        for( ; !_mergeQueue.empty(); ++count)
         {
+            if ( !hasMergeBudget(count, merged, start) )
+                break;
+
             Request* req = _mergeQueue.begin()->get();
             if ( req && req->_lastTick >= _checkpoint )
             {
-                OE_START_TIMER(req_apply);
-                req->apply( getFrameStamp() );
-                double s = OE_STOP_TIMER(req_apply);
-
-                req->setState(Request::FINISHED);
+                // a request that's waiting on the compiler stays in the MERGING state.
+                if ( merge( req ) )
+                    req->setState(Request::FINISHED);
+                ++merged;
+            }
+            else if ( req )
+            {
+                req->getUploadSet().clear();
             }
 
             _mergeQueue.erase( _mergeQueue.begin() );
         }
 
+        _lastMergeMS    = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+        _lastMergeCount = merged;
+
+        // an unlimited loader only needs the update traversal while compiling.
+        if ( !isMergeLimited() && _compiling.empty() )
+        {
+            setNumChildrenRequiringUpdateTraversal( 0 );
+        }
+
         // cull finished requests.
+        if ( isMergeLimited() )
         {
             Threading::ScopedMutexLock lock( _requestsMutex );
 
@@ -346,22 +415,26 @@ PagerLoader::addChild(osg::Node* node)
         {
             if ( req->_lastTick >= _checkpoint )
             {
-                if ( _mergesPerFrame > 0 )
+                if ( isMergeLimited() )
                 {
                     _mergeQueue.insert( req );
                     req->setState( Request::MERGING );
                 }
-                else
+                else if ( merge( req ) )
                 {
-                    req->apply( getFrameStamp() );
                     req->setState( Request::FINISHED );
                     if ( REPORT_ACTIVITY )
                         Registry::instance()->endActivity( req->getName() );
                 }
+                else
+                {
+                    req->setState( Request::MERGING );
+                }
             }                
 
             else
             {
+                req->getUploadSet().clear();
                 req->setState( Request::FINISHED );
                 if ( REPORT_ACTIVITY )
                     Registry::instance()->endActivity( req->getName() );
@@ -376,6 +449,194 @@ PagerLoader::addChild(osg::Node* node)
     return true;
 }
 
+bool
+PagerLoader::merge(Loader::Request* req)
+{
+    Request::UploadSet& objects = req->getUploadSet();
+    if ( !objects.empty() )
+    {
+        if ( _uploadSink.valid() )
+        {
+            _uploadSink->upload( req, objects );
+            objects.clear();
+        }
+        else if ( compile( req ) )
+        {
+            // mergeCompiled() takes it from here.
+            objects.clear();
+            return false;
+        }
+        else
+        {
+            // GL objects compile on first draw.
+            objects.clear();
+        }
+    }
+
+    req->apply( getFrameStamp() );
+    return true;
+}
+
+namespace
+{
+    // Tells the loader that a request's GL objects are compiled. The
+    // incremental compile operation calls this from the graphics thread, so
+    // all it does is flag the request; the loader merges it in the update
+    // traversal.
+    struct NotifyWhenCompiled : public osgUtil::IncrementalCompileOperation::CompileCompletedCallback
+    {
+        NotifyWhenCompiled(PagerLoader* loader, UID requestUID)
+            : _loader(loader), _requestUID(requestUID) { }
+
+        bool compileCompleted(osgUtil::IncrementalCompileOperation::CompileSet*)
+        {
+            osg::ref_ptr<PagerLoader> loader;
+            if ( _loader.lock(loader) )
+                loader->notifyCompiled( _requestUID );
+
+            // there's no subgraph for the ICO to merge.
+            return true;
+        }
+
+        osg::observer_ptr<PagerLoader> _loader;
+        UID                            _requestUID;
+    };
+}
+
+bool
+PagerLoader::compile(Loader::Request* req)
+{
+    // load() sets the compile operation from the cull thread.
+    osg::ref_ptr<osgUtil::IncrementalCompileOperation> ico;
+    {
+        Threading::ScopedMutexLock lock( _requestsMutex );
+        _ico.lock(ico);
+    }
+
+    // Without a compile operation, GL objects compile lazily on first draw.
+    if ( !ico.valid() || !ico->isActive() )
+        return false;
+
+    typedef osgUtil::IncrementalCompileOperation ICO;
+
+    const Request::UploadSet& objects = req->getUploadSet();
+
+    osg::ref_ptr<ICO::CompileSet> compileSet = new ICO::CompileSet();
+
+    const ICO::ContextSet& contexts = ico->getContextSet();
+    for(ICO::ContextSet::const_iterator c = contexts.begin(); c != contexts.end(); ++c)
+    {
+        ICO::CompileList& list = compileSet->_compileMap[*c];
+
+        for(unsigned i=0; i<objects._textures.size(); ++i)
+            list.add( objects._textures[i].get() );
+
+        for(unsigned i=0; i<objects._drawables.size(); ++i)
+            list.add( objects._drawables[i].get() );
+    }
+
+    if ( compileSet->_compileMap.empty() )
+        return false;
+
+    Compiling compiling;
+    compiling._req      = req;
+    compiling._frames   = 0u;
+    compiling._compiled = false;
+    _compiling.push_back( compiling );
+
+    // the update traversal merges the request once it's compiled.
+    if ( getNumChildrenRequiringUpdateTraversal() == 0 )
+        setNumChildrenRequiringUpdateTraversal( 1 );
+
+    compileSet->_compileCompletedCallback = new NotifyWhenCompiled( this, req->getUID() );
+    ico->add( compileSet.get(), false );
+    return true;
+}
+
+void
+PagerLoader::notifyCompiled(UID requestUID)
+{
+    Threading::ScopedMutexLock lock( _compiledMutex );
+    _compiled.insert( requestUID );
+}
+
+bool
+PagerLoader::hasMergeBudget(int count, unsigned merged, osg::Timer_t start) const
+{
+    if ( _mergesPerFrame > 0 && count >= _mergesPerFrame )
+        return false;
+
+    if ( _mergeBudgetMS > 0.0 && merged > 0u &&
+         osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) >= _mergeBudgetMS )
+        return false;
+
+    return true;
+}
+
+int
+PagerLoader::mergeCompiled(osg::Timer_t start, unsigned& merged)
+{
+    if ( _compiling.empty() )
+        return 0;
+
+    std::set<UID> compiled;
+    {
+        Threading::ScopedMutexLock lock( _compiledMutex );
+        compiled.swap( _compiled );
+    }
+
+    // if the compile operation went away, nothing else is going to compile.
+    bool icoActive = false;
+    {
+        Threading::ScopedMutexLock lock( _requestsMutex );
+        osg::ref_ptr<osgUtil::IncrementalCompileOperation> ico;
+        icoActive = _ico.lock(ico) && ico->isActive();
+    }
+
+    for(CompilingList::iterator i = _compiling.begin(); i != _compiling.end(); ++i)
+    {
+        if ( compiled.find(i->_req->getUID()) != compiled.end() )
+            i->_compiled = true;
+        ++i->_frames;
+    }
+
+    int count = 0;
+    for(CompilingList::iterator i = _compiling.begin(); i != _compiling.end(); )
+    {
+        // give up waiting on a compile that's taking too long (or was dropped)
+        // and let the objects compile on first draw.
+        bool ready = i->_compiled || !icoActive || i->_frames > MAX_COMPILE_FRAMES;
+        if ( !ready )
+        {
+            ++i;
+            continue;
+        }
+
+        if ( !hasMergeBudget(count, merged, start) )
+            break;
+
+        Request* req = i->_req.get();
+
+        // skip requests that were canceled while they compiled.
+        if ( req->_lastTick >= _checkpoint )
+        {
+            req->apply( getFrameStamp() );
+            ++merged;
+        }
+
+        req->setState( Request::FINISHED );
+
+        // a merge-limited loader reports this when it purges the request.
+        if ( !isMergeLimited() && REPORT_ACTIVITY )
+            Registry::instance()->endActivity( req->getName() );
+
+        _compiling.erase( i++ );
+        ++count;
+    }
+
+    return count;
+}
+
 TileKey
 PagerLoader::getTileKeyForRequest(UID requestUID) const
 {
@@ -267,6 +267,7 @@ RexTerrainEngineNode::postInitialize( const Map* map, const TerrainOptions& opti
     // Make a tile loader
     PagerLoader* loader = new PagerLoader( this );
     loader->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+    loader->setMergeTimeBudget( _terrainOptions.mergeTimeBudget().get() );
     _loader = loader;
     this->addChild( _loader.get() );
 
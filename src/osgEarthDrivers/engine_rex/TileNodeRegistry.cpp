@@ -27,6 +27,59 @@ using namespace osgEarth;
 //#define OE_TEST OE_INFO
 
 
+//----------------------------------------------------------------------------
+
+namespace
+{
+    // Stamps the map revision on each tile (see setMapRevision)
+    struct SetRevision
+    {
+        SetRevision(const Revision& rev, bool setToDirty) : _rev(rev), _setToDirty(setToDirty) { }
+        const Revision& _rev;
+        bool            _setToDirty;
+
+        void operator()(const TileKey& key, osg::ref_ptr<TileNode>& tile)
+        {
+            tile->setMapRevision( _rev );
+            if ( _setToDirty )
+            {
+                tile->setDirty( true );
+            }
+        }
+    };
+
+    // Dirties each tile intersecting an extent (see setDirty)
+    struct SetDirty
+    {
+        SetDirty(const GeoExtent& extent, unsigned minLevel, unsigned maxLevel) :
+            _extent(extent), _minLevel(minLevel), _maxLevel(maxLevel) { }
+        const GeoExtent& _extent;
+        unsigned         _minLevel, _maxLevel;
+
+        void operator()(const TileKey& key, osg::ref_ptr<TileNode>& tile)
+        {
+            bool checkSRS = false;
+            if (_minLevel <= key.getLOD() && 
+                _maxLevel >= key.getLOD() &&
+                _extent.intersects(key.getExtent(), checkSRS) )
+            {
+                tile->setDirty( true );
+            }
+        }
+    };
+
+    // Empties the tile set into a local map (see moveAll)
+    struct TakeAll : public TileNodeRegistry::Operation
+    {
+        TileNodeRegistry::TileNodeMap _tiles;
+
+        void operator()(TileNodeRegistry::TileNodeMap& tiles)
+        {
+            _tiles.swap( tiles );
+        }
+    };
+}
+
 //----------------------------------------------------------------------------
 
 TileNodeRegistry::TileNodeRegistry(const std::string& name) :
@@ -53,20 +106,14 @@ TileNodeRegistry::setMapRevision(const Revision& rev,
     {
         if ( _maprev != rev || setToDirty )
         {
-            Threading::ScopedWriteLock exclusive( _tilesMutex );
+            Threading::ScopedWriteLock exclusive( _revisionMutex );
 
             if ( _maprev != rev || setToDirty )
             {
                 _maprev = rev;
 
-                for( TileNodeMap::iterator i = _tiles.begin(); i != _tiles.end(); ++i )
-                {
-                    i->second->setMapRevision( _maprev );
-                    if ( setToDirty )
-                    {
-                        i->second->setDirty( true );
-                    }
-                }
+                SetRevision op( _maprev, setToDirty );
+                _tiles.forEach( op );
             }
         }
     }
@@ -80,29 +127,26 @@ TileNodeRegistry::setDirty(const GeoExtent& extent,
                            unsigned         minLevel,
                            unsigned         maxLevel)
 {
-    Threading::ScopedWriteLock exclusive( _tilesMutex );
-    
-    bool checkSRS = false;
-    for( TileNodeMap::iterator i = _tiles.begin(); i != _tiles.end(); ++i )
-    {
-        const TileKey& key = i->first;
-        if (minLevel <= key.getLOD() && 
-            maxLevel >= key.getLOD() &&
-            extent.intersects(i->first.getExtent(), checkSRS) )
-        {
-            i->second->setDirty( true );
-        }
-    }
+    SetDirty op( extent, minLevel, maxLevel );
+    _tiles.forEach( op );
 }
 
 void
 TileNodeRegistry::addSafely(TileNode* tile)
 {
-    _tiles[ tile->getTileKey() ] = tile;
-    if ( _revisioningEnabled )
-        tile->setMapRevision( _maprev );
+    {
+        // shared, so a concurrent setMapRevision can't miss this tile.
+        Threading::ScopedReadLock shared( _revisionMutex );
+
+        if ( _revisioningEnabled )
+            tile->setMapRevision( _maprev );
+
+        _tiles.insert( tile->getTileKey(), tile );
+    }
 
     // check for tiles that are waiting on this tile, and notify them!
+    Threading::ScopedMutexLock lock( _notifiersMutex );
+
     TileKeyOneToMany::iterator notifier = _notifiers.find( tile->getTileKey() );
     if ( notifier != _notifiers.end() )
     {
@@ -110,10 +154,10 @@ TileNodeRegistry::addSafely(TileNode* tile)
 
         for(TileKeySet::iterator listener = listeners.begin(); listener != listeners.end(); ++listener)
         {
-            TileNodeMap::iterator listenerTile = _tiles.find( *listener );
-            if ( listenerTile != _tiles.end() )
+            osg::ref_ptr<TileNode> listenerTile;
+            if ( _tiles.get( *listener, listenerTile ) )
             {
-                listenerTile->second->notifyOfArrival( tile );
+                listenerTile->notifyOfArrival( tile );
             }
         }
         _notifiers.erase( notifier );
@@ -129,6 +173,13 @@ void
 TileNodeRegistry::removeSafely(const TileKey& key)
 {
     _tiles.erase( key );
+    dropListener( key );
+}
+
+void
+TileNodeRegistry::dropListener(const TileKey& key)
+{
+    Threading::ScopedMutexLock lock( _notifiersMutex );
 
     for(TileKeyOneToMany::iterator i = _notifiers.begin(); i != _notifiers.end(); )
     {
@@ -146,7 +197,6 @@ TileNodeRegistry::add( TileNode* tile )
 {
     if ( tile )
     {
-        Threading::ScopedWriteLock exclusive( _tilesMutex );
         addSafely( tile );
     }
 }
@@ -156,7 +206,6 @@ TileNodeRegistry::add( const TileNodeVector& tiles )
 {
     if ( tiles.size() > 0 )
     {
-        Threading::ScopedWriteLock exclusive( _tilesMutex );
         for( TileNodeVector::const_iterator i = tiles.begin(); i != tiles.end(); ++i )
         {
             if ( i->valid() )
@@ -171,7 +220,6 @@ TileNodeRegistry::remove( TileNode* tile )
 {
     if ( tile )
     {
-        Threading::ScopedWriteLock exclusive( _tilesMutex );
         removeSafely( tile->getTileKey() );
     }
 }
@@ -179,7 +227,6 @@ TileNodeRegistry::remove( TileNode* tile )
 void
 TileNodeRegistry::clear()
 {
-    Threading::ScopedWriteLock exclusive( _tilesMutex );
     _tiles.clear();
 }
 
@@ -199,46 +246,33 @@ TileNodeRegistry::move(TileNode* tile, TileNodeRegistry* destination)
 void
 TileNodeRegistry::moveAll(TileNodeRegistry* destination)
 {
-    Threading::ScopedWriteLock exclusive( _tilesMutex );
+    TakeAll op;
+    _tiles.run( op );
 
     if ( destination )
     {
-        for( TileNodeMap::iterator i = _tiles.begin(); i != _tiles.end(); ++i )
+        for( TileNodeMap::iterator i = op._tiles.begin(); i != op._tiles.end(); ++i )
         {
             if ( i->second.valid() )
                 destination->add( i->second.get() );
         }
     }
-
-    _tiles.clear();
 }
     
 
 bool
 TileNodeRegistry::get( const TileKey& key, osg::ref_ptr<TileNode>& out_tile )
 {
-    Threading::ScopedReadLock shared( _tilesMutex );
-
-    TileNodeMap::iterator i = _tiles.find(key);
-    if ( i != _tiles.end() )
-    {
-        out_tile = i->second.get();
-        return true;
-    }
-    return false;
+    return _tiles.get( key, out_tile );
 }
 
 
 bool
 TileNodeRegistry::take( const TileKey& key, osg::ref_ptr<TileNode>& out_tile )
 {
-    Threading::ScopedWriteLock exclusive( _tilesMutex );
-
-    TileNodeMap::iterator i = _tiles.find(key);
-    if ( i != _tiles.end() )
+    if ( _tiles.take( key, out_tile ) )
     {
-        out_tile = i->second.get();
-        removeSafely( key );
+        dropListener( key );
         return true;
     }
     return false;
@@ -248,9 +282,8 @@ TileNodeRegistry::take( const TileKey& key, osg::ref_ptr<TileNode>& out_tile )
 void
 TileNodeRegistry::run( TileNodeRegistry::Operation& op )
 {
-    Threading::ScopedWriteLock lock( _tilesMutex );
     unsigned size = _tiles.size();
-    op.operator()( _tiles );
+    _tiles.run( op );
     if ( size != _tiles.size() )
         OE_TEST << LC << _name << ": tiles=" << _tiles.size() << std::endl;
 }
@@ -259,8 +292,7 @@ TileNodeRegistry::run( TileNodeRegistry::Operation& op )
 void
 TileNodeRegistry::run( const TileNodeRegistry::ConstOperation& op ) const
 {
-    Threading::ScopedReadLock lock( _tilesMutex );
-    op.operator()( _tiles );
+    _tiles.run( op );
     OE_TEST << LC << _name << ": tiles=" << _tiles.size() << std::endl;
 }
 
@@ -268,21 +300,23 @@ TileNodeRegistry::run( const TileNodeRegistry::ConstOperation& op ) const
 bool
 TileNodeRegistry::empty() const
 {
-    // don't bother mutex-protecteding this.
     return _tiles.empty();
 }
 
 void
 TileNodeRegistry::listenFor(const TileKey& tileToWaitFor, TileNode* waiter)
 {
-    Threading::ScopedWriteLock lock( _tilesMutex );
-    TileNodeMap::iterator i = _tiles.find( tileToWaitFor );
-    if ( i != _tiles.end() )
+    // hold the notifier lock across the lookup so an arrival can't slip
+    // in between the check and the listen request.
+    Threading::ScopedMutexLock lock( _notifiersMutex );
+
+    osg::ref_ptr<TileNode> tile;
+    if ( _tiles.get( tileToWaitFor, tile ) )
     {
         OE_DEBUG << LC << waiter->getTileKey().str() << " listened for " << tileToWaitFor.str()
             << ", but it was already in the repo.\n";
 
-        waiter->notifyOfArrival( i->second.get() );
+        waiter->notifyOfArrival( tile.get() );
     }
     else
     {
@@ -295,8 +329,11 @@ TileNodeRegistry::listenFor(const TileKey& tileToWaitFor, TileNode* waiter)
 TileNode*
 TileNodeRegistry::takeAny()
 {
-    Threading::ScopedWriteLock exclusive( _tilesMutex );
-    osg::ref_ptr<TileNode> tile = _tiles.begin()->second.get();
-    removeSafely( tile->getTileKey() );
+    TileKey key;
+    osg::ref_ptr<TileNode> tile;
+    if ( !_tiles.takeAny( key, tile ) )
+        return 0L;
+
+    dropListener( key );
     return tile.release();
 }
@@ -21,36 +21,158 @@
 #include <osgDB/Registry>
 #include <osg/Notify>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
 #include <stdlib.h>
 #include "libdxt.h"
 #include <string.h>
+#include <vector>
 
-class FastDXTProcessor : public osgDB::ImageProcessor
+namespace
 {
-public:
-    virtual void compress(osg::Image& image, osg::Texture::InternalFormatMode compressedFormat, bool generateMipMap, bool resizeToPowerOfTwo, CompressionMethod method, CompressionQuality quality)
+    // 16-byte aligned scratch memory; the SSE2 block loads require it.
+    struct AlignedBuffer
     {
-        //Resize the image to the nearest power of two
-        if (!osgEarth::ImageUtils::isPowerOfTwo( &image ))
+        AlignedBuffer() : _raw(0L), _data(0L) { }
+        ~AlignedBuffer() { delete [] _raw; }
+
+        unsigned char* allocate(unsigned bytes)
         {
-            unsigned int s = osg::Image::computeNearestPowerOfTwo( image.s() );
-            unsigned int t = osg::Image::computeNearestPowerOfTwo( image.t() );
-            image.scaleImage(s, t, image.r());
+            delete [] _raw;
+            _raw = new unsigned char[bytes + 15];
+            _data = (unsigned char*)(((size_t)_raw + 15) & ~(size_t)15);
+            return _data;
         }
 
-        osg::Image* sourceImage = &image;
+        unsigned char* _raw;
+        unsigned char* _data;
+    };
 
-        //FastDXT only works on RGBA imagery so we must convert it
-        osg::ref_ptr< osg::Image > rgba;
-        if (image.getPixelFormat() != GL_RGBA)
+    // One RGBA8 level of the (uncompressed) mip chain.
+    struct Level
+    {
+        const unsigned char* _data;
+        int                  _width, _height;
+    };
+
+    // A band of 4-pixel rows to encode. Bands are independent: every DXT
+    // block only reads its own 4x4 pixels and writes a fixed-size slot.
+    struct Job
+    {
+        const unsigned char* _in;
+        unsigned char*       _out;
+        int                  _width, _height;
+    };
+
+    // Pulls jobs off a shared list until it's empty.
+    struct Encoder
+    {
+        const std::vector<Job>* _jobs;
+        OpenThreads::Atomic*    _next;
+        int                     _format;
+
+        void execute()
         {
-            osg::Timer_t start = osg::Timer::instance()->tick();
-            rgba = osgEarth::ImageUtils::convertToRGBA8( &image );
-            osg::Timer_t end = osg::Timer::instance()->tick();
-            OE_INFO << "conversion to rgba took" << osg::Timer::instance()->delta_m(start, end) << std::endl;
-            sourceImage = rgba.get();
+            for(unsigned i = (++(*_next)) - 1; i < _jobs->size(); i = (++(*_next)) - 1)
+            {
+                const Job& job = (*_jobs)[i];
+                CompressDXT(job._in, job._out, job._width, job._height, _format);
+            }
         }
+    };
+
+    // Bytes needed to hold a DXT-compressed level.
+    unsigned dxtLevelSize(int width, int height, int format)
+    {
+        unsigned blocks = (unsigned)((width+3)/4) * (unsigned)((height+3)/4);
+        return blocks * (format == FORMAT_DXT1 ? 8u : 16u);
+    }
+
+    // 2x2 box-filters an RGBA8 level into the next smaller one. Dimensions
+    // of 1 are not halved, so non-square images shrink correctly.
+    void downsample(const Level& src, unsigned char* dst, int width, int height)
+    {
+        int sx = src._width  > 1 ? 2 : 1;
+        int sy = src._height > 1 ? 2 : 1;
+        int rowBytes = src._width * 4;
 
+        for(int y=0; y<height; ++y)
+        {
+            const unsigned char* r0 = src._data + (y*sy)*rowBytes;
+            const unsigned char* r1 = r0 + (sy-1)*rowBytes;
+            unsigned char* out = dst + y*width*4;
+
+            for(int x=0; x<width; ++x)
+            {
+                const unsigned char* p00 = r0 + (x*sx)*4;
+                const unsigned char* p01 = p00 + (sx-1)*4;
+                const unsigned char* p10 = r1 + (x*sx)*4;
+                const unsigned char* p11 = p10 + (sx-1)*4;
+                for(int c=0; c<4; ++c)
+                    *out++ = (unsigned char)((p00[c] + p01[c] + p10[c] + p11[c] + 2) >> 2);
+            }
+        }
+    }
+
+    // Builds levels 1..n of an RGBA8 mip chain into "buffer".
+    void buildChain(const Level& base, AlignedBuffer& buffer, std::vector<Level>& levels)
+    {
+        unsigned total = 0u;
+        for(int w=base._width, h=base._height; w > 1 || h > 1; )
+        {
+            w = w > 1 ? w/2 : 1;
+            h = h > 1 ? h/2 : 1;
+            total += ((unsigned)(w*h*4) + 15u) & ~15u;
+        }
+
+        levels.push_back(base);
+        if ( total == 0u )
+            return;
+
+        unsigned char* ptr = buffer.allocate(total);
+        while( levels.back()._width > 1 || levels.back()._height > 1 )
+        {
+            const Level& src = levels.back();
+            Level next;
+            next._width  = src._width  > 1 ? src._width/2  : 1;
+            next._height = src._height > 1 ? src._height/2 : 1;
+            next._data   = ptr;
+            downsample(src, ptr, next._width, next._height);
+            ptr += ((unsigned)(next._width*next._height*4) + 15u) & ~15u;
+            levels.push_back(next);
+        }
+    }
+
+    // Copies a level narrower or shorter than one DXT block into a buffer
+    // padded out to 4 pixels, tiling the level's pixels.
+    void padToBlocks(const Level& src, unsigned char* dst, int width, int height)
+    {
+        for(int y=0; y<height; ++y)
+            for(int x=0; x<width; ++x)
+                memcpy(
+                    dst + (y*width+x)*4,
+                    src._data + ((y % src._height)*src._width + (x % src._width))*4,
+                    4);
+    }
+}
+
+class FastDXTProcessor : public osgDB::ImageProcessor
+{
+public:
+    FastDXTProcessor()
+    {
+        _numThreads = OpenThreads::GetNumberOfProcessors();
+        const char* env = ::getenv("OSGEARTH_FASTDXT_THREADS");
+        if ( env )
+            _numThreads = ::atoi(env);
+        if ( _numThreads < 1 )
+            _numThreads = 1;
+    }
+
+    virtual void compress(osg::Image& image, osg::Texture::InternalFormatMode compressedFormat, bool generateMipMap, bool resizeToPowerOfTwo, CompressionMethod method, CompressionQuality quality)
+    {
         int format;
         GLint pixelFormat;
         switch (compressedFormat)
@@ -58,12 +180,10 @@ public:
         case osg::Texture::USE_S3TC_DXT1_COMPRESSION:
             format = FORMAT_DXT1;
             pixelFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
-            OE_INFO << "FastDXT using dxt1 format" << std::endl;
             break;
         case osg::Texture::USE_S3TC_DXT5_COMPRESSION:
             format = FORMAT_DXT5;
             pixelFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-            OE_INFO << "FastDXT dxt5 format" << std::endl;
             break;
         default:
             OSG_WARN << "Unhandled compressed format" << compressedFormat << std::endl;
@@ -71,33 +191,221 @@ public:
             break;
         }
 
-        //Copy over the source data to an array
-        unsigned char *in = 0;
-        in = (unsigned char*)memalign(16, sourceImage->getTotalSizeInBytes());
-        memcpy(in, sourceImage->data(0,0), sourceImage->getTotalSizeInBytes());
+        osg::Timer_t start = osg::Timer::instance()->tick();
 
+        //Resize the image to the nearest power of two
+        if (!osgEarth::ImageUtils::isPowerOfTwo( &image ))
+        {
+            unsigned int s = osg::Image::computeNearestPowerOfTwo( image.s() );
+            unsigned int t = osg::Image::computeNearestPowerOfTwo( image.t() );
+            image.scaleImage(s, t, image.r());
+        }
 
+        //FastDXT only works on RGBA imagery so we must convert it. RGBA8
+        //input is encoded in place unless it's misaligned for SSE2.
+        osg::ref_ptr< osg::Image > rgba;
+        AlignedBuffer aligned;
+        Level base;
+        base._width  = image.s();
+        base._height = image.t();
+        base._data   = image.data();
 
-        //Allocate memory for the output
-        unsigned char* out = (unsigned char*)memalign(16, image.s()*image.t()*4);
-        memset(out, 0, image.s()*image.t()*4);
+        if (image.getPixelFormat() != GL_RGBA || image.getDataType() != GL_UNSIGNED_BYTE)
+        {
+            rgba = osgEarth::ImageUtils::convertToRGBA8( &image );
+            if ( !rgba.valid() )
+            {
+                OSG_WARN << "FastDXT: failed to convert image to RGBA8" << std::endl;
+                return;
+            }
+            base._data = rgba->data();
+        }
+
+        if ( ((size_t)base._data & 15) != 0 )
+        {
+            unsigned bytes = base._width * base._height * 4;
+            memcpy( aligned.allocate(bytes), base._data, bytes );
+            base._data = aligned._data;
+        }
+
+        std::vector<Level> levels;
+        AlignedBuffer chain;
+        if ( generateMipMap )
+            buildChain( base, chain, levels );
+        else
+            levels.push_back( base );
+
+        // lay out the compressed levels back to back and cut them into jobs.
+        unsigned totalBytes = 0u;
+        for(unsigned i=0; i<levels.size(); ++i)
+            totalBytes += dxtLevelSize(levels[i]._width, levels[i]._height, format);
+
+        unsigned char* data = new unsigned char[totalBytes];
+
+        // levels below one block get padded out to 4 pixels.
+        AlignedBuffer padded;
+        unsigned paddedBytes = 0u;
+        for(unsigned i=0; i<levels.size(); ++i)
+            if ( levels[i]._width < 4 || levels[i]._height < 4 )
+                paddedBytes += osg::maximum(levels[i]._width,4) * osg::maximum(levels[i]._height,4) * 4;
+        unsigned char* pad = paddedBytes > 0u ? padded.allocate(paddedBytes) : 0L;
+
+        int rowsPerJob = computeRowsPerJob( base._height );
+
+        std::vector<Job> jobs;
+        osg::Image::MipmapDataType offsets;
+        unsigned offset = 0u;
+        for(unsigned i=0; i<levels.size(); ++i)
+        {
+            Level level = levels[i];
+            if ( i > 0 )
+                offsets.push_back( offset );
+
+            if ( level._width < 4 || level._height < 4 )
+            {
+                int w = osg::maximum(level._width, 4), h = osg::maximum(level._height, 4);
+                padToBlocks( level, pad, w, h );
+                level._data   = pad;
+                level._width  = w;
+                level._height = h;
+                pad += w*h*4;
+            }
+
+            unsigned bandBytes = dxtLevelSize(level._width, rowsPerJob, format);
+            unsigned char* out = data + offset;
+            for(int y=0; y<level._height; y += rowsPerJob, out += bandBytes)
+            {
+                Job job = {
+                    level._data + y*level._width*4,
+                    out,
+                    level._width,
+                    osg::minimum(rowsPerJob, level._height - y) };
+                jobs.push_back( job );
+            }
+
+            offset += dxtLevelSize(level._width, level._height, format);
+        }
+
+        runJobs( jobs, format, base._width*base._height );
+
+        image.setImage(image.s(), image.t(), image.r(), pixelFormat, pixelFormat, GL_UNSIGNED_BYTE, data, osg::Image::USE_NEW_DELETE);
+        if ( !offsets.empty() )
+            image.setMipmapLevels( offsets );
 
-        osg::Timer_t start = osg::Timer::instance()->tick();
-        int outputBytes = CompressDXT(in, out, sourceImage->s(), sourceImage->t(), format);
         osg::Timer_t end = osg::Timer::instance()->tick();
-        OE_INFO << "compression took" << osg::Timer::instance()->delta_m(start, end) << std::endl;
-
-        //Allocate and copy over the output data to the correct size array.
-        unsigned char* data = (unsigned char*)malloc(outputBytes);
-        memcpy(data, out, outputBytes);
-        memfree(out);
-        memfree(in);
-        image.setImage(image.s(), image.t(), image.r(), pixelFormat, pixelFormat, GL_UNSIGNED_BYTE, data, osg::Image::USE_MALLOC_FREE);
+        OE_INFO << "FastDXT compressed " << image.s() << "x" << image.t()
+            << " (" << levels.size() << " levels) in "
+            << osg::Timer::instance()->delta_m(start, end) << "ms" << std::endl;
     }
 
     virtual void generateMipMap(osg::Image& image, bool resizeToPowerOfTwo, CompressionMethod method)
     {
-        OSG_WARN << "FastDXT: generateMipMap not implemented" << std::endl;
+        if (image.getPixelFormat() != GL_RGBA || image.getDataType() != GL_UNSIGNED_BYTE || image.r() != 1)
+        {
+            OSG_WARN << "FastDXT: generateMipMap only supports 2D RGBA8 images" << std::endl;
+            return;
+        }
+
+        if (resizeToPowerOfTwo && !osgEarth::ImageUtils::isPowerOfTwo( &image ))
+        {
+            unsigned int s = osg::Image::computeNearestPowerOfTwo( image.s() );
+            unsigned int t = osg::Image::computeNearestPowerOfTwo( image.t() );
+            image.scaleImage(s, t, image.r());
+        }
+
+        Level base;
+        base._width  = image.s();
+        base._height = image.t();
+        base._data   = image.data();
+
+        std::vector<Level> levels;
+        AlignedBuffer chain;
+        buildChain( base, chain, levels );
+
+        unsigned totalBytes = 0u;
+        for(unsigned i=0; i<levels.size(); ++i)
+            totalBytes += levels[i]._width * levels[i]._height * 4;
+
+        unsigned char* data = new unsigned char[totalBytes];
+        osg::Image::MipmapDataType offsets;
+        unsigned offset = 0u;
+        for(unsigned i=0; i<levels.size(); ++i)
+        {
+            if ( i > 0 )
+                offsets.push_back( offset );
+            unsigned bytes = levels[i]._width * levels[i]._height * 4;
+            memcpy( data + offset, levels[i]._data, bytes );
+            offset += bytes;
+        }
+
+        image.setImage(image.s(), image.t(), image.r(), image.getInternalTextureFormat(), GL_RGBA, GL_UNSIGNED_BYTE, data, osg::Image::USE_NEW_DELETE);
+        image.setMipmapLevels( offsets );
+    }
+
+private:
+    int _numThreads;
+
+    mutable osg::ref_ptr<osgEarth::TaskService> _service;
+    mutable osgEarth::Threading::Mutex          _serviceMutex;
+
+    // Band height: a multiple of 4 that gives each thread a few bands.
+    int computeRowsPerJob(int height) const
+    {
+        int bands = _numThreads * 4;
+        int rows = ((height / bands) + 3) & ~3;
+        return osg::maximum(rows, 4);
+    }
+
+    // One pool for every compress() call, so concurrent callers share
+    // _numThreads-1 helpers instead of each starting their own.
+    osgEarth::TaskService* getService() const
+    {
+        osgEarth::Threading::ScopedMutexLock lock( _serviceMutex );
+        if ( !_service.valid() )
+            _service = new osgEarth::TaskService( "FastDXT", _numThreads-1 );
+        return _service.get();
+    }
+
+    void runJobs(const std::vector<Job>& jobs, int format, int numPixels) const
+    {
+        OpenThreads::Atomic next;
+
+        Encoder local;
+        local._jobs   = &jobs;
+        local._next   = &next;
+        local._format = format;
+
+        // not worth using helpers for small tiles.
+        unsigned numHelpers = numPixels >= 256*256 ? (unsigned)(_numThreads-1) : 0u;
+        if ( numHelpers + 1u > jobs.size() )
+            numHelpers = jobs.size() > 0 ? jobs.size() - 1u : 0u;
+
+        if ( numHelpers == 0u )
+        {
+            local.execute();
+            return;
+        }
+
+        osgEarth::TaskService* service = getService();
+        osgEarth::Threading::MultiEvent done( numHelpers );
+        std::vector< osg::ref_ptr< osgEarth::ParallelTask<Encoder> > > tasks;
+
+        for(unsigned i=0; i<numHelpers; ++i)
+        {
+            osgEarth::ParallelTask<Encoder>* task = new osgEarth::ParallelTask<Encoder>( &done );
+            static_cast<Encoder&>(*task) = local;
+            tasks.push_back( task );
+            service->add( task );
+        }
+
+        // the calling thread works too.
+        local.execute();
+
+        // helpers still in the queue just find the job list empty.
+        for(unsigned i=0; i<tasks.size(); ++i)
+            tasks[i]->runIfUnclaimed();
+
+        done.wait();
     }
 };
 
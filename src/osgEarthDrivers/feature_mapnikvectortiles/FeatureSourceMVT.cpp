@@ -29,12 +29,15 @@
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
+#include <osgEarth/ThreadingUtils>
 #include <list>
+#include <set>
+#include <istream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sqlite3.h>
 
-#include "vector_tile.pb.h"
+#include "PBFReader"
 
 #define LC "[MVT FeatureSource] "
 
@@ -62,12 +65,114 @@ enum eGeomType {
     Polygon = 3
 };
 
+// Field numbers from the vector tile spec
+// https://github.com/mapbox/vector-tile-spec/blob/master/2.1/vector_tile.proto
+#define TILE_LAYERS       3
+#define LAYER_NAME        1
+#define LAYER_FEATURES    2
+#define LAYER_KEYS        3
+#define LAYER_VALUES      4
+#define LAYER_EXTENT      5
+#define FEATURE_TAGS      2
+#define FEATURE_TYPE      3
+#define FEATURE_GEOMETRY  4
+
+namespace
+{
+    // Reads a blob in place through a std::istream.
+    struct BlobStreamBuf : public std::streambuf
+    {
+        BlobStreamBuf(const char* data, unsigned length) {
+            char* p = const_cast<char*>(data);
+            setg(p, p, p + length);
+        }
+    };
+
+    // A tag value, decoded once per layer and shared by all its features.
+    struct TagValue
+    {
+        TagValue() : _type(ATTRTYPE_UNSPECIFIED), _double(0.0), _int(0), _bool(false), _heightState(0), _height(0.0f) { }
+
+        AttributeType _type;
+        std::string   _string;
+        double        _double;
+        int           _int;
+        bool          _bool;
+
+        // cached result of parsing "other_tags" for a height (0=not parsed, 1=none, 2=found)
+        int           _heightState;
+        float         _height;
+
+        void decode(PBFReader value)
+        {
+            while( value.next() )
+            {
+                switch( value.tag() )
+                {
+                case 1: _type = ATTRTYPE_STRING; _string = value.getString(); break;
+                case 2: _type = ATTRTYPE_DOUBLE; _double = value.getFloat(); break;
+                case 3: _type = ATTRTYPE_DOUBLE; _double = value.getDouble(); break;
+                case 4: _type = ATTRTYPE_INT;    _int = (int)value.getInt64(); break;
+                case 5: _type = ATTRTYPE_INT;    _int = (int)value.getVarint(); break;
+                case 6: _type = ATTRTYPE_INT;    _int = (int)value.getSInt64(); break;
+                case 7: _type = ATTRTYPE_BOOL;   _bool = value.getBool(); break;
+                default: value.skip(); break;
+                }
+            }
+        }
+
+        void apply(Feature* feature, const std::string& key) const
+        {
+            switch( _type )
+            {
+            case ATTRTYPE_STRING: feature->set(key, _string); break;
+            case ATTRTYPE_DOUBLE: feature->set(key, _double); break;
+            case ATTRTYPE_INT:    feature->set(key, _int); break;
+            case ATTRTYPE_BOOL:   feature->set(key, _bool); break;
+            default: break;
+            }
+        }
+
+        // Special path for getting heights from our test dataset.
+        bool getOtherTagsHeight(float& out_height)
+        {
+            if ( _heightState == 0 )
+            {
+                _heightState = 1;
+                StringTokenizer tok("=>");
+                StringVector tized;
+                tok.tokenize(_string, tized);
+                if (tized.size() == 3 && tized[0] == "height")
+                {
+                    // Remove quotes from the height
+                    float height = as<float>(tized[2], FLT_MAX);
+                    if (height != FLT_MAX)
+                    {
+                        _height = height;
+                        _heightState = 2;
+                    }
+                }
+            }
+            out_height = _height;
+            return _heightState == 2;
+        }
+    };
+
+    struct Range
+    {
+        Range(const char* data, unsigned length) : _data(data), _length(length) { }
+        const char* _data;
+        unsigned    _length;
+    };
+}
+
 class MVTFeatureSource : public FeatureSource
 {
 public:
     MVTFeatureSource(const MVTFeatureOptions& options ) :
       FeatureSource( options ),
       _options     ( options ),
+      _database(0L),
       _minLevel(0),
       _maxLevel(14)
     {
@@ -76,12 +181,26 @@ public:
         {
            OE_WARN << LC << "Failed to get zlib compressor" << std::endl;
         }
+
+        if ( _options.layers().isSet() )
+        {
+            StringVector names;
+            StringTokenizer( *_options.layers(), names, ", ", "", false, true );
+            _layers.insert( names.begin(), names.end() );
+        }
     }
 
-    /** Destruct the object, cleaning up and OGR handles. */
+    /** Destruct the object, cleaning up the database handles. */
     virtual ~MVTFeatureSource()
     {               
-        //nop
+        for(std::map<unsigned, sqlite3_stmt*>::iterator i = _selectPerThread.begin(); i != _selectPerThread.end(); ++i)
+        {
+            if ( i->second )
+                sqlite3_finalize( i->second );
+        }
+
+        if ( _database )
+            sqlite3_close( _database );
     }
 
     //override
@@ -90,7 +209,7 @@ public:
         _dbOptions = dbOptions ? osg::clone(dbOptions) : 0L;
         std::string fullFilename = _options.url()->full();
 
-        int rc = sqlite3_open_v2( fullFilename.c_str(), &_database, SQLITE_OPEN_READONLY, 0L );
+        int rc = sqlite3_open_v2( fullFilename.c_str(), &_database, SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX, 0L );
         if ( rc != 0 )
         {          
             OE_WARN << LC << "Failed to open database " << sqlite3_errmsg(_database);
@@ -143,219 +262,60 @@ public:
         key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
         tileY  = numRows - tileY - 1;
 
-        //Get the image
-        sqlite3_stmt* select = NULL;
-        std::string queryStr = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-        int rc = sqlite3_prepare_v2( _database, queryStr.c_str(), -1, &select, 0L );
-        if ( rc != SQLITE_OK )
+        sqlite3_stmt* select = getSelectStatement();
+        if ( !select )
         {
-            OE_WARN << LC << "Failed to prepare SQL: " << queryStr << "; " << sqlite3_errmsg(_database) << std::endl;
             return NULL;
         }
 
-        bool valid = true;        
-
         sqlite3_bind_int( select, 1, z );
         sqlite3_bind_int( select, 2, tileX );
         sqlite3_bind_int( select, 3, tileY );
 
-        rc = sqlite3_step( select );
+        int rc = sqlite3_step( select );
 
         FeatureList features;
 
         if ( rc == SQLITE_ROW)
         {                     
-            // the pointer returned from _blob gets freed internally by sqlite, supposedly
+            // the blob stays valid until the statement is reset.
             const char* data = (const char*)sqlite3_column_blob( select, 0 );
             int dataLen = sqlite3_column_bytes( select, 0 );
 
-            std::string dataBuffer( data, dataLen );
+            // decompress if necessary (gzip or zlib header); otherwise decode in place.
+            std::string inflated;
+            bool compressed =
+                dataLen >= 2 &&
+                (((unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b) ||
+                 ((unsigned char)data[0] == 0x78));
 
-            // decompress if necessary:
-            if ( _compressor.valid() )
+            if ( compressed && _compressor.valid() )
             {
-                std::istringstream inputStream(dataBuffer);
-                std::string value;
-                if ( !_compressor->decompress(inputStream, value) )
+                BlobStreamBuf buf(data, dataLen);
+                std::istream inputStream(&buf);
+                if ( !_compressor->decompress(inputStream, inflated) )
                 {
                     OE_WARN << LC << "Decompression failed" << std::endl;
-                    valid = false;
                 }
                 else
                 {
-                    dataBuffer = value;
+                    data = inflated.data();
+                    dataLen = inflated.size();
                 }
             }
 
-            
-            
-            mapnik::vector::tile tile;
-
-            if (tile.ParseFromString(dataBuffer))
-            {
-                // Get the layer in question
-                for (unsigned int i = 0; i < tile.layers().size(); i++)
-                {
-                    const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
-
-                    //OE_NOTICE << layer.name() << std::endl;
-                    //if (layer.name() != "road") continue;
-                    //if (layer.name() != "building") continue;
-
-                    for (unsigned int j = 0; j < layer.features().size(); j++)
-                    {
-                        const mapnik::vector::tile_feature &feature = layer.features().Get(j);
-
-                        osg::ref_ptr< osgEarth::Symbology::Geometry > geometry; 
-
-                        eGeomType geomType = static_cast<eGeomType>(feature.type());
-                        if (geomType == ::Polygon)
-                        {
-                            //OE_NOTICE << "Polygon " << std::endl;
-                            geometry = new osgEarth::Symbology::Polygon();
-                        }
-                        else if (geomType == ::LineString)
-                        {
-                            //OE_NOTICE << "LineString" << std::endl;
-                            geometry = new osgEarth::Symbology::LineString();
-                        }
-                        else if (geomType == ::Point)
-                        {
-                            //OE_NOTICE << "Point" << std::endl;
-                            geometry = new osgEarth::Symbology::PointSet();
-                        }
-                        else
-                        {
-                            //OE_NOTICE << "uknown" << std::endl;
-                            geometry = new osgEarth::Symbology::LineString();
-                        }
-
-                        osg::ref_ptr< Feature > oeFeature = new Feature(geometry, key.getProfile()->getSRS());
-                        features.push_back(oeFeature.get());                    
-
-                        // Read attributes
-                        for (unsigned int k = 0; k < feature.tags().size(); k+=2)
-                        {
-                            std::string key = layer.keys().Get(feature.tags().Get(k));
-                            mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
-
-                            if (value.has_bool_value())
-                            {
-                                oeFeature->set(key, value.bool_value());
-                            }
-                            else if (value.has_double_value())
-                            {
-                                oeFeature->set(key, value.double_value());
-                            }
-                            else if (value.has_float_value())
-                            {
-                                oeFeature->set(key, value.float_value());
-                            }
-                            else if (value.has_int_value())
-                            {
-                                oeFeature->set(key, (int)value.int_value());
-                            }
-                            else if (value.has_sint_value())
-                            {
-                                oeFeature->set(key, (int)value.sint_value());
-                            }
-                            else if (value.has_string_value())
-                            {
-                                oeFeature->set(key, value.string_value());
-                            }
-                            else if (value.has_uint_value())
-                            {
-                                oeFeature->set(key, (int)value.uint_value());
-                            }
-
-                            // Special path for getting heights from our test dataset.
-                            if (key == "other_tags")
-                            {
-                                std::string other_tags = value.string_value();
-                                
-                                StringTokenizer tok("=>");
-                                StringVector tized;
-                                tok.tokenize(other_tags, tized);            
-                                if (tized.size() == 3)
-                                {
-                                    if (tized[0] == "height")
-                                    {
-                                        std::string value = tized[2];
-                                        // Remove quotes from the height
-                                        float height = as<float>(value, FLT_MAX);
-                                        if (height != FLT_MAX)
-                                        {
-                                            oeFeature->set("height", height);                                            
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        
-                        
-                        unsigned int length = 0;
-                        int cmd = -1;
-                        const int cmd_bits = 3;
-
-                        unsigned int tileres = layer.extent();
-
-                        int x = 0;
-                        int y = 0;
-
-                        for (int k = 0; k < feature.geometry_size();)
-                        {
-                            if (!length)
-                            {
-                                unsigned int cmd_length = feature.geometry(k++);
-                                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                                length = cmd_length >> cmd_bits;
-                            } 
-                            if (length > 0)
-                            {
-                                length--;
-                                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
-                                {
-                                    int px = feature.geometry(k++);
-                                    int py = feature.geometry(k++);
-                                    px = zig_zag_decode(px);
-                                    py = zig_zag_decode(py);
-
-                                    x += px;
-                                    y += py;
-
-                                    double width = key.getExtent().width();
-                                    double height = key.getExtent().height();
-
-                                    double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                                    double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                                    geometry->push_back(geoX, geoY, 0);
-                                }
-                                else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)))
-                                {
-                                    geometry->push_back(geometry->front());
-                                }
-                            }
-                        }
-
-                        if (geometry->getType() == Geometry::TYPE_POLYGON)
-                        {
-                            geometry->rewind(osgEarth::Symbology::Geometry::ORIENTATION_CCW);                                               
-                        }
-                    }
-                }
-            }
-            else
+            if ( !decodeTile(data, dataLen, key, features) )
             {
                 OE_WARN << LC << "Failed to parse " << key.str() << std::endl;
             }
         }
         else
         {
-            OE_DEBUG << LC << "SQL QUERY failed for " << queryStr << ": " << std::endl;
-            valid = false;
+            OE_DEBUG << LC << "SQL QUERY failed for " << key.str() << std::endl;
         }
 
-        sqlite3_finalize( select );
+        sqlite3_reset( select );
+        sqlite3_clear_bindings( select );
 
         if (!features.empty())
         {
@@ -366,6 +326,189 @@ public:
         return 0;
     }
 
+    /** Decodes every (selected) layer of a tile into features. */
+    bool decodeTile(const char* data, unsigned length, const TileKey& key, FeatureList& features)
+    {
+        PBFReader tile(data, length);
+        while( tile.next() )
+        {
+            if ( tile.tag() == TILE_LAYERS && tile.wireType() == PBFReader::WIRE_BYTES )
+                decodeLayer( tile.getMessage(), key, features );
+            else
+                tile.skip();
+        }
+        return tile.ok();
+    }
+
+    void decodeLayer(PBFReader layer, const TileKey& key, FeatureList& features)
+    {
+        // First pass: find the name and note where everything else is, so we
+        // can reject the layer before decoding anything.
+        std::string name;
+        unsigned tileres = 4096;
+        std::vector<Range> featureRanges, keyRanges, valueRanges;
+
+        while( layer.next() )
+        {
+            const char* d;
+            unsigned n;
+            switch( layer.tag() )
+            {
+            case LAYER_NAME:     name = layer.getString(); break;
+            case LAYER_EXTENT:   tileres = layer.getUInt32(); break;
+            case LAYER_FEATURES: if ( layer.getBytes(d, n) ) featureRanges.push_back(Range(d, n)); break;
+            case LAYER_KEYS:     if ( layer.getBytes(d, n) ) keyRanges.push_back(Range(d, n)); break;
+            case LAYER_VALUES:   if ( layer.getBytes(d, n) ) valueRanges.push_back(Range(d, n)); break;
+            default:             layer.skip(); break;
+            }
+        }
+
+        if ( !layer.ok() || featureRanges.empty() || tileres == 0 )
+            return;
+
+        if ( !_layers.empty() && _layers.find(name) == _layers.end() )
+            return;
+
+        // Keys and values are shared by all features in the layer; decode them once.
+        std::vector<std::string> keys;
+        keys.reserve( keyRanges.size() );
+        int otherTagsKey = -1;
+        for(unsigned i=0; i<keyRanges.size(); ++i)
+        {
+            keys.push_back( std::string(keyRanges[i]._data, keyRanges[i]._length) );
+            if ( keys.back() == "other_tags" )
+                otherTagsKey = i;
+        }
+
+        std::vector<TagValue> values( valueRanges.size() );
+        for(unsigned i=0; i<valueRanges.size(); ++i)
+        {
+            values[i].decode( PBFReader(valueRanges[i]._data, valueRanges[i]._length) );
+        }
+
+        const GeoExtent& extent = key.getExtent();
+        double xres = extent.width() / (double)tileres;
+        double yres = extent.height() / (double)tileres;
+        const SpatialReference* srs = key.getProfile()->getSRS();
+
+        for(unsigned f=0; f<featureRanges.size(); ++f)
+        {
+            PBFReader feature(featureRanges[f]._data, featureRanges[f]._length);
+
+            eGeomType geomType = ::Unknown;
+            const char* tagData = 0L;
+            const char* geomData = 0L;
+            unsigned tagLen = 0, geomLen = 0;
+
+            while( feature.next() )
+            {
+                switch( feature.tag() )
+                {
+                case FEATURE_TYPE:     geomType = static_cast<eGeomType>(feature.getUInt32()); break;
+                case FEATURE_TAGS:     if ( feature.wireType() == PBFReader::WIRE_BYTES ) feature.getBytes(tagData, tagLen); else feature.skip(); break;
+                case FEATURE_GEOMETRY: if ( feature.wireType() == PBFReader::WIRE_BYTES ) feature.getBytes(geomData, geomLen); else feature.skip(); break;
+                default:               feature.skip(); break;
+                }
+            }
+            if ( !feature.ok() )
+                continue;
+
+            osg::ref_ptr< osgEarth::Symbology::Geometry > geometry; 
+            if (geomType == ::Polygon)
+                geometry = new osgEarth::Symbology::Polygon();
+            else if (geomType == ::LineString)
+                geometry = new osgEarth::Symbology::LineString();
+            else if (geomType == ::Point)
+                geometry = new osgEarth::Symbology::PointSet();
+            else
+                geometry = new osgEarth::Symbology::LineString();
+
+            osg::ref_ptr< Feature > oeFeature = new Feature(geometry, srs);
+            features.push_back(oeFeature.get());
+
+            // Read attributes
+            PBFReader tags(tagData, tagLen);
+            while( tags.more() )
+            {
+                unsigned k = tags.getUInt32();
+                unsigned v = tags.getUInt32();
+                if ( !tags.ok() || k >= keys.size() || v >= values.size() )
+                    break;
+
+                values[v].apply( oeFeature.get(), keys[k] );
+
+                float height;
+                if ( (int)k == otherTagsKey && values[v].getOtherTagsHeight(height) )
+                {
+                    oeFeature->set("height", height);
+                }
+            }
+
+            // Geometry commands, straight from the packed field
+            PBFReader geom(geomData, geomLen);
+            unsigned int length = 0;
+            int cmd = -1;
+            const int cmd_bits = 3;
+            int x = 0;
+            int y = 0;
+
+            while( geom.more() )
+            {
+                if (!length)
+                {
+                    unsigned int cmd_length = geom.getUInt32();
+                    cmd = cmd_length & ((1 << cmd_bits) - 1);
+                    length = cmd_length >> cmd_bits;
+                } 
+                if (length > 0)
+                {
+                    length--;
+                    if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+                    {
+                        int px = zig_zag_decode( geom.getUInt32() );
+                        int py = zig_zag_decode( geom.getUInt32() );
+                        if ( !geom.ok() )
+                            break;
+
+                        x += px;
+                        y += py;
+
+                        double geoX = extent.xMin() + xres * (double)x;
+                        double geoY = extent.yMax() - yres * (double)y;
+                        geometry->push_back(geoX, geoY, 0);
+                    }
+                    else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)) && !geometry->empty())
+                    {
+                        geometry->push_back(geometry->front());
+                    }
+                }
+            }
+
+            if (geometry->getType() == Geometry::TYPE_POLYGON)
+            {
+                geometry->rewind(osgEarth::Symbology::Geometry::ORIENTATION_CCW);                                               
+            }
+        }
+    }
+
+    /** The tile query, prepared once per thread and reused. */
+    sqlite3_stmt* getSelectStatement()
+    {
+        Threading::ScopedMutexLock lock( _selectMutex );
+        sqlite3_stmt*& select = _selectPerThread[Threading::getCurrentThreadId()];
+        if ( !select && _database )
+        {
+            std::string queryStr = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+            int rc = sqlite3_prepare_v2( _database, queryStr.c_str(), -1, &select, 0L );
+            if ( rc != SQLITE_OK )
+            {
+                OE_WARN << LC << "Failed to prepare SQL: " << queryStr << "; " << sqlite3_errmsg(_database) << std::endl;
+                select = 0L;
+            }
+        }
+        return select;
+    }
+
     /**
     * Gets the Feature with the given FID
     * @returns
@@ -467,6 +610,9 @@ private:
     sqlite3* _database;
     unsigned int _minLevel;
     unsigned int _maxLevel;
+    std::set<std::string>               _layers;
+    std::map<unsigned, sqlite3_stmt*>   _selectPerThread;
+    Threading::Mutex                    _selectMutex;
 };
 
 
@@ -25,6 +25,7 @@
 #define LC "[FeatureCursorOGR] "
 
 #define OGR_SCOPED_LOCK GDAL_SCOPED_LOCK
+#define OGR_SCOPED_LOCK_IF GDAL_SCOPED_LOCK_IF
 
 using namespace osgEarth;
 using namespace osgEarth::Features;
@@ -62,15 +63,18 @@ namespace
 }
 
 
-FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH              dsHandle,
-                                   OGRLayerH                   layerHandle,
+FeatureCursorOGR::FeatureCursorOGR(Drivers::OGRDatasourcePool*         pool,
+                                   const Drivers::OGRDatasourcePool::Handle& handle,
                                    const FeatureSource*        source,
                                    const FeatureProfile*       profile,
                                    const Symbology::Query&     query,
                                    const FeatureFilterList&    filters) :
+_pool             ( pool ),
+_handle           ( handle ),
+_concurrent       ( pool->isConcurrent() ),
 _source           ( source ),
-_dsHandle         ( dsHandle ),
-_layerHandle      ( layerHandle ),
+_dsHandle         ( handle._ds ),
+_layerHandle      ( handle._layer ),
 _resultSetHandle  ( 0L ),
 _spatialFilter    ( 0L ),
 _query            ( query ),
@@ -79,14 +83,18 @@ _nextHandleToQueue( 0L ),
 _profile          ( profile ),
 _filters          ( filters )
 {
+    if ( _source.valid() )
+        _attrSchema = _source->getAttributeSchema();
+
     {
-        OGR_SCOPED_LOCK;
+        // the datasource handle is ours alone; in concurrent mode that's enough.
+        OGR_SCOPED_LOCK_IF( !_concurrent );
 
         std::string expr;
         std::string from = OGR_FD_GetName( OGR_L_GetLayerDefn( _layerHandle ));        
         
         
-        std::string driverName = OGR_Dr_GetName( OGR_DS_GetDriver( dsHandle ) );             
+        std::string driverName = OGR_Dr_GetName( OGR_DS_GetDriver( _dsHandle ) );             
         // Quote the layer name if it is a shapefile, so we can handle any weird filenames like those with spaces or hyphens.
         // Or quote any layers containing spaces for PostgreSQL
         if (driverName == "ESRI Shapefile" || driverName == "VRT" ||
@@ -176,19 +184,21 @@ _filters          ( filters )
 
 FeatureCursorOGR::~FeatureCursorOGR()
 {
-    OGR_SCOPED_LOCK;
+    {
+        OGR_SCOPED_LOCK_IF( !_concurrent );
 
-    if ( _nextHandleToQueue )
-        OGR_F_Destroy( _nextHandleToQueue );
+        if ( _nextHandleToQueue )
+            OGR_F_Destroy( _nextHandleToQueue );
 
-    if ( _resultSetHandle != _layerHandle )
-        OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
+        if ( _resultSetHandle && _resultSetHandle != _layerHandle )
+            OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
 
-    if ( _spatialFilter )
-        OGR_G_DestroyGeometry( _spatialFilter );
+        if ( _spatialFilter )
+            OGR_G_DestroyGeometry( _spatialFilter );
+    }
 
-    if ( _dsHandle )
-        OGRReleaseDataSource( _dsHandle );
+    // hand the datasource back for the next cursor.
+    _pool->checkin( _handle );
 }
 
 bool
@@ -223,68 +233,47 @@ FeatureCursorOGR::readChunk()
 {
     if ( !_resultSetHandle )
         return;
-    
-    FeatureList preProcessList;
-    
-    OGR_SCOPED_LOCK;
 
-    if ( _nextHandleToQueue )
+    // Only pulling the OGR features touches the datasource, so that is all
+    // we do under the lock (if we need it at all). Converting them into
+    // osgEarth features happens afterwards, so other threads can read in
+    // the meantime.
+    std::vector<OGRFeatureH> handles;
+    handles.reserve( _chunkSize );
     {
-        osg::ref_ptr<Feature> f = OgrUtils::createFeature( _nextHandleToQueue, _profile.get() );
-        if ( f.valid() && !_source->isBlacklisted(f->getFID()) )
+        OGR_SCOPED_LOCK_IF( !_concurrent );
+
+        if ( _nextHandleToQueue )
         {
-            if ( isGeometryValid( f->getGeometry() ) )
-            {
-                _queue.push( f );
+            handles.push_back( _nextHandleToQueue );
+            _nextHandleToQueue = 0L;
+        }
 
-                if ( _filters.size() > 0 )
-                {
-                    preProcessList.push_back( f.release() );
-                }
+        unsigned handlesToQueue = _chunkSize - _queue.size();
+        bool resultSetEndReached = false;
+
+        while( handles.size() < handlesToQueue )
+        {
+            OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
+            if ( handle )
+            {
+                handles.push_back( handle );
             }
             else
             {
-                OE_DEBUG << LC << "Skipping feature with invalid geometry: " << f->getGeoJSON() << std::endl;
+                resultSetEndReached = true;
+                break;
             }
         }
-        OGR_F_Destroy( _nextHandleToQueue );
-        _nextHandleToQueue = 0L;
-    }
-
-    unsigned handlesToQueue = _chunkSize - _queue.size();
-    bool resultSetEndReached = false;
-
-    for( unsigned i=0; i<handlesToQueue; i++ )
-    {
-        OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
-        if ( handle )
-        {
-            osg::ref_ptr<Feature> f = OgrUtils::createFeature( handle, _profile.get() );
-            if ( f.valid() && !_source->isBlacklisted(f->getFID()) )
-            {
-                if (isGeometryValid( f->getGeometry() ) )
-                {
-                    _queue.push( f );
 
-                    if ( _filters.size() > 0 )
-                    {
-                        preProcessList.push_back( f.release() );
-                    }
-                }
-                else
-                {
-                    OE_DEBUG << LC << "Skipping feature with invalid geometry: " << f->getGeoJSON() << std::endl;
-                }
-            }            
-            OGR_F_Destroy( handle );
-        }
-        else
-        {
-            resultSetEndReached = true;
-            break;
-        }
+        // read one more for "more" detection:
+        if (!resultSetEndReached)
+            _nextHandleToQueue = OGR_L_GetNextFeature( _resultSetHandle );
     }
 
+    FeatureList preProcessList;
+    queueFeatures( handles, preProcessList );
+
     // preprocess the features using the filter list:
     if ( preProcessList.size() > 0 )
     {
@@ -298,12 +287,34 @@ FeatureCursorOGR::readChunk()
         }
     }
 
-    // read one more for "more" detection:
-    if (!resultSetEndReached)
-        _nextHandleToQueue = OGR_L_GetNextFeature( _resultSetHandle );
-    else
-        _nextHandleToQueue = 0L;
-
     //OE_NOTICE << "read " << _queue.size() << " features ... " << std::endl;
 }
 
+// converts OGR features into osgEarth features and queues them, consuming
+// the OGR handles. Each OGR feature is a private copy, so no lock is needed.
+void
+FeatureCursorOGR::queueFeatures(const std::vector<OGRFeatureH>& handles,
+                                FeatureList&                    preProcessList)
+{
+    for( std::vector<OGRFeatureH>::const_iterator h = handles.begin(); h != handles.end(); ++h )
+    {
+        osg::ref_ptr<Feature> f = OgrUtils::createFeature( *h, _profile.get(), _attrSchema.get() );
+        if ( f.valid() && !_source->isBlacklisted(f->getFID()) )
+        {
+            if ( isGeometryValid( f->getGeometry() ) )
+            {
+                _queue.push( f );
+
+                if ( _filters.size() > 0 )
+                {
+                    preProcessList.push_back( f.release() );
+                }
+            }
+            else
+            {
+                OE_DEBUG << LC << "Skipping feature with invalid geometry: " << f->getGeoJSON() << std::endl;
+            }
+        }
+        OGR_F_Destroy( *h );
+    }
+}
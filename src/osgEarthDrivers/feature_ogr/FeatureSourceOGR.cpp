@@ -27,6 +27,7 @@
 #include <osgEarthFeatures/GeometryUtils>
 #include "OGRFeatureOptions"
 #include "FeatureCursorOGR"
+#include "OGRDatasourcePool"
 #include <osgEarthFeatures/OgrUtils>
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
@@ -82,6 +83,9 @@ public:
     /** Destruct the object, cleaning up and OGR handles. */
     virtual ~OGRFeatureSource()
     {       
+        // close the pooled handles first; cursors still out keep the pool alive.
+        _pool = 0L;
+
         OGR_SCOPED_LOCK;
 
         if ( _layerHandle )
@@ -246,6 +250,14 @@ public:
                     //Get the feature count
                     _featureCount = OGR_L_GetFeatureCount( _layerHandle, 1 );
 
+                    // Cursors read through pooled handles of their own, so that
+                    // several threads can read the layer at once.
+                    bool concurrent = _options.concurrent().isSet() ?
+                        _options.concurrent().value() :
+                        Registry::instance()->isGDALConcurrencyEnabled();
+
+                    _pool = new OGRDatasourcePool( _source, _options.layer().value(), concurrent );
+
                     initSchema();
 
                     OGRwkbGeometryType wkbType = OGR_FD_GetGeomType( OGR_L_GetLayerDefn( _layerHandle ) );
@@ -321,28 +333,14 @@ public:
         }
         else
         {
-            OGRDataSourceH dsHandle = 0L;
-            OGRLayerH layerHandle = 0L;
-
-            // open the handles safely:
-            {
-                OGR_SCOPED_LOCK;
-
-                // Each cursor requires its own DS handle so that multi-threaded access will work.
-                // The cursor impl will dispose of the new DS handle.
-                dsHandle = OGROpenShared( _source.c_str(), 0, &_ogrDriverHandle );
-                if ( dsHandle )
-                {
-                    layerHandle = openLayer(dsHandle, _options.layer().get());
-                }
-            }
-
-            if ( dsHandle && layerHandle )
+            // Each cursor requires its own DS handle so that multi-threaded access will work.
+            // The cursor returns it to the pool when it's done.
+            OGRDatasourcePool::Handle handle;
+            if ( _pool.valid() && _pool->checkout(handle) )
             {
-                // cursor is responsible for the OGR handles.
                 return new FeatureCursorOGR( 
-                    dsHandle,
-                    layerHandle, 
+                    _pool.get(),
+                    handle,
                     this,
                     getFeatureProfile(),
                     query,
@@ -350,12 +348,6 @@ public:
             }
             else
             {
-                if ( dsHandle )
-                {
-                    OGR_SCOPED_LOCK;
-                    OGRReleaseDataSource( dsHandle );
-                }
-
                 return 0L;
             }
         }
@@ -369,12 +361,28 @@ public:
             if (OGR_L_DeleteFeature( _layerHandle, fid ) == OGRERR_NONE)
             {
                 _needsSync = true;
+                if ( _pool.valid() )
+                    _pool->clear();
                 return true;
             }            
         }
         return false;
     }
 
+    virtual TimeStamp getLastModifiedTime() const
+    {
+        if ( _options.url().isSet() && !_options.url()->isRemote() )
+        {
+            // for a layer inside an archive, use the archive.
+            std::string path = _options.url()->full();
+            std::string::size_type zip = path.find(".zip/");
+            if ( zip != std::string::npos )
+                path = path.substr(0, zip+4);
+            return osgEarth::getLastModifiedTime( path );
+        }
+        return FeatureSource::getLastModifiedTime();
+    }
+
     virtual int getFeatureCount() const
     {
         return _featureCount;
@@ -395,7 +403,7 @@ public:
             OGRFeatureH handle = OGR_L_GetFeature( _layerHandle, fid);
             if (handle)
             {
-                result = OgrUtils::createFeature( handle, getFeatureProfile() );
+                result = OgrUtils::createFeature( handle, getFeatureProfile(), getAttributeSchema() );
                 OGR_F_Destroy( handle );
             }
         }
@@ -418,8 +426,6 @@ public:
         OGRFeatureH feature_handle = OGR_F_Create( OGR_L_GetLayerDefn( _layerHandle ) );
         if ( feature_handle )
         {
-            const AttributeTable& attrs = feature->getAttrs();
-
             // assign the attributes:
             int num_fields = OGR_F_GetFieldCount( feature_handle );
             for( int i=0; i<num_fields; i++ )
@@ -428,19 +434,18 @@ public:
                 std::string name = OGR_Fld_GetNameRef( field_handle_ref );
                 int field_index = OGR_F_GetFieldIndex( feature_handle, name.c_str() );
 
-                AttributeTable::const_iterator a = attrs.find( toLower(name) );
-                if ( a != attrs.end() )
+                if ( feature->hasAttr(name) )
                 {
                     switch( OGR_Fld_GetType(field_handle_ref) )
                     {
                     case OFTInteger:
-                        OGR_F_SetFieldInteger( feature_handle, field_index, a->second.getInt(0) );
+                        OGR_F_SetFieldInteger( feature_handle, field_index, feature->getInt(name, 0) );
                         break;
                     case OFTReal:
-                        OGR_F_SetFieldDouble( feature_handle, field_index, a->second.getDouble(0.0) );
+                        OGR_F_SetFieldDouble( feature_handle, field_index, feature->getDouble(name, 0.0) );
                         break;
                     case OFTString:
-                        OGR_F_SetFieldString( feature_handle, field_index, a->second.getString().c_str() );
+                        OGR_F_SetFieldString( feature_handle, field_index, feature->getString(name).c_str() );
                         break;
                     default:break;
                     }
@@ -468,6 +473,10 @@ public:
 
             // clean up the feature
             OGR_F_Destroy( feature_handle );
+
+            // pooled handles may not see the new feature.
+            if ( _pool.valid() )
+                _pool->clear();
         }
         else
         {
@@ -535,6 +544,7 @@ private:
     bool _writable;
     FeatureSchema _schema;
     Geometry::Type _geometryType;
+    osg::ref_ptr<OGRDatasourcePool> _pool;
 };
 
 
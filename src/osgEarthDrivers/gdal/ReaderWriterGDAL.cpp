@@ -48,6 +48,10 @@
 
 #define INDENT ""
 
+// Largest source window (in multiples of the tile size, per axis) that
+// createHeightField will read into memory in one RasterIO call.
+#define MAX_READ_WINDOW_SCALE 4
+
 // From easyrgb.com
 float Hue_2_RGB( float v1, float v2, float vH )
 {
@@ -631,7 +635,12 @@ public:
       _srcDS(NULL),
       _warpedDS(NULL),
       _options(options),
-      _maxDataLevel(30)
+      _maxDataLevel(30),
+      _rasterWidth(0),
+      _rasterHeight(0),
+      _concurrent(false),
+      _warpRequired(false),
+      _warpPolar(false)
     {
     }
 
@@ -639,6 +648,19 @@ public:
     {
         GDAL_SCOPED_LOCK;
 
+        // Close the per-thread datasets (concurrent mode)
+        for (ThreadDatasetsMap::iterator i = _threadDatasets.begin(); i != _threadDatasets.end(); ++i)
+        {
+            if (i->second._warpedDS && (i->second._warpedDS != i->second._srcDS))
+            {
+                GDALClose( i->second._warpedDS );
+            }
+            if (i->second._srcDS)
+            {
+                GDALClose( i->second._srcDS );
+            }
+        }
+
         // Close the _warpedDS dataset if :
         // - it exists
         // - and is different from _srcDS
@@ -783,7 +805,8 @@ public:
                     ReadResult result = _cacheBin->readString( vrtKey);
                     if (result.succeeded())
                     {
-                        _srcDS = (GDALDataset*)GDALOpen(result.getString().c_str(), GA_ReadOnly );
+                        _openString = result.getString();
+                        _srcDS = (GDALDataset*)GDALOpen(_openString.c_str(), GA_ReadOnly );
                         if (_srcDS)
                         {
                             OE_INFO << LC << INDENT << "Read VRT from cache!" << std::endl;
@@ -837,13 +860,21 @@ public:
                     {
                         return Status::Error( "Failed to build VRT from input datasets" );
                     }
+
+                    // The VRT XML doubles as a GDALOpen string for per-thread handles.
+                    char** vrtXML = _srcDS->GetMetadata( "xml:VRT" );
+                    if ( vrtXML && vrtXML[0] )
+                    {
+                        _openString = vrtXML[0];
+                    }
                 }
             }
             else
             {
                 //If we couldn't build a VRT, just try opening the file directly
                 //Open the dataset
-                _srcDS = (GDALDataset*)GDALOpen( files[0].c_str(), GA_ReadOnly );
+                _openString = files[0];
+                _srcDS = (GDALDataset*)GDALOpen( _openString.c_str(), GA_ReadOnly );
 
                 if (_srcDS)
                 {
@@ -860,6 +891,7 @@ public:
                         buf << "SUBDATASET_" << subDataset << "_NAME";
                         char *pszSubdatasetName = CPLStrdup( CSLFetchNameValue( subDatasets, buf.str().c_str() ) );
                         GDALClose( _srcDS );
+                        _openString = pszSubdatasetName;
                         _srcDS = (GDALDataset*)GDALOpen( pszSubdatasetName, GA_ReadOnly ) ;
                         CPLFree( pszSubdatasetName );
                     }
@@ -990,27 +1022,13 @@ public:
 
         if ( requiresReprojection || (profile && !profile->getSRS()->isEquivalentTo( src_srs.get() )) )
         {
-            if ( profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
-            {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
-            }
-            else
-            {
-                std::string destWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    destWKT.c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    0);
-            }
+            // Remember the warp parameters so we can build identical per-thread warped datasets.
+            _warpRequired = true;
+            _warpPolar    = profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar());
+            _warpSrcWKT   = src_srs->getWKT();
+            _warpDestWKT  = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
+
+            _warpedDS = createWarpedDataset( _srcDS );
 
             if ( _warpedDS )
             {
@@ -1028,6 +1046,11 @@ public:
             return Status::Error( "Failed to create a warping VRT" );
         }
 
+        // Per-thread warped datasets are built with the same parameters, so
+        // they all share these dimensions.
+        _rasterWidth  = _warpedDS->GetRasterXSize();
+        _rasterHeight = _warpedDS->GetRasterYSize();
+
         //Get the _geotransform
         if ( getProfile() )
         {
@@ -1149,16 +1172,98 @@ public:
         setProfile( profile );
         OE_DEBUG << LC << INDENT << "Set Profile to " << (profile ? profile->toString() : "NULL") <<  std::endl;
 
+        // Decide whether to read through per-thread dataset handles.
+        _concurrent = _options.concurrent().isSet() ?
+            _options.concurrent().value() :
+            Registry::instance()->isGDALConcurrencyEnabled();
+
+        if ( _concurrent && _openString.empty() )
+        {
+            OE_INFO << LC << INDENT << "Concurrent access is not available for this dataset; using serialized access" << std::endl;
+            _concurrent = false;
+        }
+
         return STATUS_OK;
     }
 
+    /**
+     * Creates a warped VRT over the source dataset, using the warp parameters
+     * established in initialize(). Call with the GDAL lock held.
+     */
+    GDALDataset* createWarpedDataset(GDALDataset* srcDS) const
+    {
+        if ( _warpPolar )
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+        else
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRT(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                0);
+        }
+    }
+
+    /**
+     * In concurrent mode, returns the warped dataset owned by the calling thread,
+     * opening it on first use. Returns NULL in serialized mode (or if the per-thread
+     * open failed), in which case the caller must use _warpedDS under the GDAL lock.
+     */
+    GDALDataset* getThreadDataset()
+    {
+        if ( !_concurrent )
+            return 0L;
+
+        ThreadDatasets* handles = 0L;
+        {
+            Threading::ScopedMutexLock lock( _threadDatasetsMutex );
+            handles = &_threadDatasets[Threading::getCurrentThreadId()];
+        }
+
+        // only the calling thread ever touches its own entry.
+        if ( !handles->_warpedDS && !handles->_failed )
+        {
+            // opening a dataset touches global GDAL state.
+            GDAL_SCOPED_LOCK;
+
+            handles->_srcDS = (GDALDataset*)GDALOpen( _openString.c_str(), GA_ReadOnly );
+            if ( handles->_srcDS )
+            {
+                handles->_warpedDS = _warpRequired ? createWarpedDataset(handles->_srcDS) : handles->_srcDS;
+            }
+
+            if ( !handles->_warpedDS )
+            {
+                OE_WARN << LC << "Failed to open per-thread dataset; falling back on serialized access" << std::endl;
+                if ( handles->_srcDS )
+                {
+                    GDALClose( handles->_srcDS );
+                    handles->_srcDS = 0L;
+                }
+                handles->_failed = true;
+            }
+        }
+
+        return handles->_warpedDS;
+    }
+
 
     /**
     * Finds a raster band based on color interpretation
     */
-    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
     {
-        GDAL_SCOPED_LOCK;
+        GDAL_SCOPED_LOCK_IF( !_concurrent );
 
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
@@ -1167,9 +1272,9 @@ public:
         return 0;
     }
 
-    static GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
+    GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
     {
-        GDAL_SCOPED_LOCK;
+        GDAL_SCOPED_LOCK_IF( !_concurrent );
 
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
@@ -1271,8 +1376,8 @@ public:
         double eps = 0.0001;
         if (osg::equivalent(x, 0, eps)) x = 0;
         if (osg::equivalent(y, 0, eps)) y = 0;
-        if (osg::equivalent(x, (double)_warpedDS->GetRasterXSize(), eps)) x = _warpedDS->GetRasterXSize();
-        if (osg::equivalent(y, (double)_warpedDS->GetRasterYSize(), eps)) y = _warpedDS->GetRasterYSize();
+        if (osg::equivalent(x, (double)_rasterWidth, eps)) x = _rasterWidth;
+        if (osg::equivalent(y, (double)_rasterHeight, eps)) y = _rasterHeight;
 
     }
 
@@ -1286,7 +1391,11 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Use this thread's own dataset if possible; otherwise serialize on the GDAL lock.
+        GDALDataset* warpedDS = getThreadDataset();
+        GDAL_SCOPED_LOCK_IF( warpedDS == 0L );
+        if ( !warpedDS )
+            warpedDS = _warpedDS;
 
         int tileSize = _options.tileSize().value();
 
@@ -1318,8 +1427,8 @@ public:
             int height = (int)(src_max_y - src_min_y);
 
 
-            int rasterWidth = _warpedDS->GetRasterXSize();
-            int rasterHeight = _warpedDS->GetRasterYSize();
+            int rasterWidth = warpedDS->GetRasterXSize();
+            int rasterHeight = warpedDS->GetRasterYSize();
             if (off_x + width > rasterWidth || off_y + height > rasterHeight)
             {
                 OE_WARN << LC << "Read window outside of bounds of dataset.  Source Dimensions=" << rasterWidth << "x" << rasterHeight << " Read Window=" << off_x << ", " << off_y << " " << width << "x" << height << std::endl;
@@ -1353,44 +1462,44 @@ public:
 
 
 
-            GDALRasterBand* bandRed = findBandByColorInterp(_warpedDS, GCI_RedBand);
-            GDALRasterBand* bandGreen = findBandByColorInterp(_warpedDS, GCI_GreenBand);
-            GDALRasterBand* bandBlue = findBandByColorInterp(_warpedDS, GCI_BlueBand);
-            GDALRasterBand* bandAlpha = findBandByColorInterp(_warpedDS, GCI_AlphaBand);
+            GDALRasterBand* bandRed = findBandByColorInterp(warpedDS, GCI_RedBand);
+            GDALRasterBand* bandGreen = findBandByColorInterp(warpedDS, GCI_GreenBand);
+            GDALRasterBand* bandBlue = findBandByColorInterp(warpedDS, GCI_BlueBand);
+            GDALRasterBand* bandAlpha = findBandByColorInterp(warpedDS, GCI_AlphaBand);
 
-            GDALRasterBand* bandGray = findBandByColorInterp(_warpedDS, GCI_GrayIndex);
+            GDALRasterBand* bandGray = findBandByColorInterp(warpedDS, GCI_GrayIndex);
 
-            GDALRasterBand* bandPalette = findBandByColorInterp(_warpedDS, GCI_PaletteIndex);
+            GDALRasterBand* bandPalette = findBandByColorInterp(warpedDS, GCI_PaletteIndex);
 
             if (!bandRed && !bandGreen && !bandBlue && !bandAlpha && !bandGray && !bandPalette)
             {
                 OE_DEBUG << LC << "Could not determine bands based on color interpretation, using band count" << std::endl;
                 //We couldn't find any valid bands based on the color interp, so just make an educated guess based on the number of bands in the file
                 //RGB = 3 bands
-                if (_warpedDS->GetRasterCount() == 3)
+                if (warpedDS->GetRasterCount() == 3)
                 {
-                    bandRed   = _warpedDS->GetRasterBand( 1 );
-                    bandGreen = _warpedDS->GetRasterBand( 2 );
-                    bandBlue  = _warpedDS->GetRasterBand( 3 );
+                    bandRed   = warpedDS->GetRasterBand( 1 );
+                    bandGreen = warpedDS->GetRasterBand( 2 );
+                    bandBlue  = warpedDS->GetRasterBand( 3 );
                 }
                 //RGBA = 4 bands
-                else if (_warpedDS->GetRasterCount() == 4)
+                else if (warpedDS->GetRasterCount() == 4)
                 {
-                    bandRed   = _warpedDS->GetRasterBand( 1 );
-                    bandGreen = _warpedDS->GetRasterBand( 2 );
-                    bandBlue  = _warpedDS->GetRasterBand( 3 );
-                    bandAlpha = _warpedDS->GetRasterBand( 4 );
+                    bandRed   = warpedDS->GetRasterBand( 1 );
+                    bandGreen = warpedDS->GetRasterBand( 2 );
+                    bandBlue  = warpedDS->GetRasterBand( 3 );
+                    bandAlpha = warpedDS->GetRasterBand( 4 );
                 }
                 //Gray = 1 band
-                else if (_warpedDS->GetRasterCount() == 1)
+                else if (warpedDS->GetRasterCount() == 1)
                 {
-                    bandGray = _warpedDS->GetRasterBand( 1 );
+                    bandGray = warpedDS->GetRasterBand( 1 );
                 }
                 //Gray + alpha = 2 bands
-                else if (_warpedDS->GetRasterCount() == 2)
+                else if (warpedDS->GetRasterCount() == 2)
                 {
-                    bandGray  = _warpedDS->GetRasterBand( 1 );
-                    bandAlpha = _warpedDS->GetRasterBand( 2 );
+                    bandGray  = warpedDS->GetRasterBand( 1 );
+                    bandAlpha = warpedDS->GetRasterBand( 2 );
                 }
             }
 
@@ -1740,7 +1849,7 @@ public:
         return image.release();
     }
 
-    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    static float getBandNoDataValue(GDALRasterBand* band)
     {
         float bandNoData = -32767.0f;
         int success;
@@ -1749,7 +1858,16 @@ public:
         {
             bandNoData = value;
         }
+        return bandNoData;
+    }
+
+    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    {
+        return isValidValue_noLock(v, getBandNoDataValue(band));
+    }
 
+    bool isValidValue_noLock(float v, float bandNoData)
+    {
         //Check to see if the value is equal to the bands specified no data
         if (bandNoData == v) return false;
         //Check to see if the value is equal to the user specified nodata value
@@ -1764,12 +1882,80 @@ public:
 
     bool isValidValue(float v, GDALRasterBand* band)
     {
-        GDAL_SCOPED_LOCK;
+        // in concurrent mode the band belongs to the calling thread, or the
+        // caller already holds the lock for the shared dataset.
+        GDAL_SCOPED_LOCK_IF( !_concurrent );
         return isValidValue_noLock( v, band );
     }
 
 
+    /**
+     * Reads single source pixels directly from a raster band (one RasterIO per pixel).
+     */
+    struct BandSampler
+    {
+        BandSampler(GDALTileSource* source, GDALRasterBand* band) : _source(source), _band(band) { }
+
+        bool read(int col, int row, float& value)
+        {
+            _band->RasterIO(GF_Read, col, row, 1, 1, &value, 1, 1, GDT_Float32, 0, 0);
+            return _source->isValidValue(value, _band);
+        }
+
+        GDALTileSource* _source;
+        GDALRasterBand* _band;
+    };
+
+    /**
+     * Reads source pixels from a window of the raster band that was read into
+     * memory in a single RasterIO call, with validity precomputed per pixel.
+     */
+    struct WindowSampler
+    {
+        WindowSampler() : _x0(0), _y0(0), _width(0), _height(0) { }
+
+        /** Reads the window [x0, x0+width) x [y0, y0+height) from the band. */
+        bool load(GDALTileSource* source, GDALRasterBand* band, int x0, int y0, int width, int height)
+        {
+            _x0 = x0, _y0 = y0, _width = width, _height = height;
+            _data.resize(width * height);
+            _valid.resize(width * height);
+
+            if (band->RasterIO(GF_Read, x0, y0, width, height, &_data[0], width, height, GDT_Float32, 0, 0) != CE_None)
+                return false;
+
+            float bandNoData = getBandNoDataValue(band);
+            for (unsigned i = 0; i < _data.size(); ++i)
+            {
+                _valid[i] = source->isValidValue_noLock(_data[i], bandNoData) ? 1 : 0;
+            }
+            return true;
+        }
+
+        inline bool read(int col, int row, float& value) const
+        {
+            unsigned i = (row - _y0) * _width + (col - _x0);
+            value = _data[i];
+            return _valid[i] != 0;
+        }
+
+        int                        _x0, _y0, _width, _height;
+        std::vector<float>         _data;
+        std::vector<unsigned char> _valid;
+    };
+
     float getInterpolatedValue(GDALRasterBand *band, double x, double y, bool applyOffset=true)
+    {
+        BandSampler sampler(this, band);
+        return getInterpolatedValue(sampler, x, y, applyOffset);
+    }
+
+    /**
+     * Samples the source at a geographic location using the configured
+     * interpolation method. SAMPLER supplies the individual source pixels.
+     */
+    template<typename SAMPLER>
+    float getInterpolatedValue(SAMPLER& sampler, double x, double y, bool applyOffset=true)
     {
         double r, c;
         geoToPixel( x, y, c, r );
@@ -1788,31 +1974,30 @@ public:
             {
                 c = 0;
             }
-            else if (c > _warpedDS->GetRasterXSize()-1 && c <= _warpedDS->GetRasterXSize()-0.5)
+            else if (c > _rasterWidth-1 && c <= _rasterWidth-0.5)
             {
-                c = _warpedDS->GetRasterXSize()-1;
+                c = _rasterWidth-1;
             }
 
             if (r < 0 && r >= -0.5)
             {
                 r = 0;
             }
-            else if (r > _warpedDS->GetRasterYSize()-1 && r <= _warpedDS->GetRasterYSize()-0.5)
+            else if (r > _rasterHeight-1 && r <= _rasterHeight-0.5)
             {
-                r = _warpedDS->GetRasterYSize()-1;
+                r = _rasterHeight-1;
             }
         }
 
         float result = 0.0f;
 
         //If the location is outside of the pixel values of the dataset, just return 0
-        if (c < 0 || r < 0 || c > _warpedDS->GetRasterXSize()-1 || r > _warpedDS->GetRasterYSize()-1)
+        if (c < 0 || r < 0 || c > _rasterWidth-1 || r > _rasterHeight-1)
             return NO_DATA_VALUE;
 
         if ( _options.interpolation() == INTERP_NEAREST )
         {
-            band->RasterIO(GF_Read, (int)osg::round(c), (int)osg::round(r), 1, 1, &result, 1, 1, GDT_Float32, 0, 0);
-            if (!isValidValue( result, band))
+            if (!sampler.read((int)osg::round(c), (int)osg::round(r), result))
             {
                 return NO_DATA_VALUE;
             }
@@ -1820,27 +2005,21 @@ public:
         else
         {
             int rowMin = osg::maximum((int)floor(r), 0);
-            int rowMax = osg::maximum(osg::minimum((int)ceil(r), (int)(_warpedDS->GetRasterYSize()-1)), 0);
+            int rowMax = osg::maximum(osg::minimum((int)ceil(r), (int)(_rasterHeight-1)), 0);
             int colMin = osg::maximum((int)floor(c), 0);
-            int colMax = osg::maximum(osg::minimum((int)ceil(c), (int)(_warpedDS->GetRasterXSize()-1)), 0);
+            int colMax = osg::maximum(osg::minimum((int)ceil(c), (int)(_rasterWidth-1)), 0);
 
             if (rowMin > rowMax) rowMin = rowMax;
             if (colMin > colMax) colMin = colMax;
 
             float urHeight, llHeight, ulHeight, lrHeight;
 
-            band->RasterIO(GF_Read, colMin, rowMin, 1, 1, &llHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMin, rowMax, 1, 1, &ulHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMin, 1, 1, &lrHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMax, 1, 1, &urHeight, 1, 1, GDT_Float32, 0, 0);
-
-            /*
-            if (!isValidValue(urHeight, band)) urHeight = 0.0f;
-            if (!isValidValue(llHeight, band)) llHeight = 0.0f;
-            if (!isValidValue(ulHeight, band)) ulHeight = 0.0f;
-            if (!isValidValue(lrHeight, band)) lrHeight = 0.0f;
-            */
-            if ((!isValidValue(urHeight, band)) || (!isValidValue(llHeight, band)) ||(!isValidValue(ulHeight, band)) || (!isValidValue(lrHeight, band)))
+            bool llValid = sampler.read(colMin, rowMin, llHeight);
+            bool ulValid = sampler.read(colMin, rowMax, ulHeight);
+            bool lrValid = sampler.read(colMax, rowMin, lrHeight);
+            bool urValid = sampler.read(colMax, rowMax, urHeight);
+
+            if (!urValid || !llValid || !ulValid || !lrValid)
             {
                 return NO_DATA_VALUE;
             }
@@ -1894,6 +2073,44 @@ public:
     }
 
 
+    /**
+     * Computes the window of source pixels needed to interpolate every post of
+     * the tile, including a one-pixel apron. Returns false if the window is empty.
+     */
+    bool getReadWindow(double xmin, double ymin, double xmax, double ymax, int& x0, int& y0, int& width, int& height)
+    {
+        double cx[4], cy[4];
+        geoToPixel(xmin, ymin, cx[0], cy[0]);
+        geoToPixel(xmin, ymax, cx[1], cy[1]);
+        geoToPixel(xmax, ymin, cx[2], cy[2]);
+        geoToPixel(xmax, ymax, cx[3], cy[3]);
+
+        double minC = cx[0], maxC = cx[0], minR = cy[0], maxR = cy[0];
+        for (int i = 1; i < 4; ++i)
+        {
+            minC = osg::minimum(minC, cx[i]); maxC = osg::maximum(maxC, cx[i]);
+            minR = osg::minimum(minR, cy[i]); maxR = osg::maximum(maxR, cy[i]);
+        }
+
+        // account for the half pixel offset, and add the apron.
+        int rasterWidth  = _rasterWidth;
+        int rasterHeight = _rasterHeight;
+        int colLo = osg::maximum((int)floor(minC - 0.5) - 1, 0);
+        int colHi = osg::minimum((int)ceil (maxC - 0.5) + 1, rasterWidth - 1);
+        int rowLo = osg::maximum((int)floor(minR - 0.5) - 1, 0);
+        int rowHi = osg::minimum((int)ceil (maxR - 0.5) + 1, rasterHeight - 1);
+
+        if (colLo > colHi || rowLo > rowHi)
+            return false;
+
+        x0 = colLo;
+        y0 = rowLo;
+        width  = colHi - colLo + 1;
+        height = rowHi - rowLo + 1;
+        return true;
+    }
+
+
 #if 1
     osg::HeightField* createHeightField( const TileKey&        key,
                                          ProgressCallback*     progress)
@@ -1904,7 +2121,11 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Use this thread's own dataset if possible; otherwise serialize on the GDAL lock.
+        GDALDataset* warpedDS = getThreadDataset();
+        GDAL_SCOPED_LOCK_IF( warpedDS == 0L );
+        if ( !warpedDS )
+            warpedDS = _warpedDS;
 
         int tileSize = _options.tileSize().value();
 
@@ -1919,24 +2140,52 @@ public:
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             double dx = (xmax - xmin) / (tileSize-1);
             double dy = (ymax - ymin) / (tileSize-1);
 
+            // Read all the source pixels covering the tile in one shot and interpolate
+            // in memory. For low LODs over high-res data the window can be huge, so in
+            // that case fall back on reading just the pixels each post needs.
+            int x0, y0, width, height;
+            WindowSampler window;
+            bool useWindow =
+                getReadWindow(xmin, ymin, xmax, ymax, x0, y0, width, height) &&
+                width  <= MAX_READ_WINDOW_SCALE * tileSize &&
+                height <= MAX_READ_WINDOW_SCALE * tileSize &&
+                window.load(this, band, x0, y0, width, height);
+
+            if ( useWindow )
+            {
                 for (int r = 0; r < tileSize; ++r)
                 {
                     double geoY = ymin + (dy * (double)r);
-                for (int c = 0; c < tileSize; ++c)
+                    for (int c = 0; c < tileSize; ++c)
+                    {
+                        double geoX = xmin + (dx * (double)c);
+                        float h = getInterpolatedValue(window, geoX, geoY);
+                        hf->setHeight(c, r, h);
+                    }
+                }
+            }
+            else
+            {
+                BandSampler sampler(this, band);
+                for (int r = 0; r < tileSize; ++r)
                 {
-                    double geoX = xmin + (dx * (double)c);
-                    float h = getInterpolatedValue(band, geoX, geoY);
-                    hf->setHeight(c, r, h);
+                    double geoY = ymin + (dy * (double)r);
+                    for (int c = 0; c < tileSize; ++c)
+                    {
+                        double geoX = xmin + (dx * (double)c);
+                        float h = getInterpolatedValue(sampler, geoX, geoY);
+                        hf->setHeight(c, r, h);
+                    }
                 }
             }
         }
@@ -1985,7 +2234,11 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Use this thread's own dataset if possible; otherwise serialize on the GDAL lock.
+        GDALDataset* warpedDS = getThreadDataset();
+        GDAL_SCOPED_LOCK_IF( warpedDS == 0L );
+        if ( !warpedDS )
+            warpedDS = _warpedDS;
 
         int tileSize = _options.tileSize().value();
 
@@ -2009,8 +2262,8 @@ public:
             geoToPixel( intersection.xMin(), intersection.yMax(), src_min_x, src_min_y);
             geoToPixel( intersection.xMax(), intersection.yMin(), src_max_x, src_max_y);
 
-            int rasterWidth = _warpedDS->GetRasterXSize();
-            int rasterHeight = _warpedDS->GetRasterYSize();
+            int rasterWidth = warpedDS->GetRasterXSize();
+            int rasterHeight = warpedDS->GetRasterYSize();
 
             // Convert the doubles to integers.  We floor the mins and ceil the maximums to give the widest window possible.
             src_min_x = osg::round(src_min_x);
@@ -2173,11 +2426,11 @@ public:
             OE_DEBUG << LC << "Read extents " << read_min_x << ", " << read_min_y << " to " << read_max_x << ", " << read_max_y << std::endl;
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             float *heights = new float[target_width * target_height];
@@ -2262,6 +2515,29 @@ private:
     osg::ref_ptr< osgDB::Options > _dbOptions;
 
     unsigned int _maxDataLevel;
+    int          _rasterWidth;
+    int          _rasterHeight;
+
+    // per-thread dataset handles (concurrent mode)
+    struct ThreadDatasets
+    {
+        ThreadDatasets() : _srcDS(0L), _warpedDS(0L), _failed(false) { }
+        GDALDataset* _srcDS;
+        GDALDataset* _warpedDS;
+        bool         _failed;
+    };
+    typedef std::map<unsigned, ThreadDatasets> ThreadDatasetsMap;
+
+    bool              _concurrent;
+    std::string       _openString;
+    ThreadDatasetsMap _threadDatasets;
+    Threading::Mutex  _threadDatasetsMutex;
+
+    // warp parameters, for creating per-thread warped datasets
+    bool        _warpRequired;
+    bool        _warpPolar;
+    std::string _warpSrcWKT;
+    std::string _warpDestWKT;
 };
 
 
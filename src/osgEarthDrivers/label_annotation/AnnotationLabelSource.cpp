@@ -18,6 +18,7 @@
  */
 #include <osgEarthFeatures/LabelSource>
 #include <osgEarthFeatures/FeatureSourceIndexNode>
+#include <osgEarthFeatures/CompiledExpression>
 #include <osgEarthAnnotation/LabelNode>
 #include <osgEarthAnnotation/PlaceNode>
 #include <osgEarth/DepthOffset>
@@ -58,12 +59,12 @@ public:
 
         osg::Group* group = new osg::Group();
         
-        StringExpression  textContentExpr ( text ? *text->content()  : StringExpression() );
-        NumericExpression textPriorityExpr( text ? *text->priority() : NumericExpression() );
-        NumericExpression textSizeExpr    ( text ? *text->size()     : NumericExpression() );
-        StringExpression  iconUrlExpr     ( icon ? *icon->url()      : StringExpression() );
-        NumericExpression iconScaleExpr   ( icon ? *icon->scale()    : NumericExpression() );
-        NumericExpression iconHeadingExpr ( icon ? *icon->heading()  : NumericExpression() );
+        CompiledStringExpression  textContentExpr ( text ? *text->content()  : StringExpression(),  input );
+        CompiledNumericExpression textPriorityExpr( text ? *text->priority() : NumericExpression(), input );
+        CompiledNumericExpression textSizeExpr    ( text ? *text->size()     : NumericExpression(), input );
+        CompiledStringExpression  iconUrlExpr     ( icon ? *icon->url()      : StringExpression(),  input );
+        CompiledNumericExpression iconScaleExpr   ( icon ? *icon->scale()    : NumericExpression(), input );
+        CompiledNumericExpression iconHeadingExpr ( icon ? *icon->heading()  : NumericExpression(), input );
 
         for( FeatureList::const_iterator i = input.begin(); i != input.end(); ++i )
         {
@@ -98,22 +99,22 @@ public:
             if ( text )
             {
                 if ( text->content().isSet() )
-                    tempStyle.get<TextSymbol>()->content()->setLiteral( feature->eval( textContentExpr, &context ) );
+                    tempStyle.get<TextSymbol>()->content()->setLiteral( textContentExpr.eval(feature, &context) );
 
                 if ( text->size().isSet() )
-                    tempStyle.get<TextSymbol>()->size()->setLiteral( feature->eval(textSizeExpr, &context) );
+                    tempStyle.get<TextSymbol>()->size()->setLiteral( textSizeExpr.eval(feature, &context) );
             }
 
             if ( icon )
             {
                 if ( icon->url().isSet() )
-                    tempStyle.get<IconSymbol>()->url()->setLiteral( feature->eval(iconUrlExpr, &context) );
+                    tempStyle.get<IconSymbol>()->url()->setLiteral( iconUrlExpr.eval(feature, &context) );
 
                 if ( icon->scale().isSet() )
-                    tempStyle.get<IconSymbol>()->scale()->setLiteral( feature->eval(iconScaleExpr, &context) );
+                    tempStyle.get<IconSymbol>()->scale()->setLiteral( iconScaleExpr.eval(feature, &context) );
 
                 if ( icon->heading().isSet() )
-                    tempStyle.get<IconSymbol>()->heading()->setLiteral( feature->eval(iconHeadingExpr, &context) );
+                    tempStyle.get<IconSymbol>()->heading()->setLiteral( iconHeadingExpr.eval(feature, &context) );
             }
             
             osg::Node* node = makePlaceNode(
@@ -141,10 +142,10 @@ public:
     }
 
 
-    osg::Node* makePlaceNode(FilterContext&     context,
-                             Feature*           feature, 
-                             const Style&       style, 
-                             NumericExpression& priorityExpr )
+    osg::Node* makePlaceNode(FilterContext&                   context,
+                             Feature*                         feature, 
+                             const Style&                     style, 
+                             const CompiledNumericExpression& priorityExpr )
     {
         osg::Vec3d center = feature->getGeometry()->getBounds().center();
 
@@ -162,10 +163,10 @@ public:
 
         PlaceNode* node = new PlaceNode(0L, point, style, context.getDBOptions());
 
-        if ( !priorityExpr.empty() )
+        if ( !priorityExpr.expr().empty() )
         {
             AnnotationData* data = new AnnotationData();
-            data->setPriority( feature->eval(priorityExpr, &context) );
+            data->setPriority( priorityExpr.eval(feature, &context) );
             node->setAnnotationData( data );
         }
 
@@ -63,11 +63,34 @@ _options  ( options ),
 _database ( NULL ),
 _minLevel ( 0 ),
 _maxLevel ( 20 ),
-_forceRGB ( false )
+_forceRGB ( false ),
+_writeBatchSize( 1u ),
+_insert   ( NULL )
 {
     //nop
 }
 
+MBTilesTileSource::~MBTilesTileSource()
+{
+    // commit anything left in the write queue.
+    flushWrites();
+
+    for(ReaderConnections::iterator i = _readers.begin(); i != _readers.end(); ++i)
+    {
+        if ( i->second._select )
+            sqlite3_finalize( i->second._select );
+        if ( i->second._db )
+            sqlite3_close( i->second._db );
+    }
+    _readers.clear();
+
+    if ( _insert )
+        sqlite3_finalize( _insert );
+
+    if ( _database )
+        sqlite3_close( _database );
+}
+
 TileSource::Status
 MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 {    
@@ -78,6 +101,9 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
     std::string fullFilename = _options.filename()->full();   
     bool isNewDatabase = readWrite && !osgDB::fileExists(fullFilename);
 
+    _fullFilename = fullFilename;
+    _writeBatchSize = osg::maximum( _options.writeBatchSize().get(), 1u );
+
     if ( isNewDatabase )
     {
         // For a NEW database, the profile MUST be set prior to initialization.
@@ -112,6 +138,16 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
         return Status::Error( Stringify()
             << "Database \"" << fullFilename << "\": " << sqlite3_errmsg(_database) );
     }
+
+    // Write-ahead logging lets the per-thread reader connections run
+    // concurrently with the writer.
+    if ( readWrite )
+    {
+        if ( SQLITE_OK != sqlite3_exec(_database, "PRAGMA journal_mode=WAL", 0L, 0L, 0L) )
+        {
+            OE_INFO << LC << "Failed to enable WAL mode; readers may block on writes" << std::endl;
+        }
+    }
     
     // New database setup:
     if ( isNewDatabase )
@@ -270,8 +306,6 @@ osg::Image*
 MBTilesTileSource::createImage(const TileKey&    key,
                                ProgressCallback* progress)
 {
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     int z = key.getLevelOfDetail();
     int x = key.getTileX();
     int y = key.getTileY();
@@ -291,67 +325,143 @@ MBTilesTileSource::createImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
-    //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &select, 0L );
-    if ( rc != SQLITE_OK )
+    std::string dataBuffer;
+    bool found = false;
+
+    // Tiles waiting in the write queue are newer than what's in the database.
+    if ( (getMode() & MODE_WRITE) != 0 )
+    {
+        found = getQueuedTile(z, x, y, dataBuffer);
+    }
+
+    if ( !found )
+    {
+        // Each thread reads through its own connection and cached statement,
+        // so readers never wait on each other.
+        sqlite3_stmt* select = getReaderStatement();
+        if ( !select )
+        {
+            return NULL;
+        }
+
+        sqlite3_bind_int( select, 1, z );
+        sqlite3_bind_int( select, 2, x );
+        sqlite3_bind_int( select, 3, y );
+
+        int rc = sqlite3_step( select );
+        if ( rc == SQLITE_ROW)
+        {                     
+            // the pointer returned from _blob gets freed internally by sqlite, supposedly
+            const char* data = (const char*)sqlite3_column_blob( select, 0 );
+            int dataLen = sqlite3_column_bytes( select, 0 );
+
+            dataBuffer.assign( data, dataLen );
+            found = true;
+        }
+        else
+        {
+            OE_DEBUG << LC << "SQL QUERY failed for tile " << key.str() << std::endl;
+        }
+
+        sqlite3_reset( select );
+    }
+
+    if ( !found )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
         return NULL;
     }
 
-    bool valid = true;        
+    bool valid = true;
 
-    sqlite3_bind_int( select, 1, z );
-    sqlite3_bind_int( select, 2, x );
-    sqlite3_bind_int( select, 3, y );
+    // decompress if necessary:
+    if ( _compressor.valid() )
+    {
+        std::istringstream inputStream(dataBuffer);
+        std::string value;
+        if ( !_compressor->decompress(inputStream, value) )
+        {
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            valid = false;
+        }
+        else
+        {
+            dataBuffer = value;
+        }
+    }
 
+    // decode the raw image data:
     osg::Image* result = NULL;
-    rc = sqlite3_step( select );
-    if ( rc == SQLITE_ROW)
-    {                     
-        // the pointer returned from _blob gets freed internally by sqlite, supposedly
-        const char* data = (const char*)sqlite3_column_blob( select, 0 );
-        int dataLen = sqlite3_column_bytes( select, 0 );
+    if ( valid )
+    {
+        std::istringstream inputStream(dataBuffer);
+        osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
+        if (rr.validImage())
+        {
+            result = rr.takeImage();                
+        }
+    }
+
+    return result;
+}
 
-        std::string dataBuffer( data, dataLen );
+sqlite3_stmt*
+MBTilesTileSource::getReaderStatement()
+{
+    ReaderConnection* conn = 0L;
+    {
+        Threading::ScopedMutexLock lock(_readersMutex);
+        conn = &_readers[Threading::getCurrentThreadId()];
+    }
 
-        // decompress if necessary:
-        if ( _compressor.valid() )
+    // only the calling thread ever touches its own connection.
+    if ( conn->_select == 0L )
+    {
+        int rc = sqlite3_open_v2( _fullFilename.c_str(), &conn->_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 0L );
+        if ( rc != SQLITE_OK )
         {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
-            {
-                OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
-            }
-            else
-            {
-                dataBuffer = value;
-            }
+            OE_WARN << LC << "Failed to open reader connection to \"" << _fullFilename << "\": " << sqlite3_errmsg(conn->_db) << std::endl;
+            sqlite3_close( conn->_db );
+            conn->_db = 0L;
+            return 0L;
         }
 
-        // decode the raw image data:
-        if ( valid )
+        std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+        rc = sqlite3_prepare_v2( conn->_db, query.c_str(), -1, &conn->_select, 0L );
+        if ( rc != SQLITE_OK )
         {
-            std::istringstream inputStream(dataBuffer);
-            osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
-            if (rr.validImage())
-            {
-                result = rr.takeImage();                
-            }
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(conn->_db) << std::endl;
+            sqlite3_close( conn->_db );
+            conn->_db = 0L;
+            conn->_select = 0L;
+            return 0L;
         }
     }
-    else
+
+    return conn->_select;
+}
+
+bool
+MBTilesTileSource::getQueuedTile(int z, int x, int y, std::string& out_data)
+{
+    Threading::ScopedMutexLock lock(_queueMutex);
+
+    TileAddress address(z, x, y);
+
+    TileWrites::const_iterator i = _queuedWrites.find(address);
+    if ( i != _queuedWrites.end() )
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        out_data = i->second;
+        return true;
     }
 
-    sqlite3_finalize( select );
-    return result;
+    i = _flushing.find(address);
+    if ( i != _flushing.end() )
+    {
+        out_data = i->second;
+        return true;
+    }
+
+    return false;
 }
 
 bool 
@@ -362,8 +472,6 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     if ( (getMode() & MODE_WRITE) == 0 )
         return false;
 
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     // encode the data stream:
     std::stringstream buf;
     osgDB::ReaderWriter::WriteResult wr;
@@ -406,45 +514,113 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
-    // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
-    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L );
-    if ( rc != SQLITE_OK )
+    // queue the tile; the batch is committed when it fills up. Only report
+    // a failure to commit this tile, not the others in the batch.
+    TileAddress address(z, x, y);
+    bool flush = false;
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return NULL;
+        Threading::ScopedMutexLock lock(_queueMutex);
+        _queuedWrites[address] = value;
+        flush = _queuedWrites.size() >= _writeBatchSize;
     }
 
-    // bind parameters:
-    sqlite3_bind_int( insert, 1, z );
-    sqlite3_bind_int( insert, 2, x );
-    sqlite3_bind_int( insert, 3, y );
+    return flush ? flushWrites(&address) : true;
+}
 
-    // bind the data blob:
-    sqlite3_bind_blob( insert, 4, value.c_str(), value.length(), SQLITE_STATIC );
+bool
+MBTilesTileSource::flushWrites(const TileAddress* address)
+{
+    // The primary connection lock also serializes flushes, so only one batch
+    // is ever in _flushing at a time.
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
 
-    // run the sql.
-    bool ok = true;
-    int tries = 0;
-    do {
-        rc = sqlite3_step(insert);
+    {
+        Threading::ScopedMutexLock lock(_queueMutex);
+        if ( _queuedWrites.empty() )
+            return true;
+        _flushing.swap( _queuedWrites );
     }
-    while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
 
-    if (SQLITE_OK != rc && SQLITE_DONE != rc)
+    // Prep the insert statement once:
+    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+    if ( _insert == NULL )
     {
+        int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &_insert, 0L );
+        if ( rc != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database)
+                << "; dropped " << _flushing.size() << " queued tiles" << std::endl;
+            _insert = NULL;
+            Threading::ScopedMutexLock lock(_queueMutex);
+            bool ok = address == 0L || _flushing.find(*address) == _flushing.end();
+            _flushing.clear();
+            return ok;
+        }
+    }
+
+    // one transaction for the whole batch, so we only pay for one sync.
+    if ( SQLITE_OK != sqlite3_exec(_database, "BEGIN TRANSACTION", 0L, 0L, 0L) )
+    {
+        OE_WARN << LC << "Failed to begin transaction: " << sqlite3_errmsg(_database) << std::endl;
+    }
+
+    bool ok = true;
+    bool addressOK = true;
+
+    for(TileWrites::const_iterator i = _flushing.begin(); i != _flushing.end(); ++i)
+    {
+        // bind parameters:
+        sqlite3_bind_int( _insert, 1, i->first._z );
+        sqlite3_bind_int( _insert, 2, i->first._x );
+        sqlite3_bind_int( _insert, 3, i->first._y );
+
+        // bind the data blob:
+        sqlite3_bind_blob( _insert, 4, i->second.c_str(), i->second.length(), SQLITE_STATIC );
+
+        // run the sql.
+        int rc;
+        int tries = 0;
+        do {
+            rc = sqlite3_step(_insert);
+        }
+        while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
+
+        if (SQLITE_OK != rc && SQLITE_DONE != rc)
+        {
 #if SQLITE_VERSION_NUMBER >= 3007015
-        OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(_database) << std::endl;
+            OE_WARN << LC << "Failed to write tile " << i->first._z << "/" << i->first._x << "/" << i->first._y
+                << ": " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(_database) << std::endl;
 #else
-        OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(_database) << std::endl;
+            OE_WARN << LC << "Failed to write tile " << i->first._z << "/" << i->first._x << "/" << i->first._y
+                << ": " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(_database) << std::endl;
 #endif        
+            ok = false;
+            if ( address && !(*address < i->first) && !(i->first < *address) )
+                addressOK = false;
+        }
+
+        sqlite3_reset( _insert );
+    }
+
+    if ( SQLITE_OK != sqlite3_exec(_database, "COMMIT TRANSACTION", 0L, 0L, 0L) )
+    {
+        std::ostringstream tiles;
+        for(TileWrites::const_iterator i = _flushing.begin(); i != _flushing.end(); ++i)
+            tiles << " " << i->first._z << "/" << i->first._x << "/" << i->first._y;
+
+        OE_WARN << LC << "Failed to commit transaction: " << sqlite3_errmsg(_database)
+            << "; lost " << _flushing.size() << " tiles:" << tiles.str() << std::endl;
         ok = false;
+        addressOK = false;
     }
 
-    sqlite3_finalize( insert );
+    // committed; readers will find these tiles in the database now.
+    {
+        Threading::ScopedMutexLock lock(_queueMutex);
+        _flushing.clear();
+    }
 
-    return ok;
+    return address ? addressOK : ok;
 }
 
 bool
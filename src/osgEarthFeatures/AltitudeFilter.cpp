@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/AltitudeFilter>
+#include <osgEarthFeatures/CompiledExpression>
 #include <osgEarth/ElevationQuery>
 #include <osgEarth/GeoData>
 
@@ -65,13 +66,13 @@ AltitudeFilter::push( FeatureList& features, FilterContext& cx )
 void
 AltitudeFilter::pushAndDontClamp( FeatureList& features, FilterContext& cx )
 {
-    NumericExpression scaleExpr;
+    CompiledNumericExpression scaleExpr;
     if ( _altitude.valid() && _altitude->verticalScale().isSet() )
-        scaleExpr = *_altitude->verticalScale();
+        scaleExpr.compile( *_altitude->verticalScale(), features );
 
-    NumericExpression offsetExpr;
+    CompiledNumericExpression offsetExpr;
     if ( _altitude.valid() && _altitude->verticalOffset().isSet() )
-        offsetExpr = *_altitude->verticalOffset();
+        offsetExpr.compile( *_altitude->verticalOffset(), features );
 
     bool gpuClamping =
         _altitude.valid() &&
@@ -97,11 +98,11 @@ AltitudeFilter::pushAndDontClamp( FeatureList& features, FilterContext& cx )
 
         double scaleZ = 1.0;
         if ( _altitude.valid() && _altitude->verticalScale().isSet() )
-            scaleZ = feature->eval( scaleExpr, &cx );
+            scaleZ = scaleExpr.eval( feature, &cx );
 
         optional<double> offsetZ( 0.0 );
         if ( _altitude.valid() && _altitude->verticalOffset().isSet() )
-            offsetZ = feature->eval( offsetExpr, &cx );       
+            offsetZ = offsetExpr.eval( feature, &cx );       
         
         GeometryIterator gi( feature->getGeometry() );
         while( gi.hasMore() )
@@ -155,19 +156,17 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     const SpatialReference* mapSRS = mapf.getProfile()->getSRS();
     osg::ref_ptr<const SpatialReference> featureSRS = cx.profile()->getSRS();
 
-    // establish an elevation query interface based on the features' SRS.
-    ElevationQuery eq( mapf );
+    // the session's sampler keeps the elevation tiles around for the next
+    // feature tile (and the other compiler threads).
+    BatchElevationSampler* sampler = session->getElevationSampler();
 
-    // want a result even if it's low res
-    eq.setFallBackOnNoData( true );
-
-    NumericExpression scaleExpr;
+    CompiledNumericExpression scaleExpr;
     if ( _altitude->verticalScale().isSet() )
-        scaleExpr = *_altitude->verticalScale();
+        scaleExpr.compile( *_altitude->verticalScale(), features );
 
-    NumericExpression offsetExpr;
+    CompiledNumericExpression offsetExpr;
     if ( _altitude->verticalOffset().isSet() )
-        offsetExpr = *_altitude->verticalOffset();
+        offsetExpr.compile( *_altitude->verticalOffset(), features );
 
     // whether to record the min/max height-above-terrain values.
     bool collectHATs =
@@ -182,6 +181,20 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     bool vertEquiv =
         featureSRS->isVertEquivalentTo( mapSRS );
 
+    // for converting Z values (which end up in the map's vertical datum)
+    // back to the feature's SRS.
+    osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
+        SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
+
+    // First pass: evaluate the per-feature expressions and gather every point
+    // to clamp (each vertex, or the centroid of each part) so that the whole
+    // list goes to the terrain in one batch.
+    std::vector<double>     scales;
+    std::vector<double>     offsets;
+    std::vector<osg::Vec3d> points;
+
+    scales.reserve( features.size() );
+    offsets.reserve( features.size() );
 
     for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
     {
@@ -194,101 +207,128 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             feature->eval( temp, &cx );
         }
 
-        double maxTerrainZ  = -DBL_MAX;
-        double minTerrainZ  =  DBL_MAX;
-        double minHAT       =  DBL_MAX;
-        double maxHAT       = -DBL_MAX;
-
         double scaleZ = 1.0;
         if ( _altitude.valid() && _altitude->verticalScale().isSet() )
-            scaleZ = feature->eval( scaleExpr, &cx );
+            scaleZ = scaleExpr.eval( feature, &cx );
+        scales.push_back( scaleZ );
 
         double offsetZ = 0.0;
         if ( _altitude.valid() && _altitude->verticalOffset().isSet() )
-            offsetZ = feature->eval( offsetExpr, &cx );
+            offsetZ = offsetExpr.eval( feature, &cx );
+        offsets.push_back( offsetZ );
+
+        GeometryIterator gi( feature->getGeometry() );
+        while( gi.hasMore() )
+        {
+            Geometry* geom = gi.next();
+            if ( perVertex )
+            {
+                points.insert( points.end(), geom->begin(), geom->end() );
+            }
+            else
+            {
+                osgEarth::Bounds bounds = geom->getBounds();
+                const osg::Vec2d& center = bounds.center2d();
+                points.push_back( osg::Vec3d(center.x(), center.y(), 0.0) );
+            }
+        }
+    }
+
+    std::vector<double>                 elevations;
+    std::vector<ElevationQuery::Status> status;
+    sampler->getElevations( mapf, points, featureSRS.get(), elevations, &status, _maxRes );
+
+    // Second pass: walk the geometry in the same order and apply the results.
+    unsigned next = 0;
+    unsigned f    = 0;
+
+    for( FeatureList::iterator i = features.begin(); i != features.end(); ++i, ++f )
+    {
+        Feature* feature = i->get();
+
+        double maxTerrainZ  = -DBL_MAX;
+        double minTerrainZ  =  DBL_MAX;
+        double minHAT       =  DBL_MAX;
+        double maxHAT       = -DBL_MAX;
+
+        double scaleZ  = scales[f];
+        double offsetZ = offsets[f];
         
         GeometryIterator gi( feature->getGeometry() );
         while( gi.hasMore() )
         {
             Geometry* geom = gi.next();
 
+            // index of this part's first result
+            unsigned base = next;
+            next += perVertex ? geom->size() : 1u;
+
             // Absolute heights in Z. Only need to collect the HATs; the geometry
             // remains unchanged.
             if ( _altitude->clamping() == AltitudeSymbol::CLAMP_ABSOLUTE )
             {
                 if ( perVertex )
                 {
-                    std::vector<double> elevations;
-                    elevations.reserve( geom->size() );
-
-                    if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
-                        {
-                            osg::Vec3d& p = (*geom)[i];
+                        osg::Vec3d& p = (*geom)[i];
+                        double elevation = elevations[base+i];
 
-                            p.z() *= scaleZ;
-                            p.z() += offsetZ;
+                        p.z() *= scaleZ;
+                        p.z() += offsetZ;
 
-                            double z = p.z();
+                        double z = p.z();
 
-                            if ( !vertEquiv )
-                            {
-                                osg::Vec3d tempgeo;
-                                if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
-                                    z = tempgeo.z();
-                            }
+                        if ( !vertEquiv )
+                        {
+                            osg::Vec3d tempgeo;
+                            if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
+                                z = tempgeo.z();
+                        }
 
-                            double hat = z - elevations[i];
+                        double hat = z - elevation;
 
-                            if ( hat > maxHAT )
-                                maxHAT = hat;
-                            if ( hat < minHAT )
-                                minHAT = hat;
+                        if ( hat > maxHAT )
+                            maxHAT = hat;
+                        if ( hat < minHAT )
+                            minHAT = hat;
 
-                            if ( elevations[i] > maxTerrainZ )
-                                maxTerrainZ = elevations[i];
-                            if ( elevations[i] < minTerrainZ )
-                                minTerrainZ = elevations[i];
-                        }
+                        if ( elevation > maxTerrainZ )
+                            maxTerrainZ = elevation;
+                        if ( elevation < minTerrainZ )
+                            minTerrainZ = elevation;
                     }
                 }
-                else // per centroid
+                else if ( status[base] == ElevationQuery::STATUS_OK ) // per centroid
                 {
-                    osgEarth::Bounds bounds = geom->getBounds();
-                    const osg::Vec2d& center = bounds.center2d();
-                    GeoPoint centroid(featureSRS, center.x(), center.y());
-                    double   centroidElevation;
+                    double centroidElevation = elevations[base];
 
-                    if ( eq.getElevation( centroid, centroidElevation, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
+                        osg::Vec3d& p = (*geom)[i];
+                        p.z() *= scaleZ;
+                        p.z() += offsetZ;
+
+                        double z = p.z();
+                        if ( !vertEquiv )
                         {
-                            osg::Vec3d& p = (*geom)[i];
-                            p.z() *= scaleZ;
-                            p.z() += offsetZ;
-
-                            double z = p.z();
-                            if ( !vertEquiv )
-                            {
-                                osg::Vec3d tempgeo;
-                                if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
-                                    z = tempgeo.z();
-                            }
-
-                            double hat = z - centroidElevation;
-
-                            if ( hat > maxHAT )
-                                maxHAT = hat;
-                            if ( hat < minHAT )
-                                minHAT = hat;
+                            osg::Vec3d tempgeo;
+                            if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
+                                z = tempgeo.z();
                         }
 
-                        if ( centroidElevation > maxTerrainZ )
-                            maxTerrainZ = centroidElevation;
-                        if ( centroidElevation < minTerrainZ )
-                            minTerrainZ = centroidElevation;
+                        double hat = z - centroidElevation;
+
+                        if ( hat > maxHAT )
+                            maxHAT = hat;
+                        if ( hat < minHAT )
+                            minHAT = hat;
                     }
+
+                    if ( centroidElevation > maxTerrainZ )
+                        maxTerrainZ = centroidElevation;
+                    if ( centroidElevation < minTerrainZ )
+                        minTerrainZ = centroidElevation;
                 }
             }
 
@@ -296,81 +336,67 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             // and record HATs along the way.
             else if ( _altitude->clamping() == AltitudeSymbol::CLAMP_RELATIVE_TO_TERRAIN )
             {
-                osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
-                    SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
-
                 if ( perVertex )
                 {
-                    std::vector<double> elevations;
-                    elevations.reserve( geom->size() );
-
-                    if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
-                        {
-                            osg::Vec3d& p = (*geom)[i];
+                        osg::Vec3d& p = (*geom)[i];
+                        double elevation = elevations[base+i];
 
-                            p.z() *= scaleZ;
-                            p.z() += offsetZ;
+                        p.z() *= scaleZ;
+                        p.z() += offsetZ;
 
-                            double hat = p.z();
-                            p.z() = elevations[i] + p.z();
+                        double hat = p.z();
+                        p.z() = elevation + p.z();
 
-                            // if necessary, convert the Z value (which is now in the map's SRS) back to
-                            // the feature's SRS.
-                            if ( !vertEquiv )
-                            {
-                                featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                            }
+                        // if necessary, convert the Z value (which is now in the map's SRS) back to
+                        // the feature's SRS.
+                        if ( !vertEquiv )
+                        {
+                            featureSRSwithMapVertDatum->transform(p, featureSRS, p);
+                        }
 
-                            if ( hat > maxHAT )
-                                maxHAT = hat;
-                            if ( hat < minHAT )
-                                minHAT = hat;
+                        if ( hat > maxHAT )
+                            maxHAT = hat;
+                        if ( hat < minHAT )
+                            minHAT = hat;
 
-                            if ( elevations[i] > maxTerrainZ )
-                                maxTerrainZ = elevations[i];
-                            if ( elevations[i] < minTerrainZ )
-                                minTerrainZ = elevations[i];
-                        }
+                        if ( elevation > maxTerrainZ )
+                            maxTerrainZ = elevation;
+                        if ( elevation < minTerrainZ )
+                            minTerrainZ = elevation;
                     }
                 }
-                else // per-centroid
+                else if ( status[base] == ElevationQuery::STATUS_OK ) // per-centroid
                 {
-                    osgEarth::Bounds bounds = geom->getBounds();
-                    const osg::Vec2d& center = bounds.center2d();
-                    GeoPoint centroid(featureSRS, center.x(), center.y());
-                    double   centroidElevation;
+                    double centroidElevation = elevations[base];
 
-                    if ( eq.getElevation( centroid, centroidElevation, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
+                        osg::Vec3d& p = (*geom)[i];
+                        p.z() *= scaleZ;
+                        p.z() += offsetZ;
+
+                        double hat = p.z();
+                        p.z() = centroidElevation + p.z();
+
+                        // if necessary, convert the Z value (which is now in the map's SRS) back to
+                        // the feature's SRS.
+                        if ( !vertEquiv )
                         {
-                            osg::Vec3d& p = (*geom)[i];
-                            p.z() *= scaleZ;
-                            p.z() += offsetZ;
-
-                            double hat = p.z();
-                            p.z() = centroidElevation + p.z();
-
-                            // if necessary, convert the Z value (which is now in the map's SRS) back to
-                            // the feature's SRS.
-                            if ( !vertEquiv )
-                            {
-                                featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                            }
-
-                            if ( hat > maxHAT )
-                                maxHAT = hat;
-                            if ( hat < minHAT )
-                                minHAT = hat;
+                            featureSRSwithMapVertDatum->transform(p, featureSRS, p);
                         }
 
-                        if ( centroidElevation > maxTerrainZ )
-                            maxTerrainZ = centroidElevation;
-                        if ( centroidElevation < minTerrainZ )
-                            minTerrainZ = centroidElevation;
+                        if ( hat > maxHAT )
+                            maxHAT = hat;
+                        if ( hat < minHAT )
+                            minHAT = hat;
                     }
+
+                    if ( centroidElevation > maxTerrainZ )
+                        maxTerrainZ = centroidElevation;
+                    if ( centroidElevation < minTerrainZ )
+                        minTerrainZ = centroidElevation;
                 }
             }
 
@@ -379,16 +405,17 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             {
                 if ( perVertex )
                 {
-                    eq.getElevations( geom->asVector(), featureSRS, true, _maxRes );
-                    
+                    // points with no elevation keep their Z.
+                    for( unsigned i=0; i<geom->size(); ++i )
+                    {
+                        if ( status[base+i] == ElevationQuery::STATUS_OK )
+                            (*geom)[i].z() = elevations[base+i];
+                    }
+
                     // if necessary, transform the Z values (which are now in the map SRS) back
                     // into the feature's SRS.
                     if ( !vertEquiv )
                     {
-                        osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum =
-                            SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString());
-
-                        osg::Vec3d tempgeo;
                         for( unsigned i=0; i<geom->size(); ++i )
                         {
                             osg::Vec3d& p = (*geom)[i];
@@ -396,27 +423,17 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
                         }
                     }
                 }
-                else // per-centroid
+                else if ( status[base] == ElevationQuery::STATUS_OK ) // per-centroid
                 {
-                    osgEarth::Bounds bounds = geom->getBounds();
-                    const osg::Vec2d& center = bounds.center2d();
-                    GeoPoint centroid(featureSRS, center.x(), center.y());
-                    double   centroidElevation;
-
-                    osg::ref_ptr<const SpatialReference> featureSRSWithMapVertDatum;
-                    if ( !vertEquiv )
-                        featureSRSWithMapVertDatum = SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString());
+                    double centroidElevation = elevations[base];
 
-                    if ( eq.getElevation( centroid, centroidElevation, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
+                        osg::Vec3d& p = (*geom)[i];
+                        p.z() = centroidElevation;
+                        if ( !vertEquiv )
                         {
-                            osg::Vec3d& p = (*geom)[i];
-                            p.z() = centroidElevation;
-                            if ( !vertEquiv )
-                            {
-                                featureSRSWithMapVertDatum->transform(p, featureSRS, p);
-                            }
+                            featureSRSwithMapVertDatum->transform(p, featureSRS, p);
                         }
                     }
                 }
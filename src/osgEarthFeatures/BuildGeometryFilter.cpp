@@ -791,9 +791,14 @@ BuildGeometryFilter::tileAndBuildPolygon(Geometry*               ring,
 #define MAX_POINTS_PER_CROP_TILE 1024
 #define TARGET_TILE_SIZE_EXTENT_DEGREES 5.0
 
-    // Tile the incoming polygon if necessary
+    // Tile the incoming polygon if necessary. The z-order tessellator copes with
+    // large rings, so only tile by extent when it is in use.
+    unsigned maxPointsPerTile =
+        osgEarth::Tessellator::getDefaultMethod() == osgEarth::Tessellator::METHOD_ZORDER_EAR_CLIPPING ? UINT_MAX :
+        MAX_POINTS_PER_CROP_TILE;
+
     GeometryCollection tiles;
-    prepareForTesselation( ring, featureSRS, TARGET_TILE_SIZE_EXTENT_DEGREES, MAX_POINTS_PER_CROP_TILE, tiles);    
+    prepareForTesselation( ring, featureSRS, TARGET_TILE_SIZE_EXTENT_DEGREES, maxPointsPerTile, tiles);    
 
     osg::ref_ptr<osg::Geode> geode = new osg::Geode;
 
@@ -898,6 +903,12 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
     osg::ref_ptr<osg::Vec3Array> allPoints = new osg::Vec3Array();
     transformAndLocalize( ring->asVector(), featureSRS, allPoints.get(), mapSRS, world2local, makeECEF );
 
+    // The z-order tessellator takes holes as separate rings; the classic one
+    // needs them bridged into the outer ring here.
+    bool bridgeHoles = osgEarth::Tessellator::getDefaultMethod() != osgEarth::Tessellator::METHOD_ZORDER_EAR_CLIPPING;
+    osg::ref_ptr<osg::Vec3Array> holeVerts = new osg::Vec3Array();
+    std::vector<unsigned> holeLengths;
+
     Polygon* poly = dynamic_cast<Polygon*>(ring);
     if ( poly )
     {
@@ -914,6 +925,13 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
                 osg::ref_ptr<osg::Vec3Array> holePoints = new osg::Vec3Array();
                 transformAndLocalize( hole->asVector(), featureSRS, holePoints.get(), mapSRS, world2local, makeECEF );
 
+                if ( !bridgeHoles )
+                {
+                    holeLengths.push_back( holePoints->size() );
+                    holeVerts->insert( holeVerts->end(), holePoints->begin(), holePoints->end() );
+                    continue;
+                }
+
                 // find the point with the highest x value
                 unsigned int hCursor = 0;
                 for (unsigned int i=1; i < holePoints->size(); i++)
@@ -1035,20 +1053,35 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
         }
     }
     
-    GLenum mode = GL_LINE_LOOP;
+    unsigned first = 0;
     if ( osgGeom->getVertexArray() == 0L )
     {
-        osgGeom->addPrimitiveSet( new osg::DrawArrays( mode, 0, allPoints->size() ) );
         osgGeom->setVertexArray( allPoints.get() );
     }
     else
     {
         osg::Vec3Array* v = static_cast<osg::Vec3Array*>(osgGeom->getVertexArray());
-        osgGeom->addPrimitiveSet( new osg::DrawArrays( mode, v->size(), allPoints->size() ) );
+        first = v->size();
         //v->reserve(v->size() + allPoints->size());
         std::copy(allPoints->begin(), allPoints->end(), std::back_inserter(*v));
     }
 
+    if ( holeLengths.empty() )
+    {
+        osgGeom->addPrimitiveSet( new osg::DrawArrays( GL_LINE_LOOP, first, allPoints->size() ) );
+    }
+    else
+    {
+        // outer ring followed by its holes, one polygon for the tessellator
+        osg::Vec3Array* v = static_cast<osg::Vec3Array*>(osgGeom->getVertexArray());
+        std::copy(holeVerts->begin(), holeVerts->end(), std::back_inserter(*v));
+
+        osg::DrawArrayLengths* lengths = new osg::DrawArrayLengths( GL_POLYGON, first );
+        lengths->push_back( allPoints->size() );
+        lengths->insert( lengths->end(), holeLengths.begin(), holeLengths.end() );
+        osgGeom->addPrimitiveSet( lengths );
+    }
+
     //// Normal computation.
     //// Not completely correct, but better than no normals at all. TODO: update this
     //// to generate a proper normal vector in ECEF mode.
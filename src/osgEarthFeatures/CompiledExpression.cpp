@@ -0,0 +1,378 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/CompiledExpression>
+#include <osgEarthFeatures/FilterContext>
+#include <osgEarthFeatures/Session>
+#include <osgEarthFeatures/ScriptEngine>
+#include <osgEarth/StringUtils>
+#include <map>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+#define LC "[CompiledExpression] "
+
+namespace
+{
+    int getSchemaIndex(const FeatureSchema& schema, const std::string& name)
+    {
+        int index = 0;
+        for( FeatureSchema::const_iterator f = schema.begin(); f != schema.end(); ++f, ++index )
+        {
+            if ( ciEquals(f->first, name) )
+                return index;
+        }
+        return -1;
+    }
+
+    int getSchemaIndex(const AttributeSchema* schema, const std::string& name)
+    {
+        return schema ? schema->getColumn(name) : -1;
+    }
+
+    // Assigns a slot to each distinct variable name and records where that
+    // attribute sits in the schema. varSlots[i] is the slot of vars[i].
+    template<typename VARIABLES, typename SCHEMA>
+    void bindSlots(const VARIABLES&                     vars,
+                   const SCHEMA&                        schema,
+                   std::vector<CompiledExpressionSlot>& slots,
+                   std::vector<unsigned>&               varSlots)
+    {
+        slots.clear();
+        varSlots.clear();
+
+        std::map<std::string, unsigned> slotOf;
+
+        for( typename VARIABLES::const_iterator v = vars.begin(); v != vars.end(); ++v )
+        {
+            std::map<std::string, unsigned>::const_iterator s = slotOf.find( v->first );
+            if ( s == slotOf.end() )
+            {
+                CompiledExpressionSlot slot;
+                slot._name        = v->first;
+                slot._schemaIndex = getSchemaIndex( schema, v->first );
+
+                s = slotOf.insert( std::make_pair(v->first, (unsigned)slots.size()) ).first;
+                slots.push_back( slot );
+            }
+
+            varSlots.push_back( s->second );
+        }
+    }
+
+    const AttributeSchema* getAttributeSchema(const FeatureList& features)
+    {
+        return features.empty() || !features.front().valid() ? 0L : features.front()->getAttributeSchema();
+    }
+
+    ScriptEngine* getScriptEngine(FilterContext const* context)
+    {
+        return context && context->getSession() ? context->getSession()->getScriptEngine() : 0L;
+    }
+}
+
+//------------------------------------------------------------------------
+
+CompiledNumericExpression::CompiledNumericExpression(const NumericExpression& expr,
+                                                     const FeatureSchema&     schema)
+{
+    compile( expr, schema );
+}
+
+CompiledNumericExpression::CompiledNumericExpression(const NumericExpression& expr,
+                                                     const AttributeSchema*   schema)
+{
+    compile( expr, schema );
+}
+
+CompiledNumericExpression::CompiledNumericExpression(const NumericExpression& expr,
+                                                     const FeatureList&       features)
+{
+    compile( expr, features );
+}
+
+void
+CompiledNumericExpression::compile(const NumericExpression& expr,
+                                   const FeatureSchema&     schema)
+{
+    _expr       = expr;
+    _attrSchema = 0L;
+
+    std::vector<unsigned> varSlots;
+    bindSlots( _expr.variables(), schema, _slots, varSlots );
+    _expr.compile( varSlots, _program );
+}
+
+void
+CompiledNumericExpression::compile(const NumericExpression& expr,
+                                   const AttributeSchema*   schema)
+{
+    _expr       = expr;
+    _attrSchema = schema;
+
+    std::vector<unsigned> varSlots;
+    bindSlots( _expr.variables(), schema, _slots, varSlots );
+    _expr.compile( varSlots, _program );
+}
+
+void
+CompiledNumericExpression::compile(const NumericExpression& expr,
+                                   const FeatureList&       features)
+{
+    compile( expr, getAttributeSchema(features) );
+}
+
+double
+CompiledNumericExpression::evalImpl(const Feature*       feature,
+                                    ScriptEngine*        engine,
+                                    FilterContext const* context,
+                                    double*              values) const
+{
+    // features packed against our schema are read by column:
+    bool packed = _attrSchema.valid() && feature->getAttributeSchema() == _attrSchema.get();
+
+    for( unsigned s=0; s<_slots.size(); ++s )
+    {
+        const CompiledExpressionSlot& slot = _slots[s];
+        double val = 0.0;
+        bool found = false;
+
+        if ( packed && slot._schemaIndex >= 0 )
+        {
+            const PackedAttributeValue& p = feature->getPackedValue( slot._schemaIndex );
+            if ( p.present )
+            {
+                val = p.getDouble(0.0);
+                found = true;
+            }
+        }
+        else
+        {
+            found = feature->lookupDouble( slot._name, val );
+        }
+
+        if ( !found && engine )
+        {
+            //No attr found, look for script
+            ScriptResult result = engine->run( slot._name, feature, context );
+            if ( result.success() )
+                val = result.asDouble();
+            else
+                OE_WARN << LC << "Feature Script error on '" << _expr.expr() << "': " << result.message() << std::endl;
+        }
+
+        values[s] = val;
+    }
+
+    return _program.run( values );
+}
+
+double
+CompiledNumericExpression::eval(const Feature* feature, FilterContext const* context) const
+{
+    if ( !feature )
+        return 0.0;
+
+    // most expressions have a handful of variables; keep those off the heap.
+    double buffer[16];
+    if ( _slots.size() <= 16 )
+        return evalImpl( feature, getScriptEngine(context), context, buffer );
+
+    std::vector<double> values( _slots.size() );
+    return evalImpl( feature, getScriptEngine(context), context, &values[0] );
+}
+
+double
+CompiledNumericExpression::eval(const Feature* feature, Session* session) const
+{
+    if ( !feature )
+        return 0.0;
+
+    ScriptEngine* engine = session ? session->getScriptEngine() : 0L;
+
+    double buffer[16];
+    if ( _slots.size() <= 16 )
+        return evalImpl( feature, engine, 0L, buffer );
+
+    std::vector<double> values( _slots.size() );
+    return evalImpl( feature, engine, 0L, &values[0] );
+}
+
+void
+CompiledNumericExpression::eval(const FeatureList&   features,
+                                std::vector<double>& out_values,
+                                FilterContext const* context) const
+{
+    out_values.clear();
+    out_values.reserve( features.size() );
+
+    ScriptEngine* engine = getScriptEngine(context);
+    std::vector<double> values( _slots.size() + 1 );
+
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+    {
+        out_values.push_back( i->valid() ? evalImpl(i->get(), engine, context, &values[0]) : 0.0 );
+    }
+}
+
+//------------------------------------------------------------------------
+
+CompiledStringExpression::CompiledStringExpression(const StringExpression& expr,
+                                                   const FeatureSchema&    schema)
+{
+    compile( expr, schema );
+}
+
+CompiledStringExpression::CompiledStringExpression(const StringExpression& expr,
+                                                   const AttributeSchema*  schema)
+{
+    compile( expr, schema );
+}
+
+CompiledStringExpression::CompiledStringExpression(const StringExpression& expr,
+                                                   const FeatureList&      features)
+{
+    compile( expr, features );
+}
+
+void
+CompiledStringExpression::compile(const StringExpression& expr,
+                                  const FeatureSchema&    schema)
+{
+    _expr       = expr;
+    _attrSchema = 0L;
+
+    std::vector<unsigned> varSlots;
+    bindSlots( _expr.variables(), schema, _slots, varSlots );
+    _expr.compile( varSlots, _program );
+}
+
+void
+CompiledStringExpression::compile(const StringExpression& expr,
+                                  const AttributeSchema*  schema)
+{
+    _expr       = expr;
+    _attrSchema = schema;
+
+    std::vector<unsigned> varSlots;
+    bindSlots( _expr.variables(), schema, _slots, varSlots );
+    _expr.compile( varSlots, _program );
+}
+
+void
+CompiledStringExpression::compile(const StringExpression& expr,
+                                  const FeatureList&      features)
+{
+    compile( expr, getAttributeSchema(features) );
+}
+
+void
+CompiledStringExpression::evalImpl(const Feature*            feature,
+                                   ScriptEngine*             engine,
+                                   FilterContext const*      context,
+                                   std::vector<std::string>& values,
+                                   std::string&              out) const
+{
+    // features packed against our schema are read by column:
+    bool packed = _attrSchema.valid() && feature->getAttributeSchema() == _attrSchema.get();
+
+    for( unsigned s=0; s<_slots.size(); ++s )
+    {
+        const CompiledExpressionSlot& slot = _slots[s];
+        bool found = false;
+
+        if ( packed && slot._schemaIndex >= 0 )
+        {
+            const PackedAttributeValue& p = feature->getPackedValue( slot._schemaIndex );
+            if ( p.present )
+            {
+                if ( p.type == ATTRTYPE_STRING )
+                    values[s] = p.stringValue ? *p.stringValue : EMPTY_STRING;
+                else
+                    values[s] = p.getString();
+                found = true;
+            }
+        }
+        else
+        {
+            found = feature->lookupString( slot._name, values[s] );
+        }
+
+        if ( !found )
+        {
+            values[s].clear();
+
+            if ( engine )
+            {
+                //No attr found, look for script
+                ScriptResult result = engine->run( slot._name, feature, context );
+                if ( result.success() )
+                    values[s] = result.asString();
+                else
+                    OE_WARN << LC << "Feature Script error on '" << _expr.expr() << "': " << result.message() << std::endl;
+            }
+        }
+    }
+
+    _program.run( values.empty() ? 0L : &values[0], out );
+}
+
+std::string
+CompiledStringExpression::eval(const Feature* feature, FilterContext const* context) const
+{
+    std::string out;
+    if ( feature )
+    {
+        std::vector<std::string> values( _slots.size() );
+        evalImpl( feature, getScriptEngine(context), context, values, out );
+    }
+    return out;
+}
+
+std::string
+CompiledStringExpression::eval(const Feature* feature, Session* session) const
+{
+    std::string out;
+    if ( feature )
+    {
+        std::vector<std::string> values( _slots.size() );
+        evalImpl( feature, session ? session->getScriptEngine() : 0L, 0L, values, out );
+    }
+    return out;
+}
+
+void
+CompiledStringExpression::eval(const FeatureList&        features,
+                               std::vector<std::string>& out_values,
+                               FilterContext const*      context) const
+{
+    out_values.clear();
+    out_values.resize( features.size() );
+
+    ScriptEngine* engine = getScriptEngine(context);
+    std::vector<std::string> values( _slots.size() );
+
+    unsigned n = 0;
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n )
+    {
+        if ( i->valid() )
+            evalImpl( i->get(), engine, context, values, out_values[n] );
+    }
+}
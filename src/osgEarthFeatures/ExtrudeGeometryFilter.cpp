@@ -19,6 +19,7 @@
 #include <osgEarthFeatures/ExtrudeGeometryFilter>
 #include <osgEarthFeatures/Session>
 #include <osgEarthFeatures/FeatureSourceIndexNode>
+#include <osgEarthFeatures/CompiledExpression>
 #include <osgEarthSymbology/ResourceCache>
 #include <osgEarth/ECEF>
 #include <osgEarth/ImageUtils>
@@ -929,6 +930,15 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     Random wallSkinPRNG( _wallSkinSymbol.valid()? *_wallSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
     Random roofSkinPRNG( _roofSkinSymbol.valid()? *_roofSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
 
+    // bind the per-feature expressions to the features' schema once.
+    CompiledNumericExpression heightExpr;
+    if ( _heightExpr.isSet() )
+        heightExpr.compile( _heightExpr.get(), features );
+
+    CompiledStringExpression featureNameExpr;
+    if ( !_featureNameExpr.empty() )
+        featureNameExpr.compile( _featureNameExpr, features );
+
     for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
     {
         Feature* input = f->get();
@@ -981,7 +991,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             }
             else if ( _heightExpr.isSet() )
             {
-                height = input->eval( _heightExpr.mutable_value(), &context );
+                height = heightExpr.eval( input, &context );
             }
             else
             {
@@ -1109,7 +1119,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             // Set up for feature naming and feature indexing:
             std::string name;
             if ( !_featureNameExpr.empty() )
-                name = input->eval( _featureNameExpr, &context );
+                name = featureNameExpr.eval( input, &context );
 
             FeatureIndexBuilder* index = context.featureIndex();
 
@@ -144,9 +144,114 @@ AttributeValue::getBool( bool defaultValue ) const
 
 //----------------------------------------------------------------------------
 
+std::string
+PackedAttributeValue::getString() const
+{
+    switch( type ) {
+        case ATTRTYPE_STRING: return stringValue ? *stringValue : EMPTY_STRING;
+        case ATTRTYPE_DOUBLE: return osgEarth::toString(doubleValue);
+        case ATTRTYPE_INT:    return osgEarth::toString(intValue);
+        case ATTRTYPE_BOOL:   return osgEarth::toString(boolValue);
+    }
+    return EMPTY_STRING;
+}
+
+double
+PackedAttributeValue::getDouble( double defaultValue ) const 
+{
+    switch( type ) {
+        case ATTRTYPE_STRING: return osgEarth::as<double>(stringValue ? *stringValue : EMPTY_STRING, defaultValue);
+        case ATTRTYPE_DOUBLE: return doubleValue;
+        case ATTRTYPE_INT:    return (double)intValue;
+        case ATTRTYPE_BOOL:   return boolValue? 1.0 : 0.0;
+    }
+    return defaultValue;
+}
+
+int
+PackedAttributeValue::getInt( int defaultValue ) const 
+{
+    switch( type ) {
+        case ATTRTYPE_STRING: return osgEarth::as<int>(stringValue ? *stringValue : EMPTY_STRING, defaultValue);
+        case ATTRTYPE_DOUBLE: return (int)doubleValue;
+        case ATTRTYPE_INT:    return intValue;
+        case ATTRTYPE_BOOL:   return boolValue? 1 : 0;
+    }
+    return defaultValue;
+}
+
+bool
+PackedAttributeValue::getBool( bool defaultValue ) const 
+{
+    switch( type ) {
+        case ATTRTYPE_STRING: return osgEarth::as<bool>(stringValue ? *stringValue : EMPTY_STRING, defaultValue);
+        case ATTRTYPE_DOUBLE: return doubleValue != 0.0;
+        case ATTRTYPE_INT:    return intValue != 0;
+        case ATTRTYPE_BOOL:   return boolValue;
+    }
+    return defaultValue;
+}
+
+//----------------------------------------------------------------------------
+
+AttributeSchema::AttributeSchema( const FeatureSchema& schema )
+{
+    for( FeatureSchema::const_iterator i = schema.begin(); i != schema.end(); ++i )
+    {
+        _index.insert( std::make_pair(i->first, (unsigned)_columns.size()) );
+        _columns.push_back( Column(i->first, i->second) );
+        _pools.push_back( new StringPool() );
+    }
+}
+
+AttributeSchema::~AttributeSchema()
+{
+    for( unsigned i = 0; i < _pools.size(); ++i )
+        delete _pools[i];
+}
+
+int
+AttributeSchema::getColumn( const std::string& name ) const
+{
+    std::map<std::string, unsigned, CIStringComp>::const_iterator i = _index.find( name );
+    return i != _index.end() ? (int)i->second : -1;
+}
+
+const std::string*
+AttributeSchema::intern( unsigned column, const std::string& value ) const
+{
+    StringPool& pool = *_pools[column];
+    Threading::ScopedMutexLock lock( pool._mutex );
+
+    std::set<std::string>::const_iterator i = pool._strings.find( value );
+    if ( i != pool._strings.end() )
+        return &(*i);
+
+    // a high-cardinality column; the features keep their own values.
+    if ( pool._strings.size() >= MAX_INTERNED_PER_COLUMN )
+        return 0L;
+
+    return &(*pool._strings.insert( value ).first);
+}
+
+unsigned
+AttributeSchema::getNumInternedStrings() const
+{
+    unsigned count = 0;
+    for( unsigned i = 0; i < _pools.size(); ++i )
+    {
+        Threading::ScopedMutexLock lock( _pools[i]->_mutex );
+        count += _pools[i]->_strings.size();
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------------
+
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
-_srs( 0L )
+_srs( 0L ),
+_packedViewValid( false )
 //_cachedBoundingPolytopeValid( false )
 {
     //NOP
@@ -155,7 +260,8 @@ _srs( 0L )
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
 _geom ( geom ),
 _srs  ( srs ),
-_fid  ( fid )
+_fid  ( fid ),
+_packedViewValid( false )
 {
     if ( !style.empty() )
         _style = style;
@@ -164,12 +270,20 @@ _fid  ( fid )
 }
 
 Feature::Feature( const Feature& rhs, const osg::CopyOp& copyOp ) :
-_fid      ( rhs._fid ),
-_attrs    ( rhs._attrs ),
+_fid       ( rhs._fid ),
+_attrs     ( rhs._attrs ),
+_attrSchema( rhs._attrSchema.get() ),
+_packed    ( rhs._packed ),
+_ownedStrings( rhs._ownedStrings ),
 _style    ( rhs._style ),
 _geoInterp( rhs._geoInterp ),
-_srs      ( rhs._srs.get() )
+_srs      ( rhs._srs.get() ),
+_packedViewValid( false )
 {
+    // point the copied slots at our own copies of the uninterned values.
+    for( std::map<unsigned, std::string>::iterator i = _ownedStrings.begin(); i != _ownedStrings.end(); ++i )
+        _packed[i->first].stringValue = &i->second;
+
     if ( rhs._geom.valid() )
         _geom = rhs._geom->clone();
 
@@ -204,9 +318,158 @@ Feature::dirty()
     //_cachedBoundingPolytopeValid = false;
 }
 
+const AttributeTable&
+Feature::getAttrs() const
+{
+    if ( !_attrSchema.valid() )
+        return _attrs;
+
+    // several threads may read the same feature, so build the view once under a lock.
+    Threading::ScopedMutexLock lock( _packedViewMutex );
+    if ( !_packedViewValid )
+    {
+        _packedView.clear();
+        unpackTo( _packedView );
+        _packedViewValid = true;
+    }
+    return _packedView;
+}
+
+bool
+Feature::setAttributeSchema( const AttributeSchema* schema )
+{
+    if ( schema == _attrSchema.get() )
+        return schema != 0L;
+
+    unpack();
+
+    if ( !schema )
+        return false;
+
+    // every existing attribute needs a column:
+    for( AttributeTable::const_iterator i = _attrs.begin(); i != _attrs.end(); ++i )
+    {
+        if ( schema->getColumn(i->first) < 0 )
+            return false;
+    }
+
+    _packed.assign( schema->getNumColumns(), PackedAttributeValue() );
+    _attrSchema = schema;
+
+    for( AttributeTable::const_iterator i = _attrs.begin(); i != _attrs.end(); ++i )
+    {
+        const AttributeValue& a = i->second;
+        unsigned column = schema->getColumn(i->first);
+        PackedAttributeValue& p = _packed[column];
+        p.type    = a.first;
+        p.present = true;
+        p.set     = a.second.set;
+        switch( a.first ) {
+            case ATTRTYPE_STRING: setPackedString(column, a.second.stringValue); break;
+            case ATTRTYPE_DOUBLE: p.doubleValue = a.second.doubleValue; break;
+            case ATTRTYPE_INT:    p.intValue    = a.second.intValue; break;
+            case ATTRTYPE_BOOL:   p.boolValue   = a.second.boolValue; break;
+            case ATTRTYPE_UNSPECIFIED: break;
+        }
+    }
+
+    _attrs.clear();
+    return true;
+}
+
+void
+Feature::unpackTo( AttributeTable& out ) const
+{
+    for( unsigned c = 0; c < _packed.size(); ++c )
+    {
+        const PackedAttributeValue& p = _packed[c];
+        if ( !p.present )
+            continue;
+
+        AttributeValue& a = out[_attrSchema->getName(c)];
+        a.first = (AttributeType)p.type;
+        switch( p.type ) {
+            case ATTRTYPE_STRING: a.second.stringValue = p.stringValue ? *p.stringValue : EMPTY_STRING; break;
+            case ATTRTYPE_DOUBLE: a.second.doubleValue = p.doubleValue; break;
+            case ATTRTYPE_INT:    a.second.intValue    = p.intValue; break;
+            case ATTRTYPE_BOOL:   a.second.boolValue   = p.boolValue; break;
+        }
+        a.second.set = p.set;
+    }
+}
+
+void
+Feature::unpack()
+{
+    if ( !_attrSchema.valid() )
+        return;
+
+    unpackTo( _attrs );
+
+    _attrSchema = 0L;
+    std::vector<PackedAttributeValue>().swap( _packed );
+    _ownedStrings.clear();
+    AttributeTable().swap( _packedView );
+    _packedViewValid = false;
+}
+
+PackedAttributeValue*
+Feature::getPackedSlot( const std::string& name )
+{
+    if ( !_attrSchema.valid() )
+        return 0L;
+
+    int column = _attrSchema->getColumn( name );
+    if ( column >= 0 )
+    {
+        // the caller is about to change it.
+        _packedViewValid = false;
+        _ownedStrings.erase( column );
+        return &_packed[column];
+    }
+
+    // not in the schema; fall back on the attribute table.
+    unpack();
+    return 0L;
+}
+
+void
+Feature::setPackedString( unsigned column, const std::string& value )
+{
+    const std::string* pooled = _attrSchema->intern( column, value );
+    if ( pooled )
+    {
+        _ownedStrings.erase( column );
+        _packed[column].stringValue = pooled;
+    }
+    else
+    {
+        std::string& owned = _ownedStrings[column];
+        owned = value;
+        _packed[column].stringValue = &owned;
+    }
+}
+
+const PackedAttributeValue*
+Feature::findPacked( const std::string& name ) const
+{
+    int column = _attrSchema->getColumn( name );
+    return column >= 0 && _packed[column].present ? &_packed[column] : 0L;
+}
+
 void
 Feature::set( const std::string& name, const std::string& value )
 {
+    PackedAttributeValue* p = getPackedSlot( name );
+    if ( p )
+    {
+        p->type        = ATTRTYPE_STRING;
+        setPackedString( (unsigned)(p - &_packed[0]), value );
+        p->present     = true;
+        p->set         = true;
+        return;
+    }
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
@@ -216,6 +479,16 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
+    PackedAttributeValue* p = getPackedSlot( name );
+    if ( p )
+    {
+        p->type        = ATTRTYPE_DOUBLE;
+        p->doubleValue = value;
+        p->present     = true;
+        p->set         = true;
+        return;
+    }
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
@@ -225,6 +498,16 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, int value )
 {
+    PackedAttributeValue* p = getPackedSlot( name );
+    if ( p )
+    {
+        p->type     = ATTRTYPE_INT;
+        p->intValue = value;
+        p->present  = true;
+        p->set      = true;
+        return;
+    }
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
@@ -234,6 +517,16 @@ Feature::set( const std::string& name, int value )
 void
 Feature::set( const std::string& name, bool value )
 {
+    PackedAttributeValue* p = getPackedSlot( name );
+    if ( p )
+    {
+        p->type      = ATTRTYPE_BOOL;
+        p->boolValue = value;
+        p->present   = true;
+        p->set       = true;
+        return;
+    }
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
@@ -243,6 +536,14 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::setNull( const std::string& name)
 {
+    PackedAttributeValue* p = getPackedSlot( name );
+    if ( p )
+    {
+        p->present = true;
+        p->set     = false;
+        return;
+    }
+
     AttributeValue& a = _attrs[name];    
     a.second.set = false;
 }
@@ -250,52 +551,126 @@ Feature::setNull( const std::string& name)
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
+    PackedAttributeValue* p = getPackedSlot( name );
+    if ( p )
+    {
+        p->type    = type;
+        p->present = true;
+        p->set     = false;
+        return;
+    }
+
     AttributeValue& a = _attrs[name];
     a.first = type;    
     a.second.set = false;
 }
 
+bool
+Feature::lookupDouble( const std::string& name, double& out ) const
+{
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        if ( p )
+            out = p->getDouble(0.0);
+        return p != 0L;
+    }
 
+    AttributeTable::const_iterator i = _attrs.find(name);
+    if ( i != _attrs.end() )
+        out = i->second.getDouble(0.0);
+    return i != _attrs.end();
+}
 
+bool
+Feature::lookupString( const std::string& name, std::string& out ) const
+{
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        if ( p )
+            out = p->getString();
+        return p != 0L;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
+    if ( i != _attrs.end() )
+        out = i->second.getString();
+    return i != _attrs.end();
+}
 
 bool
 Feature::hasAttr( const std::string& name ) const
 {
-    return _attrs.find(toLower(name)) != _attrs.end();
+    if ( _attrSchema.valid() )
+        return findPacked(name) != 0L;
+
+    // note: the attribute table compares names case-insensitively.
+    return _attrs.find(name) != _attrs.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        return p ? p->getString() : EMPTY_STRING;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
 }
 
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        return p ? p->getDouble(defaultValue) : defaultValue;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
 }
 
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        return p ? p->getInt(defaultValue) : defaultValue;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
 }
 
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        return p ? p->getBool(defaultValue) : defaultValue;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
 }
 
 bool
 Feature::isSet( const std::string& name) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( _attrSchema.valid() )
+    {
+        const PackedAttributeValue* p = findPacked(name);
+        return p ? p->set : false;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.second.set : false;
 }
 
@@ -306,12 +681,7 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
-      {
-        val = ai->second.getDouble(0.0);
-      }
-      else if (context && context->getSession())
+      if (!lookupDouble(i->first, val) && context && context->getSession())
       {
         //No attr found, look for script
         ScriptEngine* engine = context->getSession()->getScriptEngine();
@@ -339,12 +709,7 @@ Feature::eval(NumericExpression& expr, Session* session) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
-        {
-            val = ai->second.getDouble(0.0);
-        }
-        else if (session)
+        if (!lookupDouble(i->first, val) && session)
         {
             //No attr found, look for script
             ScriptEngine* engine = session->getScriptEngine();
@@ -375,12 +740,7 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
-      {
-        val = ai->second.getString();
-      }
-      else if (context && context->getSession())
+      if (!lookupString(i->first, val) && context && context->getSession())
       {
         //No attr found, look for script
         ScriptEngine* engine = context->getSession()->getScriptEngine();
@@ -407,12 +767,7 @@ Feature::eval(StringExpression& expr, Session* session) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
-        {
-            val = ai->second.getString();
-        }
-        else if (session)
+        if (!lookupString(i->first, val) && session)
         {
             //No attr found, look for script
             ScriptEngine* engine = session->getScriptEngine();
@@ -23,6 +23,7 @@
 #include <osgEarthFeatures/Session>
 
 #include <osgEarth/Map>
+#include <osgEarth/Cache>
 #include <osgEarth/Capabilities>
 #include <osgEarth/Clamping>
 #include <osgEarth/ClampableNode>
@@ -33,17 +34,20 @@
 #include <osgEarth/FadeEffect>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 
 #include <osg/CullFace>
 #include <osg/PagedLOD>
 #include <osg/ProxyNode>
+#include <osg/ValueObject>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReaderWriter>
 #include <osgDB/WriteFile>
 #include <osgUtil/Optimizer>
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 
 #define LC "[FeatureModelGraph] " << getName()
@@ -228,6 +232,96 @@ namespace
             node->getOrCreateStateSet()->addUniform( u );
         }
     };
+
+
+    // user value that tags a style group with its style, so that a tile read
+    // from the node cache can re-apply the graph-wide state the style implies.
+    const char* NODE_CACHE_STYLE_TAG = "osgEarth.FeatureModelGraph.style";
+
+    // gathers the style tags in a cached tile.
+    struct CollectStyleTags : public osg::NodeVisitor
+    {
+        CollectStyleTags() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN) { }
+
+        std::set<std::string> _styles;
+
+        void apply(osg::Node& node)
+        {
+            std::string json;
+            if ( node.getUserValue(NODE_CACHE_STYLE_TAG, json) )
+                _styles.insert( json );
+            traverse( node );
+        }
+    };
+
+    /**
+     * Checks whether a compiled subgraph can make the round trip through the
+     * node cache. osgEarth's own node, drawable and state attribute classes
+     * have no serializers, so a tile that contains any of them (a draped
+     * style group, for example) gets compiled every time.
+     */
+    struct CheckCacheable : public osg::NodeVisitor
+    {
+        CheckCacheable() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), _cacheable(true) { }
+
+        bool _cacheable;
+
+        static bool isOsgEarth(const osg::Object* object)
+        {
+            return object && std::strncmp(object->libraryName(), "osgEarth", 8) == 0;
+        }
+
+        void checkObject(const osg::Object* object)
+        {
+            if ( isOsgEarth(object) )
+                _cacheable = false;
+        }
+
+        void checkStateSet(const osg::StateSet* ss)
+        {
+            if ( !ss )
+                return;
+
+            const osg::StateSet::AttributeList& attrs = ss->getAttributeList();
+            for(osg::StateSet::AttributeList::const_iterator i = attrs.begin(); i != attrs.end(); ++i)
+                checkObject( i->second.first.get() );
+
+            const osg::StateSet::TextureAttributeList& units = ss->getTextureAttributeList();
+            for(unsigned u = 0; u < units.size(); ++u)
+                for(osg::StateSet::AttributeList::const_iterator i = units[u].begin(); i != units[u].end(); ++i)
+                    checkObject( i->second.first.get() );
+
+            checkObject( ss->getUpdateCallback() );
+            checkObject( ss->getEventCallback() );
+        }
+
+        void apply(osg::Node& node)
+        {
+            checkObject( &node );
+            checkObject( node.getUpdateCallback() );
+            checkObject( node.getEventCallback() );
+            checkObject( node.getCullCallback() );
+            checkStateSet( node.getStateSet() );
+
+            if ( _cacheable )
+                traverse( node );
+        }
+
+        void apply(osg::Geode& geode)
+        {
+            for(unsigned i = 0; i < geode.getNumDrawables() && _cacheable; ++i)
+            {
+                const osg::Drawable* d = geode.getDrawable(i);
+                checkObject( d );
+                checkObject( d->getUpdateCallback() );
+                checkObject( d->getCullCallback() );
+                checkObject( d->getDrawCallback() );
+                checkStateSet( d->getStateSet() );
+            }
+
+            apply( static_cast<osg::Node&>(geode) );
+        }
+    };
 }
 
 
@@ -251,7 +345,9 @@ _overlayInstalled   ( 0L ),
 _overlayPlaceholder ( 0L ),
 _clampable          ( 0L ),
 _drapeable          ( 0L ),
-_overlayChange      ( OVERLAY_NO_CHANGE )
+_overlayChange      ( OVERLAY_NO_CHANGE ),
+_styleHash          ( 0u ),
+_sourceHash         ( 0u )
 {
     ctor();
 }
@@ -273,7 +369,9 @@ _overlayInstalled   ( 0L ),
 _overlayPlaceholder ( 0L ),
 _clampable          ( 0L ),
 _drapeable          ( 0L ),
-_overlayChange      ( OVERLAY_NO_CHANGE )
+_overlayChange      ( OVERLAY_NO_CHANGE ),
+_styleHash          ( 0u ),
+_sourceHash         ( 0u )
 {
     ctor();
 }
@@ -316,6 +414,12 @@ FeatureModelGraph::ctor()
     {
         _session->setResourceCache( new ResourceCache(_session->getDBOptions()) );
     }
+
+    // opt-in cache of compiled tiles.
+    if ( _options.nodeCaching() == true )
+    {
+        setupNodeCache();
+    }
     
     // Calculate the usable extent (in both feature and map coordinates) and bounds.
     const Profile* mapProfile = _session->getMapInfo().getProfile();
@@ -724,7 +828,8 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
 #else
             TileKey key(lod, tileX, tileY, featureProfile->getProfile());
 #endif
-            geometry = buildLevel( level, tileExtent, &key );
+            std::string tileName = Stringify() << lod << "_" << tileX << "_" << tileY;
+            geometry = buildLevel( level, tileExtent, &key, tileName );
             result = geometry;
         }
 
@@ -757,7 +862,7 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
         // maximum camera range.
 
         FeatureLevel all( 0.0f, FLT_MAX );
-        result = buildLevel( all, GeoExtent::INVALID, 0 );
+        result = buildLevel( all, GeoExtent::INVALID, 0, "all" );
     }
 
     else if ( (int)lod < _lodmap.size() )
@@ -778,7 +883,8 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
                 s_getTileExtent( lod, tileX, tileY, _usableFeatureExtent ) :
                 _usableFeatureExtent;
                 
-            geometry = buildLevel( *level, tileExtent, 0 );
+            std::string tileName = Stringify() << lod << "_" << tileX << "_" << tileY;
+            geometry = buildLevel( *level, tileExtent, 0, tileName );
             result = geometry;
         }
 
@@ -826,6 +932,144 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
 }
 
 
+void
+FeatureModelGraph::setupNodeCache()
+{
+    Cache* cache = Cache::get( _session->getDBOptions() );
+    if ( !cache )
+    {
+        OE_INFO << LC << "Node caching requested, but there is no cache" << std::endl;
+        return;
+    }
+
+    _nodeCachePolicy = CachePolicy::DEFAULT;
+    optional<CachePolicy> policy;
+    if ( CachePolicy::fromOptions(_session->getDBOptions(), policy) )
+        _nodeCachePolicy.mergeAndOverride( policy );
+    _nodeCachePolicy.mergeAndOverride( _options.cachePolicy() );
+
+    if ( _nodeCachePolicy.usage() == CachePolicy::USAGE_NO_CACHE )
+        return;
+
+    // The bin covers everything that shapes the compiled nodes except the style
+    // sheet and the feature source data, which each record is checked against
+    // instead so that a change overwrites tiles rather than orphaning a bin.
+    Config conf = _options.getConfig();
+    conf.remove( "styles" );
+    conf.remove( "cache_policy" );
+
+    const Profile* mapProfile = _session->getMapInfo().getProfile();
+
+    std::string signature = Stringify()
+        << conf.toJSON()
+        << _session->getFeatureSource()->getFeatureSourceOptions().getConfig().toJSON()
+        << (mapProfile ? mapProfile->getFullSignature() : std::string())
+        << (_session->getMapInfo().isGeocentric() ? "geocentric" : "projected");
+
+    std::string binId = Stringify() << std::hex << hashString(signature) << "_fmg";
+    _nodeCacheBin = cache->addBin( binId );
+    if ( !_nodeCacheBin.valid() )
+    {
+        OE_INFO << LC << "Failed to open node cache bin \"" << binId << "\"" << std::endl;
+        return;
+    }
+
+    // reference only.
+    if ( _nodeCacheBin->readMetadata().empty() )
+        _nodeCacheBin->writeMetadata( conf );
+
+    _styleHash = hashString( _session->styles()->getConfig().toJSON() );
+
+    // The source revision only counts edits made during this run, so records
+    // also carry a fingerprint of the data that survives a restart.
+    FeatureSource* source = _session->getFeatureSource();
+    const FeatureProfile* featureProfile = source->getFeatureProfile();
+    int       featureCount = source->getFeatureCount();
+    TimeStamp modified     = source->getLastModifiedTime();
+
+    _sourceHash = hashString( Stringify()
+        << featureCount << ";"
+        << modified << ";"
+        << (featureProfile ? featureProfile->getExtent().toString() : std::string()) );
+
+    if ( featureCount < 0 && modified == 0 )
+    {
+        OE_INFO << LC << "Feature source reports no feature count or modification time; "
+            << "cached tiles will only expire through the cache policy" << std::endl;
+    }
+
+    OE_INFO << LC << "Node caching in bin \"" << binId << "\"" << std::endl;
+}
+
+osg::Group*
+FeatureModelGraph::readNodeCache(const std::string& key)
+{
+    if ( !_nodeCachePolicy.isCacheReadable() )
+        return 0L;
+
+    ReadResult r = _nodeCacheBin->readObject( key );
+    if ( !r.succeeded() || _nodeCachePolicy.isExpired(r.lastModifiedTime()) )
+        return 0L;
+
+    // a record from other feature data or another style sheet is stale.
+    Revision sourceRev;
+    _session->getFeatureSource()->sync( sourceRev );
+
+    const Config& meta = r.metadata();
+    if ( meta.value<int>("source_rev", -1) != (int)sourceRev ||
+         meta.value<unsigned>("source", 0u) != _sourceHash ||
+         meta.value<unsigned>("style", 0u) != _styleHash )
+    {
+        return 0L;
+    }
+
+    osg::ref_ptr<osg::Group> group = dynamic_cast<osg::Group*>( r.getObject() );
+    if ( !group.valid() )
+        return 0L;
+
+    // compiling a style group can change state on the graph itself (GPU clamping,
+    // render bins, depth offset); a cached tile has to do the same.
+    CollectStyleTags tags;
+    group->accept( tags );
+    for(std::set<std::string>::const_iterator i = tags._styles.begin(); i != tags._styles.end(); ++i)
+    {
+        Config conf;
+        if ( conf.fromJSON(*i) )
+            checkForGlobalStyles( Style(conf) );
+    }
+
+    // share state with the rest of the session, as compiled tiles do.
+    _session->getStateSetCache()->consolidateStateAttributes( group.get() );
+
+    return group.release();
+}
+
+void
+FeatureModelGraph::writeNodeCache(const std::string& key, osg::Group* group)
+{
+    if ( !_nodeCachePolicy.isCacheWriteable() )
+        return;
+
+    CheckCacheable check;
+    group->accept( check );
+    if ( !check._cacheable )
+    {
+        OE_DEBUG << LC << "Tile " << key << " holds osgEarth-specific nodes; not caching" << std::endl;
+        return;
+    }
+
+    Revision sourceRev;
+    _session->getFeatureSource()->sync( sourceRev );
+
+    Config meta;
+    meta.set( "source_rev", (int)sourceRev );
+    meta.set( "source", _sourceHash );
+    meta.set( "style", _styleHash );
+
+    _nodeCacheBin->write( key, group, meta );
+}
+
+
 void
 FeatureModelGraph::buildSubTilePagedLODs(unsigned        parentLOD,
                                          unsigned        parentTileX,
@@ -921,7 +1165,7 @@ FeatureModelGraph::buildSubTilePagedLODs(unsigned        parentLOD,
  * data source.
  */
 osg::Group*
-FeatureModelGraph::buildLevel( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key )
+FeatureModelGraph::buildLevel( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key, const std::string& tileName )
 {
     // set up for feature indexing if appropriate:
     osg::ref_ptr<osg::Group> group;
@@ -956,8 +1200,34 @@ FeatureModelGraph::buildLevel( const FeatureLevel& level, const GeoExtent& exten
 
     query.setMap( _session->getMap() );
 
+    // The node cache holds the compiled style groups of a tile; the LOD and culling
+    // wrappers below are cheap and always built fresh. Indexed features can't be
+    // cached because the index refers to live drawables.
+    std::string nodeCacheKey;
+    bool        fromNodeCache = false;
+
+    if ( _nodeCacheBin.valid() && !index && !tileName.empty() )
+    {
+        nodeCacheKey = tileName;
+        if ( level.styleName().isSet() )
+            nodeCacheKey = Stringify() << tileName << "_" << std::hex << hashString(level.styleName().get());
+
+        osg::ref_ptr<osg::Group> cached = readNodeCache( nodeCacheKey );
+        if ( cached.valid() )
+        {
+            for(unsigned i = 0; i < cached->getNumChildren(); ++i)
+                group->addChild( cached->getChild(i) );
+            fromNodeCache = true;
+        }
+    }
+
+    if ( fromNodeCache )
+    {
+        // nothing to compile.
+    }
+
     // does the level have a style name set?
-    if ( level.styleName().isSet() )
+    else if ( level.styleName().isSet() )
     {
         osg::Node* node = 0L;
         const Style* style = _session->styles()->getStyle( *level.styleName(), false );
@@ -994,6 +1264,12 @@ FeatureModelGraph::buildLevel( const FeatureLevel& level, const GeoExtent& exten
             group->addChild( node );
     }
 
+    // save the compiled tile (even an empty one) for next time.
+    if ( !nodeCacheKey.empty() && !fromNodeCache )
+    {
+        writeNodeCache( nodeCacheKey, group.get() );
+    }
+
     if ( group->getNumChildren() > 0 )
     {
         // account for a min-range here. Do not address the max-range here; that happens
@@ -1482,6 +1758,12 @@ FeatureModelGraph::getOrCreateStyleGroupFromFactory(const Style& style)
 {
     osg::Group* styleGroup = _factory->getOrCreateStyleGroup( style, _session.get() );
 
+    // a tile read from the node cache needs to know its styles (see readNodeCache).
+    if ( styleGroup && _nodeCacheBin.valid() )
+    {
+        styleGroup->setUserValue( NODE_CACHE_STYLE_TAG, style.getConfig(false).toJSON() );
+    }
+
     // Check the style and see if we need to active GPU clamping. GPU clamping
     // is currently all-or-nothing for a single FMG.
     checkForGlobalStyles( style );
@@ -1634,7 +1916,7 @@ FeatureModelGraph::redraw()
         FeatureLevel defaultLevel( 0.0f, FLT_MAX );
         
         //Remove all current children
-        node = buildLevel( defaultLevel, GeoExtent::INVALID, 0 );
+        node = buildLevel( defaultLevel, GeoExtent::INVALID, 0, "all" );
     }
 
     float minRange = -FLT_MAX;
@@ -1691,5 +1973,9 @@ void
 FeatureModelGraph::setStyles( StyleSheet* styles )
 {
     _session->setStyles( styles );
+
+    if ( _nodeCacheBin.valid() )
+        _styleHash = hashString( _session->styles()->getConfig().toJSON() );
+
     dirty();
 }
@@ -41,7 +41,8 @@ _maxGranularity_deg( 1.0 ),
 _clusterCulling    ( true ),
 _backfaceCulling   ( true ),
 _alphaBlending     ( true ),
-_sessionWideResourceCache( true )
+_sessionWideResourceCache( true ),
+_nodeCaching       ( false )
 {
     fromConfig( _conf );
 }
@@ -67,6 +68,7 @@ FeatureModelSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "alpha_blending",   _alphaBlending );
     
     conf.getIfSet( "session_wide_resource_cache", _sessionWideResourceCache );
+    conf.getIfSet( "node_caching", _nodeCaching );
 }
 
 Config
@@ -93,6 +95,7 @@ FeatureModelSourceOptions::getConfig() const
     conf.updateIfSet( "alpha_blending",   _alphaBlending );
     
     conf.updateIfSet( "session_wide_resource_cache", _sessionWideResourceCache );
+    conf.updateIfSet( "node_caching", _nodeCaching );
 
     return conf;
 }
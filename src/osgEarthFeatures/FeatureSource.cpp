@@ -52,6 +52,7 @@ FeatureSourceOptions::fromConfig( const Config& conf )
     conf.getObjIfSet( "cache_policy", _cachePolicy );
     conf.getIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.getIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
+    conf.getIfSet   ( "packed_attributes", _packedAttributes );
 
     const ConfigSet& children = conf.children();
     for( ConfigSet::const_iterator i = children.begin(); i != children.end(); ++i )
@@ -99,6 +100,7 @@ FeatureSourceOptions::getConfig() const
     conf.updateObjIfSet( "cache_policy", _cachePolicy );
     conf.updateIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.updateIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
+    conf.updateIfSet   ( "packed_attributes", _packedAttributes );
     
     for( FeatureFilterList::const_iterator i = _filters.begin(); i != _filters.end(); ++i )
     {
@@ -112,7 +114,8 @@ FeatureSourceOptions::getConfig() const
 
 FeatureSource::FeatureSource(const ConfigOptions&  options,
                              const osgDB::Options* dbOptions) :
-_options( options )
+_options              ( options ),
+_attrSchemaInitialized( false )
 {    
     _dbOptions  = dbOptions;
     _uriContext = URIContext( dbOptions );
@@ -142,6 +145,22 @@ FeatureSource::getFeatureProfile() const
     return _featureProfile.get();
 }
 
+const AttributeSchema*
+FeatureSource::getAttributeSchema() const
+{
+    // called once per cursor or feature lookup, so a plain lock is cheap enough.
+    Threading::ScopedMutexLock lock( _attrSchemaMutex );
+    if ( !_attrSchemaInitialized )
+    {
+        if ( _options.packedAttributes() == true && !getSchema().empty() )
+        {
+            _attrSchema = new AttributeSchema( getSchema() );
+        }
+        _attrSchemaInitialized = true;
+    }
+    return _attrSchema.get();
+}
+
 const FeatureFilterList&
 FeatureSource::getFilters() const
 {
@@ -264,24 +264,24 @@ OgrUtils::createOgrGeometry(const osgEarth::Symbology::Geometry* geometry, OGRwk
 }
 
 Feature*
-OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile)
+OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile, const AttributeSchema* attrSchema)
 {
     Feature* f = 0L;
     if ( profile )
     {
-        f = createFeature( handle, profile->getSRS() );
+        f = createFeature( handle, profile->getSRS(), attrSchema );
         if ( f && profile->geoInterp().isSet() )
             f->geoInterp() = profile->geoInterp().get();
     }
     else
     {
-        f = createFeature( handle, (const SpatialReference*)0L );
+        f = createFeature( handle, (const SpatialReference*)0L, attrSchema );
     }
     return f;
 }            
 
 Feature*
-OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
+OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, const AttributeSchema* attrSchema )
 {
     long fid = OGR_F_GetFID( handle );
 
@@ -296,6 +296,10 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
 
     Feature* feature = new Feature( geom, srs, Style(), fid );
 
+    // bind the schema first so the attributes go straight into packed storage.
+    if ( attrSchema )
+        feature->setAttributeSchema( attrSchema );
+
     int numAttrs = OGR_F_GetFieldCount(handle); 
     for (int i = 0; i < numAttrs; ++i) 
     { 
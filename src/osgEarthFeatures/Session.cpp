@@ -57,6 +57,13 @@ _dbOptions     ( dbOptions )
     // tiles in a particular "layer" will tend to share state.
     _stateSetCache = new StateSetCache();
 
+    // Likewise for elevation data: feature tiles in a layer clamp to the same
+    // terrain tiles, so they share one sampler. Feature tiles already compile
+    // on several pager threads at once, so each batch fetches its tiles in
+    // the calling thread.
+    _elevationSampler = new BatchElevationSampler();
+    _elevationSampler->setNumThreads( 1u );
+
     _name = "Session (unnamed)";
 }
 
@@ -22,6 +22,7 @@
 #include <osgEarthSymbology/Expression>
 #include <osgEarth/StringUtils>
 #include <algorithm>
+#include <map>
 
 using namespace osgEarth;
 using namespace osgEarth::Symbology;
@@ -355,6 +356,126 @@ NumericExpression::eval() const
     return !osg::isNaN( _value ) ? _value : 0.0;
 }
 
+void
+NumericExpression::compile( const std::vector<unsigned>& varSlots, Program& out ) const
+{
+    out._code.clear();
+    out._maxDepth = 0u;
+
+    // map each variable's RPN position to its slot:
+    std::map<unsigned, unsigned> slotOf;
+    for( unsigned v=0; v<_vars.size() && v<varSlots.size(); ++v )
+        slotOf[_vars[v].second] = varSlots[v];
+
+    // track the stack depth as we go; eval() skips any operator that finds
+    // fewer than two operands, so the program simply leaves those out.
+    unsigned depth = 0u;
+
+    for( unsigned i=0; i<_rpn.size(); ++i )
+    {
+        const Atom& a = _rpn[i];
+
+        Program::OpCode op;
+        switch( a.first )
+        {
+        case ADD:  op = Program::OP_ADD;  break;
+        case SUB:  op = Program::OP_SUB;  break;
+        case MULT: op = Program::OP_MULT; break;
+        case DIV:  op = Program::OP_DIV;  break;
+        case MOD:  op = Program::OP_MOD;  break;
+        case MIN:  op = Program::OP_MIN;  break;
+        case MAX:  op = Program::OP_MAX;  break;
+        case VARIABLE:
+            {
+                std::map<unsigned, unsigned>::const_iterator s = slotOf.find( i );
+                op = s != slotOf.end() ? Program::OP_PUSH_SLOT : Program::OP_PUSH_CONST;
+            }
+            break;
+        default: // OPERAND (or a stray paren, which eval() pushes as a value)
+            op = Program::OP_PUSH_CONST;
+        }
+
+        if ( op == Program::OP_PUSH_CONST || op == Program::OP_PUSH_SLOT )
+        {
+            Program::Instruction inst;
+            inst._op    = op;
+            inst._slot  = op == Program::OP_PUSH_SLOT ? slotOf[i] : 0u;
+            inst._value = a.second;
+            out._code.push_back( inst );
+            out._maxDepth = std::max( out._maxDepth, ++depth );
+        }
+        else if ( depth >= 2 )
+        {
+            unsigned n = out._code.size();
+
+            // fold an operator applied to two constants:
+            if ( n >= 2 &&
+                 out._code[n-2]._op == Program::OP_PUSH_CONST &&
+                 out._code[n-1]._op == Program::OP_PUSH_CONST )
+            {
+                out._code[n-2]._value = Program::apply( op, out._code[n-2]._value, out._code[n-1]._value );
+                out._code.resize( n-1 );
+            }
+            else
+            {
+                Program::Instruction inst;
+                inst._op    = op;
+                inst._slot  = 0u;
+                inst._value = 0.0;
+                out._code.push_back( inst );
+            }
+            --depth;
+        }
+    }
+}
+
+double
+NumericExpression::Program::apply( OpCode op, double op1, double op2 )
+{
+    switch( op )
+    {
+    case OP_ADD:  return op1 + op2;
+    case OP_SUB:  return op1 - op2;
+    case OP_MULT: return op1 * op2;
+    case OP_DIV:  return op1 / op2;
+    case OP_MOD:  return fmod( op1, op2 );
+    case OP_MIN:  return std::min( op1, op2 );
+    case OP_MAX:  return std::max( op1, op2 );
+    default:   return op2;
+    }
+}
+
+double
+NumericExpression::Program::run( const double* slots ) const
+{
+    // small programs run on a stack buffer so evaluation never allocates.
+    double buffer[16];
+    std::vector<double> heap;
+    double* s = buffer;
+    if ( _maxDepth > 16u )
+    {
+        heap.resize( _maxDepth );
+        s = &heap[0];
+    }
+
+    unsigned top = 0u;
+
+    for( std::vector<Instruction>::const_iterator i = _code.begin(); i != _code.end(); ++i )
+    {
+        switch( i->_op )
+        {
+        case OP_PUSH_CONST: s[top++] = i->_value;       break;
+        case OP_PUSH_SLOT:  s[top++] = slots[i->_slot]; break;
+        default:
+            --top;
+            s[top-1] = apply( i->_op, s[top-1], s[top] );
+        }
+    }
+
+    double value = top > 0u ? s[top-1] : 0.0;
+    return !osg::isNaN( value ) ? value : 0.0;
+}
+
 //------------------------------------------------------------------------
 
 StringExpression::StringExpression( const std::string& expr ) : 
@@ -397,6 +518,8 @@ StringExpression::setLiteral( const std::string& expr )
 {
     _src = "\"" + expr + "\"";
     _value = expr;
+    _infix.clear();
+    _vars.clear();
     _dirty = false;
 }
 
@@ -551,3 +674,62 @@ StringExpression::evalURI() const
 {
     return URI(eval(), _uriContext);
 }
+
+void
+StringExpression::compile( const std::vector<unsigned>& varSlots, Program& out ) const
+{
+    out._pieces.clear();
+
+    // a literal set with setLiteral() has no infix to compile.
+    if ( _infix.empty() )
+    {
+        if ( !_value.empty() )
+        {
+            Program::Piece piece;
+            piece._slot    = -1;
+            piece._literal = _value;
+            out._pieces.push_back( piece );
+        }
+        return;
+    }
+
+    // map each variable's infix position to its slot:
+    std::map<unsigned, unsigned> slotOf;
+    for( unsigned v=0; v<_vars.size() && v<varSlots.size(); ++v )
+        slotOf[_vars[v].second] = varSlots[v];
+
+    for( unsigned i=0; i<_infix.size(); ++i )
+    {
+        std::map<unsigned, unsigned>::const_iterator s = slotOf.find( i );
+        if ( _infix[i].first == VARIABLE && s != slotOf.end() )
+        {
+            Program::Piece piece;
+            piece._slot = (int)s->second;
+            out._pieces.push_back( piece );
+        }
+        else if ( !out._pieces.empty() && out._pieces.back()._slot < 0 )
+        {
+            out._pieces.back()._literal += _infix[i].second;
+        }
+        else
+        {
+            Program::Piece piece;
+            piece._slot    = -1;
+            piece._literal = _infix[i].second;
+            out._pieces.push_back( piece );
+        }
+    }
+}
+
+void
+StringExpression::Program::run( const std::string* slots, std::string& out ) const
+{
+    out.clear();
+    for( std::vector<Piece>::const_iterator i = _pieces.begin(); i != _pieces.end(); ++i )
+    {
+        if ( i->_slot >= 0 )
+            out += slots[i->_slot];
+        else
+            out += i->_literal;
+    }
+}
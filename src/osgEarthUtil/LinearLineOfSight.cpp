@@ -254,21 +254,47 @@ LinearLineOfSightNode::compute(osg::Node* node, bool backgroundThread)
       }
 
 
-      DPLineSegmentIntersector* lsi = new DPLineSegmentIntersector(_startWorld, _endWorld);
-      osgUtil::IntersectionVisitor iv( lsi );
-
-      node->accept( iv );
-
-      DPLineSegmentIntersector::Intersections& hits = lsi->getIntersections();
-      if ( hits.size() > 0 )
+      if ( _viewshedEngine.valid() )
       {
-          _hasLOS = false;
-          _hitWorld = hits.begin()->getWorldIntersectPoint();
-          _hit.fromWorld( mapSRS, _hitWorld );
+          // intersect with the elevation data itself rather than with
+          // whatever terrain tiles happen to be loaded.
+          MapFrame mapf( getMapNode()->getMap(), Map::ELEVATION_LAYERS );
+
+          GeoPoint start, end;
+          start.fromWorld( mapSRS, _startWorld );
+          end.fromWorld( mapSRS, _endWorld );
+
+          std::vector<GeoPoint> ends( 1, end );
+          std::vector<double> blocked;
+          if ( _viewshedEngine->computeLinesOfSight( mapf, start, ends, blocked ) && blocked[0] >= 0.0 )
+          {
+              _hasLOS = false;
+              _hitWorld = _startWorld + (_endWorld - _startWorld) * blocked[0];
+              _hit.fromWorld( mapSRS, _hitWorld );
+          }
+          else
+          {
+              _hasLOS = true;
+          }
       }
       else
       {
-          _hasLOS = true;
+          DPLineSegmentIntersector* lsi = new DPLineSegmentIntersector(_startWorld, _endWorld);
+          osgUtil::IntersectionVisitor iv( lsi );
+
+          node->accept( iv );
+
+          DPLineSegmentIntersector::Intersections& hits = lsi->getIntersections();
+          if ( hits.size() > 0 )
+          {
+              _hasLOS = false;
+              _hitWorld = hits.begin()->getWorldIntersectPoint();
+              _hit.fromWorld( mapSRS, _hitWorld );
+          }
+          else
+          {
+              _hasLOS = true;
+          }
       }
     }
 
@@ -414,6 +440,16 @@ LinearLineOfSightNode::setTerrainOnly( bool terrainOnly )
     }
 }
 
+void
+LinearLineOfSightNode::setViewshedEngine( ViewshedEngine* engine )
+{
+    if (_viewshedEngine.get() != engine)
+    {
+        _viewshedEngine = engine;
+        compute(getNode());
+    }
+}
+
 osg::Node*
 LinearLineOfSightNode::getNode()
 {
@@ -199,6 +199,16 @@ RadialLineOfSightNode::setCenter(const GeoPoint& center)
     }
 }
 
+void
+RadialLineOfSightNode::setViewshedEngine( ViewshedEngine* engine )
+{
+    if (_viewshedEngine.get() != engine)
+    {
+        _viewshedEngine = engine;
+        compute(getNode());
+    }
+}
+
 bool
 RadialLineOfSightNode::getTerrainOnly() const
 {
@@ -243,11 +253,11 @@ RadialLineOfSightNode::compute(osg::Node* node )
 }
 
 void
-RadialLineOfSightNode::compute_line(osg::Node* node)
-{    
-    if ( !getMapNode() )
-        return;
-
+RadialLineOfSightNode::computeSpokes(osg::Node* node,
+                                     std::vector<osg::Vec3d>& ends,
+                                     std::vector<bool>& hasLOS,
+                                     std::vector<osg::Vec3d>& hits)
+{
     GeoPoint centerMap;
     _center.transform( getMapNode()->getMapSRS(), centerMap );
     centerMap.toWorld( _centerWorld, getMapNode()->getTerrain() );
@@ -261,32 +271,55 @@ RadialLineOfSightNode::compute_line(osg::Node* node)
 
     //Get the number of spokes
     double delta = osg::PI * 2.0 / (double)_numSpokes;
-    
-    osg::Geometry* geometry = new osg::Geometry;
-    geometry->setUseVertexBufferObjects(true);
 
-    osg::Vec3Array* verts = new osg::Vec3Array();
-    verts->reserve(_numSpokes * 5);
-    geometry->setVertexArray( verts );
+    ends.resize( _numSpokes );
+    hasLOS.assign( _numSpokes, true );
+    hits.assign( _numSpokes, osg::Vec3d() );
 
-    osg::Vec4Array* colors = new osg::Vec4Array();
-    colors->reserve( _numSpokes * 5 );
+    for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
+    {
+        double angle = delta * (double)i;
+        osg::Quat quat(angle, up );
+        osg::Vec3d spoke = quat * (side * _radius);
+        ends[i] = _centerWorld + spoke;
+    }
 
-    geometry->setColorArray( colors );
-    geometry->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
+    if ( _viewshedEngine.valid() )
+    {
+        // intersect with the elevation data itself rather than with
+        // whatever terrain tiles happen to be loaded.
+        MapFrame mapf( getMapNode()->getMap(), Map::ELEVATION_LAYERS );
+        const SpatialReference* mapSRS = getMapNode()->getMapSRS();
 
-    osg::Vec3d previousEnd;
-    osg::Vec3d firstEnd;
+        GeoPoint start;
+        start.fromWorld( mapSRS, _centerWorld );
+
+        std::vector<GeoPoint> endPoints( _numSpokes );
+        for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
+        {
+            endPoints[i].fromWorld( mapSRS, ends[i] );
+        }
+
+        std::vector<double> blocked;
+        if ( _viewshedEngine->computeLinesOfSight( mapf, start, endPoints, blocked ) )
+        {
+            for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
+            {
+                if ( blocked[i] >= 0.0 )
+                {
+                    hasLOS[i] = false;
+                    hits[i] = _centerWorld + (ends[i] - _centerWorld) * blocked[i];
+                }
+            }
+        }
+        return;
+    }
 
     osg::ref_ptr<osgUtil::IntersectorGroup> ivGroup = new osgUtil::IntersectorGroup();
 
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
-        double angle = delta * (double)i;
-        osg::Quat quat(angle, up );
-        osg::Vec3d spoke = quat * (side * _radius);
-        osg::Vec3d end = _centerWorld + spoke;
-        osg::ref_ptr<DPLineSegmentIntersector> dplsi = new DPLineSegmentIntersector( _centerWorld, end );
+        osg::ref_ptr<DPLineSegmentIntersector> dplsi = new DPLineSegmentIntersector( _centerWorld, ends[i] );
         ivGroup->addIntersector( dplsi.get() );
     }
 
@@ -297,20 +330,49 @@ RadialLineOfSightNode::compute_line(osg::Node* node)
 
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
-        DPLineSegmentIntersector* los = dynamic_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[i].get());
-        DPLineSegmentIntersector::Intersections& hits = los->getIntersections();
-
-        osg::Vec3d start = los->getStart();
-        osg::Vec3d end = los->getEnd();
-
-        osg::Vec3d hit;
-        bool hasLOS = hits.empty();
-        if (!hasLOS)
+        DPLineSegmentIntersector* los = static_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[i].get());
+        DPLineSegmentIntersector::Intersections& losHits = los->getIntersections();
+        if ( !losHits.empty() )
         {
-            hit = hits.begin()->getWorldIntersectPoint();
+            hasLOS[i] = false;
+            hits[i] = losHits.begin()->getWorldIntersectPoint();
         }
+    }
+}
 
-        if (hasLOS)
+void
+RadialLineOfSightNode::compute_line(osg::Node* node)
+{    
+    if ( !getMapNode() )
+        return;
+
+    std::vector<osg::Vec3d> ends, hits;
+    std::vector<bool>       hasLOS;
+    computeSpokes( node, ends, hasLOS, hits );
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setUseVertexBufferObjects(true);
+
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->reserve(_numSpokes * 5);
+    geometry->setVertexArray( verts );
+
+    osg::Vec4Array* colors = new osg::Vec4Array();
+    colors->reserve( _numSpokes * 5 );
+
+    geometry->setColorArray( colors );
+    geometry->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
+
+    osg::Vec3d previousEnd;
+    osg::Vec3d firstEnd;
+
+    for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
+    {
+        osg::Vec3d start = _centerWorld;
+        osg::Vec3d end = ends[i];
+        osg::Vec3d hit = hits[i];
+
+        if (hasLOS[i])
         {
             verts->push_back( start - _centerWorld );
             verts->push_back( end - _centerWorld );
@@ -390,21 +452,10 @@ RadialLineOfSightNode::compute_fill(osg::Node* node)
     if ( !getMapNode() )
         return;
 
-    GeoPoint centerMap;
-    _center.transform( getMapNode()->getMapSRS(), centerMap );
-    centerMap.toWorld( _centerWorld, getMapNode()->getTerrain() );
-
-    bool isProjected = getMapNode()->getMapSRS()->isProjected();
-
-    osg::Vec3d up = isProjected ? osg::Vec3d(0,0,1) : osg::Vec3d(_centerWorld);
-    up.normalize();
-
-    //Get the "side" vector
-    osg::Vec3d side = isProjected ? osg::Vec3d(1,0,0) : up ^ osg::Vec3d(0,0,1);
+    std::vector<osg::Vec3d> ends, hits;
+    std::vector<bool>       hasLOS;
+    computeSpokes( node, ends, hasLOS, hits );
 
-    //Get the number of spokes
-    double delta = osg::PI * 2.0 / (double)_numSpokes;
-    
     osg::Geometry* geometry = new osg::Geometry;
     geometry->setUseVertexBufferObjects(true);
 
@@ -418,42 +469,20 @@ RadialLineOfSightNode::compute_fill(osg::Node* node)
     geometry->setColorArray( colors );
     geometry->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
 
-    osg::ref_ptr<osgUtil::IntersectorGroup> ivGroup = new osgUtil::IntersectorGroup();
-
-    for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
-    {
-        double angle = delta * (double)i;
-        osg::Quat quat(angle, up );
-        osg::Vec3d spoke = quat * (side * _radius);
-        osg::Vec3d end = _centerWorld + spoke;        
-        osg::ref_ptr<DPLineSegmentIntersector> dplsi = new DPLineSegmentIntersector( _centerWorld, end );
-        ivGroup->addIntersector( dplsi.get() );
-    }
-
-    osgUtil::IntersectionVisitor iv;
-    iv.setIntersector( ivGroup.get() );
-
-    node->accept( iv );
-
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
         //Get the current hit
-        DPLineSegmentIntersector* los = dynamic_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[i].get());
-        DPLineSegmentIntersector::Intersections& hits = los->getIntersections();
-
-        osg::Vec3d currEnd = los->getEnd();
-        bool currHasLOS = hits.empty();
-        osg::Vec3d currHit = currHasLOS ? osg::Vec3d() : hits.begin()->getWorldIntersectPoint();
+        osg::Vec3d currEnd = ends[i];
+        bool currHasLOS = hasLOS[i];
+        osg::Vec3d currHit = hits[i];
 
         //Get the next hit
         unsigned int nextIndex = i + 1;
         if (nextIndex == _numSpokes) nextIndex = 0;
-        DPLineSegmentIntersector* losNext = static_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[nextIndex].get());
-        DPLineSegmentIntersector::Intersections& hitsNext = losNext->getIntersections();
 
-        osg::Vec3d nextEnd = losNext->getEnd();
-        bool nextHasLOS = hitsNext.empty();
-        osg::Vec3d nextHit = nextHasLOS ? osg::Vec3d() : hitsNext.begin()->getWorldIntersectPoint();
+        osg::Vec3d nextEnd = ends[nextIndex];
+        bool nextHasLOS = hasLOS[nextIndex];
+        osg::Vec3d nextHit = hits[nextIndex];
         
         if (currHasLOS && nextHasLOS)
         {
@@ -23,6 +23,9 @@
 #include <osgEarth/MapNode>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/GeoMath>
+#include <osgEarth/Units>
+
+#define LC "[TerrainProfile] "
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -90,6 +93,183 @@ TerrainProfile::getElevationRanges(double &min, double &max ) const
     }
 }
 
+/***************************************************/
+TerrainProfileEngine::TerrainProfileEngine() :
+_spacing      ( 30.0 ),
+_interpolation( GEOINTERP_GREAT_CIRCLE )
+{
+    _sampler = new BatchElevationSampler();
+}
+
+void
+TerrainProfileEngine::setSpacing(double meters)
+{
+    if ( meters > 0.0 )
+        _spacing = meters;
+}
+
+bool
+TerrainProfileEngine::densify(const std::vector<GeoPoint>& path,
+                              const SpatialReference*      geoSRS,
+                              double                       radius,
+                              std::vector<osg::Vec3d>&     out_points,
+                              std::vector<double>&         out_distances) const
+{
+    // path points in radians
+    std::vector<osg::Vec2d> latlon;
+    latlon.reserve( path.size() );
+    for(unsigned i = 0; i < path.size(); ++i)
+    {
+        GeoPoint geo;
+        if ( !path[i].isValid() || !path[i].transform(geoSRS, geo) )
+            return false;
+        latlon.push_back( osg::Vec2d(osg::DegreesToRadians(geo.y()), osg::DegreesToRadians(geo.x())) );
+    }
+
+    if ( latlon.empty() )
+        return false;
+
+    double distance = 0.0;
+    out_points.push_back( osg::Vec3d(osg::RadiansToDegrees(latlon[0].y()), osg::RadiansToDegrees(latlon[0].x()), 0.0) );
+    out_distances.push_back( 0.0 );
+
+    for(unsigned i = 0; i+1 < latlon.size(); ++i)
+    {
+        double lat1 = latlon[i].x(),   lon1 = latlon[i].y();
+        double lat2 = latlon[i+1].x(), lon2 = latlon[i+1].y();
+
+        bool   rhumb  = _interpolation == GEOINTERP_RHUMB_LINE;
+        double length = rhumb ?
+            GeoMath::rhumbDistance( lat1, lon1, lat2, lon2, radius ) :
+            GeoMath::distance( lat1, lon1, lat2, lon2, radius );
+
+        if ( length <= 0.0 )
+            continue;
+
+        double bearing = rhumb ? GeoMath::rhumbBearing( lat1, lon1, lat2, lon2 ) : 0.0;
+
+        unsigned num = (unsigned)ceil( length/_spacing );
+        for(unsigned k = 1; k <= num; ++k)
+        {
+            double t = (double)k / (double)num;
+            double lat, lon;
+            if ( k == num )
+            {
+                lat = lat2, lon = lon2;
+            }
+            else if ( rhumb )
+            {
+                GeoMath::rhumbDestination( lat1, lon1, bearing, t*length, lat, lon, radius );
+            }
+            else
+            {
+                GeoMath::interpolate( lat1, lon1, lat2, lon2, t, lat, lon );
+            }
+
+            out_points.push_back( osg::Vec3d(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), 0.0) );
+            out_distances.push_back( distance + t*length );
+        }
+
+        distance += length;
+    }
+
+    return true;
+}
+
+bool
+TerrainProfileEngine::computeProfile(const MapFrame& mapf,
+                                     const GeoPoint& start,
+                                     const GeoPoint& end,
+                                     TerrainProfile& out_profile) const
+{
+    std::vector<GeoPoint> path( 2 );
+    path[0] = start;
+    path[1] = end;
+    return computeProfile( mapf, path, out_profile );
+}
+
+bool
+TerrainProfileEngine::computeProfile(const MapFrame&              mapf,
+                                     const std::vector<GeoPoint>& path,
+                                     TerrainProfile&              out_profile) const
+{
+    std::vector< std::vector<GeoPoint> > paths( 1, path );
+    std::vector<TerrainProfile> profiles;
+    bool ok = computeProfiles( mapf, paths, profiles );
+    out_profile = profiles[0];
+    return ok;
+}
+
+bool
+TerrainProfileEngine::computeProfiles(const MapFrame&                             mapf,
+                                      const std::vector< std::vector<GeoPoint> >& paths,
+                                      std::vector<TerrainProfile>&                out_profiles) const
+{
+    out_profiles.assign( paths.size(), TerrainProfile() );
+    if ( paths.empty() )
+        return true;
+
+    if ( !mapf.getProfile() )
+        return false;
+
+    const SpatialReference* mapSRS = mapf.getProfile()->getSRS();
+    const SpatialReference* geoSRS = mapSRS->getGeographicSRS();
+    const double            radius = mapSRS->getEllipsoid()->getRadiusEquator();
+
+    // densify all the paths into one list of points.
+    std::vector<osg::Vec3d> points;
+    std::vector<double>     distances;
+    std::vector<unsigned>   firstSample( paths.size()+1 );
+    bool ok = true;
+
+    for(unsigned i = 0; i < paths.size(); ++i)
+    {
+        firstSample[i] = points.size();
+        if ( !densify(paths[i], geoSRS, radius, points, distances) )
+        {
+            OE_DEBUG << LC << "Invalid path " << i << std::endl;
+            points.resize( firstSample[i] );
+            distances.resize( firstSample[i] );
+            ok = false;
+        }
+    }
+    firstSample[paths.size()] = points.size();
+
+    if ( points.empty() )
+        return false;
+
+    // ask for data at least as fine as the spacing everywhere on the paths,
+    // which means at the latitude closest to the equator.
+    double latitude = 90.0;
+    for(unsigned i = 0; i < points.size(); ++i)
+    {
+        latitude = osg::minimum( latitude, fabs(points[i].y()) );
+    }
+
+    double desiredRes = SpatialReference::transformUnits(
+        Distance(_spacing, Units::METERS),
+        mapSRS,
+        latitude );
+
+    std::vector<double>                 elevations;
+    std::vector<ElevationQuery::Status> status;
+    if ( !_sampler->getElevations(mapf, points, geoSRS, elevations, &status, desiredRes) )
+        ok = false;
+
+    for(unsigned i = 0; i < paths.size(); ++i)
+    {
+        TerrainProfile& profile = out_profiles[i];
+        profile.setSpacing( _spacing );
+        for(unsigned p = firstSample[i]; p < firstSample[i+1]; ++p)
+        {
+            if ( status[p] == ElevationQuery::STATUS_OK )
+                profile.addElevation( distances[p], elevations[p] );
+        }
+    }
+
+    return ok;
+}
+
 /***************************************************/
 TerrainProfileCalculator::TerrainProfileCalculator(MapNode* mapNode, const GeoPoint& start, const GeoPoint& end):
 _mapNode( mapNode ),
@@ -185,8 +365,21 @@ void TerrainProfileCalculator::setStartEnd(const GeoPoint& start, const GeoPoint
     }
 }
 
+void TerrainProfileCalculator::setProfileEngine(TerrainProfileEngine* engine)
+{
+    if (_engine.get() != engine)
+    {
+        _engine = engine;
+        recompute();
+    }
+}
+
 void TerrainProfileCalculator::onTileAdded(const osgEarth::TileKey& tileKey, osg::Node* terrain, TerrainCallbackContext&)
 {
+    // the engine reads the elevation layers, so loading tiles changes nothing.
+    if (_engine.valid())
+        return;
+
     if (_start.isValid() && _end.isValid())
     {
         GeoExtent extent( _start.getSRS());
@@ -204,7 +397,15 @@ void TerrainProfileCalculator::recompute()
 {
     if (_start.isValid() && _end.isValid())
     {
-        computeTerrainProfile( _mapNode.get(), _start, _end, _profile);
+        if (_engine.valid() && _mapNode.valid())
+        {
+            MapFrame mapf( _mapNode->getMap(), Map::ELEVATION_LAYERS );
+            _engine->computeProfile( mapf, _start, _end, _profile );
+        }
+        else
+        {
+            computeTerrainProfile( _mapNode.get(), _start, _end, _profile);
+        }
 
         for( ChangedCallbackList::iterator i = _changedCallbacks.begin(); i != _changedCallbacks.end(); i++ )
         {
@@ -0,0 +1,703 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthUtil/Viewshed>
+#include <osgEarth/Units>
+#include <osgEarth/Notify>
+#include <osg/Image>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#define LC "[Viewshed] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace osgEarth::Symbology;
+
+namespace
+{
+    // num/den rounded to the nearest integer (halves away from zero); den > 0.
+    inline int roundDiv(int num, int den)
+    {
+        int n = 2*num + den, d = 2*den;
+        return n >= 0 ? n/d : -((-n + d - 1)/d);
+    }
+
+    // linear interpolation that tolerates one missing sample.
+    inline float lerp(float a, float b, double t)
+    {
+        if ( a == NO_DATA_VALUE ) return b;
+        if ( b == NO_DATA_VALUE ) return a;
+        return a + (float)((double)(b - a) * t);
+    }
+
+    /**
+     * State shared by all the rays of one viewshed. Elevations are already
+     * corrected for curvature, so the rays can treat the grid as flat.
+     */
+    struct SweepContext
+    {
+        const std::vector<float>*   _elev;
+        std::vector<unsigned char>* _values;
+        int                         _size;
+        int                         _n;
+        double                      _cellSize;
+        double                      _maxDistance;
+        double                      _z0;
+        double                      _targetHeight;
+
+        float elev(int col, int row) const
+        {
+            if ( col < 0 || row < 0 || col >= _size || row >= _size )
+                return NO_DATA_VALUE;
+            return (*_elev)[row*_size + col];
+        }
+
+        /**
+         * Walks one ray of the R2 algorithm, from the observer to the grid
+         * cell at offset (ex,ey) on the perimeter. At each column (or row)
+         * the ray crosses, the terrain height comes from the two cells it
+         * passes between, and the cell nearest to the ray takes its
+         * visibility from the highest slope seen so far.
+         *
+         * A cell may be crossed by many rays, but only one of them (the ray
+         * whose end point the cell rounds to) writes it, so rays running in
+         * different threads never touch the same cell.
+         */
+        void walkRay(int ex, int ey) const
+        {
+            const bool   xMajor    = abs(ex) >= abs(ey);
+            const int    major     = xMajor ? ex : ey;
+            const int    minor     = xMajor ? ey : ex;
+            const int    sign      = major > 0 ? 1 : -1;
+            const int    n         = _n;
+            const double stepLength = _cellSize * sqrt((double)(n*n + minor*minor)) / (double)n;
+
+            double maxSlope = -DBL_MAX;
+
+            for(int s = 1; s <= n; ++s)
+            {
+                double distance = stepLength * (double)s;
+                if ( distance > _maxDistance )
+                    break;
+
+                // terrain height where the ray crosses this column (or row)
+                double f  = (double)(minor*s) / (double)n;
+                double f0 = floor(f);
+                double t  = f - f0;
+                int    a  = sign*s;
+                int    i0 = (int)f0;
+
+                float zTerrain;
+                if ( xMajor )
+                    zTerrain = t > 0.0 ? lerp(elev(n+a, n+i0), elev(n+a, n+i0+1), t) : elev(n+a, n+i0);
+                else
+                    zTerrain = t > 0.0 ? lerp(elev(n+i0, n+a), elev(n+i0+1, n+a), t) : elev(n+i0, n+a);
+
+                // the cell nearest to the ray, and whether this ray owns it
+                int b = roundDiv(minor*s, n);
+                bool owned = (xMajor || abs(b) < s) && roundDiv(b*n, s) == minor;
+                if ( owned )
+                {
+                    int col = xMajor ? n+a : n+b;
+                    int row = xMajor ? n+b : n+a;
+                    unsigned char& value = (*_values)[row*_size + col];
+                    if ( value != Viewshed::OUT_OF_RANGE )
+                    {
+                        float z = (*_elev)[row*_size + col];
+                        if ( z == NO_DATA_VALUE )
+                        {
+                            value = Viewshed::NO_DATA;
+                        }
+                        else
+                        {
+                            double slope = ((double)z + _targetHeight - _z0) / (_cellSize * sqrt((double)(a*a + b*b)));
+                            value = slope >= maxSlope ? Viewshed::VISIBLE : Viewshed::INVISIBLE;
+                        }
+                    }
+                }
+
+                if ( zTerrain != NO_DATA_VALUE )
+                {
+                    double slope = ((double)zTerrain - _z0) / distance;
+                    if ( slope > maxSlope )
+                        maxSlope = slope;
+                }
+            }
+        }
+    };
+
+    // A contiguous range of rays, to run in one thread.
+    struct SweepSector
+    {
+        const SweepContext*                         _cx;
+        const std::vector< std::pair<int,int> >*    _perimeter;
+        unsigned                                    _begin, _end;
+
+        void execute()
+        {
+            for(unsigned i = _begin; i < _end; ++i)
+                _cx->walkRay( (*_perimeter)[i].first, (*_perimeter)[i].second );
+        }
+    };
+}
+
+//---------------------------------------------------------------------------
+
+Viewshed::Viewshed(const GeoPoint&         observer,
+                   const SpatialReference* tangentPlaneSRS,
+                   unsigned                size,
+                   double                  cellSize) :
+_observer( observer ),
+_srs     ( tangentPlaneSRS ),
+_size    ( size ),
+_cellSize( cellSize ),
+_values  ( size*size, (unsigned char)OUT_OF_RANGE )
+{
+    //nop
+}
+
+GeoExtent
+Viewshed::getExtent() const
+{
+    double half = 0.5 * _cellSize * (double)_size;
+    return GeoExtent( _srs.get(), -half, -half, half, half );
+}
+
+Viewshed::Value
+Viewshed::getValue(const GeoPoint& point) const
+{
+    GeoPoint local;
+    if ( !point.transform(_srs.get(), local) )
+        return OUT_OF_RANGE;
+
+    double n   = (double)(_size/2);
+    double col = floor( local.x()/_cellSize + n + 0.5 );
+    double row = floor( local.y()/_cellSize + n + 0.5 );
+    if ( col < 0.0 || row < 0.0 || col >= (double)_size || row >= (double)_size )
+        return OUT_OF_RANGE;
+
+    return getValue( (unsigned)col, (unsigned)row );
+}
+
+unsigned
+Viewshed::getNumVisible() const
+{
+    unsigned count = 0;
+    for(unsigned i = 0; i < _values.size(); ++i)
+    {
+        if ( _values[i] == VISIBLE )
+            ++count;
+    }
+    return count;
+}
+
+GeoImage
+Viewshed::createImage(const osg::Vec4f& visibleColor,
+                      const osg::Vec4f& invisibleColor) const
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( _size, _size, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    image->setInternalTextureFormat( GL_RGBA8 );
+
+    unsigned char visible[4], invisible[4];
+    for(unsigned i = 0; i < 4; ++i)
+    {
+        visible[i]   = (unsigned char)(osg::clampBetween(visibleColor[i],   0.0f, 1.0f) * 255.0f);
+        invisible[i] = (unsigned char)(osg::clampBetween(invisibleColor[i], 0.0f, 1.0f) * 255.0f);
+    }
+
+    for(unsigned row = 0; row < _size; ++row)
+    {
+        unsigned char* ptr = image->data( 0, row );
+        for(unsigned col = 0; col < _size; ++col, ptr += 4)
+        {
+            Value value = getValue( col, row );
+            if ( value == VISIBLE )
+                memcpy( ptr, visible, 4 );
+            else if ( value == INVISIBLE )
+                memcpy( ptr, invisible, 4 );
+            else
+                memset( ptr, 0, 4 );
+        }
+    }
+
+    return GeoImage( image.get(), getExtent() );
+}
+
+Geometry*
+Viewshed::createGeometry(const SpatialReference* srs) const
+{
+    // Merges runs of visible cells into rectangles: a run extends the open
+    // rectangle with the same columns in the row below, if there is one.
+    struct Rect { int _c0, _c1, _r0, _r1; };
+    std::vector<Rect> rects;
+    std::map< std::pair<int,int>, int > open;
+
+    for(int row = 0; row < (int)_size; ++row)
+    {
+        std::map< std::pair<int,int>, int > next;
+
+        int col = 0;
+        while( col < (int)_size )
+        {
+            if ( getValue(col, row) != VISIBLE )
+            {
+                ++col;
+                continue;
+            }
+
+            int c0 = col;
+            while( col < (int)_size && getValue(col, row) == VISIBLE )
+                ++col;
+
+            std::pair<int,int> run( c0, col );
+            std::map< std::pair<int,int>, int >::iterator i = open.find( run );
+            if ( i != open.end() )
+            {
+                rects[i->second]._r1 = row + 1;
+                next[run] = i->second;
+            }
+            else
+            {
+                Rect rect = { c0, col, row, row + 1 };
+                next[run] = rects.size();
+                rects.push_back( rect );
+            }
+        }
+
+        open.swap( next );
+    }
+
+    if ( rects.empty() )
+        return 0L;
+
+    const double n = (double)(_size/2);
+
+    MultiGeometry* result = new MultiGeometry();
+    for(unsigned i = 0; i < rects.size(); ++i)
+    {
+        const Rect& r = rects[i];
+        double xmin = ((double)r._c0 - n - 0.5) * _cellSize;
+        double xmax = ((double)r._c1 - n - 0.5) * _cellSize;
+        double ymin = ((double)r._r0 - n - 0.5) * _cellSize;
+        double ymax = ((double)r._r1 - n - 0.5) * _cellSize;
+
+        Polygon* poly = new Polygon();
+        poly->push_back( osg::Vec3d(xmin, ymin, 0.0) );
+        poly->push_back( osg::Vec3d(xmax, ymin, 0.0) );
+        poly->push_back( osg::Vec3d(xmax, ymax, 0.0) );
+        poly->push_back( osg::Vec3d(xmin, ymax, 0.0) );
+
+        if ( srs )
+            _srs->transform( poly->asVector(), srs );
+
+        result->add( poly );
+    }
+
+    return result;
+}
+
+//---------------------------------------------------------------------------
+
+ViewshedEngine::ViewshedEngine() :
+_resolution  ( 30.0 ),
+_targetHeight( 0.0 ),
+_curvature   ( true ),
+_refraction  ( 0.13 )
+{
+    _sampler = new BatchElevationSampler();
+}
+
+void
+ViewshedEngine::setResolution(double meters)
+{
+    if ( meters > 0.0 )
+        _resolution = meters;
+}
+
+double
+ViewshedEngine::getDrop(double distance, double radius) const
+{
+    return _curvature ? distance*distance*(1.0 - _refraction)/(2.0*radius) : 0.0;
+}
+
+bool
+ViewshedEngine::getElevations(const MapFrame&                mapf,
+                              const std::vector<osg::Vec3d>& points,
+                              const SpatialReference*        pointsSRS,
+                              double                         latitude,
+                              std::vector<float>&            out_elevations) const
+{
+    double desiredRes = SpatialReference::transformUnits(
+        Distance(_resolution, Units::METERS),
+        mapf.getProfile()->getSRS(),
+        latitude );
+
+    std::vector<double>                 elevations;
+    std::vector<ElevationQuery::Status> status;
+    _sampler->getElevations( mapf, points, pointsSRS, elevations, &status, desiredRes );
+
+    out_elevations.resize( points.size() );
+    unsigned numOK = 0;
+    for(unsigned i = 0; i < points.size(); ++i)
+    {
+        if ( status[i] == ElevationQuery::STATUS_OK )
+        {
+            out_elevations[i] = (float)elevations[i];
+            ++numOK;
+        }
+        else
+        {
+            out_elevations[i] = NO_DATA_VALUE;
+        }
+    }
+
+    return numOK > 0;
+}
+
+Viewshed*
+ViewshedEngine::computeViewshed(const MapFrame& mapf,
+                                const GeoPoint& observer,
+                                double          radius) const
+{
+    if ( !observer.isValid() || !mapf.getProfile() || radius <= 0.0 )
+        return 0L;
+
+    const SpatialReference* mapSRS = mapf.getProfile()->getSRS();
+
+    GeoPoint center;
+    if ( !observer.transform(mapSRS, center) )
+        return 0L;
+
+    GeoPoint geo;
+    if ( !center.transform(mapSRS->getGeographicSRS(), geo) )
+        return 0L;
+
+    osg::ref_ptr<const SpatialReference> ltp = mapSRS->createTangentPlaneSRS(
+        osg::Vec3d(center.x(), center.y(), 0.0) );
+    if ( !ltp.valid() )
+        return 0L;
+
+    const double cs = _resolution;
+    const int    n  = osg::maximum( (int)ceil(radius/cs), 1 );
+    const int    size = 2*n + 1;
+
+    osg::ref_ptr<Viewshed> result = new Viewshed( center, ltp.get(), size, cs );
+
+    // sample the cells within range, in one batch.
+    std::vector<osg::Vec3d> points;
+    std::vector<unsigned>   indices;
+    points.reserve( size*size );
+    indices.reserve( size*size );
+
+    for(int row = 0; row < size; ++row)
+    {
+        for(int col = 0; col < size; ++col)
+        {
+            double x = (double)(col - n) * cs;
+            double y = (double)(row - n) * cs;
+            if ( x*x + y*y <= radius*radius )
+            {
+                points.push_back( osg::Vec3d(x, y, 0.0) );
+                indices.push_back( row*size + col );
+                result->_values[row*size + col] = Viewshed::INVISIBLE;
+            }
+        }
+    }
+
+    std::vector<float> samples;
+    if ( !getElevations(mapf, points, ltp.get(), geo.y(), samples) )
+    {
+        OE_WARN << LC << "No elevation data around the observer" << std::endl;
+        return 0L;
+    }
+
+    // bend the terrain down to account for the curvature of the earth.
+    const double R = mapSRS->getEllipsoid()->getRadiusEquator();
+
+    std::vector<float> elev( size*size, NO_DATA_VALUE );
+    for(unsigned i = 0; i < indices.size(); ++i)
+    {
+        if ( samples[i] != NO_DATA_VALUE )
+        {
+            const osg::Vec3d& p = points[i];
+            elev[indices[i]] = samples[i] - (float)getDrop( sqrt(p.x()*p.x() + p.y()*p.y()), R );
+        }
+    }
+
+    float ground = elev[n*size + n];
+    if ( center.isRelative() && ground == NO_DATA_VALUE )
+    {
+        OE_WARN << LC << "No elevation data under the observer" << std::endl;
+        return 0L;
+    }
+
+    SweepContext cx;
+    cx._elev         = &elev;
+    cx._values       = &result->_values;
+    cx._size         = size;
+    cx._n            = n;
+    cx._cellSize     = cs;
+    cx._maxDistance  = radius + cs;
+    cx._z0           = center.isRelative() ? (double)ground + center.z() : center.z();
+    cx._targetHeight = _targetHeight;
+
+    result->_values[n*size + n] = Viewshed::VISIBLE;
+
+    // one ray to each cell on the perimeter of the grid, counter-clockwise
+    // starting from the south-west corner.
+    std::vector< std::pair<int,int> > perimeter;
+    perimeter.reserve( 8*n );
+    for(int i = -n; i < n; ++i)  perimeter.push_back( std::make_pair(i, -n) );
+    for(int i = -n; i < n; ++i)  perimeter.push_back( std::make_pair(n, i) );
+    for(int i = n; i > -n; --i)  perimeter.push_back( std::make_pair(i, n) );
+    for(int i = n; i > -n; --i)  perimeter.push_back( std::make_pair(-n, i) );
+
+    // split the rays into sectors; the calling thread runs the last one itself.
+    osg::ref_ptr<TaskService> service = _sampler->getService();
+    unsigned numSectors = service.valid() ?
+        osg::minimum( ((unsigned)service->getNumThreads()+1u)*4u, (unsigned)perimeter.size() ) :
+        1u;
+
+    unsigned raysPerSector = (perimeter.size() + numSectors - 1) / numSectors;
+
+    Threading::MultiEvent done( numSectors - 1 );
+    std::vector< osg::ref_ptr< ParallelTask<SweepSector> > > tasks;
+
+    SweepSector local;
+    for(unsigned s = 0; s < numSectors; ++s)
+    {
+        SweepSector sector;
+        sector._cx        = &cx;
+        sector._perimeter = &perimeter;
+        sector._begin     = s * raysPerSector;
+        sector._end       = osg::minimum( sector._begin + raysPerSector, (unsigned)perimeter.size() );
+
+        if ( s+1 == numSectors )
+        {
+            local = sector;
+        }
+        else
+        {
+            ParallelTask<SweepSector>* task = new ParallelTask<SweepSector>( &done );
+            static_cast<SweepSector&>(*task) = sector;
+            tasks.push_back( task );
+            service->add( task );
+        }
+    }
+
+    local.execute();
+
+    // sweep any sectors the pool hasn't started, so a dropped task can't stall us.
+    for(unsigned i = 0; i < tasks.size(); ++i)
+        tasks[i]->runIfUnclaimed();
+
+    if ( numSectors > 1 )
+        done.wait();
+
+    return result.release();
+}
+
+bool
+ViewshedEngine::computeLinesOfSight(const MapFrame&              mapf,
+                                    const GeoPoint&              start,
+                                    const std::vector<GeoPoint>& ends,
+                                    std::vector<double>&         out_blocked) const
+{
+    if ( !start.isValid() || !mapf.getProfile() )
+        return false;
+
+    const SpatialReference* mapSRS = mapf.getProfile()->getSRS();
+
+    GeoPoint center;
+    if ( !start.transform(mapSRS, center) )
+        return false;
+
+    GeoPoint geo;
+    if ( !center.transform(mapSRS->getGeographicSRS(), geo) )
+        return false;
+
+    osg::ref_ptr<const SpatialReference> ltp = mapSRS->createTangentPlaneSRS(
+        osg::Vec3d(center.x(), center.y(), 0.0) );
+    if ( !ltp.valid() )
+        return false;
+
+    // only the horizontal position of each end goes into the tangent plane;
+    // its height stays relative to the terrain or to the vertical datum.
+    std::vector<LinePoint> lines;
+    lines.reserve( ends.size() );
+    for(unsigned i = 0; i < ends.size(); ++i)
+    {
+        GeoPoint end;
+        osg::Vec3d local;
+        if ( !ends[i].transform(mapSRS, end) ||
+             !mapSRS->transform(osg::Vec3d(end.x(), end.y(), 0.0), ltp.get(), local) )
+        {
+            return false;
+        }
+        lines.push_back( LinePoint(local.x(), local.y(), end.z(), end.isRelative()) );
+    }
+
+    return traceLines(
+        mapf, ltp.get(), geo.y(),
+        LinePoint(0.0, 0.0, center.z(), center.isRelative()),
+        lines,
+        out_blocked );
+}
+
+bool
+ViewshedEngine::computeRadial(const MapFrame&      mapf,
+                              const GeoPoint&      center,
+                              double               radius,
+                              unsigned             numSpokes,
+                              std::vector<double>& out_blocked) const
+{
+    if ( !center.isValid() || !mapf.getProfile() || numSpokes == 0u )
+        return false;
+
+    const SpatialReference* mapSRS = mapf.getProfile()->getSRS();
+
+    GeoPoint mapCenter;
+    if ( !center.transform(mapSRS, mapCenter) )
+        return false;
+
+    GeoPoint geo;
+    if ( !mapCenter.transform(mapSRS->getGeographicSRS(), geo) )
+        return false;
+
+    osg::ref_ptr<const SpatialReference> ltp = mapSRS->createTangentPlaneSRS(
+        osg::Vec3d(mapCenter.x(), mapCenter.y(), 0.0) );
+    if ( !ltp.valid() )
+        return false;
+
+    std::vector<LinePoint> lines;
+    lines.reserve( numSpokes );
+    for(unsigned i = 0; i < numSpokes; ++i)
+    {
+        double a = 2.0 * osg::PI * (double)i / (double)numSpokes;
+        lines.push_back( LinePoint(radius*sin(a), radius*cos(a), _targetHeight, true) );
+    }
+
+    return traceLines(
+        mapf, ltp.get(), geo.y(),
+        LinePoint(0.0, 0.0, mapCenter.z(), mapCenter.isRelative()),
+        lines,
+        out_blocked );
+}
+
+bool
+ViewshedEngine::traceLines(const MapFrame&               mapf,
+                           const SpatialReference*       ltp,
+                           double                        latitude,
+                           const LinePoint&              start,
+                           const std::vector<LinePoint>& ends,
+                           std::vector<double>&          out_blocked) const
+{
+    out_blocked.assign( ends.size(), -1.0 );
+    if ( ends.empty() )
+        return true;
+
+    // sample every line at the engine resolution, all in one batch; the
+    // first sample is the start point, and the last one of each line is
+    // its end point.
+    std::vector<osg::Vec3d> points;
+    std::vector<unsigned>   firstSample( ends.size() );
+    std::vector<unsigned>   numSamples( ends.size() );
+
+    points.push_back( osg::Vec3d(start._x, start._y, 0.0) );
+
+    for(unsigned i = 0; i < ends.size(); ++i)
+    {
+        osg::Vec2d d( ends[i]._x - start._x, ends[i]._y - start._y );
+        unsigned num = osg::maximum( (unsigned)ceil(d.length()/_resolution), 1u );
+
+        firstSample[i] = points.size();
+        numSamples[i]  = num;
+
+        for(unsigned k = 1; k <= num; ++k)
+        {
+            double t = (double)k / (double)num;
+            points.push_back( osg::Vec3d(start._x + d.x()*t, start._y + d.y()*t, 0.0) );
+        }
+    }
+
+    std::vector<float> elev;
+    if ( !getElevations(mapf, points, ltp, latitude, elev) )
+        return false;
+
+    const double R = mapf.getProfile()->getSRS()->getEllipsoid()->getRadiusEquator();
+
+    double zs = start._z;
+    if ( start._relative )
+    {
+        if ( elev[0] == NO_DATA_VALUE )
+            return false;
+        zs += elev[0];
+    }
+
+    for(unsigned i = 0; i < ends.size(); ++i)
+    {
+        const unsigned first = firstSample[i];
+        const unsigned num   = numSamples[i];
+        const double   L     = osg::Vec2d(ends[i]._x - start._x, ends[i]._y - start._y).length();
+
+        float he = elev[first + num - 1];
+        double ze = ends[i]._z;
+        if ( ends[i]._relative )
+        {
+            if ( he == NO_DATA_VALUE )
+                continue;
+            ze += he;
+        }
+        ze -= getDrop( L, R );
+
+        // how far the terrain rises above the line at each sample, starting
+        // from the start point, which the line can't be below.
+        double prevT = 0.0;
+        double prevDelta = elev[0] != NO_DATA_VALUE ? osg::minimum((double)elev[0] - zs, 0.0) : 0.0;
+        for(unsigned k = 1; k < num; ++k)
+        {
+            float h = elev[first + k - 1];
+            if ( h == NO_DATA_VALUE )
+                continue;
+
+            double t     = (double)k / (double)num;
+            double line  = zs + t*(ze - zs);
+            double delta = (double)h - getDrop( t*L, R ) - line;
+
+            if ( delta > 0.0 )
+            {
+                // refine the crossing between this sample and the last one
+                out_blocked[i] = prevT + (t - prevT) * (-prevDelta / (delta - prevDelta));
+                break;
+            }
+
+            prevT     = t;
+            prevDelta = delta;
+        }
+    }
+
+    return true;
+}